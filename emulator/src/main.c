@@ -21,6 +21,11 @@
 /** Flag for the main event loop */
 static volatile bool g_main_event_loop = true;
 
+/** CPU decode and block caches and recompiler (too large for the stack) */
+static nes_cpu_cache_t g_cpu_cache;
+static nes_cpu_block_cache_t g_cpu_blocks;
+static nes_cpu_jit_t g_cpu_jit;
+
 void sigint_handler(__attribute__((unused)) int _)
 {
 	g_main_event_loop = false;
@@ -93,10 +98,50 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	/* Attach the CPU decode and block caches */
+	if ((err = nes_cpu_cache_init(&g_cpu_cache, &mem)) !=
+		    NESEMU_RETURN_SUCCESS ||
+	    (err = nes_cpu_cache_attach(&g_cpu_cache, &cpu)) !=
+		    NESEMU_RETURN_SUCCESS ||
+	    (err = nes_cpu_block_cache_init(&g_cpu_blocks, &mem)) !=
+		    NESEMU_RETURN_SUCCESS ||
+	    (err = nes_cpu_block_cache_attach(&g_cpu_blocks, &cpu)) !=
+		    NESEMU_RETURN_SUCCESS) {
+		fprintf(stderr, "Failed to initialize cpu cache, code = %04X", err);
+		return EXIT_FAILURE;
+	}
+
+	/* Pre-decode the code found by the static analysis, kept in the cache
+	 * directory given as second argument (if any) */
+	nes_cpu_analysis_t analysis;
+	if ((err = nes_cpu_analysis_load(&analysis, &cartridge,
+					 (argc > 2) ? argv[2] : NULL)) ==
+	    NESEMU_RETURN_SUCCESS) {
+		err = nes_cpu_analysis_prime(&analysis, &g_cpu_cache, &mem);
+		nes_cpu_analysis_destroy(&analysis);
+	}
+	if (err != NESEMU_RETURN_SUCCESS &&
+	    err != NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED) {
+		fprintf(stderr, "Failed to analyse the cartridge, code = %04X",
+			err);
+		return EXIT_FAILURE;
+	}
+
+	/* Translate hot blocks when the recompiler is available */
+	bool jit = false;
+	if ((err = nes_cpu_jit_init(&g_cpu_jit, NESEMU_CPU_JIT_BUFFER_SIZE)) ==
+	    NESEMU_RETURN_SUCCESS) {
+		nes_cpu_jit_attach(&g_cpu_jit, &cpu);
+		jit = true;
+	} else if (err != NESEMU_RETURN_CPU_JIT_UNSUPPORTED) {
+		fprintf(stderr, "Failed to initialize cpu jit, code = %04X", err);
+		return EXIT_FAILURE;
+	}
+
 	/* Initialize PPU */
 	nes_ppu_system_palette_t palette = NESEMU_PALETTE_STANDARD;
 	nes_ppu_t ppu;
-	if ((err = nes_ppu_init(&ppu, &palette, &mem)) !=
+	if ((err = nes_ppu_init(&ppu, &palette, &mem, &vim)) !=
 	    NESEMU_RETURN_SUCCESS) {
 		fprintf(stderr, "Failed to initialize cpu, code = %04X", err);
 		return EXIT_FAILURE;
@@ -131,6 +176,10 @@ int main(int argc, char *argv[])
 		// Let the PPU render the frame
 		int ppu_cycles = 0;
 		err = nes_ppu_render(&ppu, &framebuffer, &mem, &vim, &ppu_cycles);
+		if (err == NESEMU_RETURN_SUCCESS) {
+			// Trusted builds leave video memory errors in a sticky slot
+			err = nes_vram_error(&vim);
+		}
 		if (err != NESEMU_RETURN_SUCCESS) {
 			fprintf(stderr, "nesemu: PPU failed to execute");
 			break; /* Exit main loop */
@@ -155,18 +204,19 @@ int main(int argc, char *argv[])
 			       (Vector2){ 0, 0 }, .0f, WHITE);
 		EndDrawing();
 
-		// Catch up with the ppu
+		// VBlank NMI, delivered before the CPU catches up
+		if (ppu.nmi) {
+			ppu.nmi = false;
+			nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI,
+					       cpu.clock);
+		}
+
+		// Catch up with the ppu (3 PPU cycles per CPU cycle)
 		int cpu_cycles = 0;
-		while ((3 * cpu_cycles) < ppu_cycles) {
-			// Execute next instruction
-			int instruction_cpu_cycles = 0;
-			err = nes_cpu_next(&cpu, &mem, &instruction_cpu_cycles);
-			if (err != NESEMU_RETURN_SUCCESS) {
-				fprintf(stderr, "nesemu: cpu execution error (%d)", (int)err);
-				g_main_event_loop = false; /* Exit main event loop */
-				break;
-			}
-			cpu_cycles += instruction_cpu_cycles;
+		err = nes_cpu_run(&cpu, &mem, (ppu_cycles + 2) / 3, &cpu_cycles);
+		if (err != NESEMU_RETURN_SUCCESS) {
+			fprintf(stderr, "nesemu: cpu execution error (%d)", (int)err);
+			g_main_event_loop = false; /* Exit main event loop */
 		}
 
 		// CPU was stopped
@@ -176,6 +226,9 @@ int main(int argc, char *argv[])
 	}
 
 	CloseWindow();
+	if (jit) {
+		nes_cpu_jit_destroy(&g_cpu_jit);
+	}
 	return EXIT_SUCCESS;
 }
 
@@ -165,6 +165,23 @@ typedef struct nes_cartridge {
      */
 	nes_cartridge_write_t prg_write_fn;
 
+	/**
+     * Callback method to map a PRG ROM window address into its PRG ROM
+     * offset (current bank).
+     *
+     * @note Optional field, leave as NULL if the coverage does not need to
+     * tell PRG ROM banks apart (see 'nes_cpu_coverage_init').
+     */
+	nes_cartridge_offset_t prg_offset_fn;
+
+	/**
+     * Callback method to get the memory mapped at a PRG page (current bank),
+     * for the page table of the bus.
+     *
+     * @note Optional field, leave as NULL to use the r/w callbacks only.
+     */
+	nes_cartridge_page_t prg_page_fn;
+
 	/**
      * Method to load video data into the cartridge struct
      * Should be called at an offset (no header data nor prgrom data)
@@ -186,6 +203,14 @@ typedef struct nes_cartridge {
      */
 	nes_cartridge_mapper_t chr_mapper_fn;
 
+	/**
+     * Callback method to get the memory mapped at a pattern table page
+     * ($0000-$1FFF), for the block transfers of the video memory bus.
+     *
+     * @note Optional field, leave as NULL to use the r/w callbacks only.
+     */
+	nes_cartridge_page_t chr_page_fn;
+
 	/**
      * Method to write into cartridge's chrram.
      *
@@ -195,6 +220,20 @@ typedef struct nes_cartridge {
      */
 	nes_cartridge_write_t chr_write_fn;
 
+	/* -- Mapping State -- */
+
+	/**
+     * Size in bytes of the PRG ROM data (every bank)
+     */
+	uint32_t prg_size;
+
+	/**
+     * PRG mapping version. Mappers must increment it every time a bank switch
+     * remaps the PRG ROM window, the page table of the bus is rebuilt and
+     * CPU decode caches are invalidated when it changes.
+     */
+	uint32_t prg_version;
+
 } nes_cartridge_t;
 
 /**
@@ -21,6 +21,11 @@
  */
 #define NESEMU_CARTRIDGE_RAM_BEGIN 0x6000
 
+/**
+ * Size of the cartridge RAM window ($6000-$7FFF)
+ */
+#define NESEMU_CARTRIDGE_RAM_SIZE 0x2000
+
 /**
  * Initial address for the cartridge ROM
  */
@@ -146,4 +151,44 @@ typedef nesemu_return_t (*nes_cartridge_mapper_t)(
 	uint16_t addr,
 	uint16_t *mapped);
 
+/**
+ * Function type for a function that maps a CPU address within the PRG ROM
+ * window ($8000-$FFFF) into an offset of the PRG ROM data, given the
+ * current bank mapping.
+ *
+ * Should be implemented by each mapper type.
+ *
+ * You can use a reference to the cartridge variant type instead of
+ * `nesemu_mapper_generic_ref_t` but you'll need to cast the function pointer.
+ *
+ * @param offset Pointer to an integer where the PRG ROM offset will be stored
+ */
+typedef nesemu_return_t (*nes_cartridge_offset_t)(
+	nesemu_mapper_generic_ref_t self,
+	uint16_t addr,
+	uint32_t *offset);
+
+/**
+ * Function type for a function that gives the memory mapped at the 256-byte
+ * page of `addr` (page aligned), given the current bank mapping. The bus
+ * reads and writes through these pointers directly instead of calling the
+ * r/w callbacks.
+ *
+ * Should be implemented by each mapper type. Pages with registers (or any
+ * side effect) must be left as NULL.
+ *
+ * You can use a reference to the cartridge variant type instead of
+ * `nesemu_mapper_generic_ref_t` but you'll need to cast the function pointer.
+ *
+ * @param read Pointer to where the readable memory will be stored (NULL if
+ * reads go through the callback)
+ * @param write Pointer to where the writable memory will be stored (NULL if
+ * writes go through the callback)
+ */
+typedef nesemu_return_t (*nes_cartridge_page_t)(
+	nesemu_mapper_generic_ref_t self,
+	uint16_t addr,
+	const uint8_t **read,
+	uint8_t **write);
+
 #endif
@@ -45,6 +45,15 @@ nesemu_return_t nes_ines_nrom_prg_reader(struct nes_ines_nrom_cartridge *self,
 					 uint16_t addr,
 					 uint8_t *content);
 
+nesemu_return_t nes_ines_nrom_prg_offset(struct nes_ines_nrom_cartridge *self,
+					 uint16_t addr,
+					 uint32_t *offset);
+
+nesemu_return_t nes_ines_nrom_prg_page(struct nes_ines_nrom_cartridge *self,
+				       uint16_t addr,
+				       const uint8_t **read,
+				       uint8_t **write);
+
 /* No PRG writer as there is no external vram nor PRGRAM in this mapping */
 #define nes_ines_nrom_prg_writer NULL;
 
@@ -56,6 +65,11 @@ nesemu_return_t nes_ines_nrom_chr_reader(struct nes_ines_nrom_cartridge *self,
 					 uint16_t addr,
 					 uint8_t *content);
 
+nesemu_return_t nes_ines_nrom_chr_page(struct nes_ines_nrom_cartridge *self,
+				       uint16_t addr,
+				       const uint8_t **read,
+				       uint8_t **write);
+
 /* No CHR writer as there is no external vram nor CHRRAM in this mapping */
 #define nes_ines_nrom_chr_writer NULL;
 
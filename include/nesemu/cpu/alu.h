@@ -0,0 +1,91 @@
+/**
+ * Precomputed ALU results and status flags (optional)
+ *
+ * ADC, SBC, CMP/CPX/CPY and the shift/rotate instructions read their result
+ * and flags from tables instead of computing them, so each operation is a
+ * single load plus a status merge. The tables take ~580 KiB of RAM.
+ *
+ * Build with -DNESEMU_CPU_ALU_TABLES=ON, otherwise nothing is allocated and
+ * the handlers compute every flag.
+ */
+
+#ifndef __NESEMU_CPU_ALU_H__
+#define __NESEMU_CPU_ALU_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/util/error.h"
+
+#include <stdint.h>
+
+/**
+ * Index into the ADC/SBC ('carry' is 0 or 1) and compare tables
+ */
+#define NESEMU_CPU_ALU_INDEX(carry, reg, memory) \
+	(((uint32_t)(carry) << 16) | ((uint32_t)(reg) << 8) | (uint32_t)(memory))
+
+/**
+ * A precomputed operation
+ */
+typedef struct nes_cpu_alu_entry {
+	uint8_t result; /**< Result of the operation */
+	uint8_t flags; /**< Status flags set by the operation */
+} nes_cpu_alu_entry_t;
+
+/**
+ * Shift and rotate tables
+ */
+enum nes_cpu_alu_shift {
+	NESEMU_CPU_ALU_ASL = 0,
+	NESEMU_CPU_ALU_LSR,
+	NESEMU_CPU_ALU_ROL,
+	NESEMU_CPU_ALU_ROR,
+	NESEMU_CPU_ALU_SHIFT_COUNT,
+};
+
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+
+/**
+ * ADC and SBC keyed by carry, accumulator and memory. Flags hold C and V
+ * (replaced) and N and Z (added).
+ */
+extern struct nes_cpu_alu_entry nes_cpu_alu_adc[2 * 256 * 256];
+extern struct nes_cpu_alu_entry nes_cpu_alu_sbc[2 * 256 * 256];
+
+/**
+ * CMP, CPX and CPY keyed by register and memory (carry is always 0),
+ * only the flags are stored
+ */
+extern uint8_t nes_cpu_alu_cmp[256 * 256];
+
+/**
+ * ASL, LSR, ROL and ROR keyed by value. Flags hold C (replaced) and N and Z
+ * (added).
+ *
+ * @note Rotates in this core do not read the carry in, see 'decode.c'
+ */
+extern struct nes_cpu_alu_entry nes_cpu_alu_shift[NESEMU_CPU_ALU_SHIFT_COUNT]
+						[256];
+
+#endif
+
+/**
+ * Fill the tables, only the first call does any work. Safe to call from
+ * several threads, every caller returns once the tables are complete.
+ *
+ * @note Called by 'nes_cpu_init'
+ */
+nesemu_return_t nes_cpu_alu_init(void);
+
+/**
+ * Merge the flags of a precomputed operation into $status
+ *
+ * @param replaced Flags the operation always overwrites (set or clear)
+ */
+static inline void nes_cpu_alu_status(struct nes_cpu *self,
+				      uint8_t flags,
+				      uint8_t replaced)
+{
+	self->status = (uint8_t)((self->status & ~replaced) | flags);
+}
+
+#endif
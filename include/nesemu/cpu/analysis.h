@@ -0,0 +1,137 @@
+/**
+ * Static analysis of the PRG ROM window (optional)
+ *
+ * Code is found by tracing every reachable instruction from the reset, NMI
+ * and IRQ vectors (recursive descent, indirect jumps are not followed). The
+ * result is a map of flags per PRG ROM address: instruction and operand
+ * bytes (anything else is data), basic-block starts (blocks end after the
+ * terminators of 'block.h') and the targets of branches, jumps and calls.
+ *
+ * Maps are stored in a cache directory, one file per PRG ROM hash, and are
+ * memory-mapped by the next load of the same ROM so a warm start skips the
+ * analysis. A file is only used if its magic, format version, size and hash
+ * match, any other file is ignored and replaced.
+ *
+ * Build with -DNESEMU_CPU_ANALYSIS=ON (requires POSIX mmap), otherwise
+ * every function returns NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED.
+ */
+
+#ifndef __NESEMU_CPU_ANALYSIS_H__
+#define __NESEMU_CPU_ANALYSIS_H__
+
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * First address covered by the map (cartridge PRG ROM window)
+ */
+#define NESEMU_CPU_ANALYSIS_BEGIN NESEMU_CPU_CACHE_BEGIN
+
+/**
+ * Amount of addresses covered by the map
+ */
+#define NESEMU_CPU_ANALYSIS_SIZE NESEMU_CPU_CACHE_SIZE
+
+/**
+ * Magic at the start of a cache file
+ */
+#define NESEMU_CPU_ANALYSIS_MAGIC "NESANA01"
+
+/**
+ * Format version of the cache files, bump it whenever the layout of
+ * 'struct nes_cpu_analysis_map' or the analysis itself changes
+ */
+#define NESEMU_CPU_ANALYSIS_VERSION 1
+
+/**
+ * Extension of the cache files, named after the hexadecimal PRG ROM hash
+ */
+#define NESEMU_CPU_ANALYSIS_EXTENSION ".nesana"
+
+/**
+ * Flags of a PRG ROM address
+ */
+enum nes_cpu_analysis_flags {
+	NESEMU_CPU_ANALYSIS_CODE = 0x01, /**< Opcode of an instruction */
+	NESEMU_CPU_ANALYSIS_OPERAND = 0x02, /**< Operand of an instruction */
+	NESEMU_CPU_ANALYSIS_BLOCK = 0x04, /**< First instruction of a block */
+	NESEMU_CPU_ANALYSIS_TARGET = 0x08, /**< Branch, jump or call target */
+	NESEMU_CPU_ANALYSIS_VECTOR = 0x10, /**< Reset, NMI or IRQ handler */
+};
+
+/**
+ * Analysis result, also the layout of a cache file (host endianness)
+ */
+typedef struct nes_cpu_analysis_map {
+	char magic[8]; /**< NESEMU_CPU_ANALYSIS_MAGIC (no terminator) */
+	uint32_t version; /**< NESEMU_CPU_ANALYSIS_VERSION */
+	uint32_t size; /**< Size of this structure */
+	uint64_t hash; /**< FNV-1a hash of the PRG ROM window */
+	uint32_t instructions; /**< Amount of instructions found */
+	uint32_t blocks; /**< Amount of basic blocks found */
+	uint32_t targets; /**< Amount of branch, jump and call targets */
+	uint32_t reserved; /**< Always zero */
+
+	/**
+     * Flags per address, indexed by (address - NESEMU_CPU_ANALYSIS_BEGIN),
+     * see 'enum nes_cpu_analysis_flags'
+     */
+	uint8_t flags[NESEMU_CPU_ANALYSIS_SIZE];
+
+} nes_cpu_analysis_map_t;
+
+/**
+ * Analysis of a cartridge
+ */
+typedef struct nes_cpu_analysis {
+	/**
+     * Result, read-only (NULL before loading)
+     */
+	const struct nes_cpu_analysis_map *map;
+
+	/**
+     * The map is a cache file mapped in memory (otherwise it was allocated
+     * by the analysis)
+     */
+	bool mapped;
+
+} nes_cpu_analysis_t;
+
+/**
+ * Load the analysis of the PRG ROM currently mapped by the cartridge
+ *
+ * The cache file of the ROM is mapped if it is valid, otherwise the ROM is
+ * analysed and a new cache file is written.
+ *
+ * @param dir Cache directory, must exist (NULL to always analyse)
+ *
+ * @note Writing the cache file is best effort, an unwritable directory only
+ * costs the analysis on the next load
+ * @note Release it with 'nes_cpu_analysis_destroy'
+ */
+nesemu_return_t nes_cpu_analysis_load(struct nes_cpu_analysis *self,
+				      struct nes_cartridge *cartridge,
+				      const char *dir);
+
+/**
+ * Unmap (or release) the map
+ */
+nesemu_return_t nes_cpu_analysis_destroy(struct nes_cpu_analysis *self);
+
+/**
+ * Decode every instruction found by the analysis into the decode cache, so
+ * that code reached from the vectors never misses
+ *
+ * @note The cache must be initialized for the cartridge the analysis was
+ * loaded from, with the same PRG ROM mapping
+ */
+nesemu_return_t nes_cpu_analysis_prime(const struct nes_cpu_analysis *self,
+				       struct nes_cpu_cache *cache,
+				       struct nes_mem_main *mem);
+
+#endif
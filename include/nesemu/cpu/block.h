@@ -0,0 +1,162 @@
+/**
+ * Basic-block cache used by 'nes_cpu_run'
+ *
+ * A basic block is a straight-line run of instructions that ends at the first
+ * instruction that changes $pc (branch, JMP, JSR, RTS, RTI, BRK or STP).
+ *
+ * Frequent instruction sequences inside a block are replaced with
+ * superinstructions (see 'NESEMU_CPU_FUSED_PAIR_LIST'), executed with a
+ * single dispatch.
+ *
+ * Blocks that branch back to themselves without writing memory and only
+ * read plain RAM, ROM or PPUSTATUS (polling loops like
+ * `wait: BIT $2002; BPL wait`, `wait: LDA $10; BEQ wait` or `JMP *`) are
+ * fast-forwarded by 'nes_cpu_run' once an iteration leaves the registers
+ * and the PPU state untouched, nothing but the caller can change what they
+ * read until the run returns or the next interrupt is raised. Loops
+ * reading any other register (`wait: LDA $4016; BEQ wait`) are executed,
+ * each read has its side effects.
+ */
+
+#ifndef __NESEMU_CPU_BLOCK_H__
+#define __NESEMU_CPU_BLOCK_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * First address where blocks are discovered (cartridge PRG ROM window)
+ */
+#define NESEMU_CPU_BLOCK_BEGIN NESEMU_CPU_CACHE_BEGIN
+
+/**
+ * Amount of addresses covered by the block index
+ */
+#define NESEMU_CPU_BLOCK_INDEX_SIZE NESEMU_CPU_CACHE_SIZE
+
+/**
+ * Maximum amount of instructions in a single block
+ */
+#define NESEMU_CPU_BLOCK_MAX_LENGTH 32
+
+/**
+ * Amount of blocks in the pool, the whole cache is flushed when it fills up
+ */
+#define NESEMU_CPU_BLOCK_POOL_SIZE 1024
+
+/**
+ * Successor link slots of a block
+ */
+enum nes_cpu_block_link {
+	NESEMU_CPU_BLOCK_LINK_FALLTHROUGH = 0, /**< $pc after the last instruction */
+	NESEMU_CPU_BLOCK_LINK_TARGET = 1, /**< Last taken (or dynamic) target */
+};
+
+/**
+ * A decoded basic block
+ */
+typedef struct nes_cpu_block {
+	uint16_t pc; /**< Address of the first instruction */
+	uint16_t end; /**< Address after the last instruction */
+	uint16_t cycles; /**< Base cycles of every instruction */
+	uint16_t max_cycles; /**< Worst case cycles (page crossings, branches) */
+	uint8_t length; /**< Amount of entries (superinstructions count once) */
+	uint16_t hits; /**< Executions, used to find hot blocks */
+	bool polling; /**< Loops back to 'pc' without side effects */
+	const void *native; /**< Native translation, see 'jit.h' (or NULL) */
+
+	/**
+     * Successor blocks, always validated against $pc before being followed
+     */
+	struct nes_cpu_block *next[2];
+
+	/**
+     * Pre-decoded instructions
+     */
+	struct nes_cpu_cache_entry insts[NESEMU_CPU_BLOCK_MAX_LENGTH];
+
+} nes_cpu_block_t;
+
+/**
+ * Basic-block cache for code executing from PRG ROM ($8000-$FFFF)
+ *
+ * Blocks are discovered lazily by 'nes_cpu_run'. The cache is flushed when
+ * the pool fills up or the cartridge PRG mapping version changes.
+ *
+ * @note This structure is large (~560 KiB), avoid allocating it on the stack
+ */
+typedef struct nes_cpu_block_cache {
+	/**
+     * Block (index + 1) starting at each address, 0 if none
+     */
+	uint16_t index[NESEMU_CPU_BLOCK_INDEX_SIZE];
+
+	/**
+     * Block pool
+     */
+	struct nes_cpu_block blocks[NESEMU_CPU_BLOCK_POOL_SIZE];
+
+	/**
+     * Amount of blocks in use
+     */
+	uint16_t count;
+
+	/**
+     * Incremented on every flush
+     */
+	uint32_t generation;
+
+	/**
+     * Cartridge PRG mapping version the blocks were decoded with
+     */
+	uint32_t prg_version;
+
+} nes_cpu_block_cache_t;
+
+/**
+ * Initialize the block cache (empty) for the cartridge currently in memory
+ */
+nesemu_return_t nes_cpu_block_cache_init(struct nes_cpu_block_cache *self,
+					 struct nes_mem_main *mem);
+
+/**
+ * Attach the block cache to the CPU, discovered blocks are kept
+ *
+ * @note Call after 'nes_cpu_init', which detaches any previous cache
+ * @note Only 'nes_cpu_run' executes blocks, 'nes_cpu_next' always steps
+ */
+nesemu_return_t nes_cpu_block_cache_attach(struct nes_cpu_block_cache *self,
+					   struct nes_cpu *cpu);
+
+/**
+ * Remove every block (and link) from the cache
+ */
+void nes_cpu_block_cache_flush(struct nes_cpu_block_cache *self);
+
+/**
+ * Check if an instruction ends a basic block (changes $pc)
+ */
+static inline bool nes_cpu_block_terminator(uint8_t opcode)
+{
+	switch (opcode) {
+	case JMP_AB:
+	case JMP_IN:
+	case JSR:
+	case RTS:
+	case RTI:
+	case BRK:
+	case STP:
+		return true;
+
+	default:
+		return nes_cpu_opcodes[opcode].addressing ==
+		       NESEMU_ADDRESSING_RELATIVE;
+	}
+}
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * Pre-decoded instruction cache for code executing from cartridge PRG ROM
+ */
+
+#ifndef __NESEMU_CPU_CACHE_H__
+#define __NESEMU_CPU_CACHE_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/util/error.h"
+
+#include <stdint.h>
+
+/**
+ * First address covered by the decode cache (cartridge PRG ROM window)
+ */
+#define NESEMU_CPU_CACHE_BEGIN 0x8000
+
+/**
+ * Amount of entries in the decode cache, one per PRG ROM address
+ */
+#define NESEMU_CPU_CACHE_SIZE 0x8000
+
+/**
+ * A single decoded instruction
+ */
+typedef struct nes_cpu_cache_entry {
+	nes_cpu_handler_t handler; /**< Specialized handler (NULL if empty) */
+	uint32_t operand; /**< Operand already assembled (packed if fused) */
+	uint8_t opcode; /**< Instruction opcode (first one if fused) */
+	uint8_t length; /**< Instruction length in bytes (opcode included) */
+	uint8_t cycles; /**< Base CPU cycles */
+	uint8_t fused; /**< Superinstruction, see 'enum nes_cpu_fused_id' */
+} nes_cpu_cache_entry_t;
+
+/**
+ * Decode cache keyed by $pc for addresses in the PRG ROM window
+ * ($8000-$FFFF), entries are built lazily the first time an instruction
+ * is executed. Code executing from RAM always uses the normal fetch path.
+ *
+ * The cache is invalidated whenever the cartridge PRG mapping version
+ * changes (bank switching).
+ *
+ * @note This structure is large (512 KiB), avoid allocating it on the stack
+ */
+typedef struct nes_cpu_cache {
+	/**
+     * Decoded instructions, indexed by ($pc - NESEMU_CPU_CACHE_BEGIN)
+     */
+	struct nes_cpu_cache_entry entries[NESEMU_CPU_CACHE_SIZE];
+
+	/**
+     * Cartridge PRG mapping version the entries were decoded with
+     */
+	uint32_t prg_version;
+
+} nes_cpu_cache_t;
+
+/**
+ * Initialize the cache (empty) for the cartridge currently in memory
+ */
+nesemu_return_t nes_cpu_cache_init(struct nes_cpu_cache *self,
+				   struct nes_mem_main *mem);
+
+/**
+ * Attach the cache to the CPU, decoded entries are kept
+ *
+ * @note Call after 'nes_cpu_init', which detaches any previous cache
+ */
+nesemu_return_t nes_cpu_cache_attach(struct nes_cpu_cache *self,
+				     struct nes_cpu *cpu);
+
+/**
+ * Decode the instruction at 'pc' into its entry, same as a cache miss
+ *
+ * @note Instructions wrapping around $FFFF are never cached
+ * (NESEMU_RETURN_MEMORY_PRGROM_OVERFLOW)
+ */
+nesemu_return_t nes_cpu_cache_decode(struct nes_cpu_cache *self,
+				     struct nes_mem_main *mem,
+				     uint16_t pc);
+
+/**
+ * Remove every decoded instruction from the cache
+ */
+void nes_cpu_cache_invalidate(struct nes_cpu_cache *self);
+
+#endif
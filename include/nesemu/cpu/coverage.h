@@ -0,0 +1,217 @@
+/**
+ * Code and data coverage (optional)
+ *
+ * One bit per address and access kind: executed as an opcode, executed as
+ * an operand, read as data and written as data. Bits are kept for the whole
+ * 64 KiB CPU address space (as accessed, mirrors are distinct addresses) and
+ * for every byte of the PRG ROM, so code behind different banks at the same
+ * address is told apart.
+ *
+ * Opcode and operand bits are set by the CPU decode path (cache hits
+ * included), data bits by the bus and the stack. The reads done to decode an
+ * instruction are not data reads. The block cache and recompiler are
+ * bypassed while coverage is attached.
+ *
+ * Coverage of many runs (or instances) is combined with a bitwise OR, either
+ * in memory ('nes_cpu_coverage_merge') or from an exported file
+ * ('nes_cpu_coverage_merge_file'). The export is the raw bitmaps after a
+ * small header (host endianness).
+ *
+ * Build with -DNESEMU_CPU_COVERAGE=ON, otherwise every function returns
+ * NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED.
+ */
+
+#ifndef __NESEMU_CPU_COVERAGE_H__
+#define __NESEMU_CPU_COVERAGE_H__
+
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Magic at the start of an export
+ */
+#define NESEMU_CPU_COVERAGE_MAGIC "NESCOV01"
+
+/**
+ * Format version of the exports
+ */
+#define NESEMU_CPU_COVERAGE_VERSION 1
+
+/**
+ * Size in bytes of a CPU address space bitmap
+ */
+#define NESEMU_CPU_COVERAGE_CPU_BYTES (0x10000 / 8)
+
+/**
+ * Access kinds, also the bitmap index
+ */
+enum nes_cpu_coverage_kind {
+	NESEMU_CPU_COVERAGE_OPCODE = 0, /**< Executed, first byte */
+	NESEMU_CPU_COVERAGE_OPERAND, /**< Executed, operand bytes */
+	NESEMU_CPU_COVERAGE_READ, /**< Read as data */
+	NESEMU_CPU_COVERAGE_WRITE, /**< Written as data */
+	NESEMU_CPU_COVERAGE_KINDS,
+};
+
+/**
+ * Header of an export, followed by the CPU bitmaps and the PRG ROM bitmaps
+ * (one per kind, in 'enum nes_cpu_coverage_kind' order)
+ */
+typedef struct nes_cpu_coverage_header {
+	char magic[8]; /**< NESEMU_CPU_COVERAGE_MAGIC (no terminator) */
+	uint32_t version; /**< NESEMU_CPU_COVERAGE_VERSION */
+	uint32_t prg_size; /**< PRG ROM size in bytes (bits per PRG bitmap) */
+} nes_cpu_coverage_header_t;
+
+/**
+ * Coverage bitmaps of a cartridge
+ */
+typedef struct nes_cpu_coverage {
+	/**
+     * Bits per CPU address, bit (addr & 7) of byte (addr >> 3)
+     */
+	uint8_t cpu[NESEMU_CPU_COVERAGE_KINDS][NESEMU_CPU_COVERAGE_CPU_BYTES];
+
+	/**
+     * Bits per PRG ROM offset, NESEMU_CPU_COVERAGE_KINDS bitmaps of
+     * 'prg_bytes' bytes each (allocated by 'nes_cpu_coverage_init')
+     */
+	uint8_t *prg;
+	uint32_t prg_bytes;
+
+	/**
+     * Cartridge mapping the PRG ROM window
+     */
+	struct nes_cartridge *cartridge;
+
+	/**
+     * Bus this coverage is attached to (NULL if detached)
+     */
+	struct nes_mem_main *mem;
+
+	/**
+     * Bus accesses are not recorded (instruction decoding)
+     */
+	bool muted;
+
+} nes_cpu_coverage_t;
+
+/**
+ * Allocate empty bitmaps for the PRG ROM of the cartridge
+ *
+ * @note Without 'prg_offset_fn' (or PRG ROM) in the cartridge only the CPU
+ * bitmaps are kept: 'prg' is NULL and 'nes_cpu_coverage_test_prg' is
+ * always false
+ * @note Release them with 'nes_cpu_coverage_destroy'
+ */
+nesemu_return_t nes_cpu_coverage_init(struct nes_cpu_coverage *self,
+				      struct nes_cartridge *cartridge);
+
+/**
+ * Detach and release the bitmaps
+ */
+nesemu_return_t nes_cpu_coverage_destroy(struct nes_cpu_coverage *self);
+
+/**
+ * Clear every bit
+ */
+nesemu_return_t nes_cpu_coverage_reset(struct nes_cpu_coverage *self);
+
+/**
+ * Record the accesses of a bus (and of the CPU decoding through it)
+ *
+ * @note Call after 'nes_mem_init', which detaches any previous coverage
+ */
+nesemu_return_t nes_cpu_coverage_attach(struct nes_cpu_coverage *self,
+					struct nes_mem_main *mem);
+
+/**
+ * Stop recording, bits are kept
+ */
+nesemu_return_t nes_cpu_coverage_detach(struct nes_cpu_coverage *self);
+
+/**
+ * Add the bits of 'other' (same PRG ROM size) to 'self'
+ */
+nesemu_return_t nes_cpu_coverage_merge(struct nes_cpu_coverage *self,
+				       const struct nes_cpu_coverage *other);
+
+/**
+ * Write the bitmaps as an export
+ */
+nesemu_return_t nes_cpu_coverage_save(const struct nes_cpu_coverage *self,
+				      FILE *f);
+
+/**
+ * Add the bits of an export (same PRG ROM size) to 'self'
+ *
+ * @return NESEMU_RETURN_CPU_COVERAGE_MISMATCH if 'f' is not an export of
+ * this format or PRG ROM size, 'self' is left untouched
+ */
+nesemu_return_t nes_cpu_coverage_merge_file(struct nes_cpu_coverage *self,
+					    FILE *f);
+
+/**
+ * Tell if a CPU address was accessed as 'kind'
+ */
+bool nes_cpu_coverage_test(const struct nes_cpu_coverage *self,
+			   uint16_t addr,
+			   enum nes_cpu_coverage_kind kind);
+
+/**
+ * Tell if a PRG ROM offset was accessed as 'kind'
+ */
+bool nes_cpu_coverage_test_prg(const struct nes_cpu_coverage *self,
+			       uint32_t offset,
+			       enum nes_cpu_coverage_kind kind);
+
+/**
+ * Amount of CPU addresses accessed as 'kind'
+ */
+uint32_t nes_cpu_coverage_count(const struct nes_cpu_coverage *self,
+				enum nes_cpu_coverage_kind kind);
+
+/**
+ * Record an access to a PRG ROM window address in the bitmap of its bank
+ */
+void nes_cpu_coverage_mark_prg(struct nes_cpu_coverage *self,
+			       uint16_t addr,
+			       enum nes_cpu_coverage_kind kind);
+
+/**
+ * Record an access
+ */
+static inline void nes_cpu_coverage_mark(struct nes_cpu_coverage *self,
+					 uint16_t addr,
+					 enum nes_cpu_coverage_kind kind)
+{
+	self->cpu[kind][addr >> 3] |= (uint8_t)(1 << (addr & 7));
+	if (addr >= NESEMU_CARTRIDGE_ROM_BEGIN) {
+		nes_cpu_coverage_mark_prg(self, addr, kind);
+	}
+}
+
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+/**
+ * Record a data access of the bus (if coverage is attached)
+ *
+ * @note Called by the slow path of the bus (every page while attached) and
+ * by the stack
+ */
+static inline void nes_cpu_coverage_access(struct nes_mem_main *mem,
+					   uint16_t addr,
+					   enum nes_cpu_coverage_kind kind)
+{
+	struct nes_cpu_coverage *self = mem->coverage;
+	if (self != NULL && !self->muted) {
+		nes_cpu_coverage_mark(self, addr, kind);
+	}
+}
+#endif
+
+#endif
@@ -13,6 +13,15 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Forward declarations, see 'cache.h', 'block.h', 'jit.h', 'profile.h',
+ * 'trace.h' and 'debug.h' */
+struct nes_cpu_cache;
+struct nes_cpu_block_cache;
+struct nes_cpu_jit;
+struct nes_cpu_profile;
+struct nes_cpu_trace;
+struct nes_debugger;
+
 /**
  * When restarting the SP should be decreased
  * by this exact amount
@@ -24,6 +33,26 @@
  */
 #define NESEMU_CPU_IRQ_ADDR (uint16_t)0xFFFE
 
+/**
+ * CPU cycles taken to deliver an interrupt (NMI or IRQ)
+ */
+#define NESEMU_CPU_INTERRUPT_CYCLES 7
+
+/**
+ * Timestamp of an event that is not scheduled
+ */
+#define NESEMU_CPU_EVENT_NEVER UINT64_MAX
+
+/**
+ * Interrupt sources, raised by the scheduler at their timestamp
+ */
+enum nes_cpu_event {
+	NESEMU_CPU_EVENT_NMI = 0, /**< PPU VBlank NMI (edge triggered) */
+	NESEMU_CPU_EVENT_IRQ_MAPPER, /**< Cartridge mapper IRQ (level) */
+	NESEMU_CPU_EVENT_IRQ_APU, /**< APU frame counter IRQ (level) */
+	NESEMU_CPU_EVENT_COUNT,
+};
+
 /**
  * 6502 CPU variant.
  * You should not access any of the registers directly.
@@ -40,11 +69,42 @@ typedef struct nes_cpu {
 	uint8_t a; /**< Accumulator */
 	uint8_t x; /**< Index Register X */
 	uint8_t y; /**< Index Register Y */
-	uint8_t status; /**< Processor Status */
+	uint8_t status; /**< Processor Status (see 'nes_cpu_status_sync') */
 
 	/* Support */
 	bool stop; /**< Stop execution flag (use STP instruction) */
 	uint8_t brk; /**< BRK Reason (0xFF on internal error) */
+	struct nes_cpu_cache *cache; /**< Decode cache (NULL if disabled) */
+	struct nes_cpu_block_cache *blocks; /**< Block cache (NULL if disabled) */
+	struct nes_cpu_jit *jit; /**< Block recompiler (NULL if disabled) */
+
+	/* Lazy flags */
+#ifdef CONFIG_NESEMU_CPU_LAZY_FLAGS
+	uint8_t lazy_n; /**< OR of the pending results (N flag) */
+	bool lazy_z; /**< A pending result was zero (Z flag) */
+#endif
+
+	/* Clock and scheduler */
+	uint64_t clock; /**< Master clock, CPU cycles since power-up */
+	uint64_t next_event; /**< Earliest event timestamp, see 'events' */
+	uint64_t events[NESEMU_CPU_EVENT_COUNT]; /**< Timestamp per source */
+	uint8_t irq; /**< Asserted IRQ lines (1 << 'enum nes_cpu_event') */
+
+	/* Profiler */
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	struct nes_cpu_profile *profile; /**< Counters (NULL if detached) */
+#endif
+
+	/* Trace */
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	struct nes_cpu_trace *trace; /**< Ring buffer (NULL if detached) */
+#endif
+
+	/* Debugger */
+#ifdef CONFIG_NESEMU_DEBUGGER
+	struct nes_debugger *debugger; /**< Breakpoints (NULL if detached) */
+	bool halt; /**< A watchpoint was hit, stop at the next event check */
+#endif
 
     /* Debug */
 #ifdef CONFIG_NESEMU_DEBUG
@@ -77,16 +137,102 @@ nesemu_return_t nes_cpu_reset(struct nes_cpu *self,
  * @param cycles Reference to an integer where the amount of CPU cycles
  * for the decoded instruction will be stored
  *
- * @note Will execute the instruction at $PC and then return
+ * @note Will execute the instruction at $PC and then return, or deliver the
+ * pending interrupt instead (see 'nes_cpu_event_schedule')
  */
 nesemu_return_t nes_cpu_next(struct nes_cpu *self,
 			     struct nes_mem_main *mem,
 			     int *cycles);
 
+/**
+ * Process instructions until the cycle budget is consumed, the CPU is
+ * stopped or an error occurs.
+ *
+ * Registers are kept in a local copy of the CPU for the whole run and
+ * arguments are only checked once, prefer this function over calling
+ * 'nes_cpu_next' in a loop. Scheduled interrupts are delivered at the
+ * first instruction boundary at or after their timestamp.
+ *
+ * @param self Reference to the CPU structure
+ * @param mem System memory
+ * @param budget Amount of CPU cycles to execute, the last instruction may
+ * exceed it
+ * @param cycles Reference to an integer where the amount of CPU cycles
+ * actually executed will be stored
+ */
+nesemu_return_t nes_cpu_run(struct nes_cpu *self,
+			    struct nes_mem_main *mem,
+			    int budget,
+			    int *cycles);
+
+/**
+ * Raise an interrupt once the master clock reaches 'at', replacing any
+ * previous timestamp of the same source
+ *
+ * NMIs are delivered at the first instruction boundary at or after 'at'.
+ * IRQ sources assert their line at 'at' and keep it asserted (delivered
+ * whenever the I flag is clear) until 'nes_cpu_irq_release'.
+ *
+ * @note 'nes_cpu_run' only looks at the events when 'next_event' is crossed
+ */
+nesemu_return_t nes_cpu_event_schedule(struct nes_cpu *self,
+				       enum nes_cpu_event event,
+				       uint64_t at);
+
+/**
+ * Remove a scheduled event (an already asserted IRQ line is kept)
+ */
+nesemu_return_t nes_cpu_event_cancel(struct nes_cpu *self,
+				     enum nes_cpu_event event);
+
+/**
+ * Release the IRQ line of a source (the handler acknowledged it)
+ */
+nesemu_return_t nes_cpu_irq_release(struct nes_cpu *self,
+				    enum nes_cpu_event event);
+
+/**
+ * Earliest timestamp where the events have to be checked, the current
+ * clock while an IRQ line is asserted (it may get unmasked at any time) or
+ * the debugger waits to stop the CPU
+ */
+static inline uint64_t nes_cpu_event_next(const struct nes_cpu *self)
+{
+	if (self->irq != 0) {
+		return self->clock;
+	}
+#ifdef CONFIG_NESEMU_DEBUGGER
+	if (self->halt) {
+		return self->clock;
+	}
+#endif
+
+	uint64_t next = NESEMU_CPU_EVENT_NEVER;
+	for (int i = 0; i < NESEMU_CPU_EVENT_COUNT; i++) {
+		if (self->events[i] < next) {
+			next = self->events[i];
+		}
+	}
+
+	return next;
+}
+
 /**
  * Fetch the next word from memory at $pc and increment $pc
  */
-uint8_t nes_cpu_fetch(struct nes_cpu *self, struct nes_mem_main *mem);
+static inline uint8_t nes_cpu_fetch(struct nes_cpu *self,
+				    struct nes_mem_main *mem)
+{
+	// Get next instruction, no fail
+#ifdef CONFIG_NESEMU_TRUSTED
+	return nes_mem_read8(mem, self->pc++);
+#else
+	uint8_t result;
+	(void)nes_mem_r8(mem, self->pc++, &result);
+
+	return result;
+#endif
+}
 
 /**
  * Set CPU status register given a bit mask
@@ -105,4 +251,63 @@ static inline void nes_cpu_status_mask_unset(struct nes_cpu *self,
 	self->status = NESEMU_CPU_STATUS_UNSET_MASK(self->status, mask);
 }
 
+/**
+ * Update the N flag given a result
+ *
+ * @note Deferred until 'nes_cpu_status_sync' with CONFIG_NESEMU_CPU_LAZY_FLAGS
+ */
+static inline void nes_cpu_status_n(struct nes_cpu *self, uint8_t value)
+{
+#ifdef CONFIG_NESEMU_CPU_LAZY_FLAGS
+	self->lazy_n |= value;
+#else
+	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_N(value));
+#endif
+}
+
+/**
+ * Update the Z flag given a result
+ *
+ * @note Deferred until 'nes_cpu_status_sync' with CONFIG_NESEMU_CPU_LAZY_FLAGS
+ */
+static inline void nes_cpu_status_z(struct nes_cpu *self, uint8_t value)
+{
+#ifdef CONFIG_NESEMU_CPU_LAZY_FLAGS
+	self->lazy_z |= (value == 0);
+#else
+	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_Z(value));
+#endif
+}
+
+/**
+ * Update both the N & Z flags given a result
+ */
+static inline void nes_cpu_status_nz(struct nes_cpu *self, uint8_t value)
+{
+	nes_cpu_status_n(self, value);
+	nes_cpu_status_z(self, value);
+}
+
+/**
+ * Fold the pending N & Z flags into $status, call before reading it.
+ *
+ * Flags are only ever added by the instruction handlers, so the pending
+ * results can be folded at any point and in any order. Both 'nes_cpu_next'
+ * and 'nes_cpu_run' return with $status up to date.
+ *
+ * @note Does nothing without CONFIG_NESEMU_CPU_LAZY_FLAGS
+ */
+static inline void nes_cpu_status_sync(struct nes_cpu *self)
+{
+#ifdef CONFIG_NESEMU_CPU_LAZY_FLAGS
+	nes_cpu_status_mask_set(self,
+				NESEMU_CPU_STATUS_MASK_N(self->lazy_n) |
+					(self->lazy_z ? NESEMU_CPU_FLAGS_Z : 0));
+	self->lazy_n = 0;
+	self->lazy_z = false;
+#else
+	(void)self;
+#endif
+}
+
 #endif
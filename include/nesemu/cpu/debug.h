@@ -0,0 +1,206 @@
+/**
+ * Breakpoints and watchpoints (optional)
+ *
+ * Neither costs anything to the addresses they are not set on:
+ *
+ * - A breakpoint replaces the handler of its decode cache entry with
+ *   'nes_debugger_trap', which rewinds $pc and stops the CPU before the
+ *   instruction executes. Blocks end before a breakpoint, so the block cache
+ *   (and recompiler) keep running every other instruction. Only PRG ROM
+ *   addresses ($8000-$FFFF) can hold breakpoints, a decode cache has to be
+ *   attached to the CPU.
+ *
+ * - A watchpoint removes the fast path of the 256-byte pages it covers
+ *   from the page table of the bus ('watch_pages' of 'struct nes_mem_main'),
+ *   accesses to any other page are plain loads and stores. A hit raises a
+ *   CPU event, so the CPU stops at the next instruction boundary. While
+ *   watchpoints are set, 'nes_cpu_run' steps instead of executing whole
+ *   blocks, so that it stops right after the accessing instruction.
+ *
+ * Both 'nes_cpu_next' and 'nes_cpu_run' return NESEMU_INFO_CPU_BREAK when
+ * stopped, 'hit' tells why. Call 'nes_debugger_step' to execute the
+ * instruction under a breakpoint and keep going.
+ *
+ * Build with -DNESEMU_DEBUGGER=ON, otherwise every function returns
+ * NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED.
+ */
+
+#ifndef __NESEMU_CPU_DEBUG_H__
+#define __NESEMU_CPU_DEBUG_H__
+
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Maximum amount of watchpoints
+ */
+#define NESEMU_DEBUGGER_WATCHPOINTS 16
+
+/**
+ * What stopped the CPU (also the access kinds of a watchpoint)
+ */
+enum nes_debugger_kind {
+	NESEMU_DEBUGGER_NONE = 0x00, /**< Not stopped */
+	NESEMU_DEBUGGER_READ = 0x01, /**< Memory read */
+	NESEMU_DEBUGGER_WRITE = 0x02, /**< Memory write */
+	NESEMU_DEBUGGER_EXECUTE = 0x04, /**< Breakpoint */
+};
+
+/**
+ * Watched address range
+ */
+typedef struct nes_debugger_watchpoint {
+	uint16_t begin; /**< First address */
+	uint16_t end; /**< Last address (inclusive) */
+	uint8_t kinds; /**< NESEMU_DEBUGGER_READ and/or NESEMU_DEBUGGER_WRITE */
+} nes_debugger_watchpoint_t;
+
+/**
+ * Reason of the last stop
+ */
+typedef struct nes_debugger_hit {
+	enum nes_debugger_kind kind; /**< NESEMU_DEBUGGER_NONE if none */
+	uint16_t address; /**< Breakpoint or accessed address */
+	uint8_t value; /**< Value read or written (watchpoints) */
+	uint16_t pc; /**< $pc after decoding the accessing instruction */
+} nes_debugger_hit_t;
+
+/**
+ * Debugger of a CPU and its bus
+ */
+typedef struct nes_debugger {
+	/**
+     * Breakpoints, one bit per PRG ROM address
+     */
+	uint8_t breakpoints[NESEMU_CPU_CACHE_SIZE / 8];
+
+	/**
+     * Watchpoints, the first 'watch_count' are in use
+     */
+	struct nes_debugger_watchpoint watchpoints[NESEMU_DEBUGGER_WATCHPOINTS];
+	uint8_t watch_count;
+
+	/**
+     * Last stop
+     */
+	struct nes_debugger_hit hit;
+
+	/**
+     * Debugged CPU and bus
+     */
+	struct nes_cpu *cpu;
+	struct nes_mem_main *mem;
+
+	/**
+     * CPU registers being executed, the local copy of 'nes_cpu_run' while
+     * it runs, 'cpu' otherwise
+     */
+	struct nes_cpu *running;
+
+	/**
+     * The debugger is decoding an instruction, its reads are not reported
+     */
+	bool decoding;
+
+} nes_debugger_t;
+
+/**
+ * Attach a debugger (without breakpoints or watchpoints) to the CPU and
+ * its bus
+ *
+ * @note Call after 'nes_cpu_init' and after attaching the decode cache
+ */
+nesemu_return_t nes_debugger_attach(struct nes_debugger *self,
+				    struct nes_cpu *cpu,
+				    struct nes_mem_main *mem);
+
+/**
+ * Remove every breakpoint and watchpoint and detach the debugger
+ */
+nesemu_return_t nes_debugger_detach(struct nes_debugger *self);
+
+/**
+ * Stop before executing the instruction at 'addr' ($8000-$FFFF)
+ */
+nesemu_return_t nes_debugger_break_add(struct nes_debugger *self,
+				       uint16_t addr);
+
+/**
+ * Remove the breakpoint at 'addr' (if any)
+ */
+nesemu_return_t nes_debugger_break_remove(struct nes_debugger *self,
+					  uint16_t addr);
+
+/**
+ * Stop after an instruction accesses an address in [begin, end]. Work RAM
+ * addresses ($0000-$1FFF) are also hit through their mirrors.
+ *
+ * @param kinds NESEMU_DEBUGGER_READ and/or NESEMU_DEBUGGER_WRITE
+ */
+nesemu_return_t nes_debugger_watch_add(struct nes_debugger *self,
+				       uint16_t begin,
+				       uint16_t end,
+				       uint8_t kinds);
+
+/**
+ * Remove a watchpoint, same arguments as 'nes_debugger_watch_add'
+ */
+nesemu_return_t nes_debugger_watch_remove(struct nes_debugger *self,
+					  uint16_t begin,
+					  uint16_t end,
+					  uint8_t kinds);
+
+/**
+ * Execute the next instruction even if it has a breakpoint (or deliver the
+ * pending interrupt), same as 'nes_cpu_next'
+ */
+nesemu_return_t nes_debugger_step(struct nes_debugger *self, int *cycles);
+
+/**
+ * Set the breakpoints again after the decode cache was invalidated
+ *
+ * @note Called by the CPU
+ */
+void nes_debugger_rearm(struct nes_debugger *self);
+
+/**
+ * Handler of the decode cache entries with a breakpoint, the operand is
+ * the address of the instruction
+ */
+nesemu_return_t nes_debugger_trap(struct nes_cpu *self,
+				  struct nes_mem_main *mem,
+				  uint32_t operand,
+				  int *cycles);
+
+/**
+ * Slow handler of the watched pages, record a hit if a watchpoint covers
+ * the access
+ */
+void nes_debugger_watch_hit(struct nes_debugger *self,
+			    uint16_t addr,
+			    uint8_t value,
+			    enum nes_debugger_kind kind);
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+/**
+ * Hand an access to a watched page over to the debugger
+ *
+ * @note Called by the slow path of the bus (and by the stack)
+ */
+static inline void nes_debugger_watch(struct nes_mem_main *mem,
+				      uint16_t addr,
+				      uint8_t value,
+				      enum nes_debugger_kind kind)
+{
+	if (mem->watch_pages[addr >> 8] & kind) {
+		nes_debugger_watch_hit(mem->debugger, addr, value, kind);
+	}
+}
+#endif
+
+#endif
@@ -6,12 +6,15 @@
 #ifndef __NESEMU_CPU_OPS_H__
 #define __NESEMU_CPU_OPS_H__
 
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
 #include <stdint.h>
 
-/**
- * Look-up table for CPU cycles for each operation
- */
-extern const uint8_t nes_cpu_op_cycles[256];
+/* Forward declarations, see 'cpu.h' and 'memory/main.h' */
+struct nes_cpu;
+struct nes_mem_main;
+struct nes_cpu_opcode;
 
 /**
  * CPU addressing modes
@@ -28,6 +31,8 @@ enum nes_cpu_addressing_mode {
 	NESEMU_ADDRESSING_INDIRECT,
 	NESEMU_ADDRESSING_INDIRECT_X,
 	NESEMU_ADDRESSING_INDIRECT_Y,
+	NESEMU_ADDRESSING_IMPLIED,
+	NESEMU_ADDRESSING_RELATIVE,
 };
 
 /**
@@ -251,4 +256,298 @@ enum nes_cpu_instruction_set {
     STP = 0xDB,
 };
 
+/**
+ * Function type for an instruction handler.
+ *
+ * Handlers execute a single decoded instruction, `cycles` is already
+ * initialized with the base cycles from the opcode table and handlers only
+ * add the extra cycles (page crossing, branching).
+ *
+ * @note Every handler is specialized for a single opcode, addressing mode
+ * and page penalty are resolved at compile time.
+ *
+ * @param operand Instruction operand already fetched by the decoder, 8-bit
+ * operands use the low byte and 1-byte instructions get 0. Superinstructions
+ * get the operands of every fused instruction packed in program order.
+ */
+typedef nesemu_return_t (*nes_cpu_handler_t)(struct nes_cpu *self,
+					     struct nes_mem_main *mem,
+					     uint32_t operand,
+					     int *cycles);
+
+/**
+ * Opcode table entry, everything required to decode and execute an opcode
+ */
+typedef struct nes_cpu_opcode {
+	nes_cpu_handler_t handler; /**< Handler (NULL if unsupported) */
+	enum nes_cpu_addressing_mode addressing; /**< Addressing mode */
+	uint8_t cycles; /**< Base CPU cycles */
+	uint8_t length; /**< Instruction length in bytes (opcode included) */
+	bool page_penalty; /**< +1 cycle when indexing crosses a page */
+} nes_cpu_opcode_t;
+
+/**
+ * Opcode table indexed by opcode. Defined alongside the handlers.
+ */
+extern const struct nes_cpu_opcode nes_cpu_opcodes[256];
+
+/**
+ * Mnemonic per opcode (NULL if unsupported), for profiling and tracing.
+ * Defined alongside the handlers.
+ */
+extern const char *const nes_cpu_mnemonics[256];
+
+/**
+ * Every supported opcode as an X-macro, this is the single source of truth
+ * used to build the opcode table (and the `switch` fallback).
+ *
+ * X(opcode, mnemonic, addressing, cycles, length, page_penalty)
+ *
+ * Reference:
+ * https://www.nesdev.org/obelisk-6502-guide/reference.html
+ */
+#define NESEMU_CPU_OPCODE_LIST(X)                 \
+	X(LDA_IM, LDA, IMMEDIATE, 2, 2, false)    \
+	X(LDA_ZP, LDA, ZERO_PAGE, 3, 2, false)    \
+	X(LDA_ZX, LDA, ZERO_PAGE_X, 4, 2, false)  \
+	X(LDA_AB, LDA, ABSOLUTE, 4, 3, false)     \
+	X(LDA_AX, LDA, ABSOLUTE_X, 4, 3, true)    \
+	X(LDA_AY, LDA, ABSOLUTE_Y, 4, 3, true)    \
+	X(LDA_IX, LDA, INDIRECT_X, 6, 2, false)   \
+	X(LDA_IY, LDA, INDIRECT_Y, 5, 2, true)    \
+	X(LDX_IM, LDX, IMMEDIATE, 2, 2, false)    \
+	X(LDX_ZP, LDX, ZERO_PAGE, 3, 2, false)    \
+	X(LDX_ZY, LDX, ZERO_PAGE_Y, 4, 2, false)  \
+	X(LDX_AB, LDX, ABSOLUTE, 4, 3, false)     \
+	X(LDX_AY, LDX, ABSOLUTE_Y, 4, 3, true)    \
+	X(LDY_IM, LDY, IMMEDIATE, 2, 2, false)    \
+	X(LDY_ZP, LDY, ZERO_PAGE, 3, 2, false)    \
+	X(LDY_ZX, LDY, ZERO_PAGE_X, 4, 2, false)  \
+	X(LDY_AB, LDY, ABSOLUTE, 4, 3, false)     \
+	X(LDY_AX, LDY, ABSOLUTE_X, 4, 3, true)    \
+	X(STA_ZP, STA, ZERO_PAGE, 3, 2, false)    \
+	X(STA_ZX, STA, ZERO_PAGE_X, 4, 2, false)  \
+	X(STA_AB, STA, ABSOLUTE, 4, 3, false)     \
+	X(STA_AX, STA, ABSOLUTE_X, 5, 3, false)   \
+	X(STA_AY, STA, ABSOLUTE_Y, 5, 3, false)   \
+	X(STA_IX, STA, INDIRECT_X, 6, 2, false)   \
+	X(STA_IY, STA, INDIRECT_Y, 6, 2, false)   \
+	X(STX_ZP, STX, ZERO_PAGE, 3, 2, false)    \
+	X(STX_ZY, STX, ZERO_PAGE_Y, 4, 2, false)  \
+	X(STX_AB, STX, ABSOLUTE, 4, 3, false)     \
+	X(STY_ZP, STY, ZERO_PAGE, 3, 2, false)    \
+	X(STY_ZX, STY, ZERO_PAGE_X, 4, 2, false)  \
+	X(STY_AB, STY, ABSOLUTE, 4, 3, false)     \
+	X(TAX, TAX, IMPLIED, 2, 1, false)         \
+	X(TXA, TXA, IMPLIED, 2, 1, false)         \
+	X(TAY, TAY, IMPLIED, 2, 1, false)         \
+	X(TYA, TYA, IMPLIED, 2, 1, false)         \
+	X(TSX, TSX, IMPLIED, 2, 1, false)         \
+	X(TXS, TXS, IMPLIED, 2, 1, false)         \
+	X(PHA, PHA, IMPLIED, 3, 1, false)         \
+	X(PLA, PLA, IMPLIED, 4, 1, false)         \
+	X(PHP, PHP, IMPLIED, 3, 1, false)         \
+	X(PLP, PLP, IMPLIED, 4, 1, false)         \
+	X(AND_IM, AND, IMMEDIATE, 2, 2, false)    \
+	X(AND_ZP, AND, ZERO_PAGE, 3, 2, false)    \
+	X(AND_ZX, AND, ZERO_PAGE_X, 4, 2, false)  \
+	X(AND_AB, AND, ABSOLUTE, 4, 3, false)     \
+	X(AND_AX, AND, ABSOLUTE_X, 4, 3, true)    \
+	X(AND_AY, AND, ABSOLUTE_Y, 4, 3, true)    \
+	X(AND_IX, AND, INDIRECT_X, 6, 2, false)   \
+	X(AND_IY, AND, INDIRECT_Y, 5, 2, true)    \
+	X(EOR_IM, EOR, IMMEDIATE, 2, 2, false)    \
+	X(EOR_ZP, EOR, ZERO_PAGE, 3, 2, false)    \
+	X(EOR_ZX, EOR, ZERO_PAGE_X, 4, 2, false)  \
+	X(EOR_AB, EOR, ABSOLUTE, 4, 3, false)     \
+	X(EOR_AX, EOR, ABSOLUTE_X, 4, 3, true)    \
+	X(EOR_AY, EOR, ABSOLUTE_Y, 4, 3, true)    \
+	X(EOR_IX, EOR, INDIRECT_X, 6, 2, false)   \
+	X(EOR_IY, EOR, INDIRECT_Y, 5, 2, true)    \
+	X(ORA_IM, ORA, IMMEDIATE, 2, 2, false)    \
+	X(ORA_ZP, ORA, ZERO_PAGE, 3, 2, false)    \
+	X(ORA_ZX, ORA, ZERO_PAGE_X, 4, 2, false)  \
+	X(ORA_AB, ORA, ABSOLUTE, 4, 3, false)     \
+	X(ORA_AX, ORA, ABSOLUTE_X, 4, 3, true)    \
+	X(ORA_AY, ORA, ABSOLUTE_Y, 4, 3, true)    \
+	X(ORA_IX, ORA, INDIRECT_X, 6, 2, false)   \
+	X(ORA_IY, ORA, INDIRECT_Y, 5, 2, true)    \
+	X(BIT_ZP, BIT, ZERO_PAGE, 3, 2, false)    \
+	X(BIT_AB, BIT, ABSOLUTE, 4, 3, false)     \
+	X(ADC_IM, ADC, IMMEDIATE, 2, 2, false)    \
+	X(ADC_ZP, ADC, ZERO_PAGE, 3, 2, false)    \
+	X(ADC_ZX, ADC, ZERO_PAGE_X, 4, 2, false)  \
+	X(ADC_AB, ADC, ABSOLUTE, 4, 3, false)     \
+	X(ADC_AX, ADC, ABSOLUTE_X, 4, 3, true)    \
+	X(ADC_AY, ADC, ABSOLUTE_Y, 4, 3, true)    \
+	X(ADC_IX, ADC, INDIRECT_X, 6, 2, false)   \
+	X(ADC_IY, ADC, INDIRECT_Y, 5, 2, true)    \
+	X(SBC_IM, SBC, IMMEDIATE, 2, 2, false)    \
+	X(SBC_ZP, SBC, ZERO_PAGE, 3, 2, false)    \
+	X(SBC_ZX, SBC, ZERO_PAGE_X, 4, 2, false)  \
+	X(SBC_AB, SBC, ABSOLUTE, 4, 3, false)     \
+	X(SBC_AX, SBC, ABSOLUTE_X, 4, 3, true)    \
+	X(SBC_AY, SBC, ABSOLUTE_Y, 4, 3, true)    \
+	X(SBC_IX, SBC, INDIRECT_X, 6, 2, false)   \
+	X(SBC_IY, SBC, INDIRECT_Y, 5, 2, true)    \
+	X(CMP_IM, CMP, IMMEDIATE, 2, 2, false)    \
+	X(CMP_ZP, CMP, ZERO_PAGE, 3, 2, false)    \
+	X(CMP_ZX, CMP, ZERO_PAGE_X, 4, 2, false)  \
+	X(CMP_AB, CMP, ABSOLUTE, 4, 3, false)     \
+	X(CMP_AX, CMP, ABSOLUTE_X, 4, 3, true)    \
+	X(CMP_AY, CMP, ABSOLUTE_Y, 4, 3, true)    \
+	X(CMP_IX, CMP, INDIRECT_X, 6, 2, false)   \
+	X(CMP_IY, CMP, INDIRECT_Y, 5, 2, true)    \
+	X(CPX_IM, CPX, IMMEDIATE, 2, 2, false)    \
+	X(CPX_ZP, CPX, ZERO_PAGE, 3, 2, false)    \
+	X(CPX_AB, CPX, ABSOLUTE, 4, 3, false)     \
+	X(CPY_IM, CPY, IMMEDIATE, 2, 2, false)    \
+	X(CPY_ZP, CPY, ZERO_PAGE, 3, 2, false)    \
+	X(CPY_AB, CPY, ABSOLUTE, 4, 3, false)     \
+	X(INC_ZP, INC, ZERO_PAGE, 5, 2, false)    \
+	X(INC_ZX, INC, ZERO_PAGE_X, 6, 2, false)  \
+	X(INC_AB, INC, ABSOLUTE, 6, 3, false)     \
+	X(INC_AX, INC, ABSOLUTE_X, 7, 3, false)   \
+	X(INX, INX, IMPLIED, 2, 1, false)         \
+	X(INY, INY, IMPLIED, 2, 1, false)         \
+	X(DEC_ZP, DEC, ZERO_PAGE, 5, 2, false)    \
+	X(DEC_ZX, DEC, ZERO_PAGE_X, 6, 2, false)  \
+	X(DEC_AB, DEC, ABSOLUTE, 6, 3, false)     \
+	X(DEC_AX, DEC, ABSOLUTE_X, 7, 3, false)   \
+	X(DEX, DEX, IMPLIED, 2, 1, false)         \
+	X(DEY, DEY, IMPLIED, 2, 1, false)         \
+	X(ASL_ACC, ASL, ACCUMULATOR, 2, 1, false) \
+	X(ASL_ZP, ASL, ZERO_PAGE, 5, 2, false)    \
+	X(ASL_ZX, ASL, ZERO_PAGE_X, 6, 2, false)  \
+	X(ASL_AB, ASL, ABSOLUTE, 6, 3, false)     \
+	X(ASL_AX, ASL, ABSOLUTE_X, 7, 3, false)   \
+	X(LSR_ACC, LSR, ACCUMULATOR, 2, 1, false) \
+	X(LSR_ZP, LSR, ZERO_PAGE, 5, 2, false)    \
+	X(LSR_ZX, LSR, ZERO_PAGE_X, 6, 2, false)  \
+	X(LSR_AB, LSR, ABSOLUTE, 6, 3, false)     \
+	X(LSR_AX, LSR, ABSOLUTE_X, 7, 3, false)   \
+	X(ROL_ACC, ROL, ACCUMULATOR, 2, 1, false) \
+	X(ROL_ZP, ROL, ZERO_PAGE, 5, 2, false)    \
+	X(ROL_ZX, ROL, ZERO_PAGE_X, 6, 2, false)  \
+	X(ROL_AB, ROL, ABSOLUTE, 6, 3, false)     \
+	X(ROL_AX, ROL, ABSOLUTE_X, 7, 3, false)   \
+	X(ROR_ACC, ROR, ACCUMULATOR, 2, 1, false) \
+	X(ROR_ZP, ROR, ZERO_PAGE, 5, 2, false)    \
+	X(ROR_ZX, ROR, ZERO_PAGE_X, 6, 2, false)  \
+	X(ROR_AB, ROR, ABSOLUTE, 6, 3, false)     \
+	X(ROR_AX, ROR, ABSOLUTE_X, 7, 3, false)   \
+	X(JMP_AB, JMP, ABSOLUTE, 3, 3, false)     \
+	X(JMP_IN, JMP, INDIRECT, 5, 3, false)     \
+	X(JSR, JSR, ABSOLUTE, 6, 3, false)        \
+	X(RTS, RTS, IMPLIED, 6, 1, false)         \
+	X(BCC, BCC, RELATIVE, 2, 2, false)        \
+	X(BCS, BCS, RELATIVE, 2, 2, false)        \
+	X(BEQ, BEQ, RELATIVE, 2, 2, false)        \
+	X(BMI, BMI, RELATIVE, 2, 2, false)        \
+	X(BNE, BNE, RELATIVE, 2, 2, false)        \
+	X(BPL, BPL, RELATIVE, 2, 2, false)        \
+	X(BVC, BVC, RELATIVE, 2, 2, false)        \
+	X(BVS, BVS, RELATIVE, 2, 2, false)        \
+	X(CLC, CLC, IMPLIED, 2, 1, false)         \
+	X(CLD, CLD, IMPLIED, 2, 1, false)         \
+	X(CLI, CLI, IMPLIED, 2, 1, false)         \
+	X(CLV, CLV, IMPLIED, 2, 1, false)         \
+	X(SEC, SEC, IMPLIED, 2, 1, false)         \
+	X(SED, SED, IMPLIED, 2, 1, false)         \
+	X(SEI, SEI, IMPLIED, 2, 1, false)         \
+	X(BRK, BRK, IMPLIED, 7, 2, false)         \
+	X(NOP, NOP, IMPLIED, 2, 1, false)         \
+	X(RTI, RTI, IMPLIED, 6, 1, false)         \
+	X(STP, STP, IMPLIED, 3, 1, false)
+
+/**
+ * Maximum amount of instructions fused into a superinstruction
+ */
+#define NESEMU_CPU_FUSED_MAX_LENGTH 3
+
+/**
+ * Frequent instruction sequences executed as a single superinstruction
+ * (one dispatch) when they appear inside a basic block, see 'block.h'.
+ *
+ * X(name, first, second[, third])
+ *
+ * @note Only the last instruction may be a block terminator (branch, RTS...)
+ * @note Operands must fit in 32 bits once packed
+ */
+#define NESEMU_CPU_FUSED_TRIPLE_LIST(X)           \
+	X(LDA_ZP_CMP_IM_BNE, LDA_ZP, CMP_IM, BNE) \
+	X(LDA_ZP_CMP_IM_BEQ, LDA_ZP, CMP_IM, BEQ) \
+	X(LDA_AB_AND_IM_BEQ, LDA_AB, AND_IM, BEQ) \
+	X(LDA_AB_AND_IM_BNE, LDA_AB, AND_IM, BNE)
+
+#define NESEMU_CPU_FUSED_PAIR_LIST(X)         \
+	/* Loops */                           \
+	X(DEX_BNE, DEX, BNE)                  \
+	X(DEY_BNE, DEY, BNE)                  \
+	X(INX_BNE, INX, BNE)                  \
+	X(INY_BNE, INY, BNE)                  \
+	X(CMP_IM_BNE, CMP_IM, BNE)            \
+	X(CMP_IM_BEQ, CMP_IM, BEQ)            \
+	X(CPX_IM_BNE, CPX_IM, BNE)            \
+	X(CPY_IM_BNE, CPY_IM, BNE)            \
+	/* Status register polling ($2002) */ \
+	X(LDA_AB_BPL, LDA_AB, BPL)            \
+	X(LDA_AB_BMI, LDA_AB, BMI)            \
+	X(BIT_AB_BPL, BIT_AB, BPL)            \
+	X(BIT_AB_BMI, BIT_AB, BMI)            \
+	/* Moves */                           \
+	X(LDA_IM_STA_ZP, LDA_IM, STA_ZP)      \
+	X(LDA_IM_STA_AB, LDA_IM, STA_AB)      \
+	X(LDX_IM_STX_ZP, LDX_IM, STX_ZP)      \
+	X(LDA_ZP_STA_ZP, LDA_ZP, STA_ZP)      \
+	X(LDA_ZP_STA_AB, LDA_ZP, STA_AB)      \
+	X(LDA_AB_STA_AB, LDA_AB, STA_AB)      \
+	X(INC_ZP_LDA_ZP, INC_ZP, LDA_ZP)      \
+	X(STY_ZP_RTS, STY_ZP, RTS)
+
+/**
+ * Superinstruction identifiers, triples first so that the longest sequence
+ * wins
+ */
+#define _NESEMU_CPU_FUSED_ID(name, ...) NESEMU_CPU_FUSED_##name,
+enum nes_cpu_fused_id {
+	NESEMU_CPU_FUSED_NONE = 0, /**< Not fused */
+	NESEMU_CPU_FUSED_TRIPLE_LIST(_NESEMU_CPU_FUSED_ID)
+	NESEMU_CPU_FUSED_PAIR_LIST(_NESEMU_CPU_FUSED_ID)
+	NESEMU_CPU_FUSED_COUNT, /**< Amount of identifiers */
+};
+#undef _NESEMU_CPU_FUSED_ID
+
+/**
+ * Superinstruction table entry
+ */
+typedef struct nes_cpu_fused {
+	nes_cpu_handler_t handler; /**< Executes every fused instruction */
+	uint8_t length; /**< Amount of fused instructions */
+	uint8_t opcodes[NESEMU_CPU_FUSED_MAX_LENGTH]; /**< Fused opcodes */
+} nes_cpu_fused_t;
+
+/**
+ * Superinstruction table indexed by 'enum nes_cpu_fused_id'. Defined
+ * alongside the handlers.
+ */
+extern const struct nes_cpu_fused nes_cpu_fused[NESEMU_CPU_FUSED_COUNT];
+
+/**
+ * Extract the operand of the next fused instruction from a packed operand
+ *
+ * @param operand Reference to the packed operand, the extracted operand is
+ * removed from it
+ * @param opcode Opcode of the next fused instruction
+ */
+static inline uint32_t nes_cpu_fused_operand(uint32_t *operand,
+					     uint8_t opcode)
+{
+	unsigned bits = 8u * (nes_cpu_opcodes[opcode].length - 1u);
+	uint32_t result = *operand & ((UINT32_C(1) << bits) - 1u);
+	*operand >>= bits;
+
+	return result;
+}
+
 #endif
@@ -0,0 +1,138 @@
+/**
+ * Dynamic recompiler for hot basic blocks (Linux x86-64 only)
+ *
+ * Blocks from the block cache ('block.h') that execute often enough are
+ * translated into native code in an executable buffer. Simple register and
+ * flag instructions are emitted inline, every other instruction calls its
+ * specialized handler so memory (and I/O) keeps going through the bus.
+ *
+ * Build with -DNESEMU_CPU_JIT=ON, otherwise 'nes_cpu_jit_init' returns
+ * NESEMU_RETURN_CPU_JIT_UNSUPPORTED and the interpreter is always used.
+ */
+
+#ifndef __NESEMU_CPU_JIT_H__
+#define __NESEMU_CPU_JIT_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/ppu/ppu.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Default size of the executable buffer
+ */
+#define NESEMU_CPU_JIT_BUFFER_SIZE 0x100000 /* 1 MiB */
+
+/**
+ * Amount of interpreted executions before a block gets translated
+ */
+#define NESEMU_CPU_JIT_THRESHOLD 16
+
+/**
+ * Entry point into the native code, runs the translation of a block
+ *
+ * @param extra Reference to the cycles on top of the block base cycles
+ * @param failed Reference to where the index of the failing instruction is
+ * stored when an error is returned
+ * @param code Translation of the block ('block->native')
+ */
+typedef nesemu_return_t (*nes_cpu_jit_entry_t)(struct nes_cpu *self,
+					       struct nes_mem_main *mem,
+					       int *extra,
+					       int *failed,
+					       const void *code);
+
+/**
+ * Block recompiler state
+ */
+typedef struct nes_cpu_jit {
+	/**
+     * Executable buffer (mmap), writable only while translating
+     */
+	uint8_t *buffer;
+
+	/**
+     * Size of the buffer in bytes
+     */
+	size_t size;
+
+	/**
+     * Shared entry point at the start of the buffer (saves and restores the
+     * host registers so that translations stay small)
+     */
+	nes_cpu_jit_entry_t entry;
+
+	/**
+     * Bytes used by the entry point, translations start after it
+     */
+	size_t base;
+
+	/**
+     * Bytes of the buffer already in use
+     */
+	size_t used;
+
+	/**
+     * Block cache generation the translations belong to, the buffer is
+     * recycled once the block cache is flushed
+     */
+	uint32_t generation;
+
+	/**
+     * Differential mode. Every translated block is also executed by the
+     * interpreter on a copy of the CPU and memory, any difference in the
+     * resulting state stops the CPU with NESEMU_RETURN_CPU_JIT_MISMATCH.
+     */
+	bool differential;
+
+	/**
+     * CPU, memory, cartridge and PPU copies used by the differential mode
+     */
+	struct nes_cpu shadow_cpu;
+	struct nes_mem_main shadow_mem;
+	struct nes_cartridge shadow_cartridge;
+	struct nes_ppu shadow_ppu;
+
+} nes_cpu_jit_t;
+
+/**
+ * Allocate the executable buffer
+ *
+ * @param size Buffer size in bytes (use NESEMU_CPU_JIT_BUFFER_SIZE)
+ *
+ * @note Release it with 'nes_cpu_jit_destroy'
+ */
+nesemu_return_t nes_cpu_jit_init(struct nes_cpu_jit *self, size_t size);
+
+/**
+ * Release the executable buffer
+ *
+ * @note Detach it from every CPU first (or re-initialize them)
+ */
+nesemu_return_t nes_cpu_jit_destroy(struct nes_cpu_jit *self);
+
+/**
+ * Attach the recompiler to the CPU
+ *
+ * @note Call after 'nes_cpu_init', which detaches any previous recompiler
+ * @note Only blocks from an attached block cache are translated
+ */
+nesemu_return_t nes_cpu_jit_attach(struct nes_cpu_jit *self,
+				   struct nes_cpu *cpu);
+
+/**
+ * Translate a block into native code and store it in 'block->native'
+ *
+ * @param blocks Block cache the block belongs to
+ */
+nesemu_return_t nes_cpu_jit_compile(struct nes_cpu_jit *self,
+				    struct nes_cpu_block_cache *blocks,
+				    struct nes_cpu_block *block);
+
+#endif
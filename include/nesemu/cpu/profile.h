@@ -0,0 +1,115 @@
+/**
+ * Execution profiler (optional)
+ *
+ * Counts executions per opcode, per pair of consecutive opcodes and per
+ * guest $pc, plus the page crossing penalties taken per opcode. Counting
+ * happens for every instruction stepped by 'nes_cpu_next' and 'nes_cpu_run'
+ * (the block cache and recompiler are bypassed while a profiler is attached).
+ *
+ * Build with -DNESEMU_CPU_PROFILE=ON, otherwise every function returns
+ * NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED and nothing is counted.
+ */
+
+#ifndef __NESEMU_CPU_PROFILE_H__
+#define __NESEMU_CPU_PROFILE_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Value of 'last' before the first instruction
+ */
+#define NESEMU_CPU_PROFILE_NO_OPCODE 0x100
+
+/**
+ * Execution counters
+ *
+ * @note This structure is large (~1 MiB), avoid allocating it on the stack
+ */
+typedef struct nes_cpu_profile {
+	/**
+     * Executions per opcode
+     */
+	uint64_t opcodes[256];
+
+	/**
+     * Executions per opcode pair, indexed by [first][second]
+     */
+	uint64_t pairs[256][256];
+
+	/**
+     * Executions per instruction address
+     */
+	uint64_t pcs[0x10000];
+
+	/**
+     * Page crossing penalties taken per opcode (indexed addressing and
+     * taken branches)
+     */
+	uint64_t page_crosses[256];
+
+	/**
+     * Previously executed opcode, NESEMU_CPU_PROFILE_NO_OPCODE if none
+     */
+	uint16_t last;
+
+} nes_cpu_profile_t;
+
+/**
+ * Clear every counter
+ */
+nesemu_return_t nes_cpu_profile_reset(struct nes_cpu_profile *self);
+
+/**
+ * Attach the profiler to the CPU, counters are kept
+ *
+ * @note Call after 'nes_cpu_init', which detaches any previous profiler
+ */
+nesemu_return_t nes_cpu_profile_attach(struct nes_cpu_profile *self,
+				       struct nes_cpu *cpu);
+
+/**
+ * Write the non-zero counters as CSV, one per row:
+ * `kind,key,mnemonic,count` with kind one of opcode, pair, pc or page_cross
+ */
+nesemu_return_t nes_cpu_profile_dump_csv(const struct nes_cpu_profile *self,
+					 FILE *f);
+
+/**
+ * Write the non-zero counters as a JSON object with the `opcodes`, `pairs`,
+ * `pcs` and `page_crosses` members (hexadecimal keys)
+ */
+nesemu_return_t nes_cpu_profile_dump_json(const struct nes_cpu_profile *self,
+					  FILE *f);
+
+/**
+ * Count an executed instruction
+ *
+ * @param pc Address of the instruction
+ * @param relative The instruction is a branch
+ * @param extra Cycles on top of the base cycles of the instruction
+ */
+static inline void nes_cpu_profile_count(struct nes_cpu_profile *self,
+					 uint16_t pc,
+					 uint8_t opcode,
+					 bool relative,
+					 int extra)
+{
+	self->opcodes[opcode]++;
+	self->pcs[pc]++;
+	if (self->last != NESEMU_CPU_PROFILE_NO_OPCODE) {
+		self->pairs[self->last][opcode]++;
+	}
+	self->last = opcode;
+
+	// Taken branches pay one cycle before the page crossing one
+	if (extra > (relative ? 1 : 0)) {
+		self->page_crosses[opcode]++;
+	}
+}
+
+#endif
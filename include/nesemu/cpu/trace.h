@@ -0,0 +1,178 @@
+/**
+ * Instruction trace (optional)
+ *
+ * Every instruction stepped by 'nes_cpu_next' and 'nes_cpu_run' stores a
+ * compact binary record into a fixed-size ring buffer before it executes
+ * (the block cache and recompiler are bypassed while a trace is attached).
+ * Older records are overwritten, so the ring always holds the latest
+ * instructions. A writer thread can stream the ring to a file as it fills,
+ * and the records are formatted offline using the nestest.log text format.
+ *
+ * Build with -DNESEMU_CPU_TRACE=ON (requires POSIX threads), otherwise
+ * every function but the formatters returns
+ * NESEMU_RETURN_CPU_TRACE_UNSUPPORTED and nothing is recorded.
+ *
+ * Reference:
+ * https://www.qmtpro.com/~nes/misc/nestest.log
+ */
+
+#ifndef __NESEMU_CPU_TRACE_H__
+#define __NESEMU_CPU_TRACE_H__
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/util/error.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Default amount of records in the ring (1.5 MiB)
+ */
+#define NESEMU_CPU_TRACE_SIZE 0x10000
+
+/**
+ * Magic at the start of a spilled trace file, followed by raw records
+ * (host endianness)
+ */
+#define NESEMU_CPU_TRACE_MAGIC "NESTRC01"
+
+/**
+ * Length of a formatted line, terminator included
+ */
+#define NESEMU_CPU_TRACE_LINE_SIZE 128
+
+/**
+ * State of an instruction before it executes
+ *
+ * @note Tracing peeks at the memory mapped in the page table, registers
+ * and mapper callbacks are not read (reads have side effects), 'value' is
+ * 0xFF for them
+ */
+typedef struct nes_cpu_trace_record {
+	uint64_t cycle; /**< Master clock */
+	uint16_t pc; /**< Address of the instruction */
+	uint16_t address; /**< Effective address (target for JMP indirect) */
+	uint8_t opcode; /**< Opcode */
+	uint8_t operand[2]; /**< Operand bytes (little-endian) */
+	uint8_t value; /**< Memory at 'address' */
+	uint8_t a; /**< Accumulator */
+	uint8_t x; /**< Index Register X */
+	uint8_t y; /**< Index Register Y */
+	uint8_t status; /**< Processor Status */
+	uint8_t sp; /**< Stack Pointer */
+} nes_cpu_trace_record_t;
+
+/* Forward declaration, see 'trace.c' */
+struct nes_cpu_trace_writer;
+
+/**
+ * Trace ring buffer
+ */
+typedef struct nes_cpu_trace {
+	/**
+     * Ring of records (malloc), indexed by the record number & 'mask'
+     */
+	struct nes_cpu_trace_record *records;
+
+	/**
+     * Amount of records in the ring minus one (the size is a power of two)
+     */
+	uint32_t mask;
+
+	/**
+     * Records written since initialization, only the CPU stores it
+     */
+	_Atomic uint64_t head;
+
+	/**
+     * Records overwritten before the writer thread could spill them, valid
+     * after 'nes_cpu_trace_spill_stop'
+     */
+	uint64_t dropped;
+
+	/**
+     * Writer thread (NULL if not spilling)
+     */
+	struct nes_cpu_trace_writer *writer;
+
+} nes_cpu_trace_t;
+
+/**
+ * Allocate the ring
+ *
+ * @param size Amount of records, a power of two (use NESEMU_CPU_TRACE_SIZE)
+ *
+ * @note Release it with 'nes_cpu_trace_destroy'
+ */
+nesemu_return_t nes_cpu_trace_init(struct nes_cpu_trace *self, size_t size);
+
+/**
+ * Stop the writer thread (if any) and release the ring
+ *
+ * @note Detach it from every CPU first (or re-initialize them)
+ */
+nesemu_return_t nes_cpu_trace_destroy(struct nes_cpu_trace *self);
+
+/**
+ * Attach the trace to the CPU
+ *
+ * @note Call after 'nes_cpu_init', which detaches any previous trace
+ */
+nesemu_return_t nes_cpu_trace_attach(struct nes_cpu_trace *self,
+				     struct nes_cpu *cpu);
+
+/**
+ * Start a writer thread that appends every new record to 'f' (opened in
+ * binary mode), the magic is written first
+ *
+ * @note The CPU never waits for the writer, records it falls behind on are
+ * counted in 'dropped'
+ */
+nesemu_return_t nes_cpu_trace_spill_start(struct nes_cpu_trace *self,
+					  FILE *f);
+
+/**
+ * Write the remaining records and stop the writer thread, 'f' is flushed
+ * but left open
+ */
+nesemu_return_t nes_cpu_trace_spill_stop(struct nes_cpu_trace *self);
+
+/**
+ * Format the records still in the ring, oldest first
+ *
+ * @note Do not call while the CPU is running in another thread
+ */
+nesemu_return_t nes_cpu_trace_dump(const struct nes_cpu_trace *self, FILE *f);
+
+/**
+ * Format a record as a nestest.log line (no line feed)
+ *
+ * @param line Buffer of at least NESEMU_CPU_TRACE_LINE_SIZE bytes
+ */
+nesemu_return_t
+nes_cpu_trace_format(const struct nes_cpu_trace_record *record, char *line);
+
+/**
+ * Format a spilled trace file, one line per record
+ *
+ * @param in Trace file written by the writer thread
+ * @param out Where the lines are written
+ */
+nesemu_return_t nes_cpu_trace_format_file(FILE *in, FILE *out);
+
+/**
+ * Store a record in the ring
+ */
+static inline void nes_cpu_trace_push(struct nes_cpu_trace *self,
+				      const struct nes_cpu_trace_record *record)
+{
+	uint64_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+	self->records[head & self->mask] = *record;
+
+	// Publish the record to the writer thread
+	atomic_store_explicit(&self->head, head + 1, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * Dirty memory tracking (optional)
+ *
+ * The buses flag every block of NESEMU_MEMORY_DIRTY_BLOCK_SIZE bytes written
+ * since the last clear, so that save states, rewind and state sync only copy
+ * what changed since their last checkpoint. Blocks are flagged on the write
+ * paths themselves (fast path of the page table, handlers, block transfers
+ * and the stack), whether the value changed or not.
+ *
+ * Tracked regions, reported as ranges of offsets within the region:
+ *
+ * - Main memory bus: the work RAM and the cartridge RAM window ($6000-$7FFF,
+ *   as mapped at the time of the write). Registers are not memory and are
+ *   not tracked.
+ *
+ * - Video memory bus: the pattern tables (writes to CHR RAM), CIRAM and the
+ *   palette RAM.
+ *
+ * Build with -DNESEMU_MEMORY_DIRTY=ON, otherwise the buses have no tracking
+ * code and every function returns NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED.
+ */
+
+#ifndef __NESEMU_MEMORY_DIRTY_H__
+#define __NESEMU_MEMORY_DIRTY_H__
+
+#include "nesemu/util/error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Forward declarations, see 'nesemu/memory/main.h' and
+ * 'nesemu/memory/video.h'
+ */
+struct nes_mem_main;
+struct nes_mem_video;
+
+/**
+ * Size of a tracked block, log2
+ */
+#define NESEMU_MEMORY_DIRTY_BLOCK_SHIFT 6
+
+/**
+ * Size of a tracked block (64 bytes)
+ */
+#define NESEMU_MEMORY_DIRTY_BLOCK_SIZE (1 << NESEMU_MEMORY_DIRTY_BLOCK_SHIFT)
+
+/**
+ * Amount of blocks covering `size` bytes
+ */
+#define NESEMU_MEMORY_DIRTY_BLOCKS(size)                   \
+	(((size) + NESEMU_MEMORY_DIRTY_BLOCK_SIZE - 1) >> \
+	 NESEMU_MEMORY_DIRTY_BLOCK_SHIFT)
+
+/**
+ * Tracked memory regions
+ */
+enum nes_mem_dirty_region {
+	NESEMU_MEMORY_DIRTY_RAM = 0, /**< Work RAM, offsets from $0000 */
+	NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM, /**< Offsets from $6000 */
+	NESEMU_MEMORY_DIRTY_PATTERN, /**< Pattern tables, offsets from $0000 */
+	NESEMU_MEMORY_DIRTY_CIRAM, /**< Offsets in CIRAM (not mirrored) */
+	NESEMU_MEMORY_DIRTY_PALETTE, /**< Palette RAM, offsets from $3F00 */
+};
+
+/**
+ * Written range of a region, adjacent dirty blocks are merged
+ */
+typedef struct nes_mem_dirty_range {
+	uint16_t offset; /**< First byte, from the start of the region */
+	uint16_t size; /**< Amount of bytes */
+} nes_mem_dirty_range_t;
+
+/**
+ * Get the written ranges of a main memory region since the last
+ * 'nes_mem_dirty_clear'
+ *
+ * @param region NESEMU_MEMORY_DIRTY_RAM or NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM
+ * @param ranges Reference to where the first `max` ranges will be stored
+ * @param count Reference to where the amount of ranges will be stored, more
+ * than `max` if some did not fit
+ */
+nesemu_return_t nes_mem_dirty(const struct nes_mem_main *self,
+			      enum nes_mem_dirty_region region,
+			      struct nes_mem_dirty_range *ranges,
+			      size_t max,
+			      size_t *count);
+
+/**
+ * Flag every block of the main memory regions as clean (checkpoint)
+ */
+nesemu_return_t nes_mem_dirty_clear(struct nes_mem_main *self);
+
+/**
+ * Get the written ranges of a video memory region, see 'nes_mem_dirty'
+ *
+ * @param region NESEMU_MEMORY_DIRTY_PATTERN, NESEMU_MEMORY_DIRTY_CIRAM or
+ * NESEMU_MEMORY_DIRTY_PALETTE
+ */
+nesemu_return_t nes_vram_dirty(const struct nes_mem_video *self,
+			       enum nes_mem_dirty_region region,
+			       struct nes_mem_dirty_range *ranges,
+			       size_t max,
+			       size_t *count);
+
+/**
+ * Flag every block of the video memory regions as clean (checkpoint)
+ */
+nesemu_return_t nes_vram_dirty_clear(struct nes_mem_video *self);
+
+/**
+ * Merge the dirty blocks of a region into ranges
+ *
+ * @param blocks Dirty flags, one per block of the region
+ * @param size Size of the region in bytes (the last block may be partial)
+ * @return Amount of ranges, only the first `max` are stored
+ *
+ * @note Used by the buses
+ */
+size_t nes_mem_dirty_ranges(const uint8_t *blocks,
+			    size_t size,
+			    struct nes_mem_dirty_range *ranges,
+			    size_t max);
+
+#endif
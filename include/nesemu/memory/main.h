@@ -7,14 +7,25 @@
 #define __NESEMU_MEMORY_MAIN_H__
 
 #include "nesemu/util/error.h"
+#include "nesemu/util/bits.h"
 #include "nesemu/cartridge/cartridge.h"
+#include "nesemu/memory/dirty.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+/*
+ * Forward declarations, see 'nesemu/cpu/debug.h', 'nesemu/cpu/coverage.h'
+ * and 'nesemu/ppu/ppu.h'
+ */
+struct nes_debugger;
+struct nes_cpu_coverage;
+struct nes_ppu;
+
 /**
- * Size of the CPU memory. Excluding cartridge space
+ * Size of the console work RAM ($0000-$07FF)
  */
-#define NESEMU_MEMORY_RAM_SIZE 0x4020
+#define NESEMU_MEMORY_RAM_SIZE 0x0800
 
 /**
  * Initial address for the cartridge addressing
@@ -29,10 +40,10 @@
 /**
  * Base memory mirroring range end (inclusive)
  */
-#define NESEMU_MEMORY_RAM_MIRRORING_RANGE_END 0x17FF
+#define NESEMU_MEMORY_RAM_MIRRORING_RANGE_END 0x1FFF
 
 /**
- * Address mirroring base for modulo operator
+ * Address mirroring base
  *                      -> 0x0000-0x07FF
  *      - 0x0800-0x0FFF
  *      - 0x1000-0x17FF
@@ -40,6 +51,11 @@
  */
 #define NESEMU_MEMORY_RAM_MIRRORING_BASE 0x800
 
+/**
+ * Mask resolving a RAM mirror to its work RAM address
+ */
+#define NESEMU_MEMORY_RAM_MASK (NESEMU_MEMORY_RAM_MIRRORING_BASE - 1)
+
 /**
  * PPU register mirroring range start (inclusive)
  */
@@ -51,7 +67,7 @@
 #define NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_RANGE_END 0x3FFF
 
 /**
- * Address modulo for PPU register mirroring
+ * Address modulo for PPU register mirroring, also the amount of registers
  */
 #define NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE 0x8
 
@@ -60,6 +76,80 @@
  */
 #define NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR 0x2000
 
+/**
+ * First I/O register (APU, OAM DMA and controllers)
+ */
+#define NESEMU_MEMORY_RAM_IO_REG_ADDR 0x4000
+
+/**
+ * Amount of I/O registers ($4000-$401F)
+ */
+#define NESEMU_MEMORY_RAM_IO_REGISTERS \
+	(NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN - NESEMU_MEMORY_RAM_IO_REG_ADDR)
+
+/**
+ * Amount of pages of the CPU address space
+ */
+#define NESEMU_MEMORY_PAGES 256
+
+/**
+ * Size of a page of the CPU address space
+ */
+#define NESEMU_MEMORY_PAGE_SIZE 0x100
+
+/**
+ * Page of an address (256-byte pages)
+ */
+#define NESEMU_MEMORY_PAGE(addr) ((uint16_t)(addr) >> 8)
+
+/**
+ * Size of a region of the CPU address space, log2. Regions are as large as
+ * the smallest area of the memory map with its own handlers (8 KiB: work
+ * RAM and its mirrors, PPU registers, cartridge RAM, PRG ROM banks).
+ */
+#define NESEMU_MEMORY_REGION_SHIFT 13
+
+/**
+ * Amount of regions of the CPU address space
+ */
+#define NESEMU_MEMORY_REGIONS (0x10000 >> NESEMU_MEMORY_REGION_SHIFT)
+
+/**
+ * Region of an address (8 KiB regions)
+ */
+#define NESEMU_MEMORY_REGION(addr) \
+	((uint16_t)(addr) >> NESEMU_MEMORY_REGION_SHIFT)
+
+struct nes_mem_main;
+
+/**
+ * Handler of the accesses to a page without direct memory (registers,
+ * mapper callbacks)
+ */
+typedef nesemu_return_t (*nes_mem_read_fn_t)(struct nes_mem_main *self,
+					     uint16_t addr,
+					     uint8_t *result);
+
+/**
+ * See 'nes_mem_read_fn_t'
+ */
+typedef nesemu_return_t (*nes_mem_write_fn_t)(struct nes_mem_main *self,
+					      uint16_t addr,
+					      uint8_t data);
+
+/**
+ * Slow path of a region of the page table, taken by the pages of the region
+ * without a fast path (see 'read' and 'write' of 'struct nes_mem_main')
+ */
+typedef struct nes_mem_region {
+	/**
+     * Handlers of every address of the region, mapped memory included
+     */
+	nes_mem_read_fn_t read_fn;
+	nes_mem_write_fn_t write_fn;
+
+} nes_mem_region_t;
+
 /**
  * 16-bit addressable memory. This is the console's main memory/CPU memory
  * This memory also acts as a bus for accessing both internal memory and PRG
@@ -70,28 +160,96 @@
  */
 typedef struct nes_mem_main {
 	/**
-     * Raw memory array. Should not be accessed directly.
-     *
-     * This only contains console internal memory structure ($0000-$401F).
-     * Any fields mapped to cartridge are left out and r/w operations
-     * are delegated to the cartridge structure callbacks instead.
-     *
-     * That is the reason why the size of this array is smaller than
-     * the addressable space.
-     *
-     * Memory addresses above $401F should delegate r/w operations to the
-     * cartridge `cpu callbacks`.
+     * Console work RAM ($0000-$07FF), mirrored up to $1FFF. Should not be
+     * accessed directly (except by the stack).
+     */
+	uint8_t ram[NESEMU_MEMORY_RAM_SIZE];
+
+	/**
+     * PPU registers ($2000-$2007, mirrored up to $3FFF), only used while no
+     * PPU is attached
+     */
+	uint8_t ppu_registers[NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE];
+
+	/**
+     * I/O registers ($4000-$401F) without a handler
      *
-     * OPTIMIZATION: Separate this memory in different sections to avoid
-     * allocating memory to mirrored/unused addresses.
+     * Addresses above $401F (expansion, cartridge RAM and PRG ROM) belong
+     * to the cartridge and have no storage here.
      */
-	uint8_t _data[NESEMU_MEMORY_RAM_SIZE];
+	uint8_t io_registers[NESEMU_MEMORY_RAM_IO_REGISTERS];
 
 	/**
      * Reference to the game cartridge. Should already be initialized.
      */
 	struct nes_cartridge *cartridge;
 
+	/**
+     * PPU owning the registers at $2000-$3FFF, set by 'nes_ppu_init'. While
+     * NULL the registers are plain memory.
+     */
+	struct nes_ppu *ppu;
+
+	/**
+     * Fast path of the page table, accesses through a non-NULL pointer are
+     * plain loads and stores (indexed by the low byte of the address, RAM
+     * mirrors point into 'ram'). NULL while the page is handled by a handler
+     * or the accesses are recorded (debugger, coverage).
+     *
+     * Kept apart from 'regions' so that the entries an instance touches
+     * share cache lines.
+     */
+	const uint8_t *read[NESEMU_MEMORY_PAGES];
+	uint8_t *write[NESEMU_MEMORY_PAGES];
+
+	/**
+     * Handlers of the CPU address space, see 'nes_mem_map'
+     */
+	struct nes_mem_region regions[NESEMU_MEMORY_REGIONS];
+
+	/**
+     * CPU cycles the bus took during the current instruction (OAM DMA),
+     * charged and cleared by the CPU once the instruction completes
+     */
+	uint16_t stall;
+
+	/**
+     * Sticky error slot, first error of the value-returning accessors
+     * ('nes_mem_read8' and friends) since the last 'nes_mem_error'
+     */
+	nesemu_return_t error;
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+	/**
+     * Debugger owning the watchpoints (NULL if detached)
+     */
+	struct nes_debugger *debugger;
+
+	/**
+     * Access kinds watched per page, watched pages have no fast path in the
+     * page table (see 'enum nes_debugger_kind')
+     */
+	uint8_t watch_pages[NESEMU_MEMORY_PAGES];
+#endif
+
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	/**
+     * Coverage bitmaps (NULL if detached), no page has a fast path while
+     * attached
+     */
+	struct nes_cpu_coverage *coverage;
+#endif
+
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+	/**
+     * Blocks written since the last 'nes_mem_dirty_clear', one flag per
+     * block of the work RAM and of the cartridge RAM window
+     */
+	uint8_t dirty_ram[NESEMU_MEMORY_DIRTY_BLOCKS(NESEMU_MEMORY_RAM_SIZE)];
+	uint8_t dirty_cartridge[NESEMU_MEMORY_DIRTY_BLOCKS(
+		NESEMU_CARTRIDGE_RAM_SIZE)];
+#endif
+
 } nes_mem_main_t;
 
 /**
@@ -100,6 +258,83 @@ typedef struct nes_mem_main {
 nesemu_return_t nes_mem_init(struct nes_mem_main *self,
 			     struct nes_cartridge *cartridge);
 
+/**
+ * Rebuild the page table from the cartridge mapping: RAM (and mirrors) and
+ * the memory returned by the mapper map to plain loads and stores, I/O
+ * registers and any other cartridge address go through handlers (see
+ * 'nes_cartridge_page_t').
+ *
+ * @note Called by 'nes_mem_init', after a write switches PRG banks (the
+ * mapper bumps 'prg_version') and when watchpoints or coverage change
+ */
+void nes_mem_map(struct nes_mem_main *self);
+
+/**
+ * Read from a page without fast path: through the handler of its region,
+ * then report the access (watchpoints, coverage). Errors of the
+ * handler go to the sticky error slot
+ *
+ * @note Slow path of 'nes_mem_read8' and 'nes_mem_r8', I/O and mapper
+ * registers end up here
+ */
+uint8_t nes_mem_read8_slow(struct nes_mem_main *self, uint16_t addr);
+
+/**
+ * Write to a page without fast path, see 'nes_mem_read8_slow'
+ */
+void nes_mem_write8_slow(struct nes_mem_main *self,
+			 uint16_t addr,
+			 uint8_t data);
+
+/**
+ * Checked variant of 'nes_mem_read8_slow': the error of this access is
+ * returned and the sticky error slot is left as it was
+ */
+nesemu_return_t nes_mem_r8_slow(struct nes_mem_main *self,
+				uint16_t addr,
+				uint8_t *result);
+
+/**
+ * Checked variant of 'nes_mem_write8_slow', see 'nes_mem_r8_slow'
+ */
+nesemu_return_t nes_mem_w8_slow(struct nes_mem_main *self,
+				uint16_t addr,
+				uint8_t data);
+
+/**
+ * Read memory mapped at an address without the handlers, watchpoints or
+ * coverage of the bus (RAM and the pages given by the mapper)
+ *
+ * @return 0xFF for addresses without memory (registers, mapper callbacks)
+ */
+uint8_t nes_mem_peek8(const struct nes_mem_main *self, uint16_t addr);
+
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+/**
+ * Flag the block of a written address, registers are not tracked
+ *
+ * @note Called by every write path of the bus (and by the stack)
+ */
+static inline void nes_mem_dirty_mark(struct nes_mem_main *self,
+				      uint16_t addr)
+{
+	if (addr < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR) {
+		self->dirty_ram[(addr & NESEMU_MEMORY_RAM_MASK) >>
+				NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+	} else if (addr >= NESEMU_CARTRIDGE_RAM_BEGIN &&
+		   addr < NESEMU_CARTRIDGE_ROM_BEGIN) {
+		self->dirty_cartridge[(addr - NESEMU_CARTRIDGE_RAM_BEGIN) >>
+				      NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+	}
+}
+#endif
+
+/*
+ * The accessors below are inlined into their callers (the CPU above all):
+ * RAM and PRG ROM pages are a table lookup and a plain load or store, only
+ * pages without a fast path call out of line.
+ */
+
 /**
  * Write 8 bits in memory at `addr`
  *
@@ -107,9 +342,22 @@ nesemu_return_t nes_mem_init(struct nes_mem_main *self,
  * @param addr Memory address
  * @param data Data to be pushed onto memory
  */
-nesemu_return_t nes_mem_w8(struct nes_mem_main *self,
-			   uint16_t addr,
-			   uint8_t data);
+static inline nesemu_return_t nes_mem_w8(struct nes_mem_main *self,
+					 uint16_t addr,
+					 uint8_t data)
+{
+	// Mapped memory, plain store
+	uint8_t *write = self->write[NESEMU_MEMORY_PAGE(addr)];
+	if (write != NULL) {
+		write[addr & 0xFF] = data;
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+		nes_mem_dirty_mark(self, addr);
+#endif
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	return nes_mem_w8_slow(self, addr, data);
+}
 
 /**
  * Read 8 bits from memory at `addr`
@@ -118,9 +366,19 @@ nesemu_return_t nes_mem_w8(struct nes_mem_main *self,
  * @param addr Memory address
  * @param result Reference to where the result will be stored
  */
-nesemu_return_t nes_mem_r8(struct nes_mem_main *self,
-			   uint16_t addr,
-			   uint8_t *result);
+static inline nesemu_return_t nes_mem_r8(struct nes_mem_main *self,
+					 uint16_t addr,
+					 uint8_t *result)
+{
+	// Mapped memory, plain load
+	const uint8_t *read = self->read[NESEMU_MEMORY_PAGE(addr)];
+	if (read != NULL) {
+		*result = read[addr & 0xFF];
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	return nes_mem_r8_slow(self, addr, result);
+}
 
 /**
  * Write 16 bits in memory at `addr`
@@ -129,9 +387,19 @@ nesemu_return_t nes_mem_r8(struct nes_mem_main *self,
  * @param addr Memory address (should not be last memory position)
  * @param data Data to be pushed onto memory
  */
-nesemu_return_t nes_mem_w16(struct nes_mem_main *self,
-			    uint16_t addr,
-			    uint16_t data);
+static inline nesemu_return_t nes_mem_w16(struct nes_mem_main *self,
+					  uint16_t addr,
+					  uint16_t data)
+{
+	// Write LSB, then next (MSB)
+	nesemu_return_t err;
+	if ((err = nes_mem_w8(self, addr, (uint8_t)(data & 0x00FF))) !=
+	    NESEMU_RETURN_SUCCESS) {
+		return err;
+	}
+
+	return nes_mem_w8(self, addr + 1, (uint8_t)(data >> 8));
+}
 
 /**
  * Read 16 bits from memory at `addr`
@@ -140,8 +408,116 @@ nesemu_return_t nes_mem_w16(struct nes_mem_main *self,
  * @param addr Memory address (should not be last memory position)
  * @param result Reference to where the result will be stored
  */
-nesemu_return_t nes_mem_r16(struct nes_mem_main *self,
-			    uint16_t addr,
-			    uint16_t *result);
+static inline nesemu_return_t nes_mem_r16(struct nes_mem_main *self,
+					  uint16_t addr,
+					  uint16_t *result)
+{
+	// Get LSB, then next (MSB)
+	uint8_t lsb, msb;
+	nesemu_return_t err;
+	if ((err = nes_mem_r8(self, addr, &lsb)) != NESEMU_RETURN_SUCCESS ||
+	    (err = nes_mem_r8(self, addr + 1, &msb)) != NESEMU_RETURN_SUCCESS) {
+		return err;
+	}
+
+	// Build u16 from two u8
+	*result = NESEMU_UTIL_U16(msb, lsb);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Read 8 bits from memory at `addr`, errors are recorded in the sticky
+ * error slot instead of being returned
+ *
+ * @note Used by the CPU in trusted builds (CONFIG_NESEMU_TRUSTED)
+ */
+static inline uint8_t nes_mem_read8(struct nes_mem_main *self, uint16_t addr)
+{
+	// Mapped memory, cannot fail
+	const uint8_t *read = self->read[NESEMU_MEMORY_PAGE(addr)];
+	if (read != NULL) {
+		return read[addr & 0xFF];
+	}
+
+	return nes_mem_read8_slow(self, addr);
+}
+
+/**
+ * Write 8 bits in memory at `addr`, errors are recorded in the sticky
+ * error slot instead of being returned
+ */
+static inline void nes_mem_write8(struct nes_mem_main *self,
+				  uint16_t addr,
+				  uint8_t data)
+{
+	// Mapped memory, cannot fail
+	uint8_t *write = self->write[NESEMU_MEMORY_PAGE(addr)];
+	if (write != NULL) {
+		write[addr & 0xFF] = data;
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+		nes_mem_dirty_mark(self, addr);
+#endif
+		return;
+	}
+
+	nes_mem_write8_slow(self, addr, data);
+}
+
+/**
+ * Read 16 bits from memory at `addr`, errors are recorded in the sticky
+ * error slot instead of being returned
+ */
+static inline uint16_t nes_mem_read16(struct nes_mem_main *self,
+				      uint16_t addr)
+{
+	uint8_t lsb = nes_mem_read8(self, addr);
+	uint8_t msb = nes_mem_read8(self, addr + 1);
+
+	return NESEMU_UTIL_U16(msb, lsb);
+}
+
+/**
+ * Write 16 bits in memory at `addr`, errors are recorded in the sticky
+ * error slot instead of being returned
+ */
+static inline void nes_mem_write16(struct nes_mem_main *self,
+				   uint16_t addr,
+				   uint16_t data)
+{
+	nes_mem_write8(self, addr, (uint8_t)(data & 0x00FF));
+	nes_mem_write8(self, addr + 1, (uint8_t)(data >> 8));
+}
+
+/**
+ * Read `size` bytes starting at `addr` into `buffer`. Pages with a fast path
+ * are copied at once, the others are read byte by byte through their
+ * handler (with its side effects).
+ *
+ * @param mem Memory array
+ * @param addr First memory address
+ * @param buffer Reference to where the bytes will be stored
+ * @param size Amount of bytes, the range must not go past $FFFF
+ */
+nesemu_return_t nes_mem_read_block(struct nes_mem_main *self,
+				   uint16_t addr,
+				   uint8_t *buffer,
+				   size_t size);
+
+/**
+ * Write `size` bytes from `buffer` starting at `addr`, see
+ * 'nes_mem_read_block'
+ */
+nesemu_return_t nes_mem_write_block(struct nes_mem_main *self,
+				    uint16_t addr,
+				    const uint8_t *buffer,
+				    size_t size);
+
+/**
+ * Get and clear the sticky error slot
+ *
+ * @return First error since the last call, NESEMU_RETURN_SUCCESS if none
+ */
+nesemu_return_t nes_mem_error(struct nes_mem_main *self);
 
 #endif
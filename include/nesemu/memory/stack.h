@@ -9,6 +9,14 @@
 #include "nesemu/memory/main.h"
 #include "nesemu/util/error.h"
 
+#ifdef CONFIG_NESEMU_DEBUGGER
+#include "nesemu/cpu/debug.h"
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+#include "nesemu/cpu/coverage.h"
+#endif
+
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -18,10 +26,10 @@
 
 /**
  * Transform a stack address into a raw memory address by adding the base
- * address to the given value
+ * address to the given value, wrapping around within page $01
  */
 #define NESEMU_STACK_GET_ADDR(addr) \
-	(uint8_t)(NESEMU_STACK_BASE_ADDR + (uint16_t)addr)
+	(uint16_t)(NESEMU_STACK_BASE_ADDR + (uint8_t)(addr))
 
 /**
  * Max stack size in memory
@@ -33,6 +41,42 @@
 #error "Memory is not big enough to host stack, check stack and memory mappings"
 #endif
 
+/*
+ * The stack is plain console RAM, so every operation reads and writes the
+ * RAM array directly instead of going through 'nes_mem_r8'/'nes_mem_w8'
+ * (no cartridge or register decoding, no mirroring). 16-bit values are moved
+ * with a single bounds check and a single $sp update.
+ */
+
+/**
+ * Watched stack accesses are reported to the debugger
+ */
+#ifdef CONFIG_NESEMU_DEBUGGER
+#define _NESEMU_STACK_WATCH(mem, addr, value, kind) \
+	nes_debugger_watch(mem, addr, value, kind)
+#else
+#define _NESEMU_STACK_WATCH(mem, addr, value, kind)
+#endif
+
+/**
+ * Stack accesses are data accesses for the coverage
+ */
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+#define _NESEMU_STACK_COVER(mem, addr, kind) \
+	nes_cpu_coverage_access(mem, addr, NESEMU_CPU_COVERAGE_##kind)
+#else
+#define _NESEMU_STACK_COVER(mem, addr, kind)
+#endif
+
+/**
+ * Stack writes flag their RAM block
+ */
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+#define _NESEMU_STACK_DIRTY(mem, addr) nes_mem_dirty_mark(mem, addr)
+#else
+#define _NESEMU_STACK_DIRTY(mem, addr)
+#endif
+
 /**
  * Push a word to the stack
  *
@@ -40,9 +84,27 @@
  * @param sp Reference to the stack pointer
  * @param value Value to be pushed
  */
-nesemu_return_t nes_stack_push_u8(struct nes_mem_main *mem,
-				 uint8_t *sp,
-				 uint8_t value);
+static inline nesemu_return_t nes_stack_push_u8(struct nes_mem_main *mem,
+						uint8_t *sp,
+						uint8_t value)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (sp == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (*sp == 0x00) {
+		return NESEMU_RETURN_MEMORY_STACK_OVERFLOW;
+	}
+#endif
+	// Store value in stack
+	mem->ram[NESEMU_STACK_GET_ADDR(*sp)] = value;
+	_NESEMU_STACK_WATCH(mem, NESEMU_STACK_GET_ADDR(*sp), value,
+			    NESEMU_DEBUGGER_WRITE);
+	_NESEMU_STACK_COVER(mem, NESEMU_STACK_GET_ADDR(*sp), WRITE);
+	_NESEMU_STACK_DIRTY(mem, NESEMU_STACK_GET_ADDR(*sp));
+	// Reduce the sp (descending stack)
+	*sp -= 1;
+	return NESEMU_RETURN_SUCCESS;
+}
 
 /**
  * Pull a word from the stack
@@ -51,9 +113,26 @@ nesemu_return_t nes_stack_push_u8(struct nes_mem_main *mem,
  * @param sp Reference to the stack pointer
  * @param value Reference where the value will be stored 
  */
-nesemu_return_t nes_stack_pop_u8(struct nes_mem_main *mem,
-				uint8_t *sp,
-				uint8_t *result);
+static inline nesemu_return_t nes_stack_pop_u8(struct nes_mem_main *mem,
+					       uint8_t *sp,
+					       uint8_t *result)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (sp == NULL || result == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (*sp == NESEMU_STACK_SIZE) {
+		return NESEMU_RETURN_MEMORY_STACK_UNDERFLOW;
+	}
+#endif
+	// Increment the sp (descending stack)
+	*sp += 1;
+	// Read value from stack
+	*result = mem->ram[NESEMU_STACK_GET_ADDR(*sp)];
+	_NESEMU_STACK_WATCH(mem, NESEMU_STACK_GET_ADDR(*sp), *result,
+			    NESEMU_DEBUGGER_READ);
+	_NESEMU_STACK_COVER(mem, NESEMU_STACK_GET_ADDR(*sp), READ);
+	return NESEMU_RETURN_SUCCESS;
+}
 
 /**
  * Push a dword to the stack
@@ -62,9 +141,34 @@ nesemu_return_t nes_stack_pop_u8(struct nes_mem_main *mem,
  * @param sp Reference to the stack pointer
  * @param value Value to be pushed
  */
-nesemu_return_t nes_stack_push_u16(struct nes_mem_main *mem,
-				  uint8_t *sp,
-				  uint16_t value);
+static inline nesemu_return_t nes_stack_push_u16(struct nes_mem_main *mem,
+						 uint8_t *sp,
+						 uint16_t value)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (sp == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (*sp == 0x00) {
+		return NESEMU_RETURN_MEMORY_STACK_OVERFLOW;
+	}
+#endif
+	// Store value in stack (little-endian, LSB at the lower address)
+	uint16_t lsb = NESEMU_STACK_GET_ADDR(*sp - 1);
+	uint16_t msb = NESEMU_STACK_GET_ADDR(*sp);
+	mem->ram[lsb] = (uint8_t)(value & 0x00FF);
+	mem->ram[msb] = (uint8_t)(value >> 8);
+	_NESEMU_STACK_WATCH(mem, lsb, (uint8_t)(value & 0x00FF),
+			    NESEMU_DEBUGGER_WRITE);
+	_NESEMU_STACK_WATCH(mem, msb, (uint8_t)(value >> 8),
+			    NESEMU_DEBUGGER_WRITE);
+	_NESEMU_STACK_COVER(mem, lsb, WRITE);
+	_NESEMU_STACK_COVER(mem, msb, WRITE);
+	_NESEMU_STACK_DIRTY(mem, lsb);
+	_NESEMU_STACK_DIRTY(mem, msb);
+	// Reduce the sp (descending stack)
+	*sp -= 2;
+	return NESEMU_RETURN_SUCCESS;
+}
 
 /**
  * Pull a dword from the stack
@@ -73,8 +177,28 @@ nesemu_return_t nes_stack_push_u16(struct nes_mem_main *mem,
  * @param sp Reference to the stack pointer
  * @param value Reference where the value will be stored 
  */
-nesemu_return_t nes_stack_pop_u16(struct nes_mem_main *mem,
-				 uint8_t *sp,
-				 uint16_t *result);
+static inline nesemu_return_t nes_stack_pop_u16(struct nes_mem_main *mem,
+						uint8_t *sp,
+						uint16_t *result)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (sp == NULL || result == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (*sp == NESEMU_STACK_SIZE) {
+		return NESEMU_RETURN_MEMORY_STACK_UNDERFLOW;
+	}
+#endif
+	// Read value from stack (little-endian, LSB at the lower address)
+	uint16_t lsb = NESEMU_STACK_GET_ADDR(*sp + 1);
+	uint16_t msb = NESEMU_STACK_GET_ADDR(*sp + 2);
+	*result = (uint16_t)(mem->ram[lsb] | (mem->ram[msb] << 8));
+	_NESEMU_STACK_WATCH(mem, lsb, mem->ram[lsb], NESEMU_DEBUGGER_READ);
+	_NESEMU_STACK_WATCH(mem, msb, mem->ram[msb], NESEMU_DEBUGGER_READ);
+	_NESEMU_STACK_COVER(mem, lsb, READ);
+	_NESEMU_STACK_COVER(mem, msb, READ);
+	// Increment the sp (descending stack)
+	*sp += 2;
+	return NESEMU_RETURN_SUCCESS;
+}
 
 #endif
@@ -2,8 +2,10 @@
 #define __NESEMU_MEMORY_VIDEO_H__
 
 #include "nesemu/cartridge/cartridge.h"
+#include "nesemu/memory/dirty.h"
 
 #include "nesemu/util/error.h"
+#include <stddef.h>
 #include <stdint.h>
 
 /*
@@ -36,6 +38,17 @@
  */
 #define NESEMU_MEMORY_VRAM_CIRAM_ADDR 0x2000
 
+/**
+ * Size of a nametable (and its attribute table), the unit of the nametable
+ * mirroring
+ */
+#define NESEMU_MEMORY_VRAM_NAMETABLE_SIZE 0x400
+
+/**
+ * Size of a pattern table page, see 'chr_page_fn' of the cartridge
+ */
+#define NESEMU_MEMORY_VRAM_PAGE_SIZE 0x100
+
 /**
  * Pattern size in bytes
  */
@@ -85,6 +98,26 @@ typedef struct nes_mem_video {
      */
 	struct nes_cartridge *cartridge;
 
+	/**
+     * Sticky error slot, first error of the value-returning accessors
+     * ('nes_vram_read8' and 'nes_vram_write8') since the last
+     * 'nes_vram_error'
+     */
+	nesemu_return_t error;
+
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+	/**
+     * Blocks written since the last 'nes_vram_dirty_clear', one flag per
+     * block of the pattern tables, CIRAM and palette RAM
+     */
+	uint8_t dirty_pattern[NESEMU_MEMORY_DIRTY_BLOCKS(
+		NESEMU_CARTRIDGE_PATTERN_TABLE_ADDR)];
+	uint8_t dirty_ciram[NESEMU_MEMORY_DIRTY_BLOCKS(
+		NESEMU_MEMORY_VRAM_CIRAM_SIZE)];
+	uint8_t dirty_palette[NESEMU_MEMORY_DIRTY_BLOCKS(
+		NESEMU_MEMORY_VRAM_PALETTE_RAM_SIZE)];
+#endif
+
 } nes_mem_video_t;
 
 /**
@@ -109,6 +142,9 @@ nesemu_return_t nes_vram_init(struct nes_mem_video *self,
  * @param self Memory array
  * @param addr Memory address
  * @param data Data to be pushed onto memory
+ *
+ * @note Checked variant of 'nes_vram_write8', the sticky error slot is left
+ * as it was
  */
 nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
 			    uint16_t addr,
@@ -120,6 +156,8 @@ nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
  * @param self Memory array
  * @param addr Memory address
  * @param result Reference to where the result will be stored
+ *
+ * @note Checked variant of 'nes_vram_read8', see 'nes_vram_w8'
  */
 nesemu_return_t nes_vram_r8(struct nes_mem_video *self,
 			    uint16_t addr,
@@ -169,4 +207,50 @@ nesemu_return_t nes_vram_palette_read(struct nes_mem_video *self,
 				      uint16_t addr,
 				      nes_vram_palette_t *palette);
 
+/**
+ * Read `size` bytes starting at `addr` into `buffer`. Palette RAM,
+ * nametables (CIRAM) and the pattern table pages the cartridge maps
+ * ('chr_page_fn') are copied in contiguous runs, the rest is read byte by
+ * byte through the cartridge callbacks.
+ *
+ * @param self Memory array
+ * @param addr First memory address
+ * @param buffer Reference to where the bytes will be stored
+ * @param size Amount of bytes, the range must not go past $3FFF
+ */
+nesemu_return_t nes_vram_read_block(struct nes_mem_video *self,
+				    uint16_t addr,
+				    uint8_t *buffer,
+				    size_t size);
+
+/**
+ * Write `size` bytes from `buffer` starting at `addr`, see
+ * 'nes_vram_read_block'
+ */
+nesemu_return_t nes_vram_write_block(struct nes_mem_video *self,
+				     uint16_t addr,
+				     const uint8_t *buffer,
+				     size_t size);
+
+/**
+ * Read 8 bits from video memory at `addr`, errors are recorded in the
+ * sticky error slot instead of being returned
+ *
+ * @note Used by the PPU in trusted builds (CONFIG_NESEMU_TRUSTED)
+ */
+uint8_t nes_vram_read8(struct nes_mem_video *self, uint16_t addr);
+
+/**
+ * Write 8 bits in video memory at `addr`, errors are recorded in the
+ * sticky error slot instead of being returned
+ */
+void nes_vram_write8(struct nes_mem_video *self, uint16_t addr, uint8_t data);
+
+/**
+ * Get and clear the sticky error slot
+ *
+ * @return First error since the last call, NESEMU_RETURN_SUCCESS if none
+ */
+nesemu_return_t nes_vram_error(struct nes_mem_video *self);
+
 #endif
@@ -6,7 +6,17 @@
 #include <nesemu/cartridge/cartridge.h>
 #include <nesemu/memory/main.h>
 #include <nesemu/memory/video.h>
+#include <nesemu/memory/dirty.h>
 #include <nesemu/cpu/cpu.h>
+#include <nesemu/cpu/alu.h>
+#include <nesemu/cpu/profile.h>
+#include <nesemu/cpu/trace.h>
+#include <nesemu/cpu/cache.h>
+#include <nesemu/cpu/block.h>
+#include <nesemu/cpu/jit.h>
+#include <nesemu/cpu/analysis.h>
+#include <nesemu/cpu/debug.h>
+#include <nesemu/cpu/coverage.h>
 #include <nesemu/ppu/ppu.h>
 
 /** NES screen height */
@@ -15,6 +15,7 @@
 #include "palette.h"
 #include "oam.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /** Visible screen height */
@@ -26,6 +27,9 @@
 /** Size of the framebuffer (RGB24) */
 #define NESEMU_PPU_BUFFER_SIZE (NESEMU_PPU_SCREEN_HEIGHT * NESEMU_PPU_SCREEN_WIDTH)
 
+/** CPU cycles taken by an OAM DMA (one more if it starts on an odd cycle) */
+#define NESEMU_PPU_OAMDMA_CYCLES 513
+
 /** Type for the PPU image output (RGB24 buffer) */
 typedef nes_color_t nes_display_t[NESEMU_PPU_BUFFER_SIZE];
 
@@ -36,8 +40,27 @@ typedef struct nes_ppu {
 
 	uint16_t scanline; /**< Index for the current scanline */
 
+	bool nmi; /**< VBlank started with NMI enabled (cleared by the caller) */
+
     nes_ppu_system_palette_t *system_palette; /**< Reference to the system palette (RGB24) */
 
+    struct nes_mem_video *vim; /**< Video memory, accessed through PPUDATA */
+
+    /* CPU visible registers */
+    uint8_t ctrl; /**< PPUCTRL ($2000), last value written */
+    uint8_t mask; /**< PPUMASK ($2001), last value written */
+    uint8_t status; /**< PPUSTATUS ($2002), flags in the upper 3 bits */
+    uint8_t oam_addr; /**< OAMADDR ($2003) */
+    uint8_t data_buffer; /**< PPUDATA ($2007) read buffer */
+    uint8_t latch; /**< Last value written to a register (open bus) */
+
+    /* PPUCTRL decoded on write, read by the renderer */
+    uint16_t nametable; /**< Base nametable address ($2000-$2C00) */
+    uint16_t bg_pattern; /**< Background pattern table ($0000 or $1000) */
+    uint16_t sprite_pattern; /**< 8x8 sprite pattern table ($0000 or $1000) */
+    uint8_t increment; /**< VRAM address increment after PPUDATA (1 or 32) */
+    bool nmi_output; /**< Raise an NMI when VBlank starts */
+
     struct nes_ppu_oam oam[NESEMU_PPU_OAM_SPRITES]; /**< Primary OAM */
     struct nes_ppu_oam s_oam[NESEMU_PPU_SOAM_SPRITES]; /**< Secondary OAM */
 
@@ -70,7 +93,8 @@ typedef struct nes_ppu {
  *
  * @param self PPU struct reference
  * @param system_palette Reference to system palette look-up table
- * @param mem Main system memory (for access to the PPU registers)
+ * @param mem Main system memory, its PPU registers are routed to this PPU
+ * @param vim Video memory (accessed by the CPU through PPUDATA)
  *
  * @note A reference to the `system_palette` array will be stored inside
  * the ppu structure, keep this array in memory and alive as much as the
@@ -78,7 +102,42 @@ typedef struct nes_ppu {
  */
 nesemu_return_t nes_ppu_init(struct nes_ppu *self,
 			     nes_ppu_system_palette_t *system_palette,
-			     struct nes_mem_main *mem);
+			     struct nes_mem_main *mem,
+			     struct nes_mem_video *vim);
+
+/**
+ * CPU read of a PPU register ($2000-$3FFF), with its side effects: reading
+ * PPUSTATUS clears VBlank and the write toggle, reading PPUDATA moves the
+ * VRAM address. Write-only registers read the open bus.
+ *
+ * @note Called by the main memory bus
+ * @note Loops reading these registers are not fast-forwarded as polling
+ * loops, except PPUSTATUS once VBlank and the write toggle are clear (see
+ * 'block.h')
+ */
+nesemu_return_t nes_ppu_register_read(struct nes_ppu *self,
+				      uint16_t addr,
+				      uint8_t *result);
+
+/**
+ * CPU write of a PPU register ($2000-$3FFF), with its side effects on the
+ * internal registers (t, v, x, w), OAM and video memory
+ *
+ * @note Called by the main memory bus
+ */
+nesemu_return_t nes_ppu_register_write(struct nes_ppu *self,
+				       uint16_t addr,
+				       uint8_t data);
+
+/**
+ * OAM DMA transfer, 256 bytes written to OAMDATA at once: OAM is filled
+ * from OAMADDR on (wrapping around), OAMADDR is left as it was
+ *
+ * @param data Source page (256 bytes)
+ *
+ * @note Called by the main memory bus on a write to $4014
+ */
+void nes_ppu_oam_dma(struct nes_ppu *self, const uint8_t *data);
 
 /**
  * Render, exactly 1 scanline.
@@ -86,7 +145,7 @@ nesemu_return_t nes_ppu_init(struct nes_ppu *self,
  * 
  * @param self PPU structure reference
  * @param display Reference to an array of RGB24 bytes
- * @param mem System memory bus
+ * @param mem System memory bus (unused, the PPU keeps its registers)
  * @param vim Video memory bus
  * @param cycles Reference to an integer where the amount of PPU cycles the operation took
  */
@@ -119,8 +178,18 @@ enum nes_ppu_registers_t {
  */
 enum nes_ppu_ppuctrl_t {
     NESEMU_PPU_PPUCTRL_BASE_NAMETABLE = 0x03,
+    NESEMU_PPU_PPUCTRL_INCREMENT = 0x04,
     NESEMU_PPU_PPUCTRL_FOREGROUND_PATTERN_TABLE = 0x08,
     NESEMU_PPU_PPUCTRL_BACKGROUND_PATTERN_TABLE = 0x10,
+    NESEMU_PPU_PPUCTRL_NMI = 0x80,
+};
+
+/**
+ * PPUSTATUS bit masks
+ */
+enum nes_ppu_ppustatus_t {
+    NESEMU_PPU_PPUSTATUS_FLAGS = 0xE0,
+    NESEMU_PPU_PPUSTATUS_VBLANK = 0x80,
 };
 
 #endif
@@ -22,10 +22,21 @@ typedef enum nesemu_return {
 	NESEMU_RETURN_MEMORY_PRGROM_OVERFLOW = -0x13,
 	NESEMU_RETURN_MEMORY_PRGROM_NO_DATA = -0x14,
 	NESEMU_RETURN_MEMORY_VRAM_BAD_MAPPER = -0x15,
+	NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED = -0x16, /**< Dirty tracking not built */
 
 	/* --- CPU --- */
 	NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION = -0x20,
 	NESEMU_RETURN_CPU_BAD_ADDRESSING = -0x21,
+	NESEMU_RETURN_CPU_JIT_UNSUPPORTED = -0x22, /**< JIT not built for this host */
+	NESEMU_RETURN_CPU_JIT_MISMATCH = -0x23, /**< JIT and interpreter disagree */
+	NESEMU_RETURN_CPU_JIT_FULL = -0x24, /**< Executable buffer exhausted */
+	NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED = -0x25, /**< Profiler not built */
+	NESEMU_RETURN_CPU_TRACE_UNSUPPORTED = -0x26, /**< Trace not built */
+	NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED = -0x27, /**< Analysis not built */
+	NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED = -0x28, /**< Debugger not built */
+	NESEMU_RETURN_CPU_DEBUGGER_FULL = -0x29, /**< No watchpoint slot left */
+	NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED = -0x2A, /**< Coverage not built */
+	NESEMU_RETURN_CPU_COVERAGE_MISMATCH = -0x2B, /**< Not the same PRG ROM layout */
 
 	/* --- Cartridge --- */
 
@@ -41,6 +52,12 @@ typedef enum nesemu_return {
 
 	/* Information */
 
+	/**
+     * Stopped by a breakpoint (before the instruction) or a watchpoint (after
+     * the instruction that accessed memory), see 'debug.h'
+     */
+	NESEMU_INFO_CPU_BREAK = 0x20,
+
 	/**
      * Read/Write operation should be delegated to the cartridge's r/w callbacks
      * instead of being handled by the bus directly.
@@ -65,4 +82,13 @@ typedef enum nesemu_return {
 #define _NESEMU_RETURN_IF_ERR(err) ;
 #endif
 
+/**
+ * Helper macro to record an error in a sticky error slot, only the first
+ * error is kept until the slot is cleared (information codes are ignored)
+ */
+#define _NESEMU_STICKY_ERR(slot, err)                                     \
+	if ((err) < NESEMU_RETURN_SUCCESS && (slot) == NESEMU_RETURN_SUCCESS) { \
+		(slot) = (err);                                            \
+	}
+
 #endif
@@ -32,10 +32,13 @@ static const char iNES_header[] = { 'N', 'E', 'S', 0x1A };
  *      nes_ines_<type>_prg_loader,
  *      nes_ines_<type>_prg_reader,
  *      nes_ines_<type>_prg_writer,
+ *      nes_ines_<type>_prg_offset,
+ *      nes_ines_<type>_prg_page,
  *      nes_ines_<type>_chr_loader,
  *      nes_ines_<type>_chr_reader,
  *      nes_ines_<type>_chr_writer,
  *      nes_ines_<type>_chr_mapper,
+ *      nes_ines_<type>_chr_page,
  *
  * Beware!. Functions are casted to their corresponding function pointer type,
  * this is to allow the first parameter to be a reference to a type instead
@@ -47,10 +50,13 @@ static const char iNES_header[] = { 'N', 'E', 'S', 0x1A };
 	cartridge->prg_load_fn = (nes_cartridge_loader_t)nes_ines_##type##_prg_loader;     \
 	cartridge->prg_read_fn = (nes_cartridge_read_t)nes_ines_##type##_prg_reader;     \
 	cartridge->prg_write_fn = (nes_cartridge_write_t)nes_ines_##type##_prg_writer;    \
+	cartridge->prg_offset_fn = (nes_cartridge_offset_t)nes_ines_##type##_prg_offset;  \
+	cartridge->prg_page_fn = (nes_cartridge_page_t)nes_ines_##type##_prg_page;        \
 	cartridge->chr_load_fn = (nes_cartridge_loader_t)nes_ines_##type##_chr_loader;     \
 	cartridge->chr_read_fn = (nes_cartridge_read_t)nes_ines_##type##_chr_reader;     \
 	cartridge->chr_write_fn = (nes_cartridge_write_t)nes_ines_##type##_chr_writer;    \
-	cartridge->chr_mapper_fn = (nes_cartridge_mapper_t)nes_ines_##type##_chr_mapper;
+	cartridge->chr_mapper_fn = (nes_cartridge_mapper_t)nes_ines_##type##_chr_mapper;  \
+	cartridge->chr_page_fn = (nes_cartridge_page_t)nes_ines_##type##_chr_page;
 
 /* -- Definitions for `cartridge.h` declarations -- */
 
@@ -133,6 +139,8 @@ nesemu_return_t nes_cartridge_read_ines(struct nes_cartridge *cartridge,
 		return err;
 	}
 
+	cartridge->prg_size = (uint32_t)prgrom_len;
+
 	// Get CHR data offset
 	cdata += prgrom_len;
 	len -= prgrom_len;
@@ -41,6 +41,43 @@ nesemu_return_t nes_ines_nrom_prg_reader(struct nes_ines_nrom_cartridge *self,
 	return NESEMU_RETURN_SUCCESS;
 }
 
+nesemu_return_t nes_ines_nrom_prg_offset(struct nes_ines_nrom_cartridge *self,
+					 uint16_t addr,
+					 uint32_t *offset)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (addr < NESEMU_CARTRIDGE_ROM_BEGIN) {
+		return NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED;
+	}
+#endif
+
+	// Same mirroring as the reader, there is no bank switching
+	*offset = self->mirrored_bank ?
+			  (addr % NESEMU_CARTRIDGE_PRGROM_BANK_SIZE) :
+			  (addr % NESEMU_CARTRIDGE_NROM_PRGROM_SIZE);
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_ines_nrom_prg_page(struct nes_ines_nrom_cartridge *self,
+				       uint16_t addr,
+				       const uint8_t **read,
+				       uint8_t **write)
+{
+	// PRG ROM is read-only, nothing below it is mapped
+	*write = NULL;
+	if (addr < NESEMU_CARTRIDGE_ROM_BEGIN) {
+		*read = NULL;
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	// Cannot fail within the PRG ROM window
+	uint32_t offset;
+	(void)nes_ines_nrom_prg_offset(self, addr, &offset);
+
+	*read = &self->prgrom[offset];
+	return NESEMU_RETURN_SUCCESS;
+}
+
 nesemu_return_t nes_ines_nrom_chr_loader(struct nes_ines_nrom_cartridge *self,
 					 uint8_t *cdata,
 					 size_t len)
@@ -67,3 +104,21 @@ nesemu_return_t nes_ines_nrom_chr_reader(struct nes_ines_nrom_cartridge *self,
 	*content = self->chrrom[addr];
 	return NESEMU_RETURN_SUCCESS;
 }
+
+nesemu_return_t nes_ines_nrom_chr_page(struct nes_ines_nrom_cartridge *self,
+				       uint16_t addr,
+				       const uint8_t **read,
+				       uint8_t **write)
+{
+	// CHR ROM is read-only
+	*write = NULL;
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (addr >= NESEMU_CARTRIDGE_NROM_CHRROM_SIZE) {
+		*read = NULL;
+		return NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED;
+	}
+#endif
+
+	*read = &self->chrrom[addr];
+	return NESEMU_RETURN_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/**
+ * This file contains definitions for functions in 'alu.h'
+ */
+
+#include "nesemu/cpu/alu.h"
+#include "nesemu/cpu/status.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+
+#include <pthread.h>
+
+struct nes_cpu_alu_entry nes_cpu_alu_adc[2 * 256 * 256];
+struct nes_cpu_alu_entry nes_cpu_alu_sbc[2 * 256 * 256];
+uint8_t nes_cpu_alu_cmp[256 * 256];
+struct nes_cpu_alu_entry nes_cpu_alu_shift[NESEMU_CPU_ALU_SHIFT_COUNT][256];
+
+/**
+ * Fills the tables exactly once, CPUs may be initialized from several
+ * threads
+ */
+static pthread_once_t alu_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Build an entry from a result and its carry, N & Z come from 'nz'
+ */
+static struct nes_cpu_alu_entry alu_entry(uint8_t result,
+					  uint8_t nz,
+					  bool carry,
+					  bool overflow)
+{
+	struct nes_cpu_alu_entry entry = {
+		.result = result,
+		.flags = NESEMU_CPU_STATUS_MASK_NZ(nz) |
+			 (carry ? NESEMU_CPU_FLAGS_C : 0) |
+			 (overflow ? NESEMU_CPU_FLAGS_V : 0),
+	};
+
+	return entry;
+}
+
+/**
+ * Fill the ADC and SBC tables, same operations as '_ADC' and '_SBC'
+ */
+static void alu_arithmetic(uint8_t c, uint8_t a, uint8_t memory)
+{
+	uint32_t i = NESEMU_CPU_ALU_INDEX(c, a, memory);
+
+	// a + m + c
+	uint16_t sum = a + memory + c;
+	nes_cpu_alu_adc[i] = alu_entry(
+		(uint8_t)sum, a, sum > UINT8_MAX,
+		(((uint8_t)sum ^ a) & ((uint8_t)sum ^ memory) &
+		 NESEMU_CPU_FLAGS_N) != 0);
+
+	// a - m - ~c
+	int16_t difference = a - memory - ~c;
+	nes_cpu_alu_sbc[i] = alu_entry(
+		(uint8_t)((uint16_t)difference & 0x00FF), a, difference < 0,
+		(((uint8_t)difference ^ a) & ((uint8_t)difference ^ ~memory) &
+		 NESEMU_CPU_FLAGS_N) != 0);
+
+	// Compare ignores the carry and always sets it
+	if (c == 0) {
+		nes_cpu_alu_cmp[i] = alu_entry(0, a - memory, true, false).flags;
+	}
+}
+
+/**
+ * Fill the shift and rotate tables, same operations as '_ASL', '_LSR',
+ * '_ROL' and '_ROR'
+ */
+static void alu_shift(uint8_t memory)
+{
+	uint8_t result = 0;
+
+	// Shift left, bit 7 goes to carry
+	uint16_t left = (uint16_t)memory << 1;
+	result = (uint8_t)left & 0xFE;
+	nes_cpu_alu_shift[NESEMU_CPU_ALU_ASL][memory] =
+		alu_entry(result, result, (left & 0x0100) != 0, false);
+
+	// Shift right (using MSB of u16), bit 0 goes to carry
+	uint16_t right = ((uint16_t)memory << 8) >> 1;
+	result = (uint8_t)(right >> 8) & 0x7F;
+	nes_cpu_alu_shift[NESEMU_CPU_ALU_LSR][memory] =
+		alu_entry(result, result, (right & 0x0080) != 0, false);
+
+	// C <- [76543210] <- C
+	result = (memory << 1) | ((memory | 0x80) >> 7);
+	nes_cpu_alu_shift[NESEMU_CPU_ALU_ROL][memory] =
+		alu_entry(result, result, (result & 0x01) != 0, false);
+
+	// C -> [76543210] -> C
+	result = (memory >> 1) | ((memory | 0x01) << 7);
+	nes_cpu_alu_shift[NESEMU_CPU_ALU_ROR][memory] =
+		alu_entry(result, result, (result & 0x80) != 0, false);
+}
+
+/**
+ * Fill every table, run through 'alu_once'
+ */
+static void alu_fill(void)
+{
+	for (uint32_t i = 0; i < 2 * 256 * 256; i++) {
+		alu_arithmetic((uint8_t)(i >> 16), (uint8_t)(i >> 8),
+			       (uint8_t)i);
+	}
+	for (uint32_t memory = 0; memory < 256; memory++) {
+		alu_shift((uint8_t)memory);
+	}
+}
+
+nesemu_return_t nes_cpu_alu_init(void)
+{
+	// Callers only return once the tables are complete
+	if (pthread_once(&alu_once, alu_fill) != 0) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#else
+
+nesemu_return_t nes_cpu_alu_init(void)
+{
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#endif
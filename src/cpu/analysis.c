@@ -0,0 +1,452 @@
+/**
+ * This file contains definitions for functions in 'analysis.h'
+ *
+ * Cache files are written to a temporary name and renamed into place, so a
+ * concurrent load of the same ROM either maps a complete file or none.
+ */
+
+#include "nesemu/cpu/analysis.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/bits.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_CPU_ANALYSIS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Maximum length of a cache file path, terminator included
+ */
+#define ANALYSIS_PATH_SIZE 4096
+
+/**
+ * FNV-1a (64 bits) parameters
+ */
+#define ANALYSIS_FNV_OFFSET 0xCBF29CE484222325ULL
+#define ANALYSIS_FNV_PRIME 0x00000100000001B3ULL
+
+/**
+ * Reset, NMI and IRQ vectors
+ */
+static const uint16_t analysis_vectors[] = { 0xFFFC, 0xFFFA, 0xFFFE };
+
+/**
+ * State of a running analysis
+ */
+struct analysis_state {
+	const uint8_t *prg; /**< PRG ROM window */
+	struct nes_cpu_analysis_map *map; /**< Result */
+	uint16_t *pending; /**< Entry points left to trace */
+	uint32_t count; /**< Amount of pending entry points */
+};
+
+/**
+ * Copy the PRG ROM window as currently mapped by the cartridge
+ */
+static nesemu_return_t analysis_read_prg(struct nes_cartridge *cartridge,
+					 uint8_t *prg)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (cartridge->prg_read_fn == NULL) {
+		return NESEMU_RETURN_CARTRIDGE_NO_CALLBACK;
+	}
+#endif
+	for (uint32_t i = 0; i < NESEMU_CPU_ANALYSIS_SIZE; i++) {
+		nesemu_return_t err = cartridge->prg_read_fn(
+			NESEMU_CARTRIDGE_GET_MAPPER_GENERIC_REF(cartridge),
+			(uint16_t)(NESEMU_CPU_ANALYSIS_BEGIN + i), &prg[i]);
+		if (err != NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * FNV-1a hash of the PRG ROM window
+ */
+static uint64_t analysis_hash(const uint8_t *prg)
+{
+	uint64_t hash = ANALYSIS_FNV_OFFSET;
+	for (uint32_t i = 0; i < NESEMU_CPU_ANALYSIS_SIZE; i++) {
+		hash = (hash ^ prg[i]) * ANALYSIS_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Mark an entry point and queue it, every address is queued at most once
+ */
+static void analysis_entry(struct analysis_state *state,
+			   uint16_t addr,
+			   uint8_t flag)
+{
+	// Code in RAM is not covered
+	if (addr < NESEMU_CPU_ANALYSIS_BEGIN) {
+		return;
+	}
+
+	uint8_t *flags = &state->map->flags[addr - NESEMU_CPU_ANALYSIS_BEGIN];
+	bool queued = (*flags & (NESEMU_CPU_ANALYSIS_CODE |
+				 NESEMU_CPU_ANALYSIS_TARGET |
+				 NESEMU_CPU_ANALYSIS_VECTOR)) != 0;
+
+	*flags |= flag | NESEMU_CPU_ANALYSIS_BLOCK;
+	if (!queued) {
+		state->pending[state->count++] = addr;
+	}
+}
+
+/**
+ * Follow the instructions starting at an entry point until the flow leaves
+ * (jump, return, invalid opcode) or reaches code already traced
+ */
+static void analysis_trace(struct analysis_state *state, uint16_t pc)
+{
+	bool start = true;
+
+	while (pc >= NESEMU_CPU_ANALYSIS_BEGIN) {
+		uint32_t i = pc - NESEMU_CPU_ANALYSIS_BEGIN;
+		uint8_t *flags = &state->map->flags[i];
+
+		if (*flags & NESEMU_CPU_ANALYSIS_CODE) {
+			// Joining a traced run starts a block there
+			if (start) {
+				*flags |= NESEMU_CPU_ANALYSIS_BLOCK;
+			}
+			return;
+		}
+
+		uint8_t opcode = state->prg[i];
+		const struct nes_cpu_opcode *op = &nes_cpu_opcodes[opcode];
+
+		// Unsupported opcodes and operands past $FFFF end the trace
+		if (op->handler == NULL ||
+		    i + op->length > NESEMU_CPU_ANALYSIS_SIZE) {
+			return;
+		}
+
+		*flags |= NESEMU_CPU_ANALYSIS_CODE |
+			  (start ? NESEMU_CPU_ANALYSIS_BLOCK : 0);
+		for (uint8_t j = 1; j < op->length; j++) {
+			flags[j] |= NESEMU_CPU_ANALYSIS_OPERAND;
+		}
+
+		uint8_t lsb = (op->length > 1) ? state->prg[i + 1] : 0;
+		uint8_t msb = (op->length > 2) ? state->prg[i + 2] : 0;
+		uint16_t next = pc + op->length;
+
+		start = nes_cpu_block_terminator(opcode);
+		if (!start) {
+			pc = next;
+			continue;
+		}
+
+		switch (opcode) {
+		case JSR:
+			// Assume the subroutine returns
+			analysis_entry(state, NESEMU_UTIL_U16(msb, lsb),
+				       NESEMU_CPU_ANALYSIS_TARGET);
+			break;
+		case JMP_AB:
+			analysis_entry(state, NESEMU_UTIL_U16(msb, lsb),
+				       NESEMU_CPU_ANALYSIS_TARGET);
+			return;
+		case JMP_IN:
+			_NESEMU_FALLTHROUGH;
+		case RTS:
+			_NESEMU_FALLTHROUGH;
+		case RTI:
+			_NESEMU_FALLTHROUGH;
+		case BRK:
+			_NESEMU_FALLTHROUGH;
+		case STP:
+			return;
+		default:
+			// Branches, both ways
+			analysis_entry(state, (uint16_t)(next + (int8_t)lsb),
+				       NESEMU_CPU_ANALYSIS_TARGET);
+			break;
+		}
+
+		pc = next;
+	}
+}
+
+/**
+ * Trace the code reachable from the vectors
+ */
+static nesemu_return_t analysis_run(struct nes_cpu_analysis_map *map,
+				    const uint8_t *prg,
+				    uint64_t hash)
+{
+	struct analysis_state state = {
+		.prg = prg,
+		.map = map,
+		.pending = (uint16_t *)malloc(NESEMU_CPU_ANALYSIS_SIZE *
+					      sizeof(uint16_t)),
+		.count = 0,
+	};
+	if (state.pending == NULL) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	memset(map, 0, sizeof(struct nes_cpu_analysis_map));
+	memcpy(map->magic, NESEMU_CPU_ANALYSIS_MAGIC, sizeof(map->magic));
+	map->version = NESEMU_CPU_ANALYSIS_VERSION;
+	map->size = sizeof(struct nes_cpu_analysis_map);
+	map->hash = hash;
+
+	// Seed with the vectors (little-endian, always in the window)
+	for (size_t v = 0;
+	     v < sizeof(analysis_vectors) / sizeof(analysis_vectors[0]); v++) {
+		uint32_t i = analysis_vectors[v] - NESEMU_CPU_ANALYSIS_BEGIN;
+		analysis_entry(&state, NESEMU_UTIL_U16(prg[i + 1], prg[i]),
+			       NESEMU_CPU_ANALYSIS_VECTOR);
+	}
+
+	while (state.count > 0) {
+		analysis_trace(&state, state.pending[--state.count]);
+	}
+	free(state.pending);
+
+	// Targets that are not code (invalid opcodes) do not start blocks
+	for (uint32_t i = 0; i < NESEMU_CPU_ANALYSIS_SIZE; i++) {
+		uint8_t flags = map->flags[i];
+		if (!(flags & NESEMU_CPU_ANALYSIS_CODE)) {
+			map->flags[i] &= (uint8_t)~NESEMU_CPU_ANALYSIS_BLOCK;
+			flags = map->flags[i];
+		}
+		map->instructions += (flags & NESEMU_CPU_ANALYSIS_CODE) != 0;
+		map->blocks += (flags & NESEMU_CPU_ANALYSIS_BLOCK) != 0;
+		map->targets += (flags & NESEMU_CPU_ANALYSIS_TARGET) != 0;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Check that a map belongs to the ROM and to this format
+ */
+static bool analysis_valid(const struct nes_cpu_analysis_map *map,
+			   uint64_t hash)
+{
+	return memcmp(map->magic, NESEMU_CPU_ANALYSIS_MAGIC,
+		      sizeof(map->magic)) == 0 &&
+	       map->version == NESEMU_CPU_ANALYSIS_VERSION &&
+	       map->size == sizeof(struct nes_cpu_analysis_map) &&
+	       map->hash == hash;
+}
+
+/**
+ * Map a cache file, NULL if missing or invalid
+ */
+static const struct nes_cpu_analysis_map *analysis_map_file(const char *path,
+							    uint64_t hash)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	// A short or padded file is never valid
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+	    st.st_size != (off_t)sizeof(struct nes_cpu_analysis_map)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *data = mmap(NULL, sizeof(struct nes_cpu_analysis_map), PROT_READ,
+			  MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	const struct nes_cpu_analysis_map *map =
+		(const struct nes_cpu_analysis_map *)data;
+	if (!analysis_valid(map, hash)) {
+		munmap(data, sizeof(struct nes_cpu_analysis_map));
+		return NULL;
+	}
+
+	return map;
+}
+
+/**
+ * Write a cache file through a temporary file
+ */
+static void analysis_store(const char *path,
+			   const struct nes_cpu_analysis_map *map)
+{
+	char tmp[ANALYSIS_PATH_SIZE];
+	int len = snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path,
+			   (long)getpid());
+	if (len < 0 || (size_t)len >= sizeof(tmp)) {
+		return;
+	}
+
+	FILE *f = fopen(tmp, "wb");
+	if (f == NULL) {
+		return;
+	}
+
+	bool written = fwrite(map, sizeof(struct nes_cpu_analysis_map), 1, f) ==
+		       1;
+	if (fclose(f) != 0 || !written || rename(tmp, path) != 0) {
+		(void)remove(tmp);
+	}
+}
+
+nesemu_return_t nes_cpu_analysis_load(struct nes_cpu_analysis *self,
+				      struct nes_cartridge *cartridge,
+				      const char *dir)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cartridge == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	self->map = NULL;
+	self->mapped = false;
+
+	uint8_t *prg = (uint8_t *)malloc(NESEMU_CPU_ANALYSIS_SIZE);
+	if (prg == NULL) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	nesemu_return_t err = analysis_read_prg(cartridge, prg);
+	if (err != NESEMU_RETURN_SUCCESS) {
+		free(prg);
+		return err;
+	}
+	uint64_t hash = analysis_hash(prg);
+
+	// Cache file of the ROM
+	char path[ANALYSIS_PATH_SIZE];
+	bool cached = false;
+	if (dir != NULL) {
+		int len = snprintf(path, sizeof(path),
+				   "%s/%016llx" NESEMU_CPU_ANALYSIS_EXTENSION,
+				   dir, (unsigned long long)hash);
+		cached = len > 0 && (size_t)len < sizeof(path);
+	}
+
+	// Warm start
+	if (cached && (self->map = analysis_map_file(path, hash)) != NULL) {
+		self->mapped = true;
+		free(prg);
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	struct nes_cpu_analysis_map *map = (struct nes_cpu_analysis_map *)malloc(
+		sizeof(struct nes_cpu_analysis_map));
+	if (map == NULL) {
+		free(prg);
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	err = analysis_run(map, prg, hash);
+	free(prg);
+	if (err != NESEMU_RETURN_SUCCESS) {
+		free(map);
+		return err;
+	}
+
+	if (cached) {
+		analysis_store(path, map);
+	}
+	self->map = map;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_analysis_destroy(struct nes_cpu_analysis *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (self->mapped) {
+		munmap((void *)self->map, sizeof(struct nes_cpu_analysis_map));
+	} else {
+		free((void *)self->map);
+	}
+
+	self->map = NULL;
+	self->mapped = false;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_analysis_prime(const struct nes_cpu_analysis *self,
+				       struct nes_cpu_cache *cache,
+				       struct nes_mem_main *mem)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->map == NULL || cache == NULL || mem == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	for (uint32_t i = 0; i < NESEMU_CPU_ANALYSIS_SIZE; i++) {
+		if (!(self->map->flags[i] & NESEMU_CPU_ANALYSIS_CODE)) {
+			continue;
+		}
+
+		nesemu_return_t err = nes_cpu_cache_decode(
+			cache, mem, (uint16_t)(NESEMU_CPU_ANALYSIS_BEGIN + i));
+		if (err != NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#else
+
+nesemu_return_t nes_cpu_analysis_load(struct nes_cpu_analysis *self,
+				      struct nes_cartridge *cartridge,
+				      const char *dir)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cartridge);
+	_NESEMU_UNUSED(dir);
+	return NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_analysis_destroy(struct nes_cpu_analysis *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_analysis_prime(const struct nes_cpu_analysis *self,
+				       struct nes_cpu_cache *cache,
+				       struct nes_mem_main *mem)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cache);
+	_NESEMU_UNUSED(mem);
+	return NESEMU_RETURN_CPU_ANALYSIS_UNSUPPORTED;
+}
+
+#endif
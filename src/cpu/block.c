@@ -0,0 +1,55 @@
+/**
+ * This file contains definitions for functions in 'block.h'
+ */
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/error.h"
+
+#include <stddef.h>
+#include <string.h>
+
+nesemu_return_t nes_cpu_block_cache_init(struct nes_cpu_block_cache *self,
+					 struct nes_mem_main *mem)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || mem == NULL || mem->cartridge == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Start empty with the current mapping
+	memset(self, 0, sizeof(struct nes_cpu_block_cache));
+	self->prg_version = mem->cartridge->prg_version;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_block_cache_attach(struct nes_cpu_block_cache *self,
+					   struct nes_cpu *cpu)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	cpu->blocks = self;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+void nes_cpu_block_cache_flush(struct nes_cpu_block_cache *self)
+{
+	// Forget every block start
+	memset(self->index, 0, sizeof(self->index));
+
+	// Links into recycled blocks must never be followed
+	for (size_t i = 0; i < self->count; i++) {
+		self->blocks[i].next[NESEMU_CPU_BLOCK_LINK_FALLTHROUGH] = NULL;
+		self->blocks[i].next[NESEMU_CPU_BLOCK_LINK_TARGET] = NULL;
+		self->blocks[i].length = 0;
+	}
+
+	self->count = 0;
+	self->generation++;
+}
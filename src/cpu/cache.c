@@ -0,0 +1,113 @@
+/**
+ * This file contains definitions for functions in 'cache.h'
+ */
+
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/coverage.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/bits.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+nesemu_return_t nes_cpu_cache_init(struct nes_cpu_cache *self,
+				   struct nes_mem_main *mem)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || mem == NULL || mem->cartridge == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Start empty with the current mapping
+	nes_cpu_cache_invalidate(self);
+	self->prg_version = mem->cartridge->prg_version;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_cache_attach(struct nes_cpu_cache *self,
+				     struct nes_cpu *cpu)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	cpu->cache = self;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Decode the instruction at 'pc' into its entry, see 'nes_cpu_cache_decode'
+ */
+static nesemu_return_t cache_decode(struct nes_cpu_cache *self,
+				    struct nes_mem_main *mem,
+				    uint16_t pc)
+{
+	struct nes_cpu_cache_entry inst;
+	uint8_t lsb = 0, msb = 0;
+
+	nesemu_return_t err = nes_mem_r8(mem, pc, &inst.opcode);
+	_NESEMU_RETURN_IF_ERR(err);
+
+	const struct nes_cpu_opcode *op = &nes_cpu_opcodes[inst.opcode];
+	if (op->handler == NULL) {
+		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
+	}
+	if (pc > (uint16_t)(0xFFFF - (op->length - 1))) {
+		return NESEMU_RETURN_MEMORY_PRGROM_OVERFLOW;
+	}
+
+	// Assemble the operand
+	if (op->length > 1) {
+		err = nes_mem_r8(mem, pc + 1, &lsb);
+		_NESEMU_RETURN_IF_ERR(err);
+	}
+	if (op->length > 2) {
+		err = nes_mem_r8(mem, pc + 2, &msb);
+		_NESEMU_RETURN_IF_ERR(err);
+	}
+
+	inst.handler = op->handler;
+	inst.operand = NESEMU_UTIL_U16(msb, lsb);
+	inst.length = op->length;
+	inst.cycles = op->cycles;
+	inst.fused = NESEMU_CPU_FUSED_NONE;
+	self->entries[pc - NESEMU_CPU_CACHE_BEGIN] = inst;
+
+	return err;
+}
+
+nesemu_return_t nes_cpu_cache_decode(struct nes_cpu_cache *self,
+				     struct nes_mem_main *mem,
+				     uint16_t pc)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || mem == NULL || pc < NESEMU_CPU_CACHE_BEGIN) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	// Decoding ahead of execution is neither code nor data coverage
+	struct nes_cpu_coverage *coverage = mem->coverage;
+	if (coverage != NULL) {
+		bool muted = coverage->muted;
+		coverage->muted = true;
+		nesemu_return_t err = cache_decode(self, mem, pc);
+		coverage->muted = muted;
+		return err;
+	}
+#endif
+	return cache_decode(self, mem, pc);
+}
+
+void nes_cpu_cache_invalidate(struct nes_cpu_cache *self)
+{
+	// NULL handler marks an empty entry
+	memset(self->entries, 0, sizeof(self->entries));
+}
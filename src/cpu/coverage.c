@@ -0,0 +1,364 @@
+/**
+ * This file contains definitions for functions in 'coverage.h'
+ */
+
+#include "nesemu/cpu/coverage.h"
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+
+/**
+ * Size in bytes of the CPU bitmaps (every kind)
+ */
+#define COVERAGE_CPU_SIZE \
+	(NESEMU_CPU_COVERAGE_KINDS * NESEMU_CPU_COVERAGE_CPU_BYTES)
+
+/**
+ * OR 'len' bytes of 'src' into 'dst'
+ */
+static void coverage_or(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		dst[i] |= src[i];
+	}
+}
+
+nesemu_return_t nes_cpu_coverage_init(struct nes_cpu_coverage *self,
+				      struct nes_cartridge *cartridge)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cartridge == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self, 0, sizeof(struct nes_cpu_coverage));
+	self->cartridge = cartridge;
+
+	// Without a PRG ROM offset callback only the CPU bitmaps are kept
+	if (cartridge->prg_offset_fn == NULL || cartridge->prg_size == 0) {
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	self->prg_bytes = (cartridge->prg_size + 7) / 8;
+	self->prg = (uint8_t *)calloc(NESEMU_CPU_COVERAGE_KINDS,
+				      self->prg_bytes);
+	if (self->prg == NULL) {
+		self->prg_bytes = 0;
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_destroy(struct nes_cpu_coverage *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	(void)nes_cpu_coverage_detach(self);
+	free(self->prg);
+	self->prg = NULL;
+	self->prg_bytes = 0;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_reset(struct nes_cpu_coverage *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self->cpu, 0, sizeof(self->cpu));
+	if (self->prg != NULL) {
+		memset(self->prg, 0,
+		       (size_t)NESEMU_CPU_COVERAGE_KINDS * self->prg_bytes);
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_attach(struct nes_cpu_coverage *self,
+					struct nes_mem_main *mem)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || mem == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	(void)nes_cpu_coverage_detach(self);
+	self->mem = mem;
+	self->muted = false;
+	mem->coverage = self;
+	nes_mem_map(mem);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_detach(struct nes_cpu_coverage *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (self->mem != NULL && self->mem->coverage == self) {
+		self->mem->coverage = NULL;
+		nes_mem_map(self->mem);
+	}
+	self->mem = NULL;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_merge(struct nes_cpu_coverage *self,
+				       const struct nes_cpu_coverage *other)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || other == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (self->prg_bytes != other->prg_bytes) {
+		return NESEMU_RETURN_CPU_COVERAGE_MISMATCH;
+	}
+
+	coverage_or(&self->cpu[0][0], &other->cpu[0][0], COVERAGE_CPU_SIZE);
+	if (self->prg != NULL) {
+		coverage_or(self->prg, other->prg,
+			    (size_t)NESEMU_CPU_COVERAGE_KINDS * self->prg_bytes);
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_save(const struct nes_cpu_coverage *self,
+				      FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	struct nes_cpu_coverage_header header = {
+		.version = NESEMU_CPU_COVERAGE_VERSION,
+		.prg_size = self->prg_bytes * 8,
+	};
+	memcpy(header.magic, NESEMU_CPU_COVERAGE_MAGIC, sizeof(header.magic));
+
+	size_t prg_size = (size_t)NESEMU_CPU_COVERAGE_KINDS * self->prg_bytes;
+	if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+	    fwrite(self->cpu, COVERAGE_CPU_SIZE, 1, f) != 1 ||
+	    (prg_size > 0 && fwrite(self->prg, prg_size, 1, f) != 1)) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_coverage_merge_file(struct nes_cpu_coverage *self,
+					    FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	struct nes_cpu_coverage_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+	    memcmp(header.magic, NESEMU_CPU_COVERAGE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != NESEMU_CPU_COVERAGE_VERSION ||
+	    header.prg_size != self->prg_bytes * 8) {
+		return NESEMU_RETURN_CPU_COVERAGE_MISMATCH;
+	}
+
+	// Read everything first, a truncated export adds nothing
+	size_t size = COVERAGE_CPU_SIZE +
+		      (size_t)NESEMU_CPU_COVERAGE_KINDS * self->prg_bytes;
+	uint8_t *bits = (uint8_t *)malloc(size);
+	if (bits == NULL) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+	if (fread(bits, size, 1, f) != 1) {
+		free(bits);
+		return NESEMU_RETURN_CPU_COVERAGE_MISMATCH;
+	}
+
+	coverage_or(&self->cpu[0][0], bits, COVERAGE_CPU_SIZE);
+	if (self->prg != NULL) {
+		coverage_or(self->prg, bits + COVERAGE_CPU_SIZE,
+			    size - COVERAGE_CPU_SIZE);
+	}
+	free(bits);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+bool nes_cpu_coverage_test(const struct nes_cpu_coverage *self,
+			   uint16_t addr,
+			   enum nes_cpu_coverage_kind kind)
+{
+	return (self->cpu[kind][addr >> 3] >> (addr & 7)) & 1;
+}
+
+bool nes_cpu_coverage_test_prg(const struct nes_cpu_coverage *self,
+			       uint32_t offset,
+			       enum nes_cpu_coverage_kind kind)
+{
+	if ((offset >> 3) >= self->prg_bytes) {
+		return false;
+	}
+
+	return (self->prg[kind * self->prg_bytes + (offset >> 3)] >>
+		(offset & 7)) &
+	       1;
+}
+
+uint32_t nes_cpu_coverage_count(const struct nes_cpu_coverage *self,
+				enum nes_cpu_coverage_kind kind)
+{
+	uint32_t count = 0;
+	for (size_t i = 0; i < NESEMU_CPU_COVERAGE_CPU_BYTES; i++) {
+		for (uint8_t bits = self->cpu[kind][i]; bits != 0;
+		     bits &= (uint8_t)(bits - 1)) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void nes_cpu_coverage_mark_prg(struct nes_cpu_coverage *self,
+			       uint16_t addr,
+			       enum nes_cpu_coverage_kind kind)
+{
+	if (self->prg == NULL) {
+		return;
+	}
+
+	// Offset within the bank currently mapped at 'addr'
+	struct nes_cartridge *cartridge = self->cartridge;
+	uint32_t offset;
+	if (cartridge->prg_offset_fn(
+		    NESEMU_CARTRIDGE_GET_MAPPER_GENERIC_REF(cartridge), addr,
+		    &offset) != NESEMU_RETURN_SUCCESS ||
+	    (offset >> 3) >= self->prg_bytes) {
+		return;
+	}
+
+	self->prg[kind * self->prg_bytes + (offset >> 3)] |=
+		(uint8_t)(1 << (offset & 7));
+}
+
+#else
+
+nesemu_return_t nes_cpu_coverage_init(struct nes_cpu_coverage *self,
+				      struct nes_cartridge *cartridge)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cartridge);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_destroy(struct nes_cpu_coverage *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_reset(struct nes_cpu_coverage *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_attach(struct nes_cpu_coverage *self,
+					struct nes_mem_main *mem)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(mem);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_detach(struct nes_cpu_coverage *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_merge(struct nes_cpu_coverage *self,
+				       const struct nes_cpu_coverage *other)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(other);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_save(const struct nes_cpu_coverage *self,
+				      FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_coverage_merge_file(struct nes_cpu_coverage *self,
+					    FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_COVERAGE_UNSUPPORTED;
+}
+
+bool nes_cpu_coverage_test(const struct nes_cpu_coverage *self,
+			   uint16_t addr,
+			   enum nes_cpu_coverage_kind kind)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(addr);
+	_NESEMU_UNUSED(kind);
+	return false;
+}
+
+bool nes_cpu_coverage_test_prg(const struct nes_cpu_coverage *self,
+			       uint32_t offset,
+			       enum nes_cpu_coverage_kind kind)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(offset);
+	_NESEMU_UNUSED(kind);
+	return false;
+}
+
+uint32_t nes_cpu_coverage_count(const struct nes_cpu_coverage *self,
+				enum nes_cpu_coverage_kind kind)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(kind);
+	return 0;
+}
+
+void nes_cpu_coverage_mark_prg(struct nes_cpu_coverage *self,
+			       uint16_t addr,
+			       enum nes_cpu_coverage_kind kind)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(addr);
+	_NESEMU_UNUSED(kind);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/alu.h"
 #include "nesemu/cpu/instructions.h"
 #include "nesemu/cpu/status.h"
 #include "nesemu/memory/main.h"
@@ -19,7 +20,17 @@ nesemu_return_t nes_cpu_init(struct nes_cpu *self,
 	self->sp -= (uint8_t)NESEMU_CPU_RESTART_SP;
 	self->status = NESEMU_CPU_FLAGS_I;
 
-	return NESEMU_RETURN_SUCCESS;
+	// The reset sequence takes as long as an interrupt
+	self->clock = NESEMU_CPU_INTERRUPT_CYCLES;
+
+	// Nothing scheduled
+	for (int i = 0; i < NESEMU_CPU_EVENT_COUNT; i++) {
+		self->events[i] = NESEMU_CPU_EVENT_NEVER;
+	}
+	self->next_event = NESEMU_CPU_EVENT_NEVER;
+
+	// Precomputed ALU (only built once)
+	return nes_cpu_alu_init();
 }
 
 nesemu_return_t nes_cpu_reset(struct nes_cpu *self,
@@ -33,15 +44,45 @@ nesemu_return_t nes_cpu_reset(struct nes_cpu *self,
 	// Only I flag gets set to 1, others are unchanged
 	self->status |= NESEMU_CPU_FLAGS_I;
 
+	// The reset sequence takes as long as an interrupt
+	self->clock += NESEMU_CPU_INTERRUPT_CYCLES;
+
 	return NESEMU_RETURN_SUCCESS;
 }
 
-inline uint8_t nes_cpu_fetch(struct nes_cpu *self,
-			     struct nes_mem_main *mem)
+nesemu_return_t nes_cpu_event_schedule(struct nes_cpu *self,
+				       enum nes_cpu_event event,
+				       uint64_t at)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || event >= NESEMU_CPU_EVENT_COUNT) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+
+	self->events[event] = at;
+	self->next_event = nes_cpu_event_next(self);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_event_cancel(struct nes_cpu *self,
+				     enum nes_cpu_event event)
+{
+	return nes_cpu_event_schedule(self, event, NESEMU_CPU_EVENT_NEVER);
+}
+
+nesemu_return_t nes_cpu_irq_release(struct nes_cpu *self,
+				    enum nes_cpu_event event)
 {
-	// Get next instruction, no fail
-	uint8_t result;
-	(void)nes_mem_r8(mem, self->pc++, &result);
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || event >= NESEMU_CPU_EVENT_COUNT) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
 
-	return result;
+	self->irq &= (uint8_t)~(1u << event);
+	self->next_event = nes_cpu_event_next(self);
+
+	return NESEMU_RETURN_SUCCESS;
 }
@@ -0,0 +1,452 @@
+/**
+ * This file contains definitions for functions in 'debug.h'
+ */
+
+#include "nesemu/cpu/debug.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+
+/**
+ * Pages of the work RAM and its mirrors ($0000-$1FFF)
+ */
+#define _DEBUGGER_RAM_PAGES \
+	NESEMU_MEMORY_PAGE(NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR)
+
+/**
+ * Check if there is a breakpoint at a PRG ROM address
+ */
+static bool debugger_has_break(const struct nes_debugger *self, uint16_t addr)
+{
+	uint16_t i = addr - NESEMU_CPU_CACHE_BEGIN;
+	return (self->breakpoints[i >> 3] >> (i & 0x07)) & 0x01;
+}
+
+/**
+ * Decode the instruction at 'addr' into the decode cache, pointing it to
+ * the trap if 'trap'
+ *
+ * @note The decoding reads are not reported to the watchpoints
+ */
+static nesemu_return_t debugger_decode(struct nes_debugger *self,
+				       uint16_t addr,
+				       bool trap)
+{
+	struct nes_cpu_cache_entry *entry =
+		&self->cpu->cache->entries[addr - NESEMU_CPU_CACHE_BEGIN];
+
+	// Left empty if the instruction cannot be decoded
+	memset(entry, 0, sizeof(struct nes_cpu_cache_entry));
+
+	self->decoding = true;
+	nesemu_return_t err = nes_cpu_cache_decode(self->cpu->cache, self->mem,
+						   addr);
+	self->decoding = false;
+
+	if (err == NESEMU_RETURN_SUCCESS && trap) {
+		// Opcode and length are kept for the trace and the decoder
+		entry->handler = nes_debugger_trap;
+		entry->operand = addr;
+	}
+
+	return err;
+}
+
+/**
+ * Drop every block, so that none of them runs over a changed breakpoint
+ */
+static void debugger_flush(struct nes_debugger *self)
+{
+	if (self->cpu->blocks != NULL) {
+		nes_cpu_block_cache_flush(self->cpu->blocks);
+	}
+}
+
+/**
+ * Check if a watchpoint covers an address, work RAM addresses match through
+ * any of their mirrors
+ */
+static bool debugger_watches(const struct nes_debugger_watchpoint *w,
+			     uint16_t addr)
+{
+	if (addr >= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR) {
+		return addr >= w->begin && addr <= w->end;
+	}
+
+	for (uint32_t at = addr & NESEMU_MEMORY_RAM_MASK;
+	     at < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR;
+	     at += NESEMU_MEMORY_RAM_MIRRORING_BASE) {
+		if (at >= w->begin && at <= w->end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Build the access kinds watched per page
+ */
+static void debugger_pages(struct nes_debugger *self)
+{
+	uint8_t *pages = self->mem->watch_pages;
+	memset(pages, 0, sizeof(self->mem->watch_pages));
+
+	for (uint8_t i = 0; i < self->watch_count; i++) {
+		const struct nes_debugger_watchpoint *w = &self->watchpoints[i];
+		for (uint32_t page = w->begin >> 8; page <= (uint32_t)(w->end >> 8);
+		     page++) {
+			pages[page] |= w->kinds;
+		}
+	}
+
+	// Work RAM pages are watched along with their mirrors
+	uint8_t ram[NESEMU_MEMORY_PAGE(NESEMU_MEMORY_RAM_SIZE)] = { 0 };
+	for (uint16_t page = 0; page < _DEBUGGER_RAM_PAGES; page++) {
+		ram[page % sizeof(ram)] |= pages[page];
+	}
+	for (uint16_t page = 0; page < _DEBUGGER_RAM_PAGES; page++) {
+		pages[page] = ram[page % sizeof(ram)];
+	}
+
+	// Watched pages lose their fast path
+	nes_mem_map(self->mem);
+}
+
+nesemu_return_t nes_debugger_attach(struct nes_debugger *self,
+				    struct nes_cpu *cpu,
+				    struct nes_mem_main *mem)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL || mem == NULL || cpu->cache == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self, 0, sizeof(struct nes_debugger));
+	self->cpu = cpu;
+	self->mem = mem;
+	self->running = cpu;
+
+	cpu->debugger = self;
+	cpu->halt = false;
+	mem->debugger = self;
+	memset(mem->watch_pages, 0, sizeof(mem->watch_pages));
+	nes_mem_map(mem);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_detach(struct nes_debugger *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Restore the decoded instructions
+	for (uint32_t i = 0; i < NESEMU_CPU_CACHE_SIZE; i++) {
+		uint16_t addr = (uint16_t)(NESEMU_CPU_CACHE_BEGIN + i);
+		if (debugger_has_break(self, addr)) {
+			(void)debugger_decode(self, addr, false);
+		}
+	}
+	memset(self->breakpoints, 0, sizeof(self->breakpoints));
+	debugger_flush(self);
+
+	self->watch_count = 0;
+	debugger_pages(self);
+
+	self->cpu->debugger = NULL;
+	self->cpu->halt = false;
+	self->cpu->next_event = nes_cpu_event_next(self->cpu);
+	self->mem->debugger = NULL;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_break_add(struct nes_debugger *self,
+				       uint16_t addr)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL ||
+	    addr < NESEMU_CPU_CACHE_BEGIN) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (debugger_has_break(self, addr)) {
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	nesemu_return_t err = debugger_decode(self, addr, true);
+	if (err != NESEMU_RETURN_SUCCESS) {
+		return err;
+	}
+
+	uint16_t i = addr - NESEMU_CPU_CACHE_BEGIN;
+	self->breakpoints[i >> 3] |= (uint8_t)(1u << (i & 0x07));
+	debugger_flush(self);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_break_remove(struct nes_debugger *self,
+					  uint16_t addr)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL ||
+	    addr < NESEMU_CPU_CACHE_BEGIN) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (!debugger_has_break(self, addr)) {
+		return NESEMU_RETURN_SUCCESS;
+	}
+
+	uint16_t i = addr - NESEMU_CPU_CACHE_BEGIN;
+	self->breakpoints[i >> 3] &= (uint8_t)~(1u << (i & 0x07));
+	(void)debugger_decode(self, addr, false);
+	debugger_flush(self);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_watch_add(struct nes_debugger *self,
+				       uint16_t begin,
+				       uint16_t end,
+				       uint8_t kinds)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL || begin > end || kinds == 0 ||
+	    (kinds & ~(NESEMU_DEBUGGER_READ | NESEMU_DEBUGGER_WRITE)) != 0) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (self->watch_count == NESEMU_DEBUGGER_WATCHPOINTS) {
+		return NESEMU_RETURN_CPU_DEBUGGER_FULL;
+	}
+
+	struct nes_debugger_watchpoint *w =
+		&self->watchpoints[self->watch_count++];
+	w->begin = begin;
+	w->end = end;
+	w->kinds = kinds;
+	debugger_pages(self);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_watch_remove(struct nes_debugger *self,
+					  uint16_t begin,
+					  uint16_t end,
+					  uint8_t kinds)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	for (uint8_t i = 0; i < self->watch_count; i++) {
+		struct nes_debugger_watchpoint *w = &self->watchpoints[i];
+		if (w->begin != begin || w->end != end || w->kinds != kinds) {
+			continue;
+		}
+
+		// Order does not matter, move the last one here
+		*w = self->watchpoints[--self->watch_count];
+		debugger_pages(self);
+		break;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_debugger_step(struct nes_debugger *self, int *cycles)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->cpu == NULL || cycles == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	struct nes_cpu *cpu = self->cpu;
+	uint16_t pc = cpu->pc;
+	self->hit.kind = NESEMU_DEBUGGER_NONE;
+
+	// Lift the breakpoint under $pc for a single instruction
+	bool lifted = pc >= NESEMU_CPU_CACHE_BEGIN &&
+		      debugger_has_break(self, pc);
+	if (lifted) {
+		(void)debugger_decode(self, pc, false);
+	}
+
+	nesemu_return_t err = nes_cpu_next(cpu, self->mem, cycles);
+
+	if (lifted) {
+		(void)debugger_decode(self, pc, true);
+	}
+
+	return err;
+}
+
+void nes_debugger_rearm(struct nes_debugger *self)
+{
+	for (uint32_t i = 0; i < NESEMU_CPU_CACHE_SIZE; i++) {
+		uint16_t addr = (uint16_t)(NESEMU_CPU_CACHE_BEGIN + i);
+		if (debugger_has_break(self, addr)) {
+			(void)debugger_decode(self, addr, true);
+		}
+	}
+}
+
+nesemu_return_t nes_debugger_trap(struct nes_cpu *self,
+				  struct nes_mem_main *mem,
+				  uint32_t operand,
+				  int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+
+	// Nothing executed, resume at the instruction
+	self->pc = (uint16_t)operand;
+	*cycles = 0;
+
+	struct nes_debugger_hit *hit = &self->debugger->hit;
+	hit->kind = NESEMU_DEBUGGER_EXECUTE;
+	hit->address = self->pc;
+	hit->value = 0;
+	hit->pc = self->pc;
+
+	return NESEMU_INFO_CPU_BREAK;
+}
+
+void nes_debugger_watch_hit(struct nes_debugger *self,
+			    uint16_t addr,
+			    uint8_t value,
+			    enum nes_debugger_kind kind)
+{
+	struct nes_cpu *cpu = self->running;
+
+	// The first hit of the instruction is kept
+	if (cpu->halt || self->decoding) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < self->watch_count; i++) {
+		const struct nes_debugger_watchpoint *w = &self->watchpoints[i];
+		if (!(w->kinds & kind) || !debugger_watches(w, addr)) {
+			continue;
+		}
+
+		self->hit.kind = kind;
+		self->hit.address = addr;
+		self->hit.value = value;
+		self->hit.pc = cpu->pc;
+
+		// Stop at the next instruction boundary
+		cpu->halt = true;
+		cpu->next_event = cpu->clock;
+		return;
+	}
+}
+
+#else
+
+nesemu_return_t nes_debugger_attach(struct nes_debugger *self,
+				    struct nes_cpu *cpu,
+				    struct nes_mem_main *mem)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cpu);
+	_NESEMU_UNUSED(mem);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_detach(struct nes_debugger *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_break_add(struct nes_debugger *self,
+				       uint16_t addr)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(addr);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_break_remove(struct nes_debugger *self,
+					  uint16_t addr)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(addr);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_watch_add(struct nes_debugger *self,
+				       uint16_t begin,
+				       uint16_t end,
+				       uint8_t kinds)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(begin);
+	_NESEMU_UNUSED(end);
+	_NESEMU_UNUSED(kinds);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_watch_remove(struct nes_debugger *self,
+					  uint16_t begin,
+					  uint16_t end,
+					  uint8_t kinds)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(begin);
+	_NESEMU_UNUSED(end);
+	_NESEMU_UNUSED(kinds);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+nesemu_return_t nes_debugger_step(struct nes_debugger *self, int *cycles)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cycles);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+void nes_debugger_rearm(struct nes_debugger *self)
+{
+	_NESEMU_UNUSED(self);
+}
+
+nesemu_return_t nes_debugger_trap(struct nes_cpu *self,
+				  struct nes_mem_main *mem,
+				  uint32_t operand,
+				  int *cycles)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+	return NESEMU_RETURN_CPU_DEBUGGER_UNSUPPORTED;
+}
+
+void nes_debugger_watch_hit(struct nes_debugger *self,
+			    uint16_t addr,
+			    uint8_t value,
+			    enum nes_debugger_kind kind)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(addr);
+	_NESEMU_UNUSED(value);
+	_NESEMU_UNUSED(kind);
+}
+
+#endif
@@ -4,6 +4,14 @@
  */
 
 #include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/alu.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/jit.h"
+#include "nesemu/cpu/profile.h"
+#include "nesemu/cpu/trace.h"
+#include "nesemu/cpu/debug.h"
+#include "nesemu/cpu/coverage.h"
 #include "nesemu/cpu/instructions.h"
 #include "nesemu/cpu/status.h"
 
@@ -11,6 +19,8 @@
 #include "nesemu/memory/paging.h"
 #include "nesemu/memory/stack.h"
 
+#include "nesemu/ppu/ppu.h"
+
 #include "nesemu/util/error.h"
 #include "nesemu/util/bits.h"
 #include "nesemu/util/compat.h"
@@ -18,30 +28,51 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
+/* Bus Access */
+
+/**
+ * Memory accesses of the handlers. Trusted builds use the value-returning
+ * accessors: errors land in the sticky 'mem->error' slot (checked once per
+ * 'nes_cpu_next'/'nes_cpu_run' call) and every error check on the result
+ * of these macros is a constant that folds away.
+ */
+#ifdef CONFIG_NESEMU_TRUSTED
+#define _CPU_R8(mem, addr, result) \
+	(*(result) = nes_mem_read8(mem, addr), NESEMU_RETURN_SUCCESS)
+#define _CPU_W8(mem, addr, data) \
+	(nes_mem_write8(mem, addr, data), NESEMU_RETURN_SUCCESS)
+#define _CPU_R16(mem, addr, result) \
+	(*(result) = nes_mem_read16(mem, addr), NESEMU_RETURN_SUCCESS)
+#else
+#define _CPU_R8(mem, addr, result) nes_mem_r8(mem, addr, result)
+#define _CPU_W8(mem, addr, data) nes_mem_w8(mem, addr, data)
+#define _CPU_R16(mem, addr, result) nes_mem_r16(mem, addr, result)
+#endif
+
 /* Private Functions */
 
 /**
  * Read appropiate memory address given the addressing mode
  *
  * @note Function to reduce boilerplate
- * @note Will read from actual PRGROM, so $pc will change
  * @note NESEMU_ADDRESSING_IMMEDIATE not supported! will return error
  *
+ * @param operand Instruction operand already fetched (little-endian)
  * @param addr Reference to where the memory address to be used is stored.
  */
-static nesemu_return_t cpu_read_addr(struct nes_cpu *self,
-				    struct nes_mem_main *mem,
-				    enum nes_cpu_addressing_mode addressing,
-				    uint16_t *addr)
+static inline nesemu_return_t
+cpu_read_addr(struct nes_cpu *self,
+	      struct nes_mem_main *mem,
+	      enum nes_cpu_addressing_mode addressing,
+	      uint16_t operand,
+	      uint16_t *addr)
 {
 	// Error code
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
-	// Placeholders for storing addresses
-	uint8_t lsb = 0, msb = 0;
-
 	// Placeholder for a full address and pointer for indirect mode
 	uint16_t ptr = 0;
 
@@ -52,43 +83,42 @@ static nesemu_return_t cpu_read_addr(struct nes_cpu *self,
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		_NESEMU_FALLTHROUGH;
 	case NESEMU_ADDRESSING_IMMEDIATE:
+		_NESEMU_FALLTHROUGH;
+	case NESEMU_ADDRESSING_IMPLIED:
+		_NESEMU_FALLTHROUGH;
+	case NESEMU_ADDRESSING_RELATIVE:
 		return NESEMU_RETURN_CPU_BAD_ADDRESSING;
 
 	case NESEMU_ADDRESSING_ZERO_PAGE:
 		// Zero Page
-		*addr = NESEMU_ZEROPAGE_GET_ADDR(nes_cpu_fetch(self, mem));
+		*addr = NESEMU_ZEROPAGE_GET_ADDR(operand);
 		break;
 
 	case NESEMU_ADDRESSING_ZERO_PAGE_X:
 		// Zero Page and add X register to addr
-		*addr = NESEMU_ZEROPAGE_GET_ADDR(nes_cpu_fetch(self, mem) +
-						 self->x);
+		*addr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->x);
 		break;
 
 	case NESEMU_ADDRESSING_ZERO_PAGE_Y:
 		// Zero Page and add Y register to addr
-		*addr = NESEMU_ZEROPAGE_GET_ADDR(nes_cpu_fetch(self, mem) +
-						 self->y);
+		*addr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->y);
 		break;
 
 	case NESEMU_ADDRESSING_ABSOLUTE:
 		// Absolute
-		lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-		*addr = NESEMU_UTIL_U16(msb, lsb);
+		*addr = operand;
 		break;
 
 	case NESEMU_ADDRESSING_ABSOLUTE_X:
 		// Absolute, X
 		// Load contents at memory address and add X
-		lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-		*addr = NESEMU_UTIL_U16(msb, lsb) + self->x;
+		*addr = operand + self->x;
 		break;
 
 	case NESEMU_ADDRESSING_ABSOLUTE_Y:
 		// Absolute, Y
 		// Load contents at memory address and add Y
-		lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-		*addr = NESEMU_UTIL_U16(msb, lsb) + self->y;
+		*addr = operand + self->y;
 		break;
 
 		/* Indirect addressing should be handled manually within JMP instruction
@@ -103,21 +133,20 @@ static nesemu_return_t cpu_read_addr(struct nes_cpu *self,
 	case NESEMU_ADDRESSING_INDIRECT_X:
 		// Indirect X (Pre-Indexed)
 		// Load the pointer address (always zero page) and add X
-		ptr = NESEMU_ZEROPAGE_GET_ADDR(nes_cpu_fetch(self, mem) +
-					       self->x);
+		ptr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->x);
 		// Contents in ptr will be used as the actual address
-		err = nes_mem_r16(mem, ptr, addr);
+		err = _CPU_R16(mem, ptr, addr);
 		break;
 
 	case NESEMU_ADDRESSING_INDIRECT_Y:
 		// Indirect Y (Post-Indexed)
 		// Load the pointer address (always zero page)
-		ptr = NESEMU_ZEROPAGE_GET_ADDR(nes_cpu_fetch(self, mem));
+		ptr = NESEMU_ZEROPAGE_GET_ADDR(operand);
 		// Contents in ptr will be used as the actual address
-		err = nes_mem_r16(mem, ptr, addr);
+		err = _CPU_R16(mem, ptr, addr);
 		_NESEMU_RETURN_IF_ERR(err);
 		// Add Y to the actual address
-		addr += self->y;
+		*addr += self->y;
 		break;
 	}
 
@@ -129,18 +158,21 @@ static nesemu_return_t cpu_read_addr(struct nes_cpu *self,
  * Read an u8 value from memory using appropiate addressing mode
  *
  * @note Function to reduce boilerplate
- * @note Will call 'get_addr' so $pc will change
- * @note Will add 1 to 'cycles' in some addressing modes with crosspage
+ * @note Will call 'cpu_read_addr' for addressing modes other than immediate
+ * @note Will add 1 to 'cycles' if the opcode has a page crossing penalty
  *
+ * @param op Opcode table entry (addressing mode and page penalty)
+ * @param operand Instruction operand already fetched (little-endian)
  * @param cycles Reference to the CPU cycles that the operation will take,
  * this value will change depending on the addr mode
  * @param memory Reference to where the value will be stored
  */
-static nesemu_return_t cpu_read_mem(struct nes_cpu *self,
-				   struct nes_mem_main *mem,
-				   enum nes_cpu_addressing_mode addressing,
-				   int *cycles,
-				   uint8_t *memory)
+static inline nesemu_return_t cpu_read_mem(struct nes_cpu *self,
+					   struct nes_mem_main *mem,
+					   const struct nes_cpu_opcode *op,
+					   uint16_t operand,
+					   int *cycles,
+					   uint8_t *memory)
 {
 	// Return status
 	nesemu_return_t err = 0;
@@ -148,29 +180,32 @@ static nesemu_return_t cpu_read_mem(struct nes_cpu *self,
 	// Store address
 	uint16_t addr = 0;
 
-	switch (addressing) {
+	switch (op->addressing) {
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		return NESEMU_RETURN_CPU_BAD_ADDRESSING;
 
 	case NESEMU_ADDRESSING_IMMEDIATE:
-		*memory = nes_cpu_fetch(self, mem);
+		*memory = (uint8_t)operand;
 		break;
 
-	// Additional cycle if page crossed
-	case NESEMU_ADDRESSING_ABSOLUTE_X:
-	case NESEMU_ADDRESSING_ABSOLUTE_Y:
-	case NESEMU_ADDRESSING_INDIRECT_Y:
-		if (nes_mem_is_crosspage(addr)) {
-			*cycles += 1;
-		}
-		_NESEMU_FALLTHROUGH;
 	default:
 		// Get the address
-		err = cpu_read_addr(self, mem, addressing, &addr);
+		err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 		_NESEMU_RETURN_IF_ERR(err);
 
+		// Additional cycle if the indexed address crossed a page
+		if (op->page_penalty) {
+			uint8_t index =
+				(op->addressing == NESEMU_ADDRESSING_ABSOLUTE_X) ?
+					self->x :
+					self->y;
+			if (((addr - index) & 0xFF00) != (addr & 0xFF00)) {
+				*cycles += 1;
+			}
+		}
+
 		// Read value
-		err = nes_mem_r8(mem, addr, memory);
+		err = _CPU_R8(mem, addr, memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
@@ -178,58 +213,65 @@ static nesemu_return_t cpu_read_mem(struct nes_cpu *self,
 	return err;
 }
 
-static nesemu_return_t _LDA(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _LDA(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Get value and store it in A
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &self->a);
+		cpu_read_mem(self, mem, op, operand, cycles, &self->a);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	return err;
 }
 
-static nesemu_return_t _LDX(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _LDX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Get value and store it in X
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &self->x);
+		cpu_read_mem(self, mem, op, operand, cycles, &self->x);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->x));
+	nes_cpu_status_nz(self, self->x);
 
 	return err;
 }
 
-static nesemu_return_t _LDY(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _LDY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Get value and store it in Y
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &self->y);
+		cpu_read_mem(self, mem, op, operand, cycles, &self->y);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->y));
+	nes_cpu_status_nz(self, self->y);
 
 	return err;
 }
 
-static nesemu_return_t _STA(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _STA(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -237,20 +279,24 @@ static nesemu_return_t _STA(struct nes_cpu *self,
 	uint16_t addr = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Write value
-	err = nes_mem_w8(mem, addr, self->a);
+	err = _CPU_W8(mem, addr, self->a);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	return err;
 }
 
-static nesemu_return_t _STX(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _STX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -258,20 +304,24 @@ static nesemu_return_t _STX(struct nes_cpu *self,
 	uint16_t addr = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Write value
-	err = nes_mem_w8(mem, addr, self->x);
+	err = _CPU_W8(mem, addr, self->x);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	return err;
 }
 
-static nesemu_return_t _STY(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _STY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -279,80 +329,163 @@ static nesemu_return_t _STY(struct nes_cpu *self,
 	uint16_t addr = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Write value
-	err = nes_mem_w8(mem, addr, self->y);
+	err = _CPU_W8(mem, addr, self->y);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	return err;
 }
 
-static nesemu_return_t _TXX(struct nes_cpu *self, uint8_t opcode)
+static inline nesemu_return_t _TAX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
-	switch (opcode) {
-	case TAX:
-		self->x = self->a;
-		nes_cpu_status_mask_set(self,
-					NESEMU_CPU_STATUS_MASK_NZ(self->x));
-		break;
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
 
-	case TXA:
-		self->a = self->x;
-		nes_cpu_status_mask_set(self,
-					NESEMU_CPU_STATUS_MASK_NZ(self->a));
-		break;
+	// Transfer A to X
+	self->x = self->a;
 
-	case TAY:
-		self->y = self->a;
-		nes_cpu_status_mask_set(self,
-					NESEMU_CPU_STATUS_MASK_NZ(self->y));
-		break;
+	// Update status flags
+	nes_cpu_status_nz(self, self->x);
 
-	case TYA:
-		self->a = self->y;
-		nes_cpu_status_mask_set(self,
-					NESEMU_CPU_STATUS_MASK_NZ(self->a));
-		break;
+	return NESEMU_RETURN_SUCCESS;
+}
 
-	case TSX:
-		self->x = self->sp;
-		nes_cpu_status_mask_set(self,
-					NESEMU_CPU_STATUS_MASK_NZ(self->x));
-		break;
+static inline nesemu_return_t _TXA(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
 
-	case TXS:
-		self->sp = self->x;
-		break;
+	// Transfer X to A
+	self->a = self->x;
 
-	default:
-		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
-	}
+	// Update status flags
+	nes_cpu_status_nz(self, self->a);
 
 	return NESEMU_RETURN_SUCCESS;
 }
 
-static nesemu_return_t _ADC(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _TAY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	// Transfer A to Y
+	self->y = self->a;
+
+	// Update status flags
+	nes_cpu_status_nz(self, self->y);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _TYA(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	// Transfer Y to A
+	self->a = self->y;
+
+	// Update status flags
+	nes_cpu_status_nz(self, self->a);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _TSX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	// Transfer $sp to X
+	self->x = self->sp;
+
+	// Update status flags
+	nes_cpu_status_nz(self, self->x);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _TXS(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	// Transfer X to $sp (no flags)
+	self->sp = self->x;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _ADC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Where to store the value to be added
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_adc[NESEMU_CPU_ALU_INDEX(
+			self->status & NESEMU_CPU_FLAGS_C, self->a, memory)];
+	nes_cpu_alu_status(self, alu->flags,
+			   NESEMU_CPU_FLAGS_C | NESEMU_CPU_FLAGS_V);
+	self->a = alu->result;
+#else
 	// Get result of operation
 	uint16_t result =
 		// a + m + c
 		self->a + memory + (self->status & NESEMU_CPU_FLAGS_C);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	// Clear/Set carry (C)
 	(result > UINT8_MAX) ?
@@ -371,30 +504,41 @@ static nesemu_return_t _ADC(struct nes_cpu *self,
 
 	// Store result
 	self->a = (uint8_t)(result & 0x00FF);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _SBC(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _SBC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Where to store the value to be added
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_sbc[NESEMU_CPU_ALU_INDEX(
+			self->status & NESEMU_CPU_FLAGS_C, self->a, memory)];
+	nes_cpu_alu_status(self, alu->flags,
+			   NESEMU_CPU_FLAGS_C | NESEMU_CPU_FLAGS_V);
+	self->a = alu->result;
+#else
 	// Get result of operation (signed)
 	int16_t result =
 		// a - m - ~c
 		self->a - memory - ~(self->status & NESEMU_CPU_FLAGS_C);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	// Clear/Set carry (C)
 	(result < 0) ?
@@ -413,14 +557,19 @@ static nesemu_return_t _SBC(struct nes_cpu *self,
 
 	// Store result
 	self->a = (uint8_t)((uint16_t)result & 0x00FF);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _INC(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _INC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -431,30 +580,34 @@ static nesemu_return_t _INC(struct nes_cpu *self,
 	uint8_t memory = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Read value
-	err = nes_mem_r8(mem, addr, &memory);
+	err = _CPU_R8(mem, addr, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update value
 	memory += 1;
 
 	// Store value
-	err = nes_mem_w8(mem, addr, memory);
+	err = _CPU_W8(mem, addr, memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_status_nz(self, memory);
 
 	return err;
 }
 
-static nesemu_return_t _DEC(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _DEC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -465,66 +618,114 @@ static nesemu_return_t _DEC(struct nes_cpu *self,
 	uint8_t memory = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Read value
-	err = nes_mem_r8(mem, addr, &memory);
+	err = _CPU_R8(mem, addr, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update value
 	memory -= 1;
 
 	// Store value
-	err = nes_mem_w8(mem, addr, memory);
+	err = _CPU_W8(mem, addr, memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_status_nz(self, memory);
 
 	return err;
 }
 
-static inline void _INX(struct nes_cpu *self)
+static inline nesemu_return_t _INX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Increment the register
 	self->x += 1;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->x));
+	nes_cpu_status_nz(self, self->x);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _DEX(struct nes_cpu *self)
+static inline nesemu_return_t _DEX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Decrement the register
 	self->x -= 1;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->x));
+	nes_cpu_status_nz(self, self->x);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _INY(struct nes_cpu *self)
+static inline nesemu_return_t _INY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Increment the register
 	self->y += 1;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->y));
+	nes_cpu_status_nz(self, self->y);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _DEY(struct nes_cpu *self)
+static inline nesemu_return_t _DEY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Decrement the register
 	self->y -= 1;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->y));
+	nes_cpu_status_nz(self, self->y);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static nesemu_return_t _ASL(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _ASL(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -534,7 +735,7 @@ static nesemu_return_t _ASL(struct nes_cpu *self,
 	// Placeholder for memory
 	uint8_t memory = 0;
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		memory = self->a;
@@ -542,21 +743,28 @@ static nesemu_return_t _ASL(struct nes_cpu *self,
 
 	default:
 		// Get the address
-		err = cpu_read_addr(self, mem, addressing, &addr);
+		err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 		_NESEMU_RETURN_IF_ERR(err);
 		// Read value
-		err = nes_mem_r8(mem, addr, &memory);
+		err = _CPU_R8(mem, addr, &memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_shift[NESEMU_CPU_ALU_ASL][memory];
+	memory = alu->result;
+#else
 	// Update value
 	uint16_t result = (uint16_t)memory << 1;
 
 	// Store u8 result without first bit
 	memory = (uint8_t)result & 0xFE;
+#endif
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		self->a = memory;
@@ -564,25 +772,34 @@ static nesemu_return_t _ASL(struct nes_cpu *self,
 
 	default:
 		// Store value
-		err = nes_mem_w8(mem, addr, memory);
+		err = _CPU_W8(mem, addr, memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_alu_status(self, alu->flags, NESEMU_CPU_FLAGS_C);
+#else
+	// Update status flags
+	nes_cpu_status_nz(self, memory);
 
 	// Update carry, check if the result had an overflow
 	(result & 0x0100) ? nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 			    nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _LSR(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _LSR(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -592,7 +809,7 @@ static nesemu_return_t _LSR(struct nes_cpu *self,
 	// Placeholder for memory
 	uint8_t memory = 0;
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		memory = self->a;
@@ -600,21 +817,28 @@ static nesemu_return_t _LSR(struct nes_cpu *self,
 
 	default:
 		// Get the address
-		err = cpu_read_addr(self, mem, addressing, &addr);
+		err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 		_NESEMU_RETURN_IF_ERR(err);
 		// Read value
-		err = nes_mem_r8(mem, addr, &memory);
+		err = _CPU_R8(mem, addr, &memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_shift[NESEMU_CPU_ALU_LSR][memory];
+	memory = alu->result;
+#else
 	// Shift value (using MSB of u16)
 	uint16_t result = ((uint16_t)memory << 8) >> 1;
 
 	// Store u8 part of the result's MSB without 7th bit
 	memory = (uint8_t)(result >> 8) & 0x7F;
+#endif
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		self->a = memory;
@@ -622,25 +846,34 @@ static nesemu_return_t _LSR(struct nes_cpu *self,
 
 	default:
 		// Store value
-		err = nes_mem_w8(mem, addr, memory);
+		err = _CPU_W8(mem, addr, memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_alu_status(self, alu->flags, NESEMU_CPU_FLAGS_C);
+#else
+	// Update status flags
+	nes_cpu_status_nz(self, memory);
 
 	// Update carry, check if the result had an overflow
 	(result & 0x0080) ? nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 			    nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _ROL(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _ROL(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -650,7 +883,7 @@ static nesemu_return_t _ROL(struct nes_cpu *self,
 	// Placeholder for memory
 	uint8_t memory = 0;
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		memory = self->a;
@@ -658,18 +891,25 @@ static nesemu_return_t _ROL(struct nes_cpu *self,
 
 	default:
 		// Get the address
-		err = cpu_read_addr(self, mem, addressing, &addr);
+		err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 		_NESEMU_RETURN_IF_ERR(err);
 		// Read value
-		err = nes_mem_r8(mem, addr, &memory);
+		err = _CPU_R8(mem, addr, &memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_shift[NESEMU_CPU_ALU_ROL][memory];
+	memory = alu->result;
+#else
 	// C <- [76543210] <- C
 	memory = (memory << 1) | ((memory | 0x80) >> 7);
+#endif
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		self->a = memory;
@@ -677,25 +917,34 @@ static nesemu_return_t _ROL(struct nes_cpu *self,
 
 	default:
 		// Store value
-		err = nes_mem_w8(mem, addr, memory);
+		err = _CPU_W8(mem, addr, memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_alu_status(self, alu->flags, NESEMU_CPU_FLAGS_C);
+#else
+	// Update status flags
+	nes_cpu_status_nz(self, memory);
 
 	// Update carry, copy value of first bit
 	(memory & 0x01) ? nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 			  nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _ROR(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _ROR(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -705,7 +954,7 @@ static nesemu_return_t _ROR(struct nes_cpu *self,
 	// Placeholder for memory
 	uint8_t memory = 0;
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		memory = self->a;
@@ -713,18 +962,25 @@ static nesemu_return_t _ROR(struct nes_cpu *self,
 
 	default:
 		// Get the address
-		err = cpu_read_addr(self, mem, addressing, &addr);
+		err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 		_NESEMU_RETURN_IF_ERR(err);
 		// Read value
-		err = nes_mem_r8(mem, addr, &memory);
+		err = _CPU_R8(mem, addr, &memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed result and flags
+	const struct nes_cpu_alu_entry *alu =
+		&nes_cpu_alu_shift[NESEMU_CPU_ALU_ROR][memory];
+	memory = alu->result;
+#else
 	// C -> [76543210] -> C
 	memory = (memory >> 1) | ((memory | 0x01) << 7);
+#endif
 
-	switch (addressing) {
+	switch (op->addressing) {
 		// Use the accumulator instead
 	case NESEMU_ADDRESSING_ACCUMULATOR:
 		self->a = memory;
@@ -732,91 +988,103 @@ static nesemu_return_t _ROR(struct nes_cpu *self,
 
 	default:
 		// Store value
-		err = nes_mem_w8(mem, addr, memory);
+		err = _CPU_W8(mem, addr, memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 	}
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(memory));
+	nes_cpu_alu_status(self, alu->flags, NESEMU_CPU_FLAGS_C);
+#else
+	// Update status flags
+	nes_cpu_status_nz(self, memory);
 
 	// Update carry, copy value of first bit
 	(memory & 0x80) ? nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 			  nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _AND(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _AND(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Operation
 	self->a &= memory;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	return err;
 }
 
-static nesemu_return_t _ORA(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _ORA(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Operation
 	self->a |= memory;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	return err;
 }
 
-static nesemu_return_t _EOR(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _EOR(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Operation
 	self->a ^= memory;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 
 	return err;
 }
 
-static nesemu_return_t _BIT(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _BIT(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Decode the value
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -827,189 +1095,314 @@ static nesemu_return_t _BIT(struct nes_cpu *self,
 	uint8_t memory = 0;
 
 	// Get the address
-	err = cpu_read_addr(self, mem, addressing, &addr);
+	err = cpu_read_addr(self, mem, op->addressing, operand, &addr);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Read value
-	err = nes_mem_r8(mem, addr, &memory);
+	err = _CPU_R8(mem, addr, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Operation
 	uint8_t result = self->a & memory;
 
 	// Update status flags
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_Z(result));
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_N(memory));
+	nes_cpu_status_z(self, result);
+	nes_cpu_status_n(self, memory);
 	nes_cpu_status_mask_set(self, memory & NESEMU_CPU_FLAGS_V);
 
 	return err;
 }
 
-static nesemu_return_t _CMP(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _CMP(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed flags
+	nes_cpu_status_mask_set(
+		self, nes_cpu_alu_cmp[NESEMU_CPU_ALU_INDEX(0, self->a, memory)]);
+#else
 	// Operation
 	uint8_t result = self->a - memory;
 
 	// Update status
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(result));
+	nes_cpu_status_nz(self, result);
 
 	// Carry
 	(self->a >= memory) ?
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _CPX(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _CPX(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed flags
+	nes_cpu_status_mask_set(
+		self, nes_cpu_alu_cmp[NESEMU_CPU_ALU_INDEX(0, self->x, memory)]);
+#else
 	// Operation
 	uint8_t result = self->x - memory;
 
 	// Update status
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(result));
+	nes_cpu_status_nz(self, result);
 
 	// Carry
 	(self->x >= memory) ?
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
-static nesemu_return_t _CPY(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing,
-			   int *cycles)
+static inline nesemu_return_t _CPY(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
 	// Place holder
 	uint8_t memory = 0;
 
 	// Read memory given addressing mode
 	nesemu_return_t err =
-		cpu_read_mem(self, mem, addressing, cycles, &memory);
+		cpu_read_mem(self, mem, op, operand, cycles, &memory);
 	_NESEMU_RETURN_IF_ERR(err);
 
+#ifdef CONFIG_NESEMU_CPU_ALU_TABLES
+	// Precomputed flags
+	nes_cpu_status_mask_set(
+		self, nes_cpu_alu_cmp[NESEMU_CPU_ALU_INDEX(0, self->y, memory)]);
+#else
 	// Operation
 	uint8_t result = self->y - memory;
 
 	// Update status
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(result));
+	nes_cpu_status_nz(self, result);
 
 	// Carry
 	(self->y >= memory) ?
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C) :
 		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C);
+#endif
 
 	return err;
 }
 
 static inline nesemu_return_t _PHA(struct nes_cpu *self,
-				  struct nes_mem_main *mem)
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	return nes_stack_push_u8(mem, &self->sp, self->a);
 }
 
 static inline nesemu_return_t _PLA(struct nes_cpu *self,
-				  struct nes_mem_main *mem)
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	nesemu_return_t err = nes_stack_pop_u8(mem, &self->sp, &self->a);
 	_NESEMU_RETURN_IF_ERR(err);
 
-	nes_cpu_status_mask_set(self, NESEMU_CPU_STATUS_MASK_NZ(self->a));
+	nes_cpu_status_nz(self, self->a);
 	return err;
 }
 
 static inline nesemu_return_t _PHP(struct nes_cpu *self,
-				  struct nes_mem_main *mem)
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	nes_cpu_status_sync(self);
 	uint8_t status =
 		NESEMU_CPU_STATUS_SET_MASK(self->status, NESEMU_CPU_FLAGS_B);
 	return nes_stack_push_u8(mem, &self->sp, status);
 }
 
 static inline nesemu_return_t _PLP(struct nes_cpu *self,
-				  struct nes_mem_main *mem)
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Read status
 	uint8_t status = 0;
 	nesemu_return_t err = nes_stack_pop_u8(mem, &self->sp, &status);
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Store status (ignore B flag)
+	nes_cpu_status_sync(self);
 	self->status = (status & ~NESEMU_CPU_FLAGS_B) |
 		       (self->status & NESEMU_CPU_FLAGS_B);
 
 	return err;
 }
 
-static nesemu_return_t _CXX_SXX(struct nes_cpu *self, uint8_t opcode)
+static inline nesemu_return_t _CLC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
-	switch (opcode) {
-	case CLC:
-		nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
-		break;
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
 
-	case SEC:
-		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C);
-		break;
+	nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_C);
 
-	case CLI:
-		nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_I);
-		break;
+	return NESEMU_RETURN_SUCCESS;
+}
 
-	case SEI:
-		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_I);
-		break;
+static inline nesemu_return_t _SEC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
 
-	case CLD:
-		nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_D);
-		break;
+	nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_C);
 
-	case SED:
-		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_D);
-		break;
+	return NESEMU_RETURN_SUCCESS;
+}
 
-	case CLV:
-		nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_V);
-		break;
+static inline nesemu_return_t _CLI(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
 
-	default:
-		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
-	}
+	nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_I);
 
 	return NESEMU_RETURN_SUCCESS;
 }
 
-static void _BXX(struct nes_cpu *self,
-		 struct nes_mem_main *mem,
-		 int *cycles,
-		 bool condition)
+static inline nesemu_return_t _SEI(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_I);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _CLD(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	nes_cpu_status_mask_unset(self, NESEMU_CPU_FLAGS_D);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _SED(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_D);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _CLV(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_V);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline void _BXX(struct nes_cpu *self,
+			uint16_t operand,
+			int *cycles,
+			bool condition)
 {
 	// Amount to jump
-	int8_t jrelative = (int8_t)nes_cpu_fetch(self, mem);
+	int8_t jrelative = (int8_t)operand;
 
 	// Check condition
 	if (!condition) {
@@ -1032,92 +1425,151 @@ static void _BXX(struct nes_cpu *self,
 	self->pc = pc;
 }
 
-static inline void _BCC(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BCC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Carry Clear
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_C) == 0);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_C) == 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BCS(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BCS(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Carry Set
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_C) != 0);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_C) != 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BEQ(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BEQ(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Zero Set
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_Z) != 0);
+	nes_cpu_status_sync(self);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_Z) != 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BNE(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BNE(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Zero Set
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_Z) == 0);
+	nes_cpu_status_sync(self);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_Z) == 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BPL(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BPL(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Negative is clear
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_N) == 0);
+	nes_cpu_status_sync(self);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_N) == 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BMI(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BMI(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Negative is set
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_N) != 0);
+	nes_cpu_status_sync(self);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_N) != 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BVC(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BVC(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Overflow is clear
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_V) == 0);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_V) == 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static inline void _BVS(struct nes_cpu *self,
-			struct nes_mem_main *mem,
-			int *cycles)
+static inline nesemu_return_t _BVS(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+
 	// Overflow is set
-	_BXX(self, mem, cycles, (self->status & NESEMU_CPU_FLAGS_V) != 0);
+	_BXX(self, operand, cycles, (self->status & NESEMU_CPU_FLAGS_V) != 0);
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-static nesemu_return_t _JMP(struct nes_cpu *self,
-			   struct nes_mem_main *mem,
-			   enum nes_cpu_addressing_mode addressing)
+static inline nesemu_return_t _JMP(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(cycles);
+
 	// Placeholders
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
-	uint16_t memory = 0, addr = 0, ptr = 0;
+	uint16_t memory = 0, addr = 0;
 	uint8_t lsb = 0, msb = 0;
 
 	// Get memory value
-	switch (addressing) {
+	switch (op->addressing) {
 	case NESEMU_ADDRESSING_ABSOLUTE:
-		// Build the value
-		lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-		memory = NESEMU_UTIL_U16(msb, lsb);
+		// Operand is the value
+		memory = operand;
 		break;
 
 	case NESEMU_ADDRESSING_INDIRECT:
-		// Build pointer
-		lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-		ptr = NESEMU_UTIL_U16(msb, lsb);
-
 		/* BUG Simulation!
          * Reference: https://www.nesdev.org/wiki/Instruction_reference#JMP
          *  
@@ -1129,21 +1581,21 @@ static nesemu_return_t _JMP(struct nes_cpu *self,
          * reads the wrong address.
          * For example, JMP ($03FF) reads $03FF and $0300 instead of $0400.
          */
-		if ((ptr & 0x00FF) == 0x00FF) {
-			// Read LSB from (ptr)
-			err = nes_mem_r8(mem, ptr, &lsb);
+		if ((operand & 0x00FF) == 0x00FF) {
+			// Read LSB from (operand)
+			err = _CPU_R8(mem, operand, &lsb);
 			// Read MSB from beginning of the page
-			err = nes_mem_r8(mem, (ptr & 0xFF00), &msb);
+			err = _CPU_R8(mem, (operand & 0xFF00), &msb);
 			// Build the value
 			addr = NESEMU_UTIL_U16(msb, lsb);
 		} else {
 			// Get addr at pointer
-			err = nes_mem_r16(mem, ptr, &addr);
+			err = _CPU_R16(mem, operand, &addr);
 		}
 		_NESEMU_RETURN_IF_ERR(err);
 
 		// Read value at addr
-		nes_mem_r16(mem, addr, &memory);
+		(void)_CPU_R16(mem, addr, &memory);
 		_NESEMU_RETURN_IF_ERR(err);
 		break;
 
@@ -1157,17 +1609,20 @@ static nesemu_return_t _JMP(struct nes_cpu *self,
 	return err;
 }
 
-static nesemu_return_t _JSR(struct nes_cpu *self,
-			   struct nes_mem_main *mem)
+static inline nesemu_return_t _JSR(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(cycles);
+
 	// Placeholders
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
-	uint16_t jaddr = 0;
-	uint8_t lsb = 0, msb = 0;
 
-	// Build absolute address
-	lsb = nes_cpu_fetch(self, mem), msb = nes_cpu_fetch(self, mem);
-	jaddr = NESEMU_UTIL_U16(msb, lsb);
+	// Absolute address
+	uint16_t jaddr = operand;
 
 	// Push $pc to stack
     // Beware! JSR pushed ($pc - 1) to stack, not $pc
@@ -1179,9 +1634,16 @@ static nesemu_return_t _JSR(struct nes_cpu *self,
 	return err;
 }
 
-static nesemu_return_t _RTS(struct nes_cpu *self,
-			   struct nes_mem_main *mem)
+static inline nesemu_return_t _RTS(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Pull from stack
 	nesemu_return_t err = nes_stack_pop_u16(mem, &self->sp, &self->pc);
 
@@ -1191,11 +1653,17 @@ static nesemu_return_t _RTS(struct nes_cpu *self,
 	return err;
 }
 
-static nesemu_return_t _BRK(struct nes_cpu *self,
-			   struct nes_mem_main *mem)
+static inline nesemu_return_t _BRK(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(cycles);
+
 	// Store break reason
-	self->brk = nes_cpu_fetch(self, mem);
+	self->brk = (uint8_t)operand;
 
 	// Push program counter
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
@@ -1203,6 +1671,7 @@ static nesemu_return_t _BRK(struct nes_cpu *self,
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Push flags NV11DIZC
+	nes_cpu_status_sync(self);
 	err = nes_stack_push_u16(
 		mem, &self->sp,
 		NESEMU_CPU_STATUS_SET_MASK(self->status, NESEMU_CPU_FLAGS_B));
@@ -1221,9 +1690,16 @@ static nesemu_return_t _BRK(struct nes_cpu *self,
 	return err;
 }
 
-static nesemu_return_t _RTI(struct nes_cpu *self,
-			   struct nes_mem_main *mem)
+static inline nesemu_return_t _RTI(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Placeholders
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
@@ -1233,6 +1709,7 @@ static nesemu_return_t _RTI(struct nes_cpu *self,
 	_NESEMU_RETURN_IF_ERR(err);
 
 	// Store status (ignore B flag)
+	nes_cpu_status_sync(self);
 	self->status = (status & ~NESEMU_CPU_FLAGS_B) |
 		       (self->status & NESEMU_CPU_FLAGS_B);
 
@@ -1241,568 +1718,1340 @@ static nesemu_return_t _RTI(struct nes_cpu *self,
 	return err;
 }
 
-static inline void _STP(struct nes_cpu *self)
+static inline nesemu_return_t _NOP(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static inline nesemu_return_t _STP(struct nes_cpu *self,
+				   struct nes_mem_main *mem,
+				   const struct nes_cpu_opcode *op,
+				   uint16_t operand,
+				   int *cycles)
 {
+	_NESEMU_UNUSED(mem);
+	_NESEMU_UNUSED(op);
+	_NESEMU_UNUSED(operand);
+	_NESEMU_UNUSED(cycles);
+
 	// Set stop flag
 	self->stop = true;
+
+	return NESEMU_RETURN_SUCCESS;
 }
 
-/* Public Functions */
+/* Specialized Handlers */
 
-nesemu_return_t nes_cpu_next(struct nes_cpu *self,
-			    struct nes_mem_main *mem,
-			    int *c)
+/**
+ * Helper macro for generating the handler of a single opcode from
+ * `NESEMU_CPU_OPCODE_LIST`. Addressing mode and page penalty are constants so
+ * the instruction (and its effective address computation) gets inlined
+ * without any of the addressing mode switches.
+ */
+#define _CPU_OPCODE_HANDLER(opc, mnemonic, mode, cyc, len, penalty)  \
+	static nesemu_return_t _op_##opc(struct nes_cpu *self,       \
+					 struct nes_mem_main *mem,   \
+					 uint32_t operand,           \
+					 int *cycles)                \
+	{                                                            \
+		static const struct nes_cpu_opcode op = {            \
+			.addressing = NESEMU_ADDRESSING_##mode,      \
+			.page_penalty = penalty,                     \
+		};                                                   \
+		return _##mnemonic(self, mem, &op, operand, cycles); \
+	}
+
+NESEMU_CPU_OPCODE_LIST(_CPU_OPCODE_HANDLER)
+
+/* Opcode Table */
+
+/**
+ * Helper macro for building an opcode table entry from `NESEMU_CPU_OPCODE_LIST`
+ */
+#define _CPU_OPCODE_TABLE_ENTRY(opc, mnemonic, mode, cyc, len, penalty) \
+	[opc] = {                                                       \
+		.handler = _op_##opc,                                   \
+		.addressing = NESEMU_ADDRESSING_##mode,                 \
+		.cycles = cyc,                                          \
+		.length = len,                                          \
+		.page_penalty = penalty,                                \
+	},
+
+const struct nes_cpu_opcode nes_cpu_opcodes[256] = {
+	NESEMU_CPU_OPCODE_LIST(_CPU_OPCODE_TABLE_ENTRY)
+};
+
+/**
+ * Helper macro for building a mnemonic table entry
+ */
+#define _CPU_MNEMONIC_TABLE_ENTRY(opc, mnemonic, mode, cyc, len, penalty) \
+	[opc] = #mnemonic,
+
+const char *const nes_cpu_mnemonics[256] = {
+	NESEMU_CPU_OPCODE_LIST(_CPU_MNEMONIC_TABLE_ENTRY)
+};
+
+/* Superinstructions */
+
+/**
+ * Report the fused instruction that failed
+ */
+static inline void cpu_fused_fail(struct nes_cpu *self, uint8_t opcode)
 {
-	/* Check input arguments */
 #ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
-	if (self == NULL || c == NULL) {
-		return NESEMU_RETURN_BAD_ARGUMENTS;
-	}
+	self->brk = opcode;
+#else
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(opcode);
 #endif
-	// Error code
-	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+}
 
-	// Get instruction opcode
-	uint8_t opc = nes_cpu_fetch(self, mem);
+/**
+ * Helper macros for generating the handler of a superinstruction from
+ * `NESEMU_CPU_FUSED_*_LIST`, every fused instruction is inlined in order.
+ *
+ * @note $pc is already past the last fused instruction, only the last one
+ * (a block terminator) may read it
+ * @note On error $brk holds the fused instruction that failed, cycles and
+ * $pc are reported for the whole superinstruction
+ */
+#define _CPU_FUSED_STEP(opc)                                             \
+	err = _op_##opc(self, mem, nes_cpu_fused_operand(&operand, opc), \
+			cycles);                                         \
+	if (err != NESEMU_RETURN_SUCCESS) {                              \
+		cpu_fused_fail(self, opc);                               \
+		return err;                                              \
+	}
 
-#ifdef CONFIG_NESEMU_DEBUG
-    self->last_inst = opc;
-    self->last_pc = self->pc - 1;
-#endif
+#define _CPU_FUSED_TRIPLE_HANDLER(name, first, second, third)          \
+	static nesemu_return_t _fused_##name(struct nes_cpu *self,     \
+					     struct nes_mem_main *mem, \
+					     uint32_t operand,         \
+					     int *cycles)              \
+	{                                                              \
+		nesemu_return_t err = NESEMU_RETURN_SUCCESS;           \
+		_CPU_FUSED_STEP(first)                                 \
+		_CPU_FUSED_STEP(second)                                \
+		_CPU_FUSED_STEP(third)                                 \
+		return err;                                            \
+	}
 
-	// Set cycles using the instruction
-	*c = nes_cpu_op_cycles[opc];
+#define _CPU_FUSED_PAIR_HANDLER(name, first, second)                   \
+	static nesemu_return_t _fused_##name(struct nes_cpu *self,     \
+					     struct nes_mem_main *mem, \
+					     uint32_t operand,         \
+					     int *cycles)              \
+	{                                                              \
+		nesemu_return_t err = NESEMU_RETURN_SUCCESS;           \
+		_CPU_FUSED_STEP(first)                                 \
+		_CPU_FUSED_STEP(second)                                \
+		return err;                                            \
+	}
 
-	// Decode the instruction
-	switch (opc) {
-	// LDA
-	case LDA_IM:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case LDA_ZP:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case LDA_ZX:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case LDA_AB:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case LDA_AX:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case LDA_AY:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case LDA_IX:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case LDA_IY:
-		err = _LDA(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+NESEMU_CPU_FUSED_TRIPLE_LIST(_CPU_FUSED_TRIPLE_HANDLER)
+NESEMU_CPU_FUSED_PAIR_LIST(_CPU_FUSED_PAIR_HANDLER)
 
-	// LDX
-	case LDX_IM:
-		err = _LDX(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case LDX_ZP:
-		err = _LDX(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case LDX_ZY:
-		err = _LDX(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_Y, c);
-		break;
-	case LDX_AB:
-		err = _LDX(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case LDX_AY:
-		err = _LDX(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
+/**
+ * Helper macros for building a superinstruction table entry
+ */
+#define _CPU_FUSED_TRIPLE_ENTRY(name, first, second, third) \
+	[NESEMU_CPU_FUSED_##name] = {                       \
+		.handler = _fused_##name,                   \
+		.length = 3,                                \
+		.opcodes = { first, second, third },        \
+	},
+
+#define _CPU_FUSED_PAIR_ENTRY(name, first, second) \
+	[NESEMU_CPU_FUSED_##name] = {              \
+		.handler = _fused_##name,          \
+		.length = 2,                       \
+		.opcodes = { first, second },      \
+	},
+
+const struct nes_cpu_fused nes_cpu_fused[NESEMU_CPU_FUSED_COUNT] = {
+	NESEMU_CPU_FUSED_TRIPLE_LIST(_CPU_FUSED_TRIPLE_ENTRY)
+	NESEMU_CPU_FUSED_PAIR_LIST(_CPU_FUSED_PAIR_ENTRY)
+};
+
+#ifdef CONFIG_NESEMU_CPU_SWITCH_DISPATCH
+/**
+ * Helper macro for building the `switch` fallback from `NESEMU_CPU_OPCODE_LIST`
+ */
+#define _CPU_OPCODE_SWITCH_CASE(opc, mnemonic, mode, cyc, len, penalty) \
+	case opc:                                                       \
+		err = _op_##opc(self, mem, inst.operand, c);            \
 		break;
+#endif
 
-	// LDY
-	case LDY_IM:
-		err = _LDY(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case LDY_ZP:
-		err = _LDY(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case LDY_ZX:
-		err = _LDY(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case LDY_AB:
-		err = _LDY(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case LDY_AX:
-		err = _LDY(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
+/**
+ * Fetch and decode the instruction at $pc through the opcode table
+ *
+ * @note $pc is moved past the instruction (opcode and operand)
+ *
+ * @param inst Reference to where the decoded instruction will be stored
+ */
+static inline nesemu_return_t cpu_fetch_decode(struct nes_cpu *self,
+					       struct nes_mem_main *mem,
+					       struct nes_cpu_cache_entry *inst)
+{
+	// Get instruction opcode
+	inst->opcode = nes_cpu_fetch(self, mem);
 
-	// STA
-	case STA_ZP:
-		err = _STA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case STA_ZX:
-		err = _STA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
-	case STA_AB:
-		err = _STA(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
-	case STA_AX:
-		err = _STA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
-		break;
-	case STA_AY:
-		err = _STA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y);
-		break;
-	case STA_IX:
-		err = _STA(self, mem, NESEMU_ADDRESSING_INDIRECT_X);
-		break;
-	case STA_IY:
-		err = _STA(self, mem, NESEMU_ADDRESSING_INDIRECT_Y);
-		break;
+	// Get the opcode table entry
+	const struct nes_cpu_opcode *op = &nes_cpu_opcodes[inst->opcode];
 
-		// STX
-	case STX_ZP:
-		err = _STX(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case STX_ZY:
-		err = _STX(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_Y);
-		break;
-	case STX_AB:
-		err = _STX(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
+	/* Instruction not found */
+	if (op->handler == NULL) {
+		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
+	}
 
-	// STY
-	case STY_ZP:
-		err = _STY(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case STY_ZX:
-		err = _STY(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
-	case STY_AB:
-		err = _STY(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
+	inst->handler = op->handler;
+	inst->length = op->length;
+	inst->cycles = op->cycles;
+	inst->fused = NESEMU_CPU_FUSED_NONE;
 
-		// TAX
-	case TAX:
-		_NESEMU_FALLTHROUGH;
-	case TXA:
-		_NESEMU_FALLTHROUGH;
-	case TAY:
-		_NESEMU_FALLTHROUGH;
-	case TYA:
-		_NESEMU_FALLTHROUGH;
-	// $sp transfers
-	case TSX:
-		_NESEMU_FALLTHROUGH;
-	case TXS:
-		err = _TXX(self, opc);
-		break;
+	// Assemble the operand
+	uint8_t lsb = 0, msb = 0;
+	if (op->length > 1) {
+		lsb = nes_cpu_fetch(self, mem);
+	}
+	if (op->length > 2) {
+		msb = nes_cpu_fetch(self, mem);
+	}
+	inst->operand = NESEMU_UTIL_U16(msb, lsb);
 
-		// AND
-	case AND_IM:
-		err = _AND(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case AND_ZP:
-		err = _AND(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case AND_ZX:
-		err = _AND(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case AND_AB:
-		err = _AND(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case AND_AX:
-		err = _AND(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case AND_AY:
-		err = _AND(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case AND_IX:
-		err = _AND(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case AND_IY:
-		err = _AND(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+	return NESEMU_RETURN_SUCCESS;
+}
 
-		// EOR
-	case EOR_IM:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case EOR_ZP:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case EOR_ZX:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case EOR_AB:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case EOR_AX:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case EOR_AY:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case EOR_IX:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case EOR_IY:
-		err = _EOR(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+/**
+ * Decode the instruction at $pc, using the decode cache for PRG ROM
+ * addresses when one is attached
+ *
+ * @note $pc is moved past the instruction (opcode and operand)
+ *
+ * @param inst Reference to where the decoded instruction will be stored
+ */
+static inline nesemu_return_t cpu_decode(struct nes_cpu *self,
+					 struct nes_mem_main *mem,
+					 struct nes_cpu_cache_entry *inst)
+{
+	struct nes_cpu_cache *cache = self->cache;
 
-		// ORA
-	case ORA_IM:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case ORA_ZP:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case ORA_ZX:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case ORA_AB:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case ORA_AX:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case ORA_AY:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case ORA_IX:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case ORA_IY:
-		err = _ORA(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+	// RAM (or no cache), use the normal fetch path
+	if (cache == NULL || self->pc < NESEMU_CPU_CACHE_BEGIN) {
+		return cpu_fetch_decode(self, mem, inst);
+	}
 
-		// BIT
-	case BIT_ZP:
-		err = _BIT(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case BIT_AB:
-		err = _BIT(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
+	// A bank switch remapped the PRG ROM window
+	if (cache->prg_version != mem->cartridge->prg_version) {
+		nes_cpu_cache_invalidate(cache);
+		cache->prg_version = mem->cartridge->prg_version;
+#ifdef CONFIG_NESEMU_DEBUGGER
+		if (self->debugger != NULL) {
+			nes_debugger_rearm(self->debugger);
+		}
+#endif
+	}
 
-		// ADC
-	case ADC_IM:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case ADC_ZP:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case ADC_ZX:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case ADC_AB:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case ADC_AX:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case ADC_AY:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case ADC_IX:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case ADC_IY:
-		err = _ADC(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+	struct nes_cpu_cache_entry *entry =
+		&cache->entries[self->pc - NESEMU_CPU_CACHE_BEGIN];
 
-		// SBC
-	case SBC_IM:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case SBC_ZP:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case SBC_ZX:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case SBC_AB:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case SBC_AX:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case SBC_AY:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case SBC_IX:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case SBC_IY:
-		err = _SBC(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+	// Cache hit
+	if (entry->handler != NULL) {
+		*inst = *entry;
+		self->pc += inst->length;
+		return NESEMU_RETURN_SUCCESS;
+	}
 
-		// CMP
-	case CMP_IM:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case CMP_ZP:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case CMP_ZX:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X, c);
-		break;
-	case CMP_AB:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
-	case CMP_AX:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X, c);
-		break;
-	case CMP_AY:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_ABSOLUTE_Y, c);
-		break;
-	case CMP_IX:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_INDIRECT_X, c);
-		break;
-	case CMP_IY:
-		err = _CMP(self, mem, NESEMU_ADDRESSING_INDIRECT_Y, c);
-		break;
+	// Cache miss, decode and store it
+	uint16_t pc = self->pc;
+	nesemu_return_t err = cpu_fetch_decode(self, mem, inst);
+	_NESEMU_RETURN_IF_ERR(err);
 
-		// CPX
-	case CPX_IM:
-		err = _CPX(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case CPX_ZP:
-		err = _CPX(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case CPX_AB:
-		err = _CPX(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
+	// Instructions wrapping around $FFFF read operands from RAM
+	if (pc <= (uint16_t)(0xFFFF - (inst->length - 1))) {
+		*entry = *inst;
+	}
 
-		// CPY
-	case CPY_IM:
-		err = _CPY(self, mem, NESEMU_ADDRESSING_IMMEDIATE, c);
-		break;
-	case CPY_ZP:
-		err = _CPY(self, mem, NESEMU_ADDRESSING_ZERO_PAGE, c);
-		break;
-	case CPY_AB:
-		err = _CPY(self, mem, NESEMU_ADDRESSING_ABSOLUTE, c);
-		break;
+	return err;
+}
 
-		// INC
-	case INC_ZP:
-		_INC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case INC_ZX:
-		_INC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
-	case INC_AB:
-		_INC(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
-	case INC_AX:
-		_INC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
-		break;
+#ifdef CONFIG_NESEMU_CPU_TRACE
+/**
+ * Read memory mapped at an address, without the side effects of the bus
+ * (see 'nes_mem_peek8')
+ */
+static inline uint8_t cpu_trace_peek(const struct nes_mem_main *mem,
+				     uint16_t addr)
+{
+	return nes_mem_peek8(mem, addr);
+}
 
-		// INX
-	case INX:
-		_INX(self);
-		break;
+/**
+ * Same as 'cpu_trace_peek' for a little-endian pointer
+ */
+static inline uint16_t cpu_trace_peek16(const struct nes_mem_main *mem,
+					uint16_t lsb,
+					uint16_t msb)
+{
+	return NESEMU_UTIL_U16(cpu_trace_peek(mem, msb),
+			       cpu_trace_peek(mem, lsb));
+}
 
-		// INY
-	case INY:
-		_INY(self);
-		break;
+/**
+ * Record the state before a decoded instruction executes
+ *
+ * The effective address is computed again from the registers, pointers and
+ * values are peeked at through 'cpu_trace_peek' so that tracing has no
+ * effect on the bus.
+ *
+ * @param pc Address of the instruction
+ */
+static void cpu_trace(struct nes_cpu *self,
+		      struct nes_mem_main *mem,
+		      uint16_t pc,
+		      const struct nes_cpu_cache_entry *inst)
+{
+	const struct nes_cpu_opcode *op = &nes_cpu_opcodes[inst->opcode];
+	uint16_t operand = (uint16_t)inst->operand;
+	uint16_t addr = 0;
+	uint8_t value = 0xFF;
+	uint16_t ptr = 0;
+	bool memory = true;
 
-		// DEC
-	case DEC_ZP:
-		_DEC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
-	case DEC_ZX:
-		_DEC(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
+	// The record shows the observable $status
+	nes_cpu_status_sync(self);
+
+	switch (op->addressing) {
+	case NESEMU_ADDRESSING_ZERO_PAGE:
+		addr = NESEMU_ZEROPAGE_GET_ADDR(operand);
 		break;
-	case DEC_AB:
-		_DEC(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
+	case NESEMU_ADDRESSING_ZERO_PAGE_X:
+		addr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->x);
 		break;
-	case DEC_AX:
-		_DEC(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
+	case NESEMU_ADDRESSING_ZERO_PAGE_Y:
+		addr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->y);
 		break;
-
-		// DEX
-	case DEX:
-		_DEX(self);
+	case NESEMU_ADDRESSING_ABSOLUTE:
+		addr = operand;
 		break;
-
-		// DEY
-	case DEY:
-		_DEY(self);
+	case NESEMU_ADDRESSING_ABSOLUTE_X:
+		addr = operand + self->x;
 		break;
-
-		// ASL
-	case ASL_ACC:
-		_ASL(self, mem, NESEMU_ADDRESSING_ACCUMULATOR);
+	case NESEMU_ADDRESSING_ABSOLUTE_Y:
+		addr = operand + self->y;
 		break;
-	case ASL_ZP:
-		_ASL(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
+	case NESEMU_ADDRESSING_INDIRECT:
+		// Target of JMP, same page wrap as '_JMP'
+		addr = cpu_trace_peek16(
+			mem, operand,
+			(operand & 0xFF00) | (uint8_t)((operand & 0xFF) + 1));
+		memory = false;
 		break;
-	case ASL_ZX:
-		_ASL(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
+	case NESEMU_ADDRESSING_INDIRECT_X:
+		ptr = NESEMU_ZEROPAGE_GET_ADDR(operand + self->x);
+		addr = cpu_trace_peek16(mem, ptr, ptr + 1);
 		break;
-	case ASL_AB:
-		_ASL(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
+	case NESEMU_ADDRESSING_INDIRECT_Y:
+		ptr = NESEMU_ZEROPAGE_GET_ADDR(operand);
+		addr = cpu_trace_peek16(mem, ptr, ptr + 1) + self->y;
 		break;
-	case ASL_AX:
-		_ASL(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
+	default:
+		// No memory operand
+		memory = false;
 		break;
+	}
 
-		// LSR
-	case LSR_ACC:
-		_LSR(self, mem, NESEMU_ADDRESSING_ACCUMULATOR);
-		break;
+	// Registers have no memory mapped and are skipped
+	if (memory) {
+		value = cpu_trace_peek(mem, addr);
+	}
+
+	struct nes_cpu_trace_record record = {
+		.cycle = self->clock,
+		.pc = pc,
+		.address = addr,
+		.opcode = inst->opcode,
+		.operand = {(uint8_t)operand, (uint8_t)(operand >> 8)},
+		.value = value,
+		.a = self->a,
+		.x = self->x,
+		.y = self->y,
+		.status = self->status,
+		.sp = self->sp,
+	};
+	nes_cpu_trace_push(self->trace, &record);
+}
+#endif
+
+/**
+ * Decode and execute a single instruction at $pc
+ *
+ * @note Shared by 'nes_cpu_next' and 'nes_cpu_run', arguments are not checked
+ */
+static inline nesemu_return_t cpu_step(struct nes_cpu *self,
+				       struct nes_mem_main *mem,
+				       int *c)
+{
+	// Error code
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+#ifdef CONFIG_NESEMU_DEBUG
+    self->last_pc = self->pc;
+#endif
+#if defined(CONFIG_NESEMU_CPU_PROFILE) || defined(CONFIG_NESEMU_CPU_TRACE) || \
+	defined(CONFIG_NESEMU_CPU_COVERAGE)
+	uint16_t pc = self->pc;
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	// Decoding reads are code, not data (cache hits do not read at all)
+	struct nes_cpu_coverage *coverage = mem->coverage;
+	if (coverage != NULL) {
+		coverage->muted = true;
+	}
+#endif
+
+	// Decode the instruction (and its operand)
+	struct nes_cpu_cache_entry inst;
+	err = cpu_decode(self, mem, &inst);
+
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	if (coverage != NULL) {
+		coverage->muted = false;
+		if (err == NESEMU_RETURN_SUCCESS) {
+			nes_cpu_coverage_mark(coverage, pc,
+					      NESEMU_CPU_COVERAGE_OPCODE);
+			for (uint8_t i = 1; i < inst.length; i++) {
+				nes_cpu_coverage_mark(
+					coverage, (uint16_t)(pc + i),
+					NESEMU_CPU_COVERAGE_OPERAND);
+			}
+		}
+	}
+#endif
+
+#ifdef CONFIG_NESEMU_DEBUG
+    self->last_inst = inst.opcode;
+#endif
+
+	/* Instruction not found */
+	_NESEMU_RETURN_IF_ERR(err);
+
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	if (self->trace != NULL) {
+		cpu_trace(self, mem, pc, &inst);
+	}
+#endif
+
+	// Set cycles using the instruction
+	*c = inst.cycles;
+
+#ifndef CONFIG_NESEMU_CPU_SWITCH_DISPATCH
+	// Execute the specialized handler
+	err = inst.handler(self, mem, inst.operand, c);
+#else
+#ifdef CONFIG_NESEMU_DEBUGGER
+	// Breakpoints only replace the handler of the entry
+	if (inst.handler == nes_debugger_trap) {
+		return nes_debugger_trap(self, mem, inst.operand, c);
+	}
+#endif
+	// Execute the instruction (portable fallback)
+	switch (inst.opcode) {
+		NESEMU_CPU_OPCODE_LIST(_CPU_OPCODE_SWITCH_CASE)
+
+	default:
+		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
+	}
+#endif
+
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	// Anything past the base cycles is a taken branch or a page crossing
+	if (self->profile != NULL) {
+		nes_cpu_profile_count(
+			self->profile, pc, inst.opcode,
+			nes_cpu_opcodes[inst.opcode].addressing ==
+				NESEMU_ADDRESSING_RELATIVE,
+			*c - inst.cycles);
+	}
+#endif
+
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+    // Information codes (breakpoints) do not stop the CPU
+    if (err < NESEMU_RETURN_SUCCESS) {
+        self->brk = inst.opcode;
+        self->stop = true;
+    }
+#endif
+
+	return err;
+}
+
+/* Basic Blocks */
+
+/**
+ * Check if the instructions starting at 'insts' match a superinstruction
+ *
+ * @param count Amount of instructions available
+ * @param fused Reference to where the superinstruction will be stored
+ *
+ * @return Amount of instructions fused (0 if none)
+ */
+static uint8_t cpu_fuse(const struct nes_cpu_cache_entry *insts,
+			uint8_t count,
+			struct nes_cpu_cache_entry *fused)
+{
+	// Triples come first, the longest match wins
+	for (uint8_t id = NESEMU_CPU_FUSED_NONE + 1; id < NESEMU_CPU_FUSED_COUNT;
+	     id++) {
+		const struct nes_cpu_fused *f = &nes_cpu_fused[id];
+		if (f->length > count) {
+			continue;
+		}
+
+		uint8_t i = 0;
+		while (i < f->length && insts[i].opcode == f->opcodes[i]) {
+			i++;
+		}
+		if (i < f->length) {
+			continue;
+		}
+
+		// Pack the operands in program order
+		fused->handler = f->handler;
+		fused->opcode = insts[0].opcode;
+		fused->operand = 0;
+		fused->length = 0;
+		fused->cycles = 0;
+		fused->fused = id;
+		for (uint8_t j = 0, shift = 0; j < f->length; j++) {
+			fused->operand |= (uint32_t)insts[j].operand << shift;
+			fused->length += insts[j].length;
+			fused->cycles += insts[j].cycles;
+			shift += 8 * (insts[j].length - 1);
+		}
+
+		return f->length;
+	}
+
+	return 0;
+}
+
+/**
+ * Replace the known instruction sequences of a block with superinstructions
+ */
+static void cpu_block_fuse(struct nes_cpu_block *block)
+{
+	uint8_t length = 0;
+	for (uint8_t i = 0; i < block->length; length++) {
+		struct nes_cpu_cache_entry fused;
+		uint8_t n = cpu_fuse(&block->insts[i], block->length - i, &fused);
+		if (n > 0) {
+			block->insts[length] = fused;
+			i += n;
+		} else {
+			block->insts[length] = block->insts[i++];
+		}
+	}
+
+	block->length = length;
+}
+
+/**
+ * Check if an instruction leaves memory (and the stack) untouched
+ */
+static bool cpu_block_read_only(uint8_t opcode)
+{
+	switch (opcode) {
+	case STA_ZP:
+	case STA_ZX:
+	case STA_AB:
+	case STA_AX:
+	case STA_AY:
+	case STA_IX:
+	case STA_IY:
+	case STX_ZP:
+	case STX_ZY:
+	case STX_AB:
+	case STY_ZP:
+	case STY_ZX:
+	case STY_AB:
+	case INC_ZP:
+	case INC_ZX:
+	case INC_AB:
+	case INC_AX:
+	case DEC_ZP:
+	case DEC_ZX:
+	case DEC_AB:
+	case DEC_AX:
+	case ASL_ZP:
+	case ASL_ZX:
+	case ASL_AB:
+	case ASL_AX:
 	case LSR_ZP:
-		_LSR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
 	case LSR_ZX:
-		_LSR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
 	case LSR_AB:
-		_LSR(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
 	case LSR_AX:
-		_LSR(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
-		break;
-
-		// ROL
-	case ROL_ACC:
-		_ROL(self, mem, NESEMU_ADDRESSING_ACCUMULATOR);
-		break;
 	case ROL_ZP:
-		_ROL(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
 	case ROL_ZX:
-		_ROL(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
 	case ROL_AB:
-		_ROL(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
 	case ROL_AX:
-		_ROL(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
-		break;
-
-		// ROR
-	case ROR_ACC:
-		_ROR(self, mem, NESEMU_ADDRESSING_ACCUMULATOR);
-		break;
 	case ROR_ZP:
-		_ROR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE);
-		break;
 	case ROR_ZX:
-		_ROR(self, mem, NESEMU_ADDRESSING_ZERO_PAGE_X);
-		break;
 	case ROR_AB:
-		_ROR(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
 	case ROR_AX:
-		_ROR(self, mem, NESEMU_ADDRESSING_ABSOLUTE_X);
-		break;
+	case PHA:
+	case PHP:
+	case PLA:
+	case PLP:
+	case JSR:
+	case RTS:
+	case RTI:
+	case BRK:
+	case STP:
+		return false;
 
-		/* Jumps & Calls */
-	case JMP_AB:
-		err = _JMP(self, mem, NESEMU_ADDRESSING_ABSOLUTE);
-		break;
+	default:
+		return true;
+	}
+}
 
-	case JMP_IN:
-		err = _JMP(self, mem, NESEMU_ADDRESSING_INDIRECT);
-		break;
+/**
+ * Check if an instruction only reads plain memory: RAM, cartridge RAM or
+ * PRG ROM. Reading a register ($2000-$401F) has side effects and may return
+ * a different value each time, indexed and indirect loads could reach one.
+ *
+ * PPUSTATUS (and its mirrors) is the exception: the PPU does not run during
+ * 'nes_cpu_run', a second read returns the same value and repeats side
+ * effects that are already done (see 'cpu_block_poll').
+ */
+static bool cpu_block_plain_load(const struct nes_cpu_cache_entry *inst)
+{
+	switch (nes_cpu_opcodes[inst->opcode].addressing) {
+	case NESEMU_ADDRESSING_ACCUMULATOR:
+	case NESEMU_ADDRESSING_IMMEDIATE:
+	case NESEMU_ADDRESSING_IMPLIED:
+	case NESEMU_ADDRESSING_RELATIVE:
+	// Wrap around within page $00
+	case NESEMU_ADDRESSING_ZERO_PAGE:
+	case NESEMU_ADDRESSING_ZERO_PAGE_X:
+	case NESEMU_ADDRESSING_ZERO_PAGE_Y:
+		return true;
 
-	// JSR
-	case JSR:
-		err = _JSR(self, mem);
-		break;
+	case NESEMU_ADDRESSING_ABSOLUTE:
+		// Jump target, nothing is read
+		if (inst->opcode == JMP_AB) {
+			return true;
+		}
+		if (inst->operand >= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR &&
+		    inst->operand < NESEMU_MEMORY_RAM_IO_REG_ADDR) {
+			uint16_t base = NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE;
+			return inst->operand % base ==
+			       NESEMU_PPU_REG_PPUSTATUS % base;
+		}
+		return inst->operand < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR ||
+		       inst->operand >= NESEMU_CARTRIDGE_RAM_BEGIN;
 
-	// RTS
-	case RTS:
-		err = _RTS(self, mem);
-		break;
+	default:
+		return false;
+	}
+}
 
-		/* System Functions */
-	case BRK:
-		err = _BRK(self, mem);
-		break;
+/**
+ * Check if a block (not fused yet) is a polling loop: it only reads plain
+ * memory and its last instruction jumps back to its first one
+ */
+static bool cpu_block_polling(const struct nes_cpu_block *block)
+{
+	for (uint8_t i = 0; i < block->length; i++) {
+		if (!cpu_block_read_only(block->insts[i].opcode) ||
+		    !cpu_block_plain_load(&block->insts[i])) {
+			return false;
+		}
+	}
 
-	// RTI
-	case RTI:
-		err = _RTI(self, mem);
-		break;
+	const struct nes_cpu_cache_entry *last = &block->insts[block->length - 1];
+	switch (nes_cpu_opcodes[last->opcode].addressing) {
+	case NESEMU_ADDRESSING_RELATIVE:
+		return (uint16_t)(block->end + (int8_t)last->operand) ==
+		       block->pc;
 
-		/* Branches */
-	case BCC:
-		_BCC(self, mem, c);
-		break;
-	case BCS:
-		_BCS(self, mem, c);
-		break;
-	case BEQ:
-		_BEQ(self, mem, c);
-		break;
-	case BMI:
-		_BMI(self, mem, c);
-		break;
-	case BNE:
-		_BNE(self, mem, c);
-		break;
-	case BPL:
-		_BPL(self, mem, c);
-		break;
-	case BVC:
-		_BVC(self, mem, c);
-		break;
-	case BVS:
-		_BVS(self, mem, c);
-		break;
+	default:
+		return last->opcode == JMP_AB && last->operand == block->pc;
+	}
+}
 
-		/* Stack operations */
-	case PHA:
-		err = _PHA(self, mem);
-		break;
-	case PLA:
-		err = _PLA(self, mem);
-		break;
-	case PHP:
-		err = _PHP(self, mem);
-		break;
-	case PLP:
-		err = _PLP(self, mem);
-		break;
+/**
+ * Discover and decode the basic block starting at $pc
+ *
+ * @note $pc is not modified
+ *
+ * @return The new block, NULL if the first instruction cannot be decoded
+ */
+static struct nes_cpu_block *cpu_block_build(struct nes_cpu *self,
+					     struct nes_mem_main *mem,
+					     struct nes_cpu_block_cache *blocks)
+{
+	// Pool is full, start over
+	if (blocks->count == NESEMU_CPU_BLOCK_POOL_SIZE) {
+		nes_cpu_block_cache_flush(blocks);
+	}
 
-		/* Status Flag Changes */
-	case CLC:
-		_NESEMU_FALLTHROUGH;
-	case CLD:
-		_NESEMU_FALLTHROUGH;
-	case CLI:
-		_NESEMU_FALLTHROUGH;
-	case CLV:
-		_NESEMU_FALLTHROUGH;
-	case SEC:
-		_NESEMU_FALLTHROUGH;
-	case SED:
-		_NESEMU_FALLTHROUGH;
-	case SEI:
-		err = _CXX_SXX(self, opc);
-		break;
+	struct nes_cpu_block *block = &blocks->blocks[blocks->count];
+	block->pc = self->pc;
+	block->cycles = 0;
+	block->max_cycles = 0;
+	block->length = 0;
+	block->hits = 0;
+	block->native = NULL;
+	block->next[NESEMU_CPU_BLOCK_LINK_FALLTHROUGH] = NULL;
+	block->next[NESEMU_CPU_BLOCK_LINK_TARGET] = NULL;
+
+	// Decode without moving the actual $pc
+	uint16_t pc = self->pc;
+	while (block->length < NESEMU_CPU_BLOCK_MAX_LENGTH) {
+		struct nes_cpu_cache_entry *inst = &block->insts[block->length];
+		uint16_t ipc = self->pc;
+		if (cpu_decode(self, mem, inst) != NESEMU_RETURN_SUCCESS) {
+			// Leave the failing instruction to 'cpu_step'
+			self->pc = ipc;
+			break;
+		}
 
-		/* No operation */
-	case NOP:
-		break;
+		// Operands wrapping around $FFFF come from RAM, leave it to 'cpu_step'
+		if (self->pc < ipc && self->pc != 0) {
+			self->pc = ipc;
+			break;
+		}
 
-		/* WDC Extensions */
-	case STP:
-		_STP(self);
-		break;
+#ifdef CONFIG_NESEMU_DEBUGGER
+		// Breakpoints are left to 'cpu_step' too
+		if (inst->handler == nes_debugger_trap) {
+			self->pc = ipc;
+			break;
+		}
+#endif
 
-		/* Instruction not found */
-	default:
-		return NESEMU_RETURN_CPU_UNSUPPORTED_INSTRUCTION;
+		// Add up the instruction cost
+		const struct nes_cpu_opcode *op = &nes_cpu_opcodes[inst->opcode];
+		block->cycles += inst->cycles;
+		block->max_cycles += inst->cycles + (op->page_penalty ? 1 : 0) +
+				     (op->addressing == NESEMU_ADDRESSING_RELATIVE ?
+					      2 :
+					      0);
+		block->length++;
+
+		// End of the block, leaving the PRG ROM window (wraparound) or
+		// starting an OAM DMA (its stall depends on the cycle it ends at)
+		if (nes_cpu_block_terminator(inst->opcode) ||
+		    self->pc < NESEMU_CPU_BLOCK_BEGIN ||
+		    (op->addressing == NESEMU_ADDRESSING_ABSOLUTE &&
+		     inst->operand == NESEMU_PPU_REG_OAMDMA)) {
+			break;
+		}
+	}
+
+	block->end = self->pc;
+	self->pc = pc;
+
+	// Nothing decoded
+	if (block->length == 0) {
+		return NULL;
+	}
+
+	// Candidate for fast-forwarding (confirmed while running)
+	block->polling = cpu_block_polling(block);
+
+	// Fewer dispatches per block
+	cpu_block_fuse(block);
+
+	// Register the block
+	blocks->index[pc - NESEMU_CPU_BLOCK_BEGIN] = ++blocks->count;
+	return block;
+}
+
+/**
+ * Get the block starting at $pc, following (and updating) the links of the
+ * previously executed block whenever possible
+ *
+ * @param prev Previously executed block (NULL if none)
+ *
+ * @return The block, NULL if $pc cannot be executed as a block
+ */
+static inline struct nes_cpu_block *
+cpu_block_lookup(struct nes_cpu *self,
+		 struct nes_mem_main *mem,
+		 struct nes_cpu_block *prev)
+{
+	struct nes_cpu_block_cache *blocks = self->blocks;
+	uint16_t pc = self->pc;
+
+	// Blocks only live in PRG ROM
+	if (pc < NESEMU_CPU_BLOCK_BEGIN) {
+		return NULL;
+	}
+
+	// A bank switch remapped the PRG ROM window, the links point to blocks
+	// of the previous mapping
+	if (blocks->prg_version != mem->cartridge->prg_version) {
+		nes_cpu_block_cache_flush(blocks);
+		blocks->prg_version = mem->cartridge->prg_version;
+		prev = NULL;
+	}
+
+	// Follow the links (hot path)
+	if (prev != NULL) {
+		struct nes_cpu_block *next;
+		if ((next = prev->next[NESEMU_CPU_BLOCK_LINK_FALLTHROUGH]) !=
+			    NULL &&
+		    next->pc == pc) {
+			return next;
+		}
+		if ((next = prev->next[NESEMU_CPU_BLOCK_LINK_TARGET]) != NULL &&
+		    next->pc == pc) {
+			return next;
+		}
+	}
+
+	// Find the block or discover it
+	struct nes_cpu_block *block = NULL;
+	uint16_t count = blocks->count;
+	uint16_t index = blocks->index[pc - NESEMU_CPU_BLOCK_BEGIN];
+	if (index != 0) {
+		block = &blocks->blocks[index - 1];
+	} else if ((block = cpu_block_build(self, mem, blocks)) == NULL) {
+		return NULL;
+	}
+
+	// Link it to the previous block (unless the pool was just flushed)
+	if (prev != NULL && blocks->count >= count) {
+		prev->next[(pc == prev->end) ? NESEMU_CPU_BLOCK_LINK_FALLTHROUGH :
+					       NESEMU_CPU_BLOCK_LINK_TARGET] =
+			block;
+	}
+
+	return block;
+}
+
+/**
+ * Account for a block that failed at instruction 'failed'
+ *
+ * @param extra Extra cycles of the instructions before the failing one
+ * @param c Reference to where the consumed cycles will be stored
+ */
+static inline void cpu_block_fail(struct nes_cpu *self,
+				  const struct nes_cpu_block *block,
+				  int failed,
+				  int extra,
+				  int *c)
+{
+	// Only count the instructions that did execute
+	*c = extra;
+	for (int j = 0; j < failed; j++) {
+		*c += block->insts[j].cycles;
 	}
 
 #ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
-    if (err != NESEMU_RETURN_SUCCESS) {
-        self->brk = opc;
-        self->stop = true;
-    }
+	// Superinstructions already reported the fused instruction that failed
+	if (block->insts[failed].fused == NESEMU_CPU_FUSED_NONE) {
+		self->brk = block->insts[failed].opcode;
+	}
+	self->stop = true;
+#else
+	_NESEMU_UNUSED(self);
+#endif
+}
+
+/**
+ * Execute every instruction in a block
+ *
+ * @param c Reference to where the consumed cycles will be stored
+ */
+static inline nesemu_return_t cpu_block_exec(struct nes_cpu *self,
+					     struct nes_mem_main *mem,
+					     const struct nes_cpu_block *block,
+					     int *c)
+{
+	// Error code
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	// Cycles on top of the block base cycles
+	int extra = 0;
+
+	for (uint8_t i = 0; i < block->length; i++) {
+		const struct nes_cpu_cache_entry *inst = &block->insts[i];
+
+#ifdef CONFIG_NESEMU_DEBUG
+		self->last_pc = self->pc;
+		self->last_inst = inst->opcode;
+#endif
+
+		int before = extra;
+		self->pc += inst->length;
+		err = inst->handler(self, mem, inst->operand, &extra);
+		if (err != NESEMU_RETURN_SUCCESS) {
+			cpu_block_fail(self, block, i, before, c);
+			return err;
+		}
+	}
+
+	*c = block->cycles + extra;
+	return err;
+}
+
+#ifdef CONFIG_NESEMU_CPU_JIT
+
+/**
+ * Execute the native translation of a block
+ *
+ * @param c Reference to where the consumed cycles will be stored
+ */
+static inline nesemu_return_t cpu_jit_exec(struct nes_cpu *self,
+					   struct nes_mem_main *mem,
+					   const struct nes_cpu_block *block,
+					   int *c)
+{
+	int extra = 0, failed = 0;
+	nesemu_return_t err =
+		self->jit->entry(self, mem, &extra, &failed, block->native);
+	if (err != NESEMU_RETURN_SUCCESS) {
+		cpu_block_fail(self, block, failed, extra, c);
+		return err;
+	}
+
+	*c = block->cycles + extra;
+	return err;
+}
+
+/**
+ * Execute the native translation and the interpreter side by side, the
+ * interpreter runs on the shadow copies of the recompiler
+ *
+ * @return NESEMU_RETURN_CPU_JIT_MISMATCH if both engines disagree
+ */
+static nesemu_return_t cpu_jit_verify(struct nes_cpu *self,
+				      struct nes_mem_main *mem,
+				      const struct nes_cpu_block *block,
+				      int *c)
+{
+	struct nes_cpu_jit *jit = self->jit;
+
+	// Same starting state (the cartridge holds the mapper state, the PPU
+	// its registers)
+	jit->shadow_cpu = *self;
+	jit->shadow_mem = *mem;
+	memcpy(&jit->shadow_cartridge, mem->cartridge,
+	       sizeof(struct nes_cartridge));
+	jit->shadow_mem.cartridge = &jit->shadow_cartridge;
+	if (mem->ppu != NULL) {
+		memcpy(&jit->shadow_ppu, mem->ppu, sizeof(struct nes_ppu));
+		jit->shadow_mem.ppu = &jit->shadow_ppu;
+	}
+	nes_mem_map(&jit->shadow_mem);
+
+	int sc = 0;
+	nesemu_return_t serr =
+		cpu_block_exec(&jit->shadow_cpu, &jit->shadow_mem, block, &sc);
+	nesemu_return_t err = cpu_jit_exec(self, mem, block, c);
+
+	// Compare the resulting state
+	nes_cpu_status_sync(self);
+	nes_cpu_status_sync(&jit->shadow_cpu);
+	const struct nes_cpu *s = &jit->shadow_cpu;
+	if (err != serr || *c != sc || self->pc != s->pc || self->a != s->a ||
+	    self->x != s->x || self->y != s->y || self->sp != s->sp ||
+	    self->status != s->status || self->stop != s->stop ||
+	    self->brk != s->brk ||
+	    memcmp(mem->ram, jit->shadow_mem.ram, sizeof(mem->ram)) != 0 ||
+	    memcmp(mem->ppu_registers, jit->shadow_mem.ppu_registers,
+		   sizeof(mem->ppu_registers)) != 0 ||
+	    memcmp(mem->io_registers, jit->shadow_mem.io_registers,
+		   sizeof(mem->io_registers)) != 0 ||
+	    mem->stall != jit->shadow_mem.stall ||
+	    memcmp(mem->cartridge, &jit->shadow_cartridge,
+		   sizeof(struct nes_cartridge)) != 0 ||
+	    (mem->ppu != NULL && memcmp(mem->ppu, &jit->shadow_ppu,
+					sizeof(struct nes_ppu)) != 0)) {
+#ifdef CONFIG_NESEMU_DEBUG
+		self->last_pc = block->pc;
+#endif
+		self->brk = 0xFF;
+		self->stop = true;
+		return NESEMU_RETURN_CPU_JIT_MISMATCH;
+	}
+
+	return err;
+}
+
+#endif
+
+/**
+ * Execute a block, translating it to native code once it gets hot
+ *
+ * @param c Reference to where the consumed cycles will be stored
+ */
+static inline nesemu_return_t cpu_block_run(struct nes_cpu *self,
+					    struct nes_mem_main *mem,
+					    struct nes_cpu_block *block,
+					    int *c)
+{
+#ifdef CONFIG_NESEMU_CPU_JIT
+	struct nes_cpu_jit *jit = self->jit;
+	if (jit != NULL) {
+		// Translation failures (buffer full) keep the block interpreted
+		if (block->native == NULL &&
+		    block->hits < NESEMU_CPU_JIT_THRESHOLD &&
+		    ++block->hits == NESEMU_CPU_JIT_THRESHOLD) {
+			(void)nes_cpu_jit_compile(jit, self->blocks, block);
+		}
+
+		if (block->native != NULL) {
+			return jit->differential ?
+				       cpu_jit_verify(self, mem, block, c) :
+				       cpu_jit_exec(self, mem, block, c);
+		}
+	}
+#endif
+
+	return cpu_block_exec(self, mem, block, c);
+}
+
+/**
+ * Execute a polling loop block and skip its next iterations when they would
+ * repeat this one exactly
+ *
+ * An iteration that ends back at the block with the same registers, and
+ * did not write memory, will be repeated with the same cycles until
+ * something outside of the CPU changes the memory it reads. PPUSTATUS reads
+ * clear VBlank and the write toggle, the iteration is only repeated exactly
+ * if both were already clear. That can only change after 'nes_cpu_run'
+ * returns or once an interrupt is raised, so
+ * every whole iteration that fits before the budget is consumed or the next
+ * event is due is charged without executing it. The last (partial)
+ * iterations are left to the caller, the result is the same as executing
+ * each one of them.
+ *
+ * @param remaining Cycles left before the budget is consumed or the next
+ * event is due, more than 'block->max_cycles'
+ * @param c Reference to where the consumed cycles will be stored
+ */
+static inline nesemu_return_t cpu_block_poll(struct nes_cpu *self,
+					     struct nes_mem_main *mem,
+					     struct nes_cpu_block *block,
+					     int remaining,
+					     int *c)
+{
+	// Registers (and PPU state read through PPUSTATUS) before the
+	// iteration
+	nes_cpu_status_sync(self);
+	uint8_t a = self->a, x = self->x, y = self->y, sp = self->sp,
+		status = self->status;
+	const struct nes_ppu *ppu = mem->ppu;
+	uint8_t ppu_status = ppu != NULL ? ppu->status : 0;
+	uint8_t ppu_w = ppu != NULL ? ppu->w : 0;
+
+	nesemu_return_t err = cpu_block_run(self, mem, block, c);
+	_NESEMU_RETURN_IF_ERR(err);
+
+	// Loop was left or still making progress
+	nes_cpu_status_sync(self);
+	if (self->pc != block->pc || self->a != a || self->x != x ||
+	    self->y != y || self->sp != sp || self->status != status) {
+		return err;
+	}
+	if (ppu != NULL && (ppu->status != ppu_status || ppu->w != ppu_w)) {
+		return err;
+	}
+
+	// Whole iterations that still end before the budget
+	*c += ((remaining - 1 - *c) / *c) * *c;
+
+	return err;
+}
+
+/* Events */
+
+/**
+ * Push $pc and $status and jump to the handler of an interrupt
+ */
+static nesemu_return_t cpu_interrupt(struct nes_cpu *self,
+				     struct nes_mem_main *mem,
+				     uint16_t vector)
+{
+	// Push program counter
+	nesemu_return_t err = nes_stack_push_u16(mem, &self->sp, self->pc);
+	_NESEMU_RETURN_IF_ERR(err);
+
+	// Push flags NV1BDIZC, B is only set by BRK and PHP
+	nes_cpu_status_sync(self);
+	err = nes_stack_push_u8(
+		mem, &self->sp,
+		NESEMU_CPU_STATUS_UNSET_MASK((self->status | NESEMU_CPU_FLAGS_1),
+					     NESEMU_CPU_FLAGS_B));
+	_NESEMU_RETURN_IF_ERR(err);
+
+	// Mask IRQs
+	nes_cpu_status_mask_set(self, NESEMU_CPU_FLAGS_I);
+
+	// Jump to the handler
+	err = _CPU_R16(mem, vector, &self->pc);
+
+	return err;
+}
+
+/**
+ * Raise the events that are due and deliver the pending interrupt (NMI
+ * first), called once the clock reaches 'next_event'
+ *
+ * @param c Reference to where the consumed cycles will be stored, 0 if no
+ * interrupt was delivered
+ */
+static nesemu_return_t cpu_event_dispatch(struct nes_cpu *self,
+					  struct nes_mem_main *mem,
+					  int *c)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+	bool nmi = false;
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+	// A watchpoint was hit by the previous instruction
+	if (self->halt) {
+		self->halt = false;
+		self->next_event = nes_cpu_event_next(self);
+		*c = 0;
+		return NESEMU_INFO_CPU_BREAK;
+	}
+#endif
+
+	// Events due
+	for (int i = 0; i < NESEMU_CPU_EVENT_COUNT; i++) {
+		if (self->events[i] > self->clock) {
+			continue;
+		}
+
+		self->events[i] = NESEMU_CPU_EVENT_NEVER;
+		if (i == NESEMU_CPU_EVENT_NMI) {
+			nmi = true;
+		} else {
+			self->irq |= (uint8_t)(1u << i);
+		}
+	}
+
+	*c = 0;
+	if (nmi) {
+		err = cpu_interrupt(self, mem, NESEMU_CPU_VECTOR_NMI);
+		*c = NESEMU_CPU_INTERRUPT_CYCLES;
+	} else if (self->irq != 0 &&
+		   (self->status & NESEMU_CPU_FLAGS_I) == 0) {
+		err = cpu_interrupt(self, mem, NESEMU_CPU_VECTOR_IRQ);
+		*c = NESEMU_CPU_INTERRUPT_CYCLES;
+	}
+
+	self->next_event = nes_cpu_event_next(self);
+
+	return err;
+}
+
+/**
+ * Cycles that can be executed before the budget is consumed or the next
+ * event is due
+ *
+ * @param remaining Cycles left in the budget
+ */
+static inline int cpu_event_horizon(const struct nes_cpu *self, int remaining)
+{
+	if (self->next_event <= self->clock) {
+		return 0;
+	}
+
+	uint64_t until = self->next_event - self->clock;
+	return (until < (uint64_t)remaining) ? (int)until : remaining;
+}
+
+/**
+ * Cycles the bus took from the CPU while executing the last 'c' cycles (OAM
+ * DMA), one more to realign when the transfer starts on an odd cycle
+ */
+static inline int cpu_stall(const struct nes_cpu *self,
+			    struct nes_mem_main *mem,
+			    int c)
+{
+	int stall = mem->stall;
+	mem->stall = 0;
+
+	if (stall != 0 && ((self->clock + (uint64_t)c) & 1) != 0) {
+		stall++;
+	}
+
+	return stall;
+}
+
+#ifdef CONFIG_NESEMU_TRUSTED
+/**
+ * Pick up the sticky bus error left by a batch of instructions, the CPU
+ * stops as with any other error ($brk is 0xFF, the instruction is unknown)
+ */
+static inline nesemu_return_t cpu_trusted_check(struct nes_cpu *self,
+						struct nes_mem_main *mem,
+						nesemu_return_t err)
+{
+	if (err == NESEMU_RETURN_SUCCESS &&
+	    mem->error != NESEMU_RETURN_SUCCESS) {
+		err = nes_mem_error(mem);
+		self->brk = 0xFF;
+		self->stop = true;
+	}
+
+	return err;
+}
+#endif
+
+/* Public Functions */
+
+nesemu_return_t nes_cpu_next(struct nes_cpu *self,
+			    struct nes_mem_main *mem,
+			    int *c)
+{
+	/* Check input arguments */
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || c == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+	*c = 0;
+
+	// A pending interrupt is delivered instead of the next instruction
+	if (self->clock >= self->next_event) {
+		err = cpu_event_dispatch(self, mem, c);
+	}
+	if (err == NESEMU_RETURN_SUCCESS && *c == 0) {
+		err = cpu_step(self, mem, c);
+	}
+	if (err == NESEMU_RETURN_SUCCESS) {
+		*c += cpu_stall(self, mem, *c);
+		self->clock += (uint64_t)*c;
+	}
+
+#ifdef CONFIG_NESEMU_TRUSTED
+	err = cpu_trusted_check(self, mem, err);
+#endif
+
+	// Leave $status observable
+	nes_cpu_status_sync(self);
+
+	return err;
+}
+
+nesemu_return_t nes_cpu_run(struct nes_cpu *self,
+			   struct nes_mem_main *mem,
+			   int budget,
+			   int *cycles)
+{
+	/* Check input arguments */
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || mem == NULL || cycles == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Error code
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	// Work on a local copy of the registers, written back once at the end
+	struct nes_cpu cpu = *self;
+
+	// Consumed cycles
+	int done = 0;
+
+	// Last executed block
+	struct nes_cpu_block *block = NULL;
+
+	// Blocks are bypassed while profiling, tracing or recording coverage,
+	// so that every instruction is seen
+	bool blocks = cpu.blocks != NULL;
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	blocks = blocks && cpu.profile == NULL;
+#endif
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	blocks = blocks && cpu.trace == NULL;
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	blocks = blocks && mem->coverage == NULL;
+#endif
+#ifdef CONFIG_NESEMU_DEBUGGER
+	// Watchpoint hits land in the local copy, and stop right after the
+	// instruction (not the block)
+	if (cpu.debugger != NULL) {
+		cpu.debugger->running = &cpu;
+		blocks = blocks && cpu.debugger->watch_count == 0;
+	}
+#endif
+
+	while (done < budget && !cpu.stop) {
+		int c = 0;
+
+		// Events are only looked at once their timestamp is crossed
+		if (cpu.clock >= cpu.next_event &&
+		    (err = cpu_event_dispatch(&cpu, mem, &c)) !=
+			    NESEMU_RETURN_SUCCESS) {
+			break;
+		}
+
+		// Cycles until the budget is consumed or the next event is due
+		int horizon = cpu_event_horizon(&cpu, budget - done);
+
+		if (c > 0) {
+			// Interrupt delivered, the handler starts a new chain
+			block = NULL;
+		}
+		// Execute whole blocks while they cannot overrun the horizon
+		else if (blocks &&
+			 (block = cpu_block_lookup(&cpu, mem, block)) != NULL &&
+			 block->max_cycles < horizon) {
+			err = block->polling ?
+				      cpu_block_poll(&cpu, mem, block, horizon,
+						     &c) :
+				      cpu_block_run(&cpu, mem, block, &c);
+		} else {
+			err = cpu_step(&cpu, mem, &c);
+			block = NULL;
+		}
+
+		if (err != NESEMU_RETURN_SUCCESS) {
+			break;
+		}
+
+		// Charged at once, the CPU does nothing else meanwhile
+		c += cpu_stall(&cpu, mem, c);
+
+		done += c;
+		cpu.clock += (uint64_t)c;
+	}
+
+#ifdef CONFIG_NESEMU_TRUSTED
+	err = cpu_trusted_check(&cpu, mem, err);
+#endif
+
+	// Store the CPU state back
+	nes_cpu_status_sync(&cpu);
+	*self = cpu;
+	*cycles = done;
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+	if (cpu.debugger != NULL) {
+		cpu.debugger->running = self;
+	}
 #endif
 
 	return err;
@@ -1,39 +0,0 @@
-#include "nesemu/cpu/instructions.h"
-
-/**
- * Look-up table for CPU cycles for each operation
- */
-const uint8_t nes_cpu_op_cycles[256] = {
-	// 0x00–0x0F
-	7, 6, 0, 0, 0, 3, 5, 0, 3, 2, 2, 0, 0, 4, 6, 0,
-	// 0x10–0x1F
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-	// 0x20–0x2F
-	6, 6, 0, 0, 3, 3, 5, 0, 4, 2, 2, 0, 4, 4, 6, 0,
-	// 0x30–0x3F
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-	// 0x40–0x4F
-	6, 6, 0, 0, 0, 3, 5, 0, 4, 2, 2, 0, 3, 4, 6, 0,
-	// 0x50–0x5F
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-	// 0x60–0x6F
-	6, 6, 0, 0, 3, 3, 5, 0, 4, 2, 2, 0, 4, 4, 6, 0,
-	// 0x70–0x7F
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-	// 0x80–0x8F
-	0, 6, 0, 0, 3, 3, 5, 0, 3, 2, 0, 0, 4, 4, 6, 0,
-	// 0x90–0x9F
-	2, 6, 0, 0, 0, 4, 6, 0, 2, 5, 0, 0, 0, 5, 7, 0,
-	// 0xA0–0xAF
-	2, 6, 2, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
-	// 0xB0–0xBF
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-	// 0xC0–0xCF
-	2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
-	// 0xD0–0xDF
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 3, 0, 4, 7, 0,
-	// 0xE0–0xEF
-	2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
-	// 0xF0–0xFF
-	2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
-};
@@ -0,0 +1,664 @@
+/**
+ * This file contains definitions for functions in 'jit.h'
+ *
+ * The entry point at the start of the buffer saves the callee-saved host
+ * registers once and calls the translation, which relies on:
+ *      rbx = struct nes_cpu *self
+ *      rbp = struct nes_mem_main *mem
+ *      r12 = int *extra
+ *      r13 = extra cycles before the current handler (restored on error)
+ *      r14 = int *failed
+ *
+ * CPU registers stay in 'struct nes_cpu' (always in L1), most instructions
+ * call back into the interpreter handlers so keeping them in host registers
+ * would require spilling them around every call.
+ *
+ * Only block terminators (JMP, JSR, RTS, ...) read $pc, so it is stored
+ * before them, at the end of the block and by the error stubs.
+ */
+
+#include "nesemu/cpu/jit.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/cpu/status.h"
+#include "nesemu/util/error.h"
+#include "nesemu/util/compat.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_CPU_JIT
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "CONFIG_NESEMU_CPU_JIT requires Linux x86-64"
+#endif
+
+#include <sys/mman.h>
+
+/**
+ * Worst case amount of bytes emitted for a single instruction
+ */
+#define _JIT_INSTRUCTION_MAX_SIZE 128
+
+/**
+ * Amount of bytes emitted around the instructions (alignment, return)
+ */
+#define _JIT_BLOCK_OVERHEAD_SIZE 64
+
+/**
+ * Translations start at multiples of this size
+ */
+#define _JIT_BLOCK_ALIGNMENT 16
+
+/* Fields are addressed as [rbx + disp8] */
+#define _JIT_OFFSET(field) ((uint8_t)offsetof(struct nes_cpu, field))
+
+_Static_assert(offsetof(struct nes_cpu, status) < 0x80 &&
+		       offsetof(struct nes_cpu, brk) < 0x80,
+	       "CPU registers must be addressable with an 8-bit displacement");
+#ifdef CONFIG_NESEMU_DEBUG
+_Static_assert(offsetof(struct nes_cpu, last_pc) < 0x80,
+	       "CPU debug fields must be addressable with an 8-bit displacement");
+#endif
+
+/**
+ * Code emitter
+ */
+struct jit_emitter {
+	uint8_t *code; /**< Current position */
+	uint8_t *fail[NESEMU_CPU_BLOCK_MAX_LENGTH]; /**< rel32 to error stubs */
+	uint16_t fail_pc[NESEMU_CPU_BLOCK_MAX_LENGTH]; /**< $pc on error */
+};
+
+/* Private Functions */
+
+static inline void jit_u8(struct jit_emitter *e, uint8_t value)
+{
+	*e->code++ = value;
+}
+
+static inline void jit_u32(struct jit_emitter *e, uint32_t value)
+{
+	memcpy(e->code, &value, sizeof(value));
+	e->code += sizeof(value);
+}
+
+static inline void jit_u64(struct jit_emitter *e, uint64_t value)
+{
+	memcpy(e->code, &value, sizeof(value));
+	e->code += sizeof(value);
+}
+
+/**
+ * Emit a sequence of bytes
+ */
+static inline void jit_bytes(struct jit_emitter *e, const uint8_t *bytes,
+			     size_t len)
+{
+	memcpy(e->code, bytes, len);
+	e->code += len;
+}
+
+#define _JIT_EMIT(e, ...)                              \
+	jit_bytes(e, (const uint8_t[]){ __VA_ARGS__ }, \
+		  sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+/**
+ * Store a 16-bit immediate into a CPU field
+ *
+ * @note 'mov word [mem], imm16' stalls the decoder (length changing prefix),
+ * go through ecx instead
+ */
+static void jit_store_u16(struct jit_emitter *e, uint8_t field, uint16_t value)
+{
+	// mov ecx, value
+	jit_u8(e, 0xB9);
+	jit_u32(e, value);
+
+	// mov word [rbx + field], cx
+	_JIT_EMIT(e, 0x66, 0x89, 0x4B, field);
+}
+
+/**
+ * Store $pc
+ */
+static inline void jit_store_pc(struct jit_emitter *e, uint16_t pc)
+{
+	jit_store_u16(e, _JIT_OFFSET(pc), pc);
+}
+
+/**
+ * Load an immediate into a register (LDA/LDX/LDY #imm), flags are constant
+ */
+static void jit_load_immediate(struct jit_emitter *e, uint8_t reg,
+			       uint8_t value)
+{
+	// mov byte [rbx + reg], value
+	_JIT_EMIT(e, 0xC6, 0x43, reg, value);
+
+	// or byte [rbx + status], NZ(value)
+	uint8_t mask = NESEMU_CPU_STATUS_MASK_NZ(value);
+	if (mask != 0) {
+		_JIT_EMIT(e, 0x80, 0x4B, _JIT_OFFSET(status), mask);
+	}
+}
+
+/**
+ * Transfer/increment/decrement a register (TAX, INX, DEY, ...)
+ *
+ * @param delta +1 increment, -1 decrement, 0 transfer
+ * @param flags Update N and Z
+ */
+static void jit_transfer(struct jit_emitter *e, uint8_t src, uint8_t dst,
+			 int delta, bool flags)
+{
+	// mov al, byte [rbx + src]
+	_JIT_EMIT(e, 0x8A, 0x43, src);
+
+	if (delta > 0) {
+		// inc al
+		_JIT_EMIT(e, 0xFE, 0xC0);
+	} else if (delta < 0) {
+		// dec al
+		_JIT_EMIT(e, 0xFE, 0xC8);
+	}
+
+	// mov byte [rbx + dst], al
+	_JIT_EMIT(e, 0x88, 0x43, dst);
+
+	if (flags) {
+		_JIT_EMIT(e,
+			  // mov cl, al
+			  0x88, 0xC1,
+			  // and cl, N
+			  0x80, 0xE1, NESEMU_CPU_FLAGS_N,
+			  // test al, al
+			  0x84, 0xC0,
+			  // jnz +3
+			  0x75, 0x03,
+			  // or cl, Z
+			  0x80, 0xC9, NESEMU_CPU_FLAGS_Z,
+			  // or byte [rbx + status], cl
+			  0x08, 0x4B, _JIT_OFFSET(status));
+	}
+}
+
+/**
+ * Set or clear a status flag (CLC, SEI, ...)
+ */
+static void jit_status(struct jit_emitter *e, uint8_t mask, bool set)
+{
+	if (set) {
+		// or byte [rbx + status], mask
+		_JIT_EMIT(e, 0x80, 0x4B, _JIT_OFFSET(status), mask);
+	} else {
+		// and byte [rbx + status], ~mask
+		_JIT_EMIT(e, 0x80, 0x63, _JIT_OFFSET(status), (uint8_t)~mask);
+	}
+}
+
+/**
+ * Conditional branch, target and page crossing are known at compile time
+ *
+ * @param pc $pc after the branch instruction
+ * @param taken_if_set Branch is taken when the flag is set
+ */
+static void jit_branch(struct jit_emitter *e, uint16_t pc, uint16_t operand,
+		       uint8_t mask, bool taken_if_set)
+{
+	uint16_t target = pc + (int8_t)operand;
+	uint8_t extra = ((target & 0xFF00) != (pc & 0xFF00)) ? 2 : 1;
+
+	// Not taken
+	jit_store_pc(e, pc);
+
+	// test byte [rbx + status], mask
+	_JIT_EMIT(e, 0xF6, 0x43, _JIT_OFFSET(status), mask);
+	// jz/jnz over the taken path (9 + 5 bytes)
+	_JIT_EMIT(e, taken_if_set ? 0x74 : 0x75, 14);
+
+	// Taken
+	jit_store_pc(e, target);
+	// add dword [r12], extra
+	_JIT_EMIT(e, 0x41, 0x83, 0x04, 0x24, extra);
+}
+
+/**
+ * Last opcode of an entry, the entry is a block terminator if it is one
+ */
+static inline uint8_t jit_last_opcode(const struct nes_cpu_cache_entry *inst)
+{
+	if (inst->fused == NESEMU_CPU_FUSED_NONE) {
+		return inst->opcode;
+	}
+
+	const struct nes_cpu_fused *f = &nes_cpu_fused[inst->fused];
+	return f->opcodes[f->length - 1];
+}
+
+/**
+ * Call the specialized handler of an instruction
+ *
+ * @param pc $pc after the instruction
+ * @param index Instruction index within the block (for error reporting)
+ */
+static void jit_call(struct jit_emitter *e,
+		     const struct nes_cpu_cache_entry *inst,
+		     uint16_t pc,
+		     size_t index)
+{
+	// Terminators read (and write) $pc
+	if (nes_cpu_block_terminator(jit_last_opcode(inst))) {
+		jit_store_pc(e, pc);
+	}
+
+	_JIT_EMIT(e,
+		  // mov r13d, dword [r12]
+		  0x45, 0x8B, 0x2C, 0x24,
+		  // mov rdi, rbx
+		  0x48, 0x89, 0xDF,
+		  // mov rsi, rbp
+		  0x48, 0x89, 0xEE);
+
+	// mov edx, operand
+	jit_u8(e, 0xBA);
+	jit_u32(e, inst->operand);
+
+	// mov rcx, r12
+	_JIT_EMIT(e, 0x4C, 0x89, 0xE1);
+
+	// call handler (rel32 when the buffer is close enough to the handlers)
+	intptr_t rel = (intptr_t)(uintptr_t)inst->handler -
+		       (intptr_t)(uintptr_t)(e->code + 5);
+	if (rel >= INT32_MIN && rel <= INT32_MAX) {
+		jit_u8(e, 0xE8);
+		jit_u32(e, (uint32_t)(int32_t)rel);
+	} else {
+		// mov rax, handler; call rax
+		_JIT_EMIT(e, 0x48, 0xB8);
+		jit_u64(e, (uint64_t)(uintptr_t)inst->handler);
+		_JIT_EMIT(e, 0xFF, 0xD0);
+	}
+
+	// test eax, eax; jnz <error stub>
+	_JIT_EMIT(e, 0x85, 0xC0, 0x0F, 0x85);
+	e->fail[index] = e->code;
+	e->fail_pc[index] = pc;
+	jit_u32(e, 0);
+}
+
+/**
+ * Emit a single (not fused) instruction without calling its handler
+ *
+ * @return false if the instruction has no inline translation
+ */
+static bool jit_inline_single(struct jit_emitter *e,
+			      const struct nes_cpu_cache_entry *inst,
+			      uint16_t pc)
+{
+	uint8_t a = _JIT_OFFSET(a), x = _JIT_OFFSET(x), y = _JIT_OFFSET(y),
+		sp = _JIT_OFFSET(sp);
+
+	// Must behave exactly like the handlers in 'decode.c'
+	switch (inst->opcode) {
+	case LDA_IM:
+		jit_load_immediate(e, a, (uint8_t)inst->operand);
+		break;
+	case LDX_IM:
+		jit_load_immediate(e, x, (uint8_t)inst->operand);
+		break;
+	case LDY_IM:
+		jit_load_immediate(e, y, (uint8_t)inst->operand);
+		break;
+
+	case TAX:
+		jit_transfer(e, a, x, 0, true);
+		break;
+	case TXA:
+		jit_transfer(e, x, a, 0, true);
+		break;
+	case TAY:
+		jit_transfer(e, a, y, 0, true);
+		break;
+	case TYA:
+		jit_transfer(e, y, a, 0, true);
+		break;
+	case TSX:
+		jit_transfer(e, sp, x, 0, true);
+		break;
+	case TXS:
+		jit_transfer(e, x, sp, 0, false);
+		break;
+	case INX:
+		jit_transfer(e, x, x, 1, true);
+		break;
+	case DEX:
+		jit_transfer(e, x, x, -1, true);
+		break;
+	case INY:
+		jit_transfer(e, y, y, 1, true);
+		break;
+	case DEY:
+		jit_transfer(e, y, y, -1, true);
+		break;
+
+	case CLC:
+		jit_status(e, NESEMU_CPU_FLAGS_C, false);
+		break;
+	case SEC:
+		jit_status(e, NESEMU_CPU_FLAGS_C, true);
+		break;
+	case CLI:
+		jit_status(e, NESEMU_CPU_FLAGS_I, false);
+		break;
+	case SEI:
+		jit_status(e, NESEMU_CPU_FLAGS_I, true);
+		break;
+	case CLD:
+		jit_status(e, NESEMU_CPU_FLAGS_D, false);
+		break;
+	case SED:
+		jit_status(e, NESEMU_CPU_FLAGS_D, true);
+		break;
+	case CLV:
+		// Same as the interpreter handler
+		jit_status(e, NESEMU_CPU_FLAGS_V, true);
+		break;
+
+	case BCC:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_C, false);
+		break;
+	case BCS:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_C, true);
+		break;
+	// With lazy flags N & Z may be pending, the handlers fold them first
+#ifndef CONFIG_NESEMU_CPU_LAZY_FLAGS
+	case BNE:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_Z, false);
+		break;
+	case BEQ:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_Z, true);
+		break;
+	case BPL:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_N, false);
+		break;
+	case BMI:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_N, true);
+		break;
+#endif
+	case BVC:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_V, false);
+		break;
+	case BVS:
+		jit_branch(e, pc, inst->operand, NESEMU_CPU_FLAGS_V, true);
+		break;
+
+	case NOP:
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Emit an instruction without calling its handler when possible,
+ * superinstructions are inlined only if every fused instruction is
+ *
+ * @param pc $pc after the instruction
+ *
+ * @return false if the instruction has no inline translation
+ */
+static bool jit_inline(struct jit_emitter *e,
+		       const struct nes_cpu_cache_entry *inst,
+		       uint16_t pc)
+{
+	if (inst->fused == NESEMU_CPU_FUSED_NONE) {
+		return jit_inline_single(e, inst, pc);
+	}
+
+	const struct nes_cpu_fused *f = &nes_cpu_fused[inst->fused];
+	uint8_t *mark = e->code;
+	uint32_t operand = inst->operand;
+	uint16_t ipc = pc - inst->length;
+
+	for (uint8_t i = 0; i < f->length; i++) {
+		struct nes_cpu_cache_entry single = {
+			.opcode = f->opcodes[i],
+			.operand = nes_cpu_fused_operand(&operand, f->opcodes[i]),
+			.length = nes_cpu_opcodes[f->opcodes[i]].length,
+		};
+
+		ipc += single.length;
+		if (!jit_inline_single(e, &single, ipc)) {
+			// Drop the partial translation, call the handler instead
+			e->code = mark;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Emit the shared entry point
+ *
+ * nesemu_return_t entry(self, mem, extra, failed, code)
+ */
+static void jit_emit_entry(struct jit_emitter *e)
+{
+	_JIT_EMIT(e,
+		  // push rbx; push rbp; push r12; push r13; push r14
+		  0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56,
+		  // sub rsp, 8 (translations call handlers with rsp aligned)
+		  0x48, 0x83, 0xEC, 0x08,
+		  // mov rbx, rdi; mov rbp, rsi
+		  0x48, 0x89, 0xFB, 0x48, 0x89, 0xF5,
+		  // mov r12, rdx; mov r14, rcx
+		  0x49, 0x89, 0xD4, 0x49, 0x89, 0xCE,
+		  // call r8
+		  0x41, 0xFF, 0xD0,
+		  // add rsp, 8
+		  0x48, 0x83, 0xC4, 0x08,
+		  // pop r14; pop r13; pop r12; pop rbp; pop rbx; ret
+		  0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3);
+}
+
+/* Public Functions */
+
+nesemu_return_t nes_cpu_jit_init(struct nes_cpu_jit *self, size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || size < _JIT_BLOCK_OVERHEAD_SIZE) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self, 0, sizeof(struct nes_cpu_jit));
+
+	// Ask for an address close to the handlers so that calls fit in rel32,
+	// the kernel is free to ignore it (calls fall back to absolute)
+	uintptr_t text = (uintptr_t)&nes_cpu_jit_compile;
+	void *hint = (void *)((text & ~(uintptr_t)0xFFFFF) - size - 0x1000000);
+
+	// Writable while translating, executable otherwise (W^X)
+	void *buffer = mmap(hint, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	struct jit_emitter e = { .code = buffer };
+	jit_emit_entry(&e);
+
+	if (mprotect(buffer, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(buffer, size);
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	self->buffer = buffer;
+	self->size = size;
+	self->base = (size_t)(e.code - self->buffer);
+	self->used = self->base;
+
+	// Object to function pointer conversion (POSIX)
+	memcpy(&self->entry, &buffer, sizeof(self->entry));
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_jit_destroy(struct nes_cpu_jit *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (self->buffer != NULL && munmap(self->buffer, self->size) != 0) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	self->buffer = NULL;
+	self->entry = NULL;
+	self->size = self->used = self->base = 0;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_jit_compile(struct nes_cpu_jit *self,
+				    struct nes_cpu_block_cache *blocks,
+				    struct nes_cpu_block *block)
+{
+	// Every previous translation is unreachable after a flush
+	if (self->generation != blocks->generation) {
+		self->generation = blocks->generation;
+		self->used = self->base;
+	}
+
+	// Out of space until the next flush
+	size_t worst = _JIT_BLOCK_OVERHEAD_SIZE +
+		       (size_t)block->length * _JIT_INSTRUCTION_MAX_SIZE;
+	if (self->used + worst > self->size) {
+		return NESEMU_RETURN_CPU_JIT_FULL;
+	}
+
+	if (mprotect(self->buffer, self->size, PROT_READ | PROT_WRITE) != 0) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	// Pad up to the alignment (int3)
+	uint8_t *start = self->buffer + self->used;
+	while (((uintptr_t)start % _JIT_BLOCK_ALIGNMENT) != 0) {
+		*start++ = 0xCC;
+	}
+
+	struct jit_emitter e = { .code = start };
+	memset(e.fail, 0, sizeof(e.fail));
+
+	/* Instructions */
+	uint16_t pc = block->pc;
+	bool pc_synced = true;
+	for (size_t i = 0; i < block->length; i++) {
+		const struct nes_cpu_cache_entry *inst = &block->insts[i];
+
+#ifdef CONFIG_NESEMU_DEBUG
+		jit_store_u16(&e, _JIT_OFFSET(last_pc), pc);
+		// mov byte [rbx + last_inst], opcode
+		_JIT_EMIT(&e, 0xC6, 0x43, _JIT_OFFSET(last_inst), inst->opcode);
+#endif
+
+		pc += inst->length;
+		if (!jit_inline(&e, inst, pc)) {
+			jit_call(&e, inst, pc, i);
+		}
+		pc_synced = nes_cpu_block_terminator(jit_last_opcode(inst));
+	}
+
+	// Terminators already left $pc in place
+	if (!pc_synced) {
+		jit_store_pc(&e, pc);
+	}
+
+	// xor eax, eax; ret
+	_JIT_EMIT(&e, 0x31, 0xC0, 0xC3);
+
+	/* Error stubs (eax holds the error code) */
+	for (size_t i = 0; i < block->length; i++) {
+		if (e.fail[i] == NULL) {
+			continue;
+		}
+
+		// Patch the jump into the stub
+		int32_t rel = (int32_t)(e.code - (e.fail[i] + 4));
+		memcpy(e.fail[i], &rel, sizeof(rel));
+
+		// mov dword [r12], r13d (drop the failing instruction cycles)
+		_JIT_EMIT(&e, 0x45, 0x89, 0x2C, 0x24);
+		// mov dword [r14], index
+		_JIT_EMIT(&e, 0x41, 0xC7, 0x06);
+		jit_u32(&e, (uint32_t)i);
+		// $pc after the failing instruction, like the interpreter
+		jit_store_pc(&e, e.fail_pc[i]);
+		// ret
+		jit_u8(&e, 0xC3);
+	}
+
+	self->used = (size_t)(e.code - self->buffer);
+
+	if (mprotect(self->buffer, self->size, PROT_READ | PROT_EXEC) != 0) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	block->native = start;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#else
+
+nesemu_return_t nes_cpu_jit_init(struct nes_cpu_jit *self, size_t size)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(size);
+	return NESEMU_RETURN_CPU_JIT_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_jit_destroy(struct nes_cpu_jit *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_JIT_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_jit_compile(struct nes_cpu_jit *self,
+				    struct nes_cpu_block_cache *blocks,
+				    struct nes_cpu_block *block)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(blocks);
+	_NESEMU_UNUSED(block);
+	return NESEMU_RETURN_CPU_JIT_UNSUPPORTED;
+}
+
+#endif
+
+nesemu_return_t nes_cpu_jit_attach(struct nes_cpu_jit *self,
+				   struct nes_cpu *cpu)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+#ifdef CONFIG_NESEMU_CPU_JIT
+	cpu->jit = self;
+	return NESEMU_RETURN_SUCCESS;
+#else
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cpu);
+	return NESEMU_RETURN_CPU_JIT_UNSUPPORTED;
+#endif
+}
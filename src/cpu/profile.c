@@ -0,0 +1,181 @@
+/**
+ * This file contains definitions for functions in 'profile.h'
+ */
+
+#include "nesemu/cpu/profile.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+
+/**
+ * Mnemonic of an opcode, "???" if unsupported
+ */
+static const char *profile_mnemonic(uint8_t opcode)
+{
+	const char *name = nes_cpu_mnemonics[opcode];
+	return (name != NULL) ? name : "???";
+}
+
+nesemu_return_t nes_cpu_profile_reset(struct nes_cpu_profile *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self, 0, sizeof(struct nes_cpu_profile));
+	self->last = NESEMU_CPU_PROFILE_NO_OPCODE;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_profile_attach(struct nes_cpu_profile *self,
+				       struct nes_cpu *cpu)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	cpu->profile = self;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_profile_dump_csv(const struct nes_cpu_profile *self,
+					 FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	fprintf(f, "kind,key,mnemonic,count\n");
+
+	for (int i = 0; i < 256; i++) {
+		if (self->opcodes[i] != 0) {
+			fprintf(f, "opcode,%02X,%s,%llu\n", i,
+				profile_mnemonic((uint8_t)i),
+				(unsigned long long)self->opcodes[i]);
+		}
+	}
+
+	for (int i = 0; i < 256; i++) {
+		for (int j = 0; j < 256; j++) {
+			if (self->pairs[i][j] != 0) {
+				fprintf(f, "pair,%02X %02X,%s %s,%llu\n", i, j,
+					profile_mnemonic((uint8_t)i),
+					profile_mnemonic((uint8_t)j),
+					(unsigned long long)self->pairs[i][j]);
+			}
+		}
+	}
+
+	for (int pc = 0; pc < 0x10000; pc++) {
+		if (self->pcs[pc] != 0) {
+			fprintf(f, "pc,%04X,,%llu\n", pc,
+				(unsigned long long)self->pcs[pc]);
+		}
+	}
+
+	for (int i = 0; i < 256; i++) {
+		if (self->page_crosses[i] != 0) {
+			fprintf(f, "page_cross,%02X,%s,%llu\n", i,
+				profile_mnemonic((uint8_t)i),
+				(unsigned long long)self->page_crosses[i]);
+		}
+	}
+
+	return ferror(f) ? NESEMU_RETURN_GENERIC_ERROR : NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Write the non-zero counters of a table as JSON members
+ *
+ * @param digits Hexadecimal digits of the keys
+ */
+static void profile_json_object(FILE *f,
+				const char *name,
+				const uint64_t *counts,
+				size_t length,
+				int digits,
+				bool last)
+{
+	bool first = true;
+
+	fprintf(f, "  \"%s\": {", name);
+	for (size_t i = 0; i < length; i++) {
+		if (counts[i] == 0) {
+			continue;
+		}
+
+		fprintf(f, "%s\n    \"%0*zX\": %llu", first ? "" : ",", digits,
+			i, (unsigned long long)counts[i]);
+		first = false;
+	}
+	fprintf(f, "%s}%s\n", first ? "" : "\n  ", last ? "" : ",");
+}
+
+nesemu_return_t nes_cpu_profile_dump_json(const struct nes_cpu_profile *self,
+					  FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Pairs are keyed by both opcodes ("A9D0" for A9 followed by D0)
+	fprintf(f, "{\n");
+	profile_json_object(f, "opcodes", self->opcodes, 256, 2, false);
+	profile_json_object(f, "pairs", &self->pairs[0][0], 256 * 256, 4,
+			    false);
+	profile_json_object(f, "pcs", self->pcs, 0x10000, 4, false);
+	profile_json_object(f, "page_crosses", self->page_crosses, 256, 2,
+			    true);
+	fprintf(f, "}\n");
+
+	return ferror(f) ? NESEMU_RETURN_GENERIC_ERROR : NESEMU_RETURN_SUCCESS;
+}
+
+#else
+
+nesemu_return_t nes_cpu_profile_reset(struct nes_cpu_profile *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_profile_attach(struct nes_cpu_profile *self,
+				       struct nes_cpu *cpu)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cpu);
+	return NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_profile_dump_csv(const struct nes_cpu_profile *self,
+					 FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_profile_dump_json(const struct nes_cpu_profile *self,
+					  FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_PROFILE_UNSUPPORTED;
+}
+
+#endif
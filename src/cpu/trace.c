@@ -0,0 +1,483 @@
+/**
+ * This file contains definitions for functions in 'trace.h'
+ *
+ * The writer thread never blocks the CPU. It copies a chunk of records out
+ * of the ring and then re-reads the head: any copied record whose slot may
+ * have been reused meanwhile is discarded (and counted as dropped) instead
+ * of being written torn.
+ */
+
+#include "nesemu/cpu/trace.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/instructions.h"
+#include "nesemu/cpu/status.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_NESEMU_CPU_TRACE
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/**
+ * Amount of records the writer thread spills at once
+ */
+#define TRACE_CHUNK 0x1000
+
+/**
+ * Writer thread sleep while the ring is empty (nanoseconds)
+ */
+#define TRACE_IDLE_NS 1000000L
+
+/**
+ * Instruction text of a record, nestest.log style
+ *
+ * @param text Buffer of at least NESEMU_CPU_TRACE_LINE_SIZE bytes
+ */
+static void trace_disassemble(const struct nes_cpu_trace_record *record,
+			      char *text)
+{
+	const struct nes_cpu_opcode *op = &nes_cpu_opcodes[record->opcode];
+	const char *mnemonic = nes_cpu_mnemonics[record->opcode];
+	uint8_t lsb = record->operand[0], msb = record->operand[1];
+	uint16_t operand = (uint16_t)(msb << 8 | lsb);
+	size_t size = NESEMU_CPU_TRACE_LINE_SIZE;
+
+	// Unsupported opcodes only show their byte
+	if (mnemonic == NULL) {
+		snprintf(text, size, ".DB $%02X", record->opcode);
+		return;
+	}
+
+	switch (op->addressing) {
+	case NESEMU_ADDRESSING_ACCUMULATOR:
+		snprintf(text, size, "%s A", mnemonic);
+		break;
+
+	case NESEMU_ADDRESSING_IMMEDIATE:
+		snprintf(text, size, "%s #$%02X", mnemonic, lsb);
+		break;
+
+	case NESEMU_ADDRESSING_ZERO_PAGE:
+		snprintf(text, size, "%s $%02X = %02X", mnemonic, lsb,
+			 record->value);
+		break;
+
+	case NESEMU_ADDRESSING_ZERO_PAGE_X:
+		snprintf(text, size, "%s $%02X,X @ %02X = %02X", mnemonic, lsb,
+			 record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_ZERO_PAGE_Y:
+		snprintf(text, size, "%s $%02X,Y @ %02X = %02X", mnemonic, lsb,
+			 record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_ABSOLUTE:
+		// Jumps do not access their target
+		if (record->opcode == JMP_AB || record->opcode == JSR) {
+			snprintf(text, size, "%s $%04X", mnemonic, operand);
+		} else {
+			snprintf(text, size, "%s $%04X = %02X", mnemonic,
+				 operand, record->value);
+		}
+		break;
+
+	case NESEMU_ADDRESSING_ABSOLUTE_X:
+		snprintf(text, size, "%s $%04X,X @ %04X = %02X", mnemonic,
+			 operand, record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_ABSOLUTE_Y:
+		snprintf(text, size, "%s $%04X,Y @ %04X = %02X", mnemonic,
+			 operand, record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_INDIRECT:
+		snprintf(text, size, "%s ($%04X) = %04X", mnemonic, operand,
+			 record->address);
+		break;
+
+	case NESEMU_ADDRESSING_INDIRECT_X:
+		snprintf(text, size, "%s ($%02X,X) @ %02X = %04X = %02X",
+			 mnemonic, lsb, (uint8_t)(lsb + record->x),
+			 record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_INDIRECT_Y:
+		snprintf(text, size, "%s ($%02X),Y = %04X @ %04X = %02X",
+			 mnemonic, lsb, (uint16_t)(record->address - record->y),
+			 record->address, record->value);
+		break;
+
+	case NESEMU_ADDRESSING_RELATIVE:
+		// Target is relative to the next instruction
+		snprintf(text, size, "%s $%04X", mnemonic,
+			 (uint16_t)(record->pc + op->length + (int8_t)lsb));
+		break;
+
+	case NESEMU_ADDRESSING_IMPLIED:
+		snprintf(text, size, "%s", mnemonic);
+		break;
+	}
+}
+
+nesemu_return_t
+nes_cpu_trace_format(const struct nes_cpu_trace_record *record, char *line)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (record == NULL || line == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	// Instruction bytes, unsupported opcodes have no operand
+	uint8_t length = nes_cpu_opcodes[record->opcode].length;
+	char bytes[9] = "";
+	snprintf(bytes, sizeof(bytes), "%02X", record->opcode);
+	if (length > 1) {
+		snprintf(bytes + 2, sizeof(bytes) - 2, " %02X",
+			 record->operand[0]);
+	}
+	if (length > 2) {
+		snprintf(bytes + 5, sizeof(bytes) - 5, " %02X",
+			 record->operand[1]);
+	}
+
+	char text[NESEMU_CPU_TRACE_LINE_SIZE];
+	trace_disassemble(record, text);
+
+	// 3 PPU dots per CPU cycle, 341 dots per scanline, 262 per frame
+	uint64_t dots = record->cycle * 3;
+	unsigned scanline = (unsigned)((dots / 341) % 262);
+	unsigned dot = (unsigned)(dots % 341);
+
+	// Bit 5 of $status is not stored but always reads as set
+	snprintf(line, NESEMU_CPU_TRACE_LINE_SIZE,
+		 "%04X  %-8s  %-31.31s A:%02X X:%02X Y:%02X P:%02X SP:%02X "
+		 "PPU:%3u,%3u CYC:%llu",
+		 record->pc, bytes, text, record->a, record->x, record->y,
+		 record->status | NESEMU_CPU_FLAGS_1, record->sp, scanline, dot,
+		 (unsigned long long)record->cycle);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Format a single record into a file, with a line feed
+ */
+static nesemu_return_t trace_write_line(const struct nes_cpu_trace_record *r,
+					FILE *f)
+{
+	char line[NESEMU_CPU_TRACE_LINE_SIZE];
+	(void)nes_cpu_trace_format(r, line);
+
+	if (fputs(line, f) == EOF || fputc('\n', f) == EOF) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_trace_format_file(FILE *in, FILE *out)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (in == NULL || out == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	// Check the magic
+	char magic[sizeof(NESEMU_CPU_TRACE_MAGIC) - 1];
+	if (fread(magic, sizeof(magic), 1, in) != 1 ||
+	    memcmp(magic, NESEMU_CPU_TRACE_MAGIC, sizeof(magic)) != 0) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+
+	struct nes_cpu_trace_record record;
+	while (fread(&record, sizeof(record), 1, in) == 1) {
+		err = trace_write_line(&record, out);
+		_NESEMU_RETURN_IF_ERR(err);
+	}
+
+	return ferror(in) ? NESEMU_RETURN_GENERIC_ERROR : err;
+}
+
+#ifdef CONFIG_NESEMU_CPU_TRACE
+
+/**
+ * Writer thread state
+ */
+struct nes_cpu_trace_writer {
+	pthread_t thread; /**< Writer thread */
+	FILE *f; /**< Destination file */
+	atomic_bool running; /**< Cleared to stop the thread */
+	uint64_t tail; /**< Next record to spill */
+	nesemu_return_t err; /**< First write error */
+	struct nes_cpu_trace_record chunk[TRACE_CHUNK]; /**< Copied records */
+};
+
+/**
+ * Spill the records written since the last call, up to a chunk
+ *
+ * @return Amount of records consumed (spilled or dropped)
+ */
+static uint64_t trace_drain(struct nes_cpu_trace *self)
+{
+	struct nes_cpu_trace_writer *writer = self->writer;
+	uint64_t size = (uint64_t)self->mask + 1;
+	uint64_t head = atomic_load_explicit(&self->head, memory_order_acquire);
+	uint64_t start = writer->tail;
+	uint64_t tail = start;
+
+	// Fell behind a whole ring, the oldest records are gone
+	if (head - tail > size) {
+		self->dropped += head - tail - size;
+		tail = head - size;
+	}
+
+	uint64_t count = head - tail;
+	if (count > TRACE_CHUNK) {
+		count = TRACE_CHUNK;
+	}
+
+	// Copy first, the CPU keeps writing meanwhile
+	for (uint64_t i = 0; i < count; i++) {
+		writer->chunk[i] = self->records[(tail + i) & self->mask];
+	}
+
+	// Slots of records at or before 'head - size' may have been reused
+	atomic_thread_fence(memory_order_acquire);
+	head = atomic_load_explicit(&self->head, memory_order_relaxed);
+	uint64_t torn = 0;
+	if (head - tail >= size) {
+		torn = head - tail - size + 1;
+		torn = (torn > count) ? count : torn;
+		self->dropped += torn;
+	}
+
+	if (count > torn &&
+	    fwrite(&writer->chunk[torn], sizeof(struct nes_cpu_trace_record),
+		   count - torn, writer->f) != count - torn &&
+	    writer->err == NESEMU_RETURN_SUCCESS) {
+		writer->err = NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	writer->tail = tail + count;
+
+	return writer->tail - start;
+}
+
+/**
+ * Writer thread entry point
+ */
+static void *trace_writer(void *arg)
+{
+	struct nes_cpu_trace *self = (struct nes_cpu_trace *)arg;
+	struct nes_cpu_trace_writer *writer = self->writer;
+	const struct timespec idle = {.tv_sec = 0, .tv_nsec = TRACE_IDLE_NS};
+
+	for (;;) {
+		// Read before draining so nothing written before a stop is lost
+		bool running = atomic_load(&writer->running);
+
+		uint64_t consumed = trace_drain(self);
+		if (consumed == 0) {
+			if (!running) {
+				break;
+			}
+			nanosleep(&idle, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+nesemu_return_t nes_cpu_trace_init(struct nes_cpu_trace *self, size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || size == 0 || (size & (size - 1)) != 0 ||
+	    size > UINT32_MAX) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self, 0, sizeof(struct nes_cpu_trace));
+
+	self->records = (struct nes_cpu_trace_record *)calloc(
+		size, sizeof(struct nes_cpu_trace_record));
+	if (self->records == NULL) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+	self->mask = (uint32_t)(size - 1);
+	atomic_init(&self->head, 0);
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_trace_destroy(struct nes_cpu_trace *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+	if (self->writer != NULL) {
+		err = nes_cpu_trace_spill_stop(self);
+	}
+
+	free(self->records);
+	self->records = NULL;
+
+	return err;
+}
+
+nesemu_return_t nes_cpu_trace_attach(struct nes_cpu_trace *self,
+				     struct nes_cpu *cpu)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || cpu == NULL || self->records == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	cpu->trace = self;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_trace_spill_start(struct nes_cpu_trace *self,
+					  FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL || self->records == NULL ||
+	    self->writer != NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	if (fwrite(NESEMU_CPU_TRACE_MAGIC, sizeof(NESEMU_CPU_TRACE_MAGIC) - 1,
+		   1, f) != 1) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	struct nes_cpu_trace_writer *writer =
+		(struct nes_cpu_trace_writer *)malloc(
+			sizeof(struct nes_cpu_trace_writer));
+	if (writer == NULL) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	// Only records written from now on are spilled
+	writer->f = f;
+	writer->tail = atomic_load(&self->head);
+	writer->err = NESEMU_RETURN_SUCCESS;
+	atomic_init(&writer->running, true);
+	self->writer = writer;
+
+	if (pthread_create(&writer->thread, NULL, trace_writer, self) != 0) {
+		self->writer = NULL;
+		free(writer);
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_cpu_trace_spill_stop(struct nes_cpu_trace *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || self->writer == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	struct nes_cpu_trace_writer *writer = self->writer;
+
+	atomic_store(&writer->running, false);
+	if (pthread_join(writer->thread, NULL) != 0) {
+		return NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	nesemu_return_t err = writer->err;
+	if (fflush(writer->f) != 0) {
+		err = NESEMU_RETURN_GENERIC_ERROR;
+	}
+
+	self->writer = NULL;
+	free(writer);
+
+	return err;
+}
+
+nesemu_return_t nes_cpu_trace_dump(const struct nes_cpu_trace *self, FILE *f)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || f == NULL || self->records == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	uint64_t size = (uint64_t)self->mask + 1;
+	uint64_t head = atomic_load(&self->head);
+	uint64_t first = (head > size) ? head - size : 0;
+
+	for (uint64_t i = first; i < head; i++) {
+		err = trace_write_line(&self->records[i & self->mask], f);
+		_NESEMU_RETURN_IF_ERR(err);
+	}
+
+	return err;
+}
+
+#else
+
+nesemu_return_t nes_cpu_trace_init(struct nes_cpu_trace *self, size_t size)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(size);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_trace_destroy(struct nes_cpu_trace *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_trace_attach(struct nes_cpu_trace *self,
+				     struct nes_cpu *cpu)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(cpu);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_trace_spill_start(struct nes_cpu_trace *self,
+					  FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_trace_spill_stop(struct nes_cpu_trace *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+nesemu_return_t nes_cpu_trace_dump(const struct nes_cpu_trace *self, FILE *f)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(f);
+	return NESEMU_RETURN_CPU_TRACE_UNSUPPORTED;
+}
+
+#endif
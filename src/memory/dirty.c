@@ -0,0 +1,179 @@
+/**
+ * This file contains definitions for functions in 'dirty.h'
+ */
+
+#include "nesemu/memory/dirty.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/video.h"
+#include "nesemu/util/compat.h"
+#include "nesemu/util/error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+size_t nes_mem_dirty_ranges(const uint8_t *blocks,
+			    size_t size,
+			    struct nes_mem_dirty_range *ranges,
+			    size_t max)
+{
+	size_t count = 0;
+	size_t amount = NESEMU_MEMORY_DIRTY_BLOCKS(size);
+
+	for (size_t i = 0; i < amount; i++) {
+		if (!blocks[i]) {
+			continue;
+		}
+
+		// Extend the run over the dirty blocks that follow
+		size_t first = i;
+		while (i + 1 < amount && blocks[i + 1]) {
+			i++;
+		}
+
+		if (count < max) {
+			size_t begin = first << NESEMU_MEMORY_DIRTY_BLOCK_SHIFT;
+			size_t end = (i + 1) << NESEMU_MEMORY_DIRTY_BLOCK_SHIFT;
+			ranges[count].offset = (uint16_t)begin;
+			ranges[count].size =
+				(uint16_t)((end < size ? end : size) - begin);
+		}
+		count++;
+	}
+
+	return count;
+}
+
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+
+nesemu_return_t nes_mem_dirty(const struct nes_mem_main *self,
+			      enum nes_mem_dirty_region region,
+			      struct nes_mem_dirty_range *ranges,
+			      size_t max,
+			      size_t *count)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || count == NULL || (ranges == NULL && max != 0)) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+
+	switch (region) {
+	case NESEMU_MEMORY_DIRTY_RAM:
+		*count = nes_mem_dirty_ranges(self->dirty_ram,
+					      NESEMU_MEMORY_RAM_SIZE, ranges,
+					      max);
+		return NESEMU_RETURN_SUCCESS;
+	case NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM:
+		*count = nes_mem_dirty_ranges(self->dirty_cartridge,
+					      NESEMU_CARTRIDGE_RAM_SIZE, ranges,
+					      max);
+		return NESEMU_RETURN_SUCCESS;
+	default:
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+}
+
+nesemu_return_t nes_mem_dirty_clear(struct nes_mem_main *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self->dirty_ram, 0, sizeof(self->dirty_ram));
+	memset(self->dirty_cartridge, 0, sizeof(self->dirty_cartridge));
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_vram_dirty(const struct nes_mem_video *self,
+			       enum nes_mem_dirty_region region,
+			       struct nes_mem_dirty_range *ranges,
+			       size_t max,
+			       size_t *count)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL || count == NULL || (ranges == NULL && max != 0)) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+
+	switch (region) {
+	case NESEMU_MEMORY_DIRTY_PATTERN:
+		*count = nes_mem_dirty_ranges(
+			self->dirty_pattern,
+			NESEMU_CARTRIDGE_PATTERN_TABLE_ADDR, ranges, max);
+		return NESEMU_RETURN_SUCCESS;
+	case NESEMU_MEMORY_DIRTY_CIRAM:
+		*count = nes_mem_dirty_ranges(self->dirty_ciram,
+					      NESEMU_MEMORY_VRAM_CIRAM_SIZE,
+					      ranges, max);
+		return NESEMU_RETURN_SUCCESS;
+	case NESEMU_MEMORY_DIRTY_PALETTE:
+		*count = nes_mem_dirty_ranges(
+			self->dirty_palette,
+			NESEMU_MEMORY_VRAM_PALETTE_RAM_SIZE, ranges, max);
+		return NESEMU_RETURN_SUCCESS;
+	default:
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+}
+
+nesemu_return_t nes_vram_dirty_clear(struct nes_mem_video *self)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (self == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	}
+#endif
+	memset(self->dirty_pattern, 0, sizeof(self->dirty_pattern));
+	memset(self->dirty_ciram, 0, sizeof(self->dirty_ciram));
+	memset(self->dirty_palette, 0, sizeof(self->dirty_palette));
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#else
+
+nesemu_return_t nes_mem_dirty(const struct nes_mem_main *self,
+			      enum nes_mem_dirty_region region,
+			      struct nes_mem_dirty_range *ranges,
+			      size_t max,
+			      size_t *count)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(region);
+	_NESEMU_UNUSED(ranges);
+	_NESEMU_UNUSED(max);
+	_NESEMU_UNUSED(count);
+	return NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED;
+}
+
+nesemu_return_t nes_mem_dirty_clear(struct nes_mem_main *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED;
+}
+
+nesemu_return_t nes_vram_dirty(const struct nes_mem_video *self,
+			       enum nes_mem_dirty_region region,
+			       struct nes_mem_dirty_range *ranges,
+			       size_t max,
+			       size_t *count)
+{
+	_NESEMU_UNUSED(self);
+	_NESEMU_UNUSED(region);
+	_NESEMU_UNUSED(ranges);
+	_NESEMU_UNUSED(max);
+	_NESEMU_UNUSED(count);
+	return NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED;
+}
+
+nesemu_return_t nes_vram_dirty_clear(struct nes_mem_video *self)
+{
+	_NESEMU_UNUSED(self);
+	return NESEMU_RETURN_MEMORY_DIRTY_UNSUPPORTED;
+}
+
+#endif
@@ -1,8 +1,17 @@
 #include "nesemu/memory/main.h"
 
+#include "nesemu/ppu/ppu.h"
 #include "nesemu/util/error.h"
 #include "nesemu/util/bits.h"
 
+#ifdef CONFIG_NESEMU_DEBUGGER
+#include "nesemu/cpu/debug.h"
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+#include "nesemu/cpu/coverage.h"
+#endif
+
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -43,124 +52,483 @@ static inline nesemu_return_t _cartridge_write(struct nes_mem_main *mem,
 		value);
 }
 
-/* -- Public Functions -- */
+/**
+ * Work RAM and its mirrors ($0000-$1FFF), for the pages without fast path
+ */
+static nesemu_return_t _mem_read_ram(struct nes_mem_main *self,
+				     uint16_t addr,
+				     uint8_t *result)
+{
+	*result = self->ram[addr & NESEMU_MEMORY_RAM_MASK];
+	return NESEMU_RETURN_SUCCESS;
+}
 
-inline nesemu_return_t nes_mem_init(struct nes_mem_main *self,
-				    struct nes_cartridge *cartridge)
+/**
+ * See '_mem_read_ram'
+ */
+static nesemu_return_t _mem_write_ram(struct nes_mem_main *self,
+				      uint16_t addr,
+				      uint8_t data)
 {
-	memset(self, 0, sizeof(struct nes_mem_main));
-	self->cartridge = cartridge;
+	self->ram[addr & NESEMU_MEMORY_RAM_MASK] = data;
+	return NESEMU_RETURN_SUCCESS;
+}
 
+/**
+ * PPU registers ($2000-$3FFF), mirrored every 8 bytes
+ */
+static nesemu_return_t _mem_read_register(struct nes_mem_main *self,
+					  uint16_t addr,
+					  uint8_t *result)
+{
+	// The PPU applies the side effects of the access
+	if (self->ppu != NULL) {
+		return nes_ppu_register_read(self->ppu, addr, result);
+	}
+
+	*result = self->ppu_registers[addr %
+				      NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE];
 	return NESEMU_RETURN_SUCCESS;
 }
 
-nesemu_return_t nes_mem_w8(struct nes_mem_main *self,
-			   uint16_t addr,
-			   uint8_t data)
+/**
+ * See '_mem_read_register'
+ */
+static nesemu_return_t _mem_write_register(struct nes_mem_main *self,
+					   uint16_t addr,
+					   uint8_t data)
 {
-	// Cartridge address, delegate to cartridge callback
-	if (addr >= NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN) {
-		// ! Must return, the callback should handle the logic
-		return _cartridge_write(self, addr, data);
+	if (self->ppu != NULL) {
+		return nes_ppu_register_write(self->ppu, addr, data);
 	}
 
-	//! Change the address based on mirroring rules
+	self->ppu_registers[addr % NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE] =
+		data;
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * OAM DMA ($4014), copy the CPU page 'data' to OAM, the CPU is halted for
+ * NESEMU_PPU_OAMDMA_CYCLES
+ */
+static nesemu_return_t _mem_write_oamdma(struct nes_mem_main *self,
+					 uint16_t addr,
+					 uint8_t data)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+	uint16_t src = NESEMU_UTIL_U16(data, 0x00);
 
-	// RAM mirroring
-	else if ((addr >= NESEMU_MEMORY_RAM_MIRRORING_RANGE_START) &&
-		 (addr <= NESEMU_MEMORY_RAM_MIRRORING_RANGE_END)) {
-		// Address modulo with base should give the target address
-		addr = addr % NESEMU_MEMORY_RAM_MIRRORING_BASE;
+	self->io_registers[addr - NESEMU_MEMORY_RAM_IO_REG_ADDR] = data;
+	self->stall = NESEMU_PPU_OAMDMA_CYCLES;
+	if (self->ppu == NULL) {
+		return NESEMU_RETURN_SUCCESS;
 	}
 
-	// PPU mirroring
-	else if ((addr >= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_RANGE_START) &&
-		 (addr <= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_RANGE_END)) {
-		// Address modulo with base + addr should give the target address
-		addr = (addr % NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE) +
-		       NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR;
+	// Plain memory is copied in place, anything else read first
+	const uint8_t *page = self->read[NESEMU_MEMORY_PAGE(src)];
+	uint8_t buffer[NESEMU_MEMORY_PAGE_SIZE];
+	if (page == NULL) {
+		if ((err = nes_mem_read_block(self, src, buffer,
+					      sizeof(buffer))) !=
+		    NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+		page = buffer;
 	}
 
-	// Write data to target address
-	self->_data[addr] = data;
+	nes_ppu_oam_dma(self->ppu, page);
 
 	return NESEMU_RETURN_SUCCESS;
 }
 
-nesemu_return_t nes_mem_r8(struct nes_mem_main *self,
-			   uint16_t addr,
-			   uint8_t *result)
+/**
+ * Handlers of an I/O register
+ */
+struct _mem_io_register {
+	nes_mem_read_fn_t read;
+	nes_mem_write_fn_t write;
+};
+
+/**
+ * Dispatch table of the I/O registers ($4000-$401F), indexed from
+ * NESEMU_MEMORY_RAM_IO_REG_ADDR. A NULL handler keeps the value as plain
+ * memory: the APU and the controllers have no subsystem to forward to.
+ */
+static const struct _mem_io_register
+	_mem_io_registers[NESEMU_MEMORY_RAM_IO_REGISTERS] = {
+		[NESEMU_PPU_REG_OAMDMA - NESEMU_MEMORY_RAM_IO_REG_ADDR] = {
+			.read = NULL,
+			.write = _mem_write_oamdma,
+		},
+	};
+
+/**
+ * Cartridge addresses without mapped memory, a write may switch banks
+ */
+static nesemu_return_t _mem_write_cartridge(struct nes_mem_main *self,
+					    uint16_t addr,
+					    uint8_t data)
+{
+	uint32_t version = self->cartridge->prg_version;
+	nesemu_return_t err = _cartridge_write(self, addr, data);
+
+	// The mapper remapped the PRG ROM window
+	if (self->cartridge->prg_version != version) {
+		nes_mem_map(self);
+	}
+
+	return err;
+}
+
+/**
+ * I/O registers ($4000-$401F), the rest of the page is cartridge space
+ */
+static nesemu_return_t _mem_read_io(struct nes_mem_main *self,
+				    uint16_t addr,
+				    uint8_t *result)
 {
-	// Cartridge address, delegate to cartridge callback
 	if (addr >= NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN) {
-		// ! Must return, the callback should handle the logic
 		return _cartridge_read(self, addr, result);
 	}
 
-	//! Change the address based on mirroring rules
-
-	// RAM mirroring
-	else if ((addr >= NESEMU_MEMORY_RAM_MIRRORING_RANGE_START) &&
-		 (addr <= NESEMU_MEMORY_RAM_MIRRORING_RANGE_END)) {
-		// Address modulo with base should give the target address
-		addr = addr % NESEMU_MEMORY_RAM_MIRRORING_BASE;
+	nes_mem_read_fn_t read =
+		_mem_io_registers[addr - NESEMU_MEMORY_RAM_IO_REG_ADDR].read;
+	if (read != NULL) {
+		return read(self, addr, result);
 	}
 
-	// PPU mirroring
-	else if ((addr >= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_RANGE_START) &&
-		 (addr <= NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_RANGE_END)) {
-		// Address modulo with base + addr should give the target address
-		addr = (addr % NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_BASE) +
-		       NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR;
+	*result = self->io_registers[addr - NESEMU_MEMORY_RAM_IO_REG_ADDR];
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * See '_mem_read_io'
+ */
+static nesemu_return_t _mem_write_io(struct nes_mem_main *self,
+				     uint16_t addr,
+				     uint8_t data)
+{
+	if (addr >= NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN) {
+		return _mem_write_cartridge(self, addr, data);
 	}
 
-	// Read data to target address
-	*result = self->_data[addr];
+	nes_mem_write_fn_t write =
+		_mem_io_registers[addr - NESEMU_MEMORY_RAM_IO_REG_ADDR].write;
+	if (write != NULL) {
+		return write(self, addr, data);
+	}
 
+	self->io_registers[addr - NESEMU_MEMORY_RAM_IO_REG_ADDR] = data;
 	return NESEMU_RETURN_SUCCESS;
 }
 
-nesemu_return_t nes_mem_w16(struct nes_mem_main *self,
-			    uint16_t addr,
-			    uint16_t data)
+/**
+ * Memory given by the mapper at a cartridge page (NULL if none)
+ */
+static void _mem_map_cartridge(const struct nes_mem_main *self,
+			       uint16_t addr,
+			       const uint8_t **read,
+			       uint8_t **write)
 {
-	// Decompose u16 into two u8
-	uint8_t msb = (data & 0xFF00) >> 8, lsb = (data & 0x00FF);
+	struct nes_cartridge *cartridge = self->cartridge;
 
-	// Write LSB
-	nesemu_return_t err;
-	if ((err = nes_mem_w8(self, addr, lsb)) != NESEMU_RETURN_SUCCESS) {
-		return err;
+	*read = NULL;
+	*write = NULL;
+	if (cartridge == NULL || cartridge->prg_page_fn == NULL ||
+	    cartridge->prg_page_fn(
+		    NESEMU_CARTRIDGE_GET_MAPPER_GENERIC_REF(cartridge), addr,
+		    read, write) != NESEMU_RETURN_SUCCESS) {
+		*read = NULL;
+		*write = NULL;
 	}
+}
 
-	// Write next (MSB)
-	if ((err = nes_mem_w8(self, addr + 1, msb)) != NESEMU_RETURN_SUCCESS) {
-		return err;
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+/**
+ * Flag the blocks of a plain copy of 'size' bytes to 'addr'
+ */
+static void _mem_dirty_run(struct nes_mem_main *self,
+			   uint16_t addr,
+			   size_t size)
+{
+	uint32_t end = (uint32_t)addr + (uint32_t)size;
+	for (uint32_t at = addr; at < end;
+	     at = (at | (NESEMU_MEMORY_DIRTY_BLOCK_SIZE - 1)) + 1) {
+		nes_mem_dirty_mark(self, (uint16_t)at);
 	}
+}
+#endif
+
+/* -- Public Functions -- */
+
+uint8_t nes_mem_read8_slow(struct nes_mem_main *self, uint16_t addr)
+{
+	const struct nes_mem_region *region =
+		&self->regions[NESEMU_MEMORY_REGION(addr)];
+	uint8_t result = 0;
+
+	// Handler, keep its error
+	nesemu_return_t err = region->read_fn(self, addr, &result);
+	if (err < NESEMU_RETURN_SUCCESS) {
+		_NESEMU_STICKY_ERR(self->error, err);
+		return result;
+	}
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+	nes_debugger_watch(self, addr, result, NESEMU_DEBUGGER_READ);
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	nes_cpu_coverage_access(self, addr, NESEMU_CPU_COVERAGE_READ);
+#endif
+
+	return result;
+}
+
+void nes_mem_write8_slow(struct nes_mem_main *self,
+			 uint16_t addr,
+			 uint8_t data)
+{
+	const struct nes_mem_region *region =
+		&self->regions[NESEMU_MEMORY_REGION(addr)];
+
+#ifdef CONFIG_NESEMU_DEBUGGER
+	nes_debugger_watch(self, addr, data, NESEMU_DEBUGGER_WRITE);
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+	nes_cpu_coverage_access(self, addr, NESEMU_CPU_COVERAGE_WRITE);
+#endif
+
+	// Handler, keep its error
+	nesemu_return_t err = region->write_fn(self, addr, data);
+	_NESEMU_STICKY_ERR(self->error, err);
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+	// Work RAM or cartridge RAM (registers are not tracked)
+	if (err >= NESEMU_RETURN_SUCCESS) {
+		nes_mem_dirty_mark(self, addr);
+	}
+#endif
+}
+
+nesemu_return_t nes_mem_r8_slow(struct nes_mem_main *self,
+				uint16_t addr,
+				uint8_t *result)
+{
+	// The sticky slot of the caller is set aside during the access
+	nesemu_return_t sticky = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	*result = nes_mem_read8_slow(self, addr);
+
+	nesemu_return_t err = self->error;
+	self->error = sticky;
+	return err;
+}
+
+nesemu_return_t nes_mem_w8_slow(struct nes_mem_main *self,
+				uint16_t addr,
+				uint8_t data)
+{
+	// Same as 'nes_mem_r8_slow'
+	nesemu_return_t sticky = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	nes_mem_write8_slow(self, addr, data);
+
+	nesemu_return_t err = self->error;
+	self->error = sticky;
+	return err;
+}
+
+uint8_t nes_mem_peek8(const struct nes_mem_main *self, uint16_t addr)
+{
+	const uint8_t *read = self->read[NESEMU_MEMORY_PAGE(addr)];
+	uint8_t *write = NULL;
+
+	// Fast path removed by the debugger or the coverage
+	if (read == NULL) {
+		if (addr < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR) {
+			return self->ram[addr & NESEMU_MEMORY_RAM_MASK];
+		} else if (addr >= NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN) {
+			_mem_map_cartridge(self, addr & 0xFF00, &read, &write);
+		}
+	}
+
+	return read != NULL ? read[addr & 0xFF] : 0xFF;
+}
+
+inline nesemu_return_t nes_mem_init(struct nes_mem_main *self,
+				    struct nes_cartridge *cartridge)
+{
+	memset(self, 0, sizeof(struct nes_mem_main));
+	self->cartridge = cartridge;
+	nes_mem_map(self);
 
 	return NESEMU_RETURN_SUCCESS;
 }
 
-nesemu_return_t nes_mem_r16(struct nes_mem_main *self,
-			    uint16_t addr,
-			    uint16_t *result)
+void nes_mem_map(struct nes_mem_main *self)
 {
-	// Get the two placeholder bytes
-	uint8_t lsb, msb;
+	for (uint16_t i = 0; i < NESEMU_MEMORY_REGIONS; i++) {
+		struct nes_mem_region *region = &self->regions[i];
+		uint16_t addr = (uint16_t)(i << NESEMU_MEMORY_REGION_SHIFT);
+
+		// RAM and its mirrors
+		if (addr < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR) {
+			region->read_fn = _mem_read_ram;
+			region->write_fn = _mem_write_ram;
+		}
+		// PPU registers
+		else if (addr < NESEMU_MEMORY_RAM_IO_REG_ADDR) {
+			region->read_fn = _mem_read_register;
+			region->write_fn = _mem_write_register;
+		}
+		// I/O registers and the expansion area of the cartridge
+		else if (i == NESEMU_MEMORY_REGION(
+				     NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN)) {
+			region->read_fn = _mem_read_io;
+			region->write_fn = _mem_write_io;
+		}
+		// Cartridge
+		else {
+			region->read_fn = _cartridge_read;
+			region->write_fn = _mem_write_cartridge;
+		}
+	}
+
+	for (uint16_t i = 0; i < NESEMU_MEMORY_PAGES; i++) {
+		uint16_t addr = (uint16_t)(i << 8);
+
+		// RAM and its mirrors
+		if (addr < NESEMU_MEMORY_RAM_PPU_REG_MIRRORING_ADDR) {
+			self->write[i] = &self->ram[addr & NESEMU_MEMORY_RAM_MASK];
+			self->read[i] = self->write[i];
+		}
+		// Cartridge, memory of the current bank (I/O registers share
+		// the first page)
+		else if (NESEMU_MEMORY_PAGE(addr) >
+			 NESEMU_MEMORY_PAGE(NESEMU_MEMORY_RAM_CARTRIDGE_BEGIN)) {
+			_mem_map_cartridge(self, addr, &self->read[i],
+					   &self->write[i]);
+		}
+		// Registers, handlers only
+		else {
+			self->read[i] = NULL;
+			self->write[i] = NULL;
+		}
+
+		// Recorded accesses take the slow path
+#ifdef CONFIG_NESEMU_DEBUGGER
+		if (self->watch_pages[i] & NESEMU_DEBUGGER_READ) {
+			self->read[i] = NULL;
+		}
+		if (self->watch_pages[i] & NESEMU_DEBUGGER_WRITE) {
+			self->write[i] = NULL;
+		}
+#endif
+#ifdef CONFIG_NESEMU_CPU_COVERAGE
+		if (self->coverage != NULL) {
+			self->read[i] = NULL;
+			self->write[i] = NULL;
+		}
+#endif
+	}
+}
+
+nesemu_return_t nes_mem_read_block(struct nes_mem_main *self,
+				   uint16_t addr,
+				   uint8_t *buffer,
+				   size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (buffer == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (size > (size_t)0x10000 - addr) {
+		return NESEMU_RETURN_MEMORY_INVALILD_ADDR;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	// One run per page, up to the end of the page
+	for (size_t done = 0; done < size;) {
+		uint16_t at = (uint16_t)(addr + done);
+		size_t run = NESEMU_MEMORY_PAGE_SIZE - (at & 0xFF);
+		if (run > size - done) {
+			run = size - done;
+		}
+
+		// Mapped memory, plain copy
+		const uint8_t *read = self->read[NESEMU_MEMORY_PAGE(at)];
+		if (read != NULL) {
+			memcpy(&buffer[done], &read[at & 0xFF], run);
+		}
+		// Handler, byte by byte
+		else {
+			for (size_t i = 0; i < run; i++) {
+				if ((err = nes_mem_r8_slow(self, at + i,
+							   &buffer[done + i])) !=
+				    NESEMU_RETURN_SUCCESS) {
+					return err;
+				}
+			}
+		}
 
-	// Get LSB
-	nesemu_return_t err;
-	if ((err = nes_mem_r8(self, addr, &lsb)) != NESEMU_RETURN_SUCCESS) {
-		return err;
+		done += run;
 	}
 
-	// Get next (MSB)
-	if ((err = nes_mem_r8(self, addr + 1, &msb)) != NESEMU_RETURN_SUCCESS) {
-		return err;
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_mem_write_block(struct nes_mem_main *self,
+				    uint16_t addr,
+				    const uint8_t *buffer,
+				    size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (buffer == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (size > (size_t)0x10000 - addr) {
+		return NESEMU_RETURN_MEMORY_INVALILD_ADDR;
 	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
-	// Build u16 from two u8
-	*result = NESEMU_UTIL_U16(msb, lsb);
+	// One run per page, a handler may remap the pages that follow
+	for (size_t done = 0; done < size;) {
+		uint16_t at = (uint16_t)(addr + done);
+		size_t run = NESEMU_MEMORY_PAGE_SIZE - (at & 0xFF);
+		if (run > size - done) {
+			run = size - done;
+		}
+
+		// Mapped memory, plain copy
+		uint8_t *write = self->write[NESEMU_MEMORY_PAGE(at)];
+		if (write != NULL) {
+			memcpy(&write[at & 0xFF], &buffer[done], run);
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+			_mem_dirty_run(self, at, run);
+#endif
+		}
+		// Handler, byte by byte
+		else {
+			for (size_t i = 0; i < run; i++) {
+				if ((err = nes_mem_w8_slow(self, at + i,
+							   buffer[done + i])) !=
+				    NESEMU_RETURN_SUCCESS) {
+					return err;
+				}
+			}
+		}
+
+		done += run;
+	}
 
 	return NESEMU_RETURN_SUCCESS;
 }
+
+nesemu_return_t nes_mem_error(struct nes_mem_main *self)
+{
+	nesemu_return_t err = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	return err;
+}
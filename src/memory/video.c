@@ -73,6 +73,119 @@ static inline nesemu_return_t _cartridge_mapping(struct nes_mem_video *self,
 		mapped);
 }
 
+/**
+ * Contiguous memory holding `addr` and the addresses that follow it
+ *
+ * @param read Reference to where the readable memory will be stored, NULL if
+ * reads go through the cartridge callbacks (one byte at a time)
+ * @param write Same as `read`, for writes
+ * @param len Reference to where the length of the run will be stored
+ */
+static nesemu_return_t _vram_run(struct nes_mem_video *self,
+				 uint16_t addr,
+				 const uint8_t **read,
+				 uint8_t **write,
+				 size_t *len)
+{
+	nesemu_return_t status = NESEMU_RETURN_SUCCESS;
+	*read = NULL;
+	*write = NULL;
+	*len = 1;
+
+	// Palette RAM, mirrored every 32 bytes
+	if (addr >= NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
+		addr %= NESEMU_MEMORY_VRAM_PALETTE_RAM_SIZE;
+		*write = &self->palette_ram[addr];
+		*read = *write;
+		*len = NESEMU_MEMORY_VRAM_PALETTE_RAM_SIZE - addr;
+	}
+
+	// Pattern tables, memory of the page (if the cartridge maps it)
+	else if (addr < NESEMU_CARTRIDGE_PATTERN_TABLE_ADDR) {
+		uint16_t offset = addr % NESEMU_MEMORY_VRAM_PAGE_SIZE;
+		if (self->cartridge->chr_page_fn == NULL) {
+			return NESEMU_RETURN_SUCCESS;
+		}
+		if ((status = self->cartridge->chr_page_fn(
+			     NESEMU_CARTRIDGE_GET_MAPPER_GENERIC_REF(
+				     self->cartridge),
+			     addr - offset, read, write)) <
+		    NESEMU_RETURN_SUCCESS) {
+			return status;
+		}
+		*read = *read != NULL ? &(*read)[offset] : NULL;
+		*write = *write != NULL ? &(*write)[offset] : NULL;
+		*len = NESEMU_MEMORY_VRAM_PAGE_SIZE - offset;
+	}
+
+	// Nametables, mirroring is done in 1 KiB blocks
+	else {
+		uint16_t mapped = addr;
+		if ((status = _cartridge_mapping(self, addr, &mapped)) !=
+		    NESEMU_RETURN_SUCCESS) {
+			// Error, or kept by the cartridge
+			return status < NESEMU_RETURN_SUCCESS ?
+				       status :
+				       NESEMU_RETURN_SUCCESS;
+		}
+		uint16_t end = (addr | (NESEMU_MEMORY_VRAM_NAMETABLE_SIZE - 1)) + 1;
+		if (end > NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
+			end = NESEMU_MEMORY_VRAM_PALETTE_ADDR;
+		}
+		*write = &self->ciram[mapped % NESEMU_MEMORY_VRAM_CIRAM_SIZE];
+		*read = *write;
+		*len = end - addr;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+/**
+ * Flag the pattern table block of a write delegated to the cartridge
+ * (nametables kept by the cartridge are not tracked)
+ */
+static inline void _vram_dirty_pattern(struct nes_mem_video *self,
+				       uint16_t addr,
+				       nesemu_return_t status)
+{
+	if (status >= NESEMU_RETURN_SUCCESS &&
+	    addr < NESEMU_CARTRIDGE_PATTERN_TABLE_ADDR) {
+		self->dirty_pattern[addr >> NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+	}
+}
+
+/**
+ * Flag the blocks of a plain copy of 'size' bytes to 'addr', 'write' is the
+ * memory returned by '_vram_run'
+ */
+static void _vram_dirty_run(struct nes_mem_video *self,
+			    uint16_t addr,
+			    const uint8_t *write,
+			    size_t size)
+{
+	uint8_t *blocks;
+	size_t offset;
+
+	// Same regions as '_vram_run', CIRAM by its (unmirrored) offset
+	if (addr >= NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
+		blocks = self->dirty_palette;
+		offset = (size_t)(write - self->palette_ram);
+	} else if (addr < NESEMU_CARTRIDGE_PATTERN_TABLE_ADDR) {
+		blocks = self->dirty_pattern;
+		offset = addr;
+	} else {
+		blocks = self->dirty_ciram;
+		offset = (size_t)(write - self->ciram);
+	}
+
+	for (size_t at = offset; at < offset + size;
+	     at = (at | (NESEMU_MEMORY_DIRTY_BLOCK_SIZE - 1)) + 1) {
+		blocks[at >> NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+	}
+}
+#endif
+
 /* -- Public Functions -- */
 
 nesemu_return_t nes_vram_init(struct nes_mem_video *self,
@@ -84,11 +197,15 @@ nesemu_return_t nes_vram_init(struct nes_mem_video *self,
 	return NESEMU_RETURN_SUCCESS;
 }
 
-nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
-			    uint16_t addr,
-			    uint8_t data)
+void nes_vram_write8(struct nes_mem_video *self, uint16_t addr, uint8_t data)
 {
-	__CHECK_ADDRESSING(addr);
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (addr >= NESEMU_MEMORY_VRAM_ADDR_SIZE) {
+		_NESEMU_STICKY_ERR(self->error,
+				   NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+		return;
+	}
+#endif
 
 	// Internal to PPU
 	if (addr >= NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
@@ -99,27 +216,24 @@ nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
 
 		// Set the value at the Palette RAM indexes
 		self->palette_ram[addr] = data;
-
-		// Return with no errors
-		return NESEMU_RETURN_SUCCESS;
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+		self->dirty_palette[addr >> NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+#endif
+		return;
 	}
 
-	// Other addresses are mapped by the cartridge
-	nesemu_return_t status = NESEMU_RETURN_SUCCESS;
-
-    // Address mapping by cartridge into same variable
-	if ((status = _cartridge_mapping(self, addr, &addr)) < NESEMU_RETURN_SUCCESS) {
-		// Handle error
-		return status;
-	}
+	// Other addresses are mapped by the cartridge, into the same variable
+	nesemu_return_t status = _cartridge_mapping(self, addr, &addr);
 
 	/* Delegate operation to the cartridge */
-	else if (status == NESEMU_INFO_CARTRIDGE_DELEGATE_RWOP) {
-		return self->cartridge->chr_write_fn == NULL ?
-			       // This cartridge is read-only
-			       NESEMU_RETURN_CARTRIDGE_CHRROM_READ_ONLY :
-			       // Delegate logic to cartridge
-			       _cartridge_write(self, addr, data);
+	if (status == NESEMU_INFO_CARTRIDGE_DELEGATE_RWOP) {
+		// This cartridge is read-only
+		status = self->cartridge->chr_write_fn == NULL ?
+				 NESEMU_RETURN_CARTRIDGE_CHRROM_READ_ONLY :
+				 _cartridge_write(self, addr, data);
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+		_vram_dirty_pattern(self, addr, status);
+#endif
 	}
 
 	/* Do operation directly from PPU CIRAM */
@@ -127,23 +241,34 @@ nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
 		// Check that address is within range
 #ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
 		if (addr < NESEMU_MEMORY_VRAM_CIRAM_ADDR) {
-			return NESEMU_RETURN_MEMORY_VRAM_BAD_MAPPER;
+			_NESEMU_STICKY_ERR(self->error,
+					   NESEMU_RETURN_MEMORY_VRAM_BAD_MAPPER);
+			return;
 		}
 #endif
 		// Map address into index
 		addr %= NESEMU_MEMORY_VRAM_CIRAM_SIZE;
-		// Read value directly from index
+		// Write value directly at index
 		self->ciram[addr] = data;
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+		self->dirty_ciram[addr >> NESEMU_MEMORY_DIRTY_BLOCK_SHIFT] = 1;
+#endif
 	}
 
-	return status;
+	_NESEMU_STICKY_ERR(self->error, status);
 }
 
-nesemu_return_t nes_vram_r8(struct nes_mem_video *self,
-			    uint16_t addr,
-			    uint8_t *result)
+uint8_t nes_vram_read8(struct nes_mem_video *self, uint16_t addr)
 {
-	__CHECK_ADDRESSING(addr);
+	uint8_t result = 0;
+
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (addr >= NESEMU_MEMORY_VRAM_ADDR_SIZE) {
+		_NESEMU_STICKY_ERR(self->error,
+				   NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+		return result;
+	}
+#endif
 
 	// Internal to PPU
 	if (addr >= NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
@@ -153,25 +278,15 @@ nesemu_return_t nes_vram_r8(struct nes_mem_video *self,
 		addr %= NESEMU_MEMORY_VRAM_PALETTE_RAM_SIZE;
 
 		// Get the value at the Palette RAM indexes
-		*result = self->palette_ram[addr];
-
-		// Return with no errors
-		return NESEMU_RETURN_SUCCESS;
+		return self->palette_ram[addr];
 	}
 
-	// Other addresses are mapped by the cartridge
-	nesemu_return_t status = NESEMU_RETURN_SUCCESS;
-
-    // Address mapping by cartridge into the same var
-	if ((status = _cartridge_mapping(self, addr, &addr)) < NESEMU_RETURN_SUCCESS) {
-		// Handle error
-		return status;
-	}
+	// Other addresses are mapped by the cartridge, into the same variable
+	nesemu_return_t status = _cartridge_mapping(self, addr, &addr);
 
 	/* Delegate operation to the cartridge */
-	else if (status == NESEMU_INFO_CARTRIDGE_DELEGATE_RWOP) {
-		// Delegate logic to cartridge
-		return _cartridge_read(self, addr, result);
+	if (status == NESEMU_INFO_CARTRIDGE_DELEGATE_RWOP) {
+		status = _cartridge_read(self, addr, &result);
 	}
 
 	/* Do operation directly from PPU CIRAM */
@@ -179,16 +294,49 @@ nesemu_return_t nes_vram_r8(struct nes_mem_video *self,
 		// Check that address is within range
 #ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
 		if (addr < NESEMU_MEMORY_VRAM_CIRAM_ADDR) {
-			return NESEMU_RETURN_MEMORY_VRAM_BAD_MAPPER;
+			_NESEMU_STICKY_ERR(self->error,
+					   NESEMU_RETURN_MEMORY_VRAM_BAD_MAPPER);
+			return result;
 		}
 #endif
 		// Map address into index
 		addr %= NESEMU_MEMORY_VRAM_CIRAM_SIZE;
 		// Read value directly from index
-		*result = self->ciram[addr];
+		result = self->ciram[addr];
 	}
 
-	return status;
+	_NESEMU_STICKY_ERR(self->error, status);
+	return result;
+}
+
+nesemu_return_t nes_vram_w8(struct nes_mem_video *self,
+			    uint16_t addr,
+			    uint8_t data)
+{
+	// The sticky slot of the caller is set aside during the access
+	nesemu_return_t sticky = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	nes_vram_write8(self, addr, data);
+
+	nesemu_return_t err = self->error;
+	self->error = sticky;
+	return err;
+}
+
+nesemu_return_t nes_vram_r8(struct nes_mem_video *self,
+			    uint16_t addr,
+			    uint8_t *result)
+{
+	// Same as 'nes_vram_w8'
+	nesemu_return_t sticky = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	*result = nes_vram_read8(self, addr);
+
+	nesemu_return_t err = self->error;
+	self->error = sticky;
+	return err;
 }
 
 nesemu_return_t nes_vram_w16(struct nes_mem_video *self,
@@ -314,3 +462,100 @@ nesemu_return_t nes_vram_palette_read(struct nes_mem_video *self,
     return NESEMU_RETURN_SUCCESS;
 
 }
+
+nesemu_return_t nes_vram_read_block(struct nes_mem_video *self,
+				    uint16_t addr,
+				    uint8_t *buffer,
+				    size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (buffer == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (size > (size_t)NESEMU_MEMORY_VRAM_ADDR_SIZE - addr) {
+		return NESEMU_RETURN_MEMORY_INVALILD_ADDR;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	for (size_t done = 0; done < size;) {
+		uint16_t at = (uint16_t)(addr + done);
+		const uint8_t *read;
+		uint8_t *write;
+		size_t run;
+		if ((err = _vram_run(self, at, &read, &write, &run)) <
+		    NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+		if (read == NULL) {
+			run = 1;
+		} else if (run > size - done) {
+			run = size - done;
+		}
+
+		// Plain copy, or through the cartridge
+		if (read != NULL) {
+			memcpy(&buffer[done], read, run);
+		} else if ((err = nes_vram_r8(self, at, &buffer[done])) <
+			   NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+
+		done += run;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_vram_write_block(struct nes_mem_video *self,
+				     uint16_t addr,
+				     const uint8_t *buffer,
+				     size_t size)
+{
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	if (buffer == NULL) {
+		return NESEMU_RETURN_BAD_ARGUMENTS;
+	} else if (size > (size_t)NESEMU_MEMORY_VRAM_ADDR_SIZE - addr) {
+		return NESEMU_RETURN_MEMORY_INVALILD_ADDR;
+	}
+#endif
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	for (size_t done = 0; done < size;) {
+		uint16_t at = (uint16_t)(addr + done);
+		const uint8_t *read;
+		uint8_t *write;
+		size_t run;
+		if ((err = _vram_run(self, at, &read, &write, &run)) <
+		    NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+		if (write == NULL) {
+			run = 1;
+		} else if (run > size - done) {
+			run = size - done;
+		}
+
+		// Plain copy, or through the cartridge
+		if (write != NULL) {
+			memcpy(write, &buffer[done], run);
+#ifdef CONFIG_NESEMU_MEMORY_DIRTY
+			_vram_dirty_run(self, at, write, run);
+#endif
+		} else if ((err = nes_vram_w8(self, at, buffer[done])) <
+			   NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+
+		done += run;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_vram_error(struct nes_mem_video *self)
+{
+	nesemu_return_t err = self->error;
+	self->error = NESEMU_RETURN_SUCCESS;
+
+	return err;
+}
@@ -4,6 +4,7 @@
 #include "nesemu/ppu/palette.h"
 #include "nesemu/util/error.h"
 #include <stdint.h>
+#include <string.h>
 
 /**
  * Framebuffer for video output
@@ -70,21 +71,118 @@ union nes_ppu_framebuffer {
 /** Index of the post-render scanline */
 #define NESEMU_PPU_NTSC_IDLE_SCANLINE 240
 
+/** Index of the first vertical blank scanline */
+#define NESEMU_PPU_NTSC_VBLANK_START_SCANLINE 241
+
 /** Last index for the vertical blank section */
 #define NESEMU_PPU_NTSC_VBLANK_SCANLINE 260
 
 /** Index for the pre-render scanline */
 #define NESEMU_PPU_NTSC_PRERENDER_SCANLINE 261
 
+/** Amount of registers mirrored over $2000-$3FFF */
+#define NESEMU_PPU_REGISTERS 8
+
+/** Mask of the 14-bit PPU address space */
+#define NESEMU_PPU_ADDR_MASK 0x3FFF
+
+/** Offset from a palette address to the nametable under it */
+#define NESEMU_PPU_PALETTE_SHADOW_OFFSET 0x1000
+
+/* --- Private Functions --- */
+
+/**
+ * Keep PPUCTRL and its decoded copies
+ */
+static void ppu_ctrl_write(struct nes_ppu *self, uint8_t data)
+{
+	self->ctrl = data;
+
+	// Nametable select goes to t (NN)
+	self->t = (self->t & ~0x0C00) |
+		  ((data & NESEMU_PPU_PPUCTRL_BASE_NAMETABLE) << 10);
+
+	// (0 = $2000; 1 = $2400; 2 = $2800; 3 = $2C00)
+	self->nametable =
+		NESEMU_PPU_NAMETABLE_BASE_ADDR +
+		(uint16_t)(data & NESEMU_PPU_PPUCTRL_BASE_NAMETABLE) *
+			NESEMU_PPU_NAMETABLE_OFFSET;
+	self->bg_pattern = (data & NESEMU_PPU_PPUCTRL_BACKGROUND_PATTERN_TABLE) ?
+				   NESEMU_PPU_PATTERN_OFFSET :
+				   0x0000;
+	self->sprite_pattern =
+		(data & NESEMU_PPU_PPUCTRL_FOREGROUND_PATTERN_TABLE) ?
+			NESEMU_PPU_PATTERN_OFFSET :
+			0x0000;
+	self->increment = (data & NESEMU_PPU_PPUCTRL_INCREMENT) ?
+				  NESEMU_PPU_NAMETABLE_WIDTH :
+				  1;
+	self->nmi_output = (data & NESEMU_PPU_PPUCTRL_NMI) != 0;
+}
+
+/**
+ * PPUDATA read, buffered except for the palette
+ */
+static nesemu_return_t ppu_data_read(struct nes_ppu *self, uint8_t *result)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+	uint16_t addr = self->v & NESEMU_PPU_ADDR_MASK;
+	uint8_t value = 0;
+
+	if (addr >= NESEMU_MEMORY_VRAM_PALETTE_ADDR) {
+		// Palette is returned right away, the buffer gets the nametable
+		// byte under it
+		if ((err = nes_vram_r8(self->vim, addr, result)) <
+			    NESEMU_RETURN_SUCCESS ||
+		    (err = nes_vram_r8(self->vim,
+				       addr - NESEMU_PPU_PALETTE_SHADOW_OFFSET,
+				       &value)) < NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+	} else {
+		// Previous read is returned, this one is buffered
+		if ((err = nes_vram_r8(self->vim, addr, &value)) <
+		    NESEMU_RETURN_SUCCESS) {
+			return err;
+		}
+		*result = self->data_buffer;
+	}
+
+	self->data_buffer = value;
+	self->v = self->v + self->increment;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * PPUDATA write
+ */
+static nesemu_return_t ppu_data_write(struct nes_ppu *self, uint8_t data)
+{
+	nesemu_return_t err =
+		nes_vram_w8(self->vim, self->v & NESEMU_PPU_ADDR_MASK, data);
+
+	// Writes to CHR ROM are ignored by the hardware
+	if (err < NESEMU_RETURN_SUCCESS &&
+	    err != NESEMU_RETURN_CARTRIDGE_CHRROM_READ_ONLY) {
+		return err;
+	}
+
+	self->v = self->v + self->increment;
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
 /* --- Function Definition --- */
 nesemu_return_t nes_ppu_init(struct nes_ppu *self,
 			     nes_ppu_system_palette_t *system_palette,
-			     struct nes_mem_main *mem)
+			     struct nes_mem_main *mem,
+			     struct nes_mem_video *vim)
 {
 	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
 
 #ifndef NESEMU_DISABLE_SAFETY_CHECKS
-	if (mem == NULL) {
+	if (mem == NULL || vim == NULL) {
 		return NESEMU_RETURN_BAD_ARGUMENTS;
 	}
 	if (system_palette == NULL) {
@@ -97,10 +195,130 @@ nesemu_return_t nes_ppu_init(struct nes_ppu *self,
 
 	// Start with the pre-render scanline (scanline -1)
 	self->scanline = NESEMU_PPU_NTSC_PRERENDER_SCANLINE;
+	self->nmi = false;
+
+	// Registers at power up
+	self->vim = vim;
+	self->mask = 0;
+	self->status = 0;
+	self->oam_addr = 0;
+	self->data_buffer = 0;
+	self->latch = 0;
+	self->v = 0;
+	self->t = 0;
+	self->x = 0;
+	self->w = 0;
+	ppu_ctrl_write(self, 0);
+
+	// CPU accesses to $2000-$3FFF land here from now on
+	mem->ppu = self;
 
 	return err;
 }
 
+nesemu_return_t nes_ppu_register_read(struct nes_ppu *self,
+				      uint16_t addr,
+				      uint8_t *result)
+{
+	switch (NESEMU_PPU_REG_PPUCTRL + addr % NESEMU_PPU_REGISTERS) {
+	case NESEMU_PPU_REG_PPUSTATUS:
+		// Flags over the open bus, reading ends VBlank and resets w
+		*result = (self->status & NESEMU_PPU_PPUSTATUS_FLAGS) |
+			  (self->latch & ~NESEMU_PPU_PPUSTATUS_FLAGS);
+		self->status &= ~NESEMU_PPU_PPUSTATUS_VBLANK;
+		self->w = 0;
+		break;
+
+	case NESEMU_PPU_REG_OAMDATA:
+		*result = ((uint8_t *)self->oam)[self->oam_addr];
+		break;
+
+	case NESEMU_PPU_REG_PPUDATA:
+		return ppu_data_read(self, result);
+
+	default:
+		// Write-only register
+		*result = self->latch;
+		break;
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+nesemu_return_t nes_ppu_register_write(struct nes_ppu *self,
+				       uint16_t addr,
+				       uint8_t data)
+{
+	self->latch = data;
+
+	switch (NESEMU_PPU_REG_PPUCTRL + addr % NESEMU_PPU_REGISTERS) {
+	case NESEMU_PPU_REG_PPUCTRL:
+		ppu_ctrl_write(self, data);
+		break;
+
+	case NESEMU_PPU_REG_PPUMASK:
+		self->mask = data;
+		break;
+
+	case NESEMU_PPU_REG_PPUSTATUS:
+		// Read-only
+		break;
+
+	case NESEMU_PPU_REG_OAMADDR:
+		self->oam_addr = data;
+		break;
+
+	case NESEMU_PPU_REG_OAMDATA:
+		((uint8_t *)self->oam)[self->oam_addr++] = data;
+		break;
+
+	case NESEMU_PPU_REG_PPUSCROLL:
+		if (self->w == 0) {
+			// X scroll: coarse to t (XXXXX), fine to x
+			self->t = (self->t & ~0x001F) | (data >> 3);
+			self->x = data & 0x07;
+		} else {
+			// Y scroll: fine (yyy) and coarse (YYYYY) to t
+			self->t = (self->t & ~0x73E0) |
+				  ((uint16_t)(data & 0x07) << 12) |
+				  ((uint16_t)(data >> 3) << 5);
+		}
+		self->w = !self->w;
+		break;
+
+	case NESEMU_PPU_REG_PPUADDR:
+		if (self->w == 0) {
+			// High byte (6 bits), bit 14 is cleared
+			self->t = (self->t & 0x00FF) |
+				  ((uint16_t)(data & 0x3F) << 8);
+		} else {
+			// Low byte, then t goes to v
+			self->t = (self->t & 0x7F00) | data;
+			self->v = self->t;
+		}
+		self->w = !self->w;
+		break;
+
+	case NESEMU_PPU_REG_PPUDATA:
+		return ppu_data_write(self, data);
+	}
+
+	return NESEMU_RETURN_SUCCESS;
+}
+
+void nes_ppu_oam_dma(struct nes_ppu *self, const uint8_t *data)
+{
+	uint8_t *oam = (uint8_t *)self->oam;
+	size_t head = sizeof(self->oam) - self->oam_addr;
+
+	// From OAMADDR to the end, then the start of OAM
+	memcpy(&oam[self->oam_addr], data, head);
+	memcpy(oam, &data[head], self->oam_addr);
+
+	// Last byte written to OAMDATA
+	self->latch = data[sizeof(self->oam) - 1];
+}
+
 nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 			       nes_display_t *display,
 			       struct nes_mem_main *mem,
@@ -112,19 +330,10 @@ nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 	// Set number of cycles operation took
 	*cycles = NESEMU_PPU_NTSC_DOTS_PER_SCANLINE;
 
-	// Read PPUCTRL
-	uint8_t ppuctrl;
-	if ((err = nes_mem_r8(mem, NESEMU_PPU_REG_PPUCTRL, &ppuctrl)) <
-	    NESEMU_RETURN_SUCCESS) {
-		return err;
-	}
+	(void)mem;
 
-	// Compute base nametable addr based on PPUCTRL first 2 bytes
-	// (0 = $2000; 1 = $2400; 2 = $2800; 3 = $2C00)
-	uint16_t ntaddr =
-		NESEMU_PPU_NAMETABLE_BASE_ADDR +
-		(uint16_t)(ppuctrl & NESEMU_PPU_PPUCTRL_BASE_NAMETABLE) *
-			NESEMU_PPU_NAMETABLE_OFFSET;
+	// Base nametable addr, decoded when PPUCTRL was written
+	uint16_t ntaddr = self->nametable;
 
 	// Base attribute table address
 	uint16_t ataddr = ntaddr + NESEMU_PPU_ATTRTABLE_OFFSET;
@@ -156,11 +365,15 @@ nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 				int tileidx = ycoarse * NESEMU_PPU_NAMETABLE_WIDTH + xcoarse;
 				uint16_t taddr = ntaddr + tileidx;
 				// Buffer for tile data
+#ifdef CONFIG_NESEMU_TRUSTED
+				uint8_t tilebuff = nes_vram_read8(vim, taddr);
+#else
 				uint8_t tilebuff = 0;
 				if ((err = nes_vram_r8(vim, taddr, &tilebuff)) <
 				    NESEMU_RETURN_SUCCESS) {
 					return err;
 				}
+#endif
 
 				// Get attribute table idx for tile
 				// Each attribute byte covers a 4x4 tile block
@@ -170,10 +383,14 @@ nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 
                 // Attribute data is a byte with 4 quadrants
 				uint16_t attraddr = (ataddr + attridx);
+#ifdef CONFIG_NESEMU_TRUSTED
+				uint8_t attrbuff = nes_vram_read8(vim, attraddr);
+#else
 				uint8_t attrbuff = 0;
 				if ((err = nes_vram_r8(vim, attraddr, &attrbuff)) < NESEMU_RETURN_SUCCESS) {
 					return err;
 				}
+#endif
 
                 // Each quadrant has an index to the palette to be used
                 uint8_t quadx = (xcoarse % NESEMU_PPU_TILES_PER_ATTR) / NESEMU_PPU_TILES_PER_QUAD;
@@ -188,9 +405,7 @@ nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 				}
 
 				// Get pattern table base addr offset ($0000 or $1000)
-				uint16_t bpttraddr = ((ppuctrl & NESEMU_PPU_PPUCTRL_BACKGROUND_PATTERN_TABLE) == 0)
-                        ? 0x0000
-                        : NESEMU_PPU_PATTERN_OFFSET;
+				uint16_t bpttraddr = self->bg_pattern;
 
 				// Get background pattern
 				uint16_t pttraddr = bpttraddr + NESEMU_MEMORY_VRAM_PATTERN_SIZE * tilebuff;
@@ -226,9 +441,16 @@ nesemu_return_t nes_ppu_render(struct nes_ppu *self,
 	}
 	/* VBlank */
 	else if (self->scanline <= NESEMU_PPU_NTSC_VBLANK_SCANLINE) {
+		if (self->scanline == NESEMU_PPU_NTSC_VBLANK_START_SCANLINE) {
+			// Raise the VBlank flag and request the NMI
+			self->status |= NESEMU_PPU_PPUSTATUS_VBLANK;
+			self->nmi = self->nmi_output;
+		}
 	}
 	/* Pre-render */
 	else if (self->scanline == NESEMU_PPU_NTSC_PRERENDER_SCANLINE) {
+		// End of VBlank
+		self->status &= ~NESEMU_PPU_PPUSTATUS_VBLANK;
 	}
 
 	// Next scanline on rasterline completion, else keep same scanline
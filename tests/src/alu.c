@@ -0,0 +1,166 @@
+/**
+ * Precomputed ALU tables: every entry against the computing handlers
+ *
+ * The tables are built into this test ('src/cpu/alu.c' with
+ * CONFIG_NESEMU_CPU_ALU_TABLES), the handlers of 'nesemu_tests' compute
+ * every flag.
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/alu.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/status.h"
+#include "nesemu/memory/main.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Where the instruction under test is stored
+ */
+#define ALU_PC 0x0200
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+
+/**
+ * Run a single instruction (immediate or accumulator addressing) from RAM
+ */
+static int alu_exec(uint8_t opcode,
+		    uint8_t operand,
+		    uint8_t reg,
+		    uint8_t status)
+{
+	mem.ram[ALU_PC] = opcode;
+	mem.ram[ALU_PC + 1] = operand;
+
+	cpu.pc = ALU_PC;
+	cpu.a = reg;
+	cpu.x = reg;
+	cpu.y = reg;
+	cpu.status = status;
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_next(&cpu, &mem, &cycles));
+	nes_cpu_status_sync(&cpu);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * $status before the instruction, with the carry in 'c'
+ */
+static uint8_t alu_status(uint8_t c)
+{
+	return (uint8_t)(NESEMU_CPU_FLAGS_I | (c ? NESEMU_CPU_FLAGS_C : 0));
+}
+
+static int test_arithmetic(void)
+{
+	for (uint32_t i = 0; i < 2 * 256 * 256; i++) {
+		uint8_t c = (uint8_t)(i >> 16);
+		uint8_t a = (uint8_t)(i >> 8);
+		uint8_t m = (uint8_t)i;
+		uint8_t status = alu_status(c);
+		uint8_t kept = status &
+			       (uint8_t)~(NESEMU_CPU_FLAGS_C | NESEMU_CPU_FLAGS_V);
+		const struct nes_cpu_alu_entry *entry = NULL;
+
+		// ADC #m
+		TEST_ASSERT(alu_exec(0x69, m, a, status) == EXIT_SUCCESS);
+		entry = &nes_cpu_alu_adc[NESEMU_CPU_ALU_INDEX(c, a, m)];
+		TEST_ASSERT(cpu.a == entry->result);
+		TEST_ASSERT(cpu.status == (kept | entry->flags));
+
+		// SBC #m
+		TEST_ASSERT(alu_exec(0xE9, m, a, status) == EXIT_SUCCESS);
+		entry = &nes_cpu_alu_sbc[NESEMU_CPU_ALU_INDEX(c, a, m)];
+		TEST_ASSERT(cpu.a == entry->result);
+		TEST_ASSERT(cpu.status == (kept | entry->flags));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int test_compare(void)
+{
+	// CMP, CPX and CPY #m
+	static const uint8_t opcodes[] = { 0xC9, 0xE0, 0xC0 };
+
+	for (uint32_t i = 0; i < 2 * 256 * 256; i++) {
+		uint8_t c = (uint8_t)(i >> 16);
+		uint8_t reg = (uint8_t)(i >> 8);
+		uint8_t m = (uint8_t)i;
+		uint8_t status = alu_status(c);
+		uint8_t flags = nes_cpu_alu_cmp[NESEMU_CPU_ALU_INDEX(0, reg, m)];
+
+		for (size_t j = 0; j < sizeof(opcodes); j++) {
+			TEST_ASSERT(alu_exec(opcodes[j], m, reg, status) ==
+				    EXIT_SUCCESS);
+			TEST_ASSERT(cpu.a == reg && cpu.x == reg &&
+				    cpu.y == reg);
+			TEST_ASSERT(cpu.status == (status | flags));
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int test_shift(void)
+{
+	// ASL, LSR, ROL and ROR A, same order as 'enum nes_cpu_alu_shift'
+	static const uint8_t opcodes[NESEMU_CPU_ALU_SHIFT_COUNT] = {
+		0x0A, 0x4A, 0x2A, 0x6A
+	};
+
+	for (uint32_t i = 0; i < 2 * 256; i++) {
+		uint8_t c = (uint8_t)(i >> 8);
+		uint8_t a = (uint8_t)i;
+		uint8_t status = alu_status(c);
+		uint8_t kept = status & (uint8_t)~NESEMU_CPU_FLAGS_C;
+
+		for (int op = 0; op < NESEMU_CPU_ALU_SHIFT_COUNT; op++) {
+			const struct nes_cpu_alu_entry *entry =
+				&nes_cpu_alu_shift[op][a];
+			TEST_ASSERT(alu_exec(opcodes[op], 0x00, a, status) ==
+				    EXIT_SUCCESS);
+			TEST_ASSERT(cpu.a == entry->result);
+			TEST_ASSERT(cpu.status == (kept | entry->flags));
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int test_init_once(void)
+{
+	// Already filled by 'nes_cpu_init', later calls keep the tables
+	struct nes_cpu_alu_entry adc = nes_cpu_alu_adc[0x1FFFF];
+	TEST_OK(nes_cpu_alu_init());
+	TEST_ASSERT(nes_cpu_alu_adc[0x1FFFF].result == adc.result);
+	TEST_ASSERT(nes_cpu_alu_adc[0x1FFFF].flags == adc.flags);
+
+	// $ff + $ff + 1
+	TEST_ASSERT(adc.result == 0xFF);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (test_setup(&cartridge, &mem, &cpu) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	TEST_RUN(result, test_init_once);
+	TEST_RUN(result, test_arithmetic);
+	TEST_RUN(result, test_compare);
+	TEST_RUN(result, test_shift);
+
+	return result;
+}
@@ -0,0 +1,157 @@
+/**
+ * Static analysis: cold and warm loads of nestest through a cache directory,
+ * cache files with a wrong hash, version or size are analysed again and
+ * replaced
+ */
+
+#include "test.h"
+
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/cpu/analysis.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_cpu_analysis analysis;
+
+/**
+ * Result of the cold load, every later load must match it
+ */
+static struct nes_cpu_analysis_map reference;
+
+static char dir[] = "/tmp/nesemu-analysis-XXXXXX";
+static char path[256];
+
+/**
+ * Load the analysis and compare it with the reference
+ *
+ * @param mapped Whether the cache file is expected to be used
+ */
+static int analysis_check(bool mapped)
+{
+	TEST_OK(nes_cpu_analysis_load(&analysis, &cartridge, dir));
+	TEST_ASSERT(analysis.map != NULL);
+	TEST_ASSERT(analysis.mapped == mapped);
+	TEST_ASSERT(memcmp(analysis.map, &reference, sizeof(reference)) == 0);
+	TEST_OK(nes_cpu_analysis_destroy(&analysis));
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Overwrite a field of the cache file
+ */
+static int analysis_patch(size_t offset, const void *data, size_t size)
+{
+	FILE *f = fopen(path, "r+b");
+	TEST_ASSERT(f != NULL);
+	bool written = fseek(f, (long)offset, SEEK_SET) == 0 &&
+		       fwrite(data, size, 1, f) == 1;
+	TEST_ASSERT(fclose(f) == 0 && written);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_cold(void)
+{
+	// Without a directory, every load analyses
+	TEST_OK(nes_cpu_analysis_load(&analysis, &cartridge, NULL));
+	TEST_ASSERT(!analysis.mapped);
+	memcpy(&reference, analysis.map, sizeof(reference));
+	TEST_OK(nes_cpu_analysis_destroy(&analysis));
+
+	TEST_ASSERT(memcmp(reference.magic, NESEMU_CPU_ANALYSIS_MAGIC,
+			   sizeof(reference.magic)) == 0);
+	TEST_ASSERT(reference.version == NESEMU_CPU_ANALYSIS_VERSION);
+	TEST_ASSERT(reference.size == sizeof(reference));
+	TEST_ASSERT(reference.instructions > 0 && reference.blocks > 0);
+
+	// Reset handler of nestest
+	TEST_ASSERT(reference.flags[0xC004 - NESEMU_CPU_ANALYSIS_BEGIN] &
+		    NESEMU_CPU_ANALYSIS_VECTOR);
+
+	// First load through the directory writes the cache file
+	int len = snprintf(path, sizeof(path),
+			   "%s/%016llx" NESEMU_CPU_ANALYSIS_EXTENSION, dir,
+			   (unsigned long long)reference.hash);
+	TEST_ASSERT(len > 0 && (size_t)len < sizeof(path));
+	TEST_ASSERT(access(path, F_OK) != 0);
+	TEST_ASSERT(analysis_check(false) == EXIT_SUCCESS);
+	TEST_ASSERT(access(path, R_OK) == 0);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_warm(void)
+{
+	TEST_ASSERT(analysis_check(true) == EXIT_SUCCESS);
+	return analysis_check(true);
+}
+
+static int test_wrong_hash(void)
+{
+	uint64_t hash = reference.hash ^ 1;
+	TEST_ASSERT(analysis_patch(offsetof(struct nes_cpu_analysis_map, hash),
+				   &hash, sizeof(hash)) == EXIT_SUCCESS);
+
+	// Analysed again and replaced
+	TEST_ASSERT(analysis_check(false) == EXIT_SUCCESS);
+	return analysis_check(true);
+}
+
+static int test_wrong_version(void)
+{
+	uint32_t version = NESEMU_CPU_ANALYSIS_VERSION + 1;
+	TEST_ASSERT(analysis_patch(offsetof(struct nes_cpu_analysis_map,
+					    version),
+				   &version, sizeof(version)) == EXIT_SUCCESS);
+
+	TEST_ASSERT(analysis_check(false) == EXIT_SUCCESS);
+	return analysis_check(true);
+}
+
+static int test_wrong_size(void)
+{
+	// Truncated file
+	TEST_ASSERT(truncate(path, sizeof(reference) / 2) == 0);
+	TEST_ASSERT(analysis_check(false) == EXIT_SUCCESS);
+	TEST_ASSERT(analysis_check(true) == EXIT_SUCCESS);
+
+	// Right file size, wrong size field
+	uint32_t size = (uint32_t)sizeof(reference) - 1;
+	TEST_ASSERT(analysis_patch(offsetof(struct nes_cpu_analysis_map, size),
+				   &size, sizeof(size)) == EXIT_SUCCESS);
+	TEST_ASSERT(analysis_check(false) == EXIT_SUCCESS);
+	return analysis_check(true);
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (test_load(&cartridge) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+	if (mkdtemp(dir) == NULL) {
+		perror("cannot create the cache directory");
+		return EXIT_FAILURE;
+	}
+
+	TEST_RUN(result, test_cold);
+	TEST_RUN(result, test_warm);
+	TEST_RUN(result, test_wrong_hash);
+	TEST_RUN(result, test_wrong_version);
+	TEST_RUN(result, test_wrong_size);
+
+	(void)unlink(path);
+	(void)rmdir(dir);
+
+	return result;
+}
@@ -0,0 +1,405 @@
+/**
+ * Measure CPU instruction throughput by running Kevin Horton's "nestest" ROM
+ * repeatedly in headless mode.
+ *
+ * Usage: BenchCpu [iterations]
+ *
+ * Reference:
+ * https://www.qmtpro.com/~nes/misc/nestest.txt
+ */
+
+#include "nesemu/util/error.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/jit.h"
+#include "nesemu/cpu/profile.h"
+#include "nesemu/cpu/trace.h"
+#include "nesemu/cartridge/cartridge.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CARTRIDGE_NAME "nestest.nes"
+
+/**
+ * Initial $pc address for the headless CPU test
+ */
+#define START_PC 0xC000
+
+/**
+ * Default amount of times the ROM is executed
+ */
+#define DEFAULT_ITERATIONS 1000
+
+/**
+ * Read cartridge from FS into cdata
+ *
+ * @note cdata contents are allocated with 'malloc'
+ */
+int read_cartridge(uint8_t **cdata, size_t *len);
+
+/**
+ * Initialize the hardware and set the nestest headless entry point
+ */
+nesemu_return_t setup(struct nes_cartridge *cartridge,
+		      struct nes_mem_main *mem,
+		      struct nes_cpu *cpu,
+		      uint8_t *cdata,
+		      size_t clen);
+
+/**
+ * Run the ROM 'iterations' times calling 'nes_cpu_next' per instruction
+ */
+int bench_next(uint8_t *cdata,
+	       size_t clen,
+	       long int iterations,
+	       long int *instructions,
+	       long int *cycles,
+	       double *elapsed);
+
+/**
+ * Run the ROM 'iterations' times with a single 'nes_cpu_run' call each
+ *
+ * @param cache Decode cache shared by every iteration (NULL to disable)
+ * @param blocks Block cache shared by every iteration (NULL to disable)
+ * @param jit Block recompiler shared by every iteration (NULL to disable)
+ */
+int bench_run(uint8_t *cdata,
+	      size_t clen,
+	      long int iterations,
+	      struct nes_cpu_cache *cache,
+	      struct nes_cpu_block_cache *blocks,
+	      struct nes_cpu_jit *jit,
+	      long int *cycles,
+	      double *elapsed);
+
+/**
+ * Decode and block caches and recompiler, too large for the stack
+ */
+static struct nes_cpu_cache cache;
+static struct nes_cpu_block_cache blocks;
+static struct nes_cpu_jit jit;
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+static struct nes_cpu_profile profile;
+#endif
+#ifdef CONFIG_NESEMU_CPU_TRACE
+static struct nes_cpu_trace trace;
+#endif
+
+/* Entry point */
+
+int main(int argc, char *argv[])
+{
+	// Amount of iterations
+	long int iterations = (argc > 1) ? atol(argv[1]) : DEFAULT_ITERATIONS;
+	if (iterations <= 0) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Load cdata
+	size_t clen = 0;
+	uint8_t *cdata = NULL;
+	if (read_cartridge(&cdata, &clen) != EXIT_SUCCESS) {
+		perror("nesemu cartridge read failed with system error");
+		return EXIT_FAILURE;
+	}
+
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	(void)nes_cpu_profile_reset(&profile);
+#endif
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	if (nes_cpu_trace_init(&trace, NESEMU_CPU_TRACE_SIZE) !=
+	    NESEMU_RETURN_SUCCESS) {
+		free(cdata);
+		return EXIT_FAILURE;
+	}
+#endif
+
+	// Benchmark stepping one instruction at a time and batched execution
+	long int tcycles = 0, tinstructions = 0, rcycles = 0, ccycles = 0,
+		 bcycles = 0, jcycles = 0, vcycles = 0;
+	double elapsed = 0.0, relapsed = 0.0, celapsed = 0.0, belapsed = 0.0,
+	       jelapsed = 0.0, velapsed = 0.0;
+
+	if (bench_next(cdata, clen, iterations, &tinstructions, &tcycles,
+		       &elapsed) != EXIT_SUCCESS ||
+	    bench_run(cdata, clen, iterations, NULL, NULL, NULL, &rcycles,
+		      &relapsed) != EXIT_SUCCESS ||
+	    bench_run(cdata, clen, iterations, &cache, NULL, NULL, &ccycles,
+		      &celapsed) != EXIT_SUCCESS ||
+	    bench_run(cdata, clen, iterations, NULL, &blocks, NULL, &bcycles,
+		      &belapsed) != EXIT_SUCCESS) {
+		free(cdata);
+		return EXIT_FAILURE;
+	}
+
+	// Recompiler (only on supported hosts), checked against the interpreter
+	nesemu_return_t err = nes_cpu_jit_init(&jit, NESEMU_CPU_JIT_BUFFER_SIZE);
+	bool has_jit = (err == NESEMU_RETURN_SUCCESS);
+	if (has_jit) {
+		int result = EXIT_SUCCESS;
+
+		jit.differential = true;
+		result = bench_run(cdata, clen, 1, NULL, &blocks, &jit,
+				   &vcycles, &velapsed);
+		jit.differential = false;
+
+		if (result == EXIT_SUCCESS) {
+			result = bench_run(cdata, clen, iterations, NULL,
+					   &blocks, &jit, &jcycles, &jelapsed);
+		}
+
+		(void)nes_cpu_jit_destroy(&jit);
+		if (result != EXIT_SUCCESS) {
+			free(cdata);
+			return EXIT_FAILURE;
+		}
+	} else if (err != NESEMU_RETURN_CPU_JIT_UNSUPPORTED) {
+		fprintf(stderr, "nesemu JIT initialization failed (0x%x)\n",
+			err);
+		free(cdata);
+		return EXIT_FAILURE;
+	}
+
+	// Deallocate file data
+	free(cdata);
+	cdata = NULL;
+
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	FILE *f = fopen("profile.csv", "w");
+	if (f == NULL || nes_cpu_profile_dump_csv(&profile, f) !=
+				 NESEMU_RETURN_SUCCESS) {
+		perror("nesemu profile dump failed with system error");
+	}
+	if (f != NULL) {
+		fclose(f);
+	}
+#endif
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	FILE *t = fopen("trace.log", "w");
+	if (t == NULL || nes_cpu_trace_dump(&trace, t) != NESEMU_RETURN_SUCCESS) {
+		perror("nesemu trace dump failed with system error");
+	}
+	if (t != NULL) {
+		fclose(t);
+	}
+	(void)nes_cpu_trace_destroy(&trace);
+#endif
+
+	printf("Iterations=%ld, Instructions=%ld, Cycles=%ld\n", iterations,
+	       tinstructions, tcycles);
+	printf("nes_cpu_next: %.3fs, %.2f Minstructions/s, %.2f MHz\n", elapsed,
+	       (double)tinstructions / elapsed / 1e6,
+	       (double)tcycles / elapsed / 1e6);
+	printf("nes_cpu_run: %.3fs, %.2f MHz\n", relapsed,
+	       (double)rcycles / relapsed / 1e6);
+	printf("nes_cpu_run (decode cache): %.3fs, %.2f MHz\n", celapsed,
+	       (double)ccycles / celapsed / 1e6);
+	printf("nes_cpu_run (block cache): %.3fs, %.2f MHz\n", belapsed,
+	       (double)bcycles / belapsed / 1e6);
+	if (has_jit) {
+		printf("nes_cpu_run (JIT): %.3fs, %.2f MHz\n", jelapsed,
+		       (double)jcycles / jelapsed / 1e6);
+	} else {
+		printf("nes_cpu_run (JIT): unsupported\n");
+	}
+
+	// Every execution path must agree
+	if (rcycles != tcycles || ccycles != tcycles || bcycles != tcycles ||
+	    (has_jit && (jcycles != tcycles ||
+			 vcycles * iterations != tcycles))) {
+		fprintf(stderr,
+			"nesemu cycle count mismatch (%ld, %ld, %ld, %ld, %ld)\n",
+			tcycles, rcycles, ccycles, bcycles, jcycles);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+nesemu_return_t setup(struct nes_cartridge *cartridge,
+		      struct nes_mem_main *mem,
+		      struct nes_cpu *cpu,
+		      uint8_t *cdata,
+		      size_t clen)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	if ((err = nes_cartridge_read_ines(cartridge, cdata, clen)) !=
+		    NESEMU_RETURN_SUCCESS ||
+	    (err = nes_mem_init(mem, cartridge)) != NESEMU_RETURN_SUCCESS ||
+	    (err = nes_cpu_init(cpu, mem)) != NESEMU_RETURN_SUCCESS) {
+		fprintf(stderr,
+			"nesemu initialization failed with code (0x%x)\n", err);
+		return err;
+	}
+
+	// Set program counter
+	cpu->pc = START_PC;
+
+#ifdef CONFIG_NESEMU_CPU_PROFILE
+	// Counters accumulate over every iteration and execution path
+	err = nes_cpu_profile_attach(&profile, cpu);
+#endif
+#ifdef CONFIG_NESEMU_CPU_TRACE
+	// The ring keeps the latest instructions of every iteration
+	err = nes_cpu_trace_attach(&trace, cpu);
+#endif
+
+	return err;
+}
+
+int bench_next(uint8_t *cdata,
+	       size_t clen,
+	       long int iterations,
+	       long int *instructions,
+	       long int *cycles,
+	       double *elapsed)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	struct nes_cartridge cartridge;
+	struct nes_mem_main mem;
+	struct nes_cpu cpu;
+
+	for (long int i = 0; i < iterations; i++) {
+		// Initialize the hardware (not measured)
+		if (setup(&cartridge, &mem, &cpu, cdata, clen) !=
+		    NESEMU_RETURN_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+
+		clock_t start = clock();
+
+		// Execute until the ROM stops
+		while (!cpu.stop) {
+			int cpu_cycles = 0;
+			err = nes_cpu_next(&cpu, &mem, &cpu_cycles);
+			if (err != NESEMU_RETURN_SUCCESS) {
+				break;
+			}
+
+			*cycles += cpu_cycles;
+			*instructions += 1;
+		}
+
+		*elapsed += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		if (err != NESEMU_RETURN_SUCCESS) {
+			fprintf(stderr,
+				"nesemu CPU execution failed with error code (0x%x)\n",
+				err);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int bench_run(uint8_t *cdata,
+	      size_t clen,
+	      long int iterations,
+	      struct nes_cpu_cache *cache,
+	      struct nes_cpu_block_cache *blocks,
+	      struct nes_cpu_jit *jit,
+	      long int *cycles,
+	      double *elapsed)
+{
+	nesemu_return_t err = NESEMU_RETURN_SUCCESS;
+
+	struct nes_cartridge cartridge;
+	struct nes_mem_main mem;
+	struct nes_cpu cpu;
+
+	for (long int i = 0; i < iterations; i++) {
+		// Initialize the hardware (not measured)
+		if (setup(&cartridge, &mem, &cpu, cdata, clen) !=
+		    NESEMU_RETURN_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+
+		// Keep decoded instructions across iterations
+		if (cache != NULL) {
+			if (i == 0 && nes_cpu_cache_init(cache, &mem) !=
+					      NESEMU_RETURN_SUCCESS) {
+				return EXIT_FAILURE;
+			}
+			nes_cpu_cache_attach(cache, &cpu);
+		}
+		if (blocks != NULL) {
+			if (i == 0 && nes_cpu_block_cache_init(blocks, &mem) !=
+					      NESEMU_RETURN_SUCCESS) {
+				return EXIT_FAILURE;
+			}
+			nes_cpu_block_cache_attach(blocks, &cpu);
+		}
+		if (jit != NULL) {
+			nes_cpu_jit_attach(jit, &cpu);
+		}
+
+		clock_t start = clock();
+
+		// Execute until the ROM stops
+		int cpu_cycles = 0;
+		err = nes_cpu_run(&cpu, &mem, INT_MAX, &cpu_cycles);
+		*cycles += cpu_cycles;
+
+		*elapsed += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		if (err != NESEMU_RETURN_SUCCESS) {
+			fprintf(stderr,
+				"nesemu CPU execution failed with error code (0x%x)\n",
+				err);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int read_cartridge(uint8_t **cdata, size_t *len)
+{
+	// Read file
+	FILE *f = fopen(CARTRIDGE_NAME, "r");
+	if (f == NULL) {
+		return errno;
+	}
+
+	// Seek to end
+	if (fseek(f, 0L, SEEK_END) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	// Get the size of the file
+	*len = ftell(f);
+
+	// Seek to start
+	if (fseek(f, 0L, SEEK_SET) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	// Allocate data
+	*cdata = (uint8_t *)malloc(*len);
+
+	// Copy data from file
+	size_t rb = fread(*cdata, 1L, *len, f);
+	if (rb != *len) {
+		return EXIT_FAILURE;
+	}
+
+	// Close file
+	if (fclose(f) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
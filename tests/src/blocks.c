@@ -0,0 +1,206 @@
+/**
+ * Block cache: successor links across bank switches, polling loop
+ * detection and PPUSTATUS polling
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/video.h"
+#include "nesemu/ppu/palette.h"
+#include "nesemu/ppu/ppu.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_block_cache blocks;
+static struct nes_mem_video vim;
+static struct nes_ppu ppu;
+
+static nes_ppu_system_palette_t palette = NESEMU_PALETTE_STANDARD;
+
+/*
+ * Loop A -> B -> C -> D -> A, B differs between the banks. D selects the
+ * bank in $y, the third time around C sets it to 1 first: the links D -> A
+ * and A -> B were made with bank 0 mapped and must not be followed, B of
+ * bank 1 stores $22 and stops.
+ */
+static const uint8_t code_a[] = {
+	0x4C, 0x10, 0xC0, // $C000 JMP $C010
+};
+static const uint8_t code_b0[] = {
+	0xA9, 0x11, // $C010 LDA #$11
+	0x8D, 0x00, 0x03, // STA $0300
+	0x4C, 0x20, 0xC0, // JMP $C020
+};
+static const uint8_t code_b1[] = {
+	0xA9, 0x22, // $C010 LDA #$22
+	0x8D, 0x00, 0x03, // STA $0300
+	0xDB, // STP
+};
+static const uint8_t code_cd[] = {
+	0xE8, // $C020 INX
+	0xE0, 0x03, // CPX #$03
+	0xD0, 0x05, // BNE $C02A
+	0xA0, 0x01, // LDY #$01
+	0x4C, 0x2A, 0xC0, // JMP $C02A
+	0x8C, 0x00, 0x80, // $C02A STY $8000
+	0x4C, 0x00, 0xC0, // JMP $C000
+};
+
+static int test_links_bank_switch(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	for (uint8_t bank = 0; bank < 2; bank++) {
+		test_mapper_program(&cartridge, bank, 0xC000, code_a,
+				    sizeof(code_a));
+		test_mapper_program(&cartridge, bank, 0xC020, code_cd,
+				    sizeof(code_cd));
+	}
+	test_mapper_program(&cartridge, 0, 0xC010, code_b0, sizeof(code_b0));
+	test_mapper_program(&cartridge, 1, 0xC010, code_b1, sizeof(code_b1));
+
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+	nes_cpu_block_cache_attach(&blocks, &cpu);
+	cpu.pc = 0xC000;
+
+	// Runs forever in bank 0 if a stale link is followed
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 10000, &cycles));
+
+	TEST_ASSERT(cpu.stop);
+	TEST_ASSERT(cpu.x == 3);
+	TEST_ASSERT(test_mapper_bank == 1);
+	TEST_ASSERT(mem.ram[0x0300] == 0x22);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Bus, CPU and block cache running a loop at $C000, optionally with a PPU
+ * owning the registers
+ */
+static int polling_setup(const uint8_t *code, size_t len, bool with_ppu)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code, len);
+
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	if (with_ppu) {
+		TEST_OK(nes_vram_init(&vim, &cartridge));
+		TEST_OK(nes_ppu_init(&ppu, &palette, &mem, &vim));
+	}
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+	nes_cpu_block_cache_attach(&blocks, &cpu);
+	cpu.pc = 0xC000;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run a loop at $C000 for a while and check whether its block was taken for
+ * a polling loop
+ */
+static int polling_check(const uint8_t *code, size_t len, bool polling)
+{
+	TEST_ASSERT(polling_setup(code, len, false) == EXIT_SUCCESS);
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+
+	uint16_t index = blocks.index[0xC000 - NESEMU_CPU_BLOCK_BEGIN];
+	TEST_ASSERT(index != 0);
+	TEST_ASSERT(blocks.blocks[index - 1].polling == polling);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_polling_plain(void)
+{
+	// wait: LDA $10; BEQ wait
+	static const uint8_t ram[] = { 0xA5, 0x10, 0xF0, 0xFC };
+	TEST_ASSERT(polling_check(ram, sizeof(ram), true) == EXIT_SUCCESS);
+
+	// wait: LDA $6000; BEQ wait
+	static const uint8_t cartridge_ram[] = { 0xAD, 0x00, 0x60, 0xF0, 0xFB };
+	TEST_ASSERT(polling_check(cartridge_ram, sizeof(cartridge_ram), true) ==
+		    EXIT_SUCCESS);
+
+	// JMP *
+	static const uint8_t jump[] = { 0x4C, 0x00, 0xC0 };
+	return polling_check(jump, sizeof(jump), true);
+}
+
+static int test_polling_status(void)
+{
+	// wait: LDA $2002; BPL wait, VBlank clear
+	static const uint8_t status[] = { 0xAD, 0x02, 0x20, 0x10, 0xFB, 0xDB };
+	TEST_ASSERT(polling_check(status, sizeof(status), true) ==
+		    EXIT_SUCCESS);
+
+	// Through the PPU, the first read clears the write toggle
+	TEST_ASSERT(polling_setup(status, sizeof(status), true) ==
+		    EXIT_SUCCESS);
+	ppu.w = 1;
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+	uint16_t index = blocks.index[0xC000 - NESEMU_CPU_BLOCK_BEGIN];
+	TEST_ASSERT(index != 0 && blocks.blocks[index - 1].polling);
+	TEST_ASSERT(cycles >= 1000 - blocks.blocks[index - 1].max_cycles);
+	TEST_ASSERT(cpu.pc == 0xC000 && !cpu.stop);
+	TEST_ASSERT(ppu.w == 0);
+
+	// VBlank starts between runs, the next read sees it and clears it
+	ppu.status |= NESEMU_PPU_PPUSTATUS_VBLANK;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+	TEST_ASSERT(cpu.stop && cpu.pc == 0xC006);
+	TEST_ASSERT(cpu.a & NESEMU_PPU_PPUSTATUS_VBLANK);
+	TEST_ASSERT(!(ppu.status & NESEMU_PPU_PPUSTATUS_VBLANK));
+
+	// Any mirror of PPUSTATUS: wait: BIT $3FFA; BPL wait
+	static const uint8_t mirror[] = { 0x2C, 0xFA, 0x3F, 0x10, 0xFB };
+	return polling_check(mirror, sizeof(mirror), true);
+}
+
+static int test_polling_registers(void)
+{
+	// wait: LDA $2007; BPL wait (moves the VRAM address)
+	static const uint8_t data[] = { 0xAD, 0x07, 0x20, 0x10, 0xFB };
+	TEST_ASSERT(polling_check(data, sizeof(data), false) == EXIT_SUCCESS);
+
+	// wait: LDA $4016; BEQ wait
+	static const uint8_t input[] = { 0xAD, 0x16, 0x40, 0xF0, 0xFB };
+	TEST_ASSERT(polling_check(input, sizeof(input), false) == EXIT_SUCCESS);
+
+	// wait: LDA $0300,X; BEQ wait ($x may point anywhere)
+	static const uint8_t indexed[] = { 0xBD, 0x00, 0x03, 0xF0, 0xFB };
+	TEST_ASSERT(polling_check(indexed, sizeof(indexed), false) ==
+		    EXIT_SUCCESS);
+
+	// wait: LDA ($10),Y; BEQ wait
+	static const uint8_t indirect[] = { 0xB1, 0x10, 0xF0, 0xFC };
+	return polling_check(indirect, sizeof(indirect), false);
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_links_bank_switch);
+	TEST_RUN(result, test_polling_plain);
+	TEST_RUN(result, test_polling_status);
+	TEST_RUN(result, test_polling_registers);
+
+	return result;
+}
@@ -0,0 +1,273 @@
+/**
+ * Coverage: opcode, operand and data bits of a short program across a bank
+ * switch, merging in memory and through an export
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/coverage.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_coverage coverage;
+static struct nes_cpu_coverage other;
+
+/*
+ * Reads $0300, writes $0301 and pushes $a, then selects bank 1 and falls
+ * through into $C00A, which differs between the banks
+ */
+static const uint8_t code[] = {
+	0xAD, 0x00, 0x03, // $C000 LDA $0300
+	0x8D, 0x01, 0x03, // $C003 STA $0301
+	0x48, // $C006 PHA
+	0x8D, 0x00, 0x80, // $C007 STA $8000 ($a is 1)
+};
+static const uint8_t code_b0[] = {
+	0xDB, // $C00A STP
+};
+static const uint8_t code_b1[] = {
+	0xA2, 0x07, // $C00A LDX #$07
+	0xDB, // STP
+};
+
+/**
+ * PRG ROM offset of a window address in a bank of the test mapper
+ */
+static uint32_t coverage_offset(uint8_t bank, uint16_t addr)
+{
+	return (uint32_t)bank * TEST_BANK_SIZE + (addr % TEST_BANK_SIZE);
+}
+
+static int test_bits(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	for (uint8_t bank = 0; bank < 2; bank++) {
+		test_mapper_program(&cartridge, bank, 0xC000, code,
+				    sizeof(code));
+	}
+	test_mapper_program(&cartridge, 0, 0xC00A, code_b0, sizeof(code_b0));
+	test_mapper_program(&cartridge, 1, 0xC00A, code_b1, sizeof(code_b1));
+
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_cpu_coverage_init(&coverage, &cartridge));
+	TEST_OK(nes_cpu_coverage_attach(&coverage, &mem));
+	TEST_ASSERT(coverage.prg_bytes == 2 * TEST_BANK_SIZE / 8);
+	cpu.pc = 0xC000;
+	mem.ram[0x0300] = 0x01;
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+	TEST_ASSERT(cpu.stop);
+	TEST_ASSERT(cpu.x == 0x07);
+
+	// LDA, STA, PHA, STA, LDX and STP
+	static const uint16_t opcodes[] = { 0xC000, 0xC003, 0xC006,
+					    0xC007, 0xC00A, 0xC00C };
+	for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+		TEST_ASSERT(nes_cpu_coverage_test(&coverage, opcodes[i],
+						  NESEMU_CPU_COVERAGE_OPCODE));
+		TEST_ASSERT(!nes_cpu_coverage_test(&coverage, opcodes[i],
+						   NESEMU_CPU_COVERAGE_OPERAND));
+	}
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_OPCODE) == 6);
+
+	static const uint16_t operands[] = { 0xC001, 0xC002, 0xC004,
+					     0xC005, 0xC008, 0xC009, 0xC00B };
+	for (size_t i = 0; i < sizeof(operands) / sizeof(operands[0]); i++) {
+		TEST_ASSERT(nes_cpu_coverage_test(&coverage, operands[i],
+						  NESEMU_CPU_COVERAGE_OPERAND));
+		TEST_ASSERT(!nes_cpu_coverage_test(&coverage, operands[i],
+						   NESEMU_CPU_COVERAGE_OPCODE));
+	}
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_OPERAND) == 7);
+
+	// Data accesses, decoding reads are not data reads
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x0300,
+					  NESEMU_CPU_COVERAGE_READ));
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_READ) == 1);
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x0301,
+					  NESEMU_CPU_COVERAGE_WRITE));
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x01FD,
+					  NESEMU_CPU_COVERAGE_WRITE));
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x8000,
+					  NESEMU_CPU_COVERAGE_WRITE));
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_WRITE) == 3);
+
+	// Same window address, told apart by bank
+	TEST_ASSERT(nes_cpu_coverage_test_prg(&coverage,
+					      coverage_offset(0, 0xC007),
+					      NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(!nes_cpu_coverage_test_prg(&coverage,
+					       coverage_offset(1, 0xC007),
+					       NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(!nes_cpu_coverage_test_prg(&coverage,
+					       coverage_offset(0, 0xC00A),
+					       NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(nes_cpu_coverage_test_prg(&coverage,
+					      coverage_offset(1, 0xC00A),
+					      NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(nes_cpu_coverage_test_prg(&coverage,
+					      coverage_offset(1, 0xC00B),
+					      NESEMU_CPU_COVERAGE_OPERAND));
+
+	// Detached, bits are kept and nothing more is recorded
+	TEST_OK(nes_cpu_coverage_detach(&coverage));
+	TEST_ASSERT(mem.coverage == NULL);
+	uint8_t value = 0;
+	TEST_OK(nes_mem_r8(&mem, 0x0302, &value));
+	TEST_ASSERT(!nes_cpu_coverage_test(&coverage, 0x0302,
+					   NESEMU_CPU_COVERAGE_READ));
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_OPCODE) == 6);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_merge(void)
+{
+	// 'coverage' is left by 'test_bits'
+	TEST_OK(nes_cpu_coverage_init(&other, &cartridge));
+	test_mapper_bank = 0;
+	nes_cpu_coverage_mark(&other, 0x0400, NESEMU_CPU_COVERAGE_READ);
+	nes_cpu_coverage_mark(&other, 0xC00A, NESEMU_CPU_COVERAGE_OPCODE);
+
+	TEST_OK(nes_cpu_coverage_merge(&coverage, &other));
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x0400,
+					  NESEMU_CPU_COVERAGE_READ));
+	TEST_ASSERT(nes_cpu_coverage_test(&coverage, 0x0300,
+					  NESEMU_CPU_COVERAGE_READ));
+	TEST_ASSERT(nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_READ) == 2);
+	TEST_ASSERT(nes_cpu_coverage_test_prg(&coverage,
+					      coverage_offset(0, 0xC00A),
+					      NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(nes_cpu_coverage_test_prg(&coverage,
+					      coverage_offset(1, 0xC00A),
+					      NESEMU_CPU_COVERAGE_OPCODE));
+
+	// 'other' is unchanged
+	TEST_ASSERT(nes_cpu_coverage_count(&other,
+					   NESEMU_CPU_COVERAGE_READ) == 1);
+
+	TEST_OK(nes_cpu_coverage_destroy(&other));
+	return EXIT_SUCCESS;
+}
+
+static int test_merge_mismatch(void)
+{
+	// Without 'prg_offset_fn' only the CPU bitmaps are kept
+	nes_cartridge_offset_t offset_fn = cartridge.prg_offset_fn;
+	cartridge.prg_offset_fn = NULL;
+	nesemu_return_t err = nes_cpu_coverage_init(&other, &cartridge);
+	cartridge.prg_offset_fn = offset_fn;
+	TEST_OK(err);
+
+	TEST_ASSERT(other.prg == NULL && other.prg_bytes == 0);
+	nes_cpu_coverage_mark(&other, 0xC000, NESEMU_CPU_COVERAGE_OPCODE);
+	TEST_ASSERT(nes_cpu_coverage_test(&other, 0xC000,
+					  NESEMU_CPU_COVERAGE_OPCODE));
+	TEST_ASSERT(!nes_cpu_coverage_test_prg(&other, 0,
+					       NESEMU_CPU_COVERAGE_OPCODE));
+
+	// Not the same PRG ROM layout
+	TEST_ASSERT(nes_cpu_coverage_merge(&coverage, &other) ==
+		    NESEMU_RETURN_CPU_COVERAGE_MISMATCH);
+	TEST_ASSERT(nes_cpu_coverage_merge(&other, &coverage) ==
+		    NESEMU_RETURN_CPU_COVERAGE_MISMATCH);
+
+	TEST_OK(nes_cpu_coverage_destroy(&other));
+	return EXIT_SUCCESS;
+}
+
+static int test_file(void)
+{
+	FILE *f = tmpfile();
+	TEST_ASSERT(f != NULL);
+	TEST_OK(nes_cpu_coverage_save(&coverage, f));
+
+	// Round trip into empty bitmaps
+	TEST_OK(nes_cpu_coverage_init(&other, &cartridge));
+	rewind(f);
+	TEST_OK(nes_cpu_coverage_merge_file(&other, f));
+	TEST_ASSERT(memcmp(other.cpu, coverage.cpu, sizeof(other.cpu)) == 0);
+	TEST_ASSERT(memcmp(other.prg, coverage.prg,
+			   (size_t)NESEMU_CPU_COVERAGE_KINDS *
+				   coverage.prg_bytes) == 0);
+
+	// Merged into existing bits
+	TEST_OK(nes_cpu_coverage_reset(&other));
+	TEST_ASSERT(nes_cpu_coverage_count(&other,
+					   NESEMU_CPU_COVERAGE_OPCODE) == 0);
+	nes_cpu_coverage_mark(&other, 0x0500, NESEMU_CPU_COVERAGE_WRITE);
+	rewind(f);
+	TEST_OK(nes_cpu_coverage_merge_file(&other, f));
+	TEST_ASSERT(nes_cpu_coverage_count(&other,
+					   NESEMU_CPU_COVERAGE_WRITE) ==
+		    nes_cpu_coverage_count(&coverage,
+					   NESEMU_CPU_COVERAGE_WRITE) +
+			    1);
+
+	// A truncated export adds nothing
+	TEST_OK(nes_cpu_coverage_reset(&other));
+	long size = ftell(f);
+	uint8_t *data = (uint8_t *)malloc((size_t)size);
+	TEST_ASSERT(data != NULL);
+	rewind(f);
+	TEST_ASSERT(fread(data, (size_t)size, 1, f) == 1);
+	(void)fclose(f);
+
+	f = tmpfile();
+	TEST_ASSERT(f != NULL);
+	TEST_ASSERT(fwrite(data, (size_t)size - 1, 1, f) == 1);
+	rewind(f);
+	TEST_ASSERT(nes_cpu_coverage_merge_file(&other, f) ==
+		    NESEMU_RETURN_CPU_COVERAGE_MISMATCH);
+	TEST_ASSERT(nes_cpu_coverage_count(&other,
+					   NESEMU_CPU_COVERAGE_OPCODE) == 0);
+	(void)fclose(f);
+
+	// So does anything that is not an export
+	data[0] ^= 0xFF;
+	f = tmpfile();
+	TEST_ASSERT(f != NULL);
+	TEST_ASSERT(fwrite(data, (size_t)size, 1, f) == 1);
+	rewind(f);
+	TEST_ASSERT(nes_cpu_coverage_merge_file(&other, f) ==
+		    NESEMU_RETURN_CPU_COVERAGE_MISMATCH);
+	TEST_ASSERT(nes_cpu_coverage_count(&other,
+					   NESEMU_CPU_COVERAGE_OPCODE) == 0);
+	(void)fclose(f);
+	free(data);
+
+	TEST_OK(nes_cpu_coverage_destroy(&other));
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_bits);
+	TEST_RUN(result, test_merge);
+	TEST_RUN(result, test_merge_mismatch);
+	TEST_RUN(result, test_file);
+
+	TEST_OK(nes_cpu_coverage_destroy(&coverage));
+
+	return result;
+}
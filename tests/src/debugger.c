@@ -0,0 +1,308 @@
+/**
+ * Debugger: breakpoints and watchpoints added and removed while the CPU
+ * runs, stepping over a breakpoint and breakpoints kept across a bank
+ * switch
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/debug.h"
+#include "nesemu/memory/main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_cache cache;
+static struct nes_cpu_block_cache blocks;
+static struct nes_debugger debugger;
+
+/*
+ * Counts in $x and stores it at $0300 forever
+ */
+static const uint8_t code_loop[] = {
+	0xA2, 0x00, // $C000 LDX #$00
+	0xE8, // $C002 INX
+	0x8E, 0x00, 0x03, // $C003 STX $0300
+	0xAD, 0x00, 0x03, // $C006 LDA $0300
+	0x4C, 0x02, 0xC0, // $C009 JMP $C002
+};
+
+/*
+ * Selects bank 1 and falls through into $C005, which differs between the
+ * banks
+ */
+static const uint8_t code_switch[] = {
+	0xA9, 0x01, // $C000 LDA #$01
+	0x8D, 0x00, 0x80, // $C002 STA $8000
+};
+static const uint8_t code_switch_b0[] = {
+	0xDB, // $C005 STP
+};
+static const uint8_t code_switch_b1[] = {
+	0xE8, // $C005 INX
+	0xDB, // STP
+};
+
+/**
+ * Bus and CPU with a decode cache and the debugger, optionally the block
+ * cache
+ */
+static int debugger_setup(bool with_blocks)
+{
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_cpu_cache_init(&cache, &mem));
+	TEST_OK(nes_cpu_cache_attach(&cache, &cpu));
+	if (with_blocks) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		TEST_OK(nes_cpu_block_cache_attach(&blocks, &cpu));
+	}
+	TEST_OK(nes_debugger_attach(&debugger, &cpu, &mem));
+	cpu.pc = 0xC000;
+
+	return EXIT_SUCCESS;
+}
+
+static int debugger_loop_setup(bool with_blocks)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code_loop,
+			    sizeof(code_loop));
+
+	return debugger_setup(with_blocks);
+}
+
+static int breakpoints_check(bool with_blocks)
+{
+	TEST_ASSERT(debugger_loop_setup(with_blocks) == EXIT_SUCCESS);
+	int cycles = 0;
+
+	// Nothing set, the loop runs through the budget
+	TEST_OK(nes_cpu_run(&cpu, &mem, 200, &cycles));
+	TEST_ASSERT(cpu.x > 1);
+	uint8_t x = cpu.x;
+
+	// Added at runtime, stops before the instruction
+	TEST_OK(nes_debugger_break_add(&debugger, 0xC003));
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC003);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_EXECUTE);
+	TEST_ASSERT(debugger.hit.address == 0xC003);
+	TEST_ASSERT(cpu.x == (uint8_t)(x + 1));
+	TEST_ASSERT(mem.ram[0x0300] == x);
+
+	// Stays there until stepped over
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC003);
+	TEST_ASSERT(cycles == 0);
+
+	TEST_OK(nes_debugger_step(&debugger, &cycles));
+	TEST_ASSERT(cpu.pc == 0xC006);
+	TEST_ASSERT(cycles == 4);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_NONE);
+	TEST_ASSERT(mem.ram[0x0300] == (uint8_t)(x + 1));
+
+	// Still armed for the next time around
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC003);
+	TEST_ASSERT(cpu.x == (uint8_t)(x + 2));
+
+	// Removed at runtime
+	TEST_OK(nes_debugger_break_remove(&debugger, 0xC003));
+	TEST_OK(nes_cpu_run(&cpu, &mem, 200, &cycles));
+	TEST_ASSERT(cpu.x > (uint8_t)(x + 2));
+
+	TEST_OK(nes_debugger_detach(&debugger));
+	return EXIT_SUCCESS;
+}
+
+static int test_breakpoints(void)
+{
+	return breakpoints_check(false);
+}
+
+static int test_breakpoints_blocks(void)
+{
+	// Blocks built before the breakpoint must not run over it
+	return breakpoints_check(true);
+}
+
+static int test_watchpoints(void)
+{
+	TEST_ASSERT(debugger_loop_setup(true) == EXIT_SUCCESS);
+	int cycles = 0;
+
+	TEST_OK(nes_cpu_run(&cpu, &mem, 200, &cycles));
+	TEST_ASSERT(mem.read[0x03] != NULL && mem.write[0x03] != NULL);
+
+	// Stops right after the accessing instruction
+	TEST_OK(nes_debugger_watch_add(&debugger, 0x0300, 0x0300,
+				       NESEMU_DEBUGGER_WRITE));
+	TEST_ASSERT(mem.watch_pages[0x03] == NESEMU_DEBUGGER_WRITE);
+	TEST_ASSERT(mem.write[0x03] == NULL);
+	TEST_ASSERT(mem.write[0x02] != NULL && mem.write[0x04] != NULL);
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC006);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_WRITE);
+	TEST_ASSERT(debugger.hit.address == 0x0300);
+	TEST_ASSERT(debugger.hit.value == cpu.x);
+	TEST_ASSERT(mem.ram[0x0300] == cpu.x);
+
+	// Reads of the same page do not match a write watchpoint
+	TEST_OK(nes_debugger_watch_add(&debugger, 0x0300, 0x03FF,
+				       NESEMU_DEBUGGER_READ));
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC009);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_READ);
+	TEST_ASSERT(debugger.hit.address == 0x0300);
+	TEST_ASSERT(cpu.a == cpu.x);
+
+	// Removed at runtime, only the read one is left
+	TEST_OK(nes_debugger_watch_remove(&debugger, 0x0300, 0x0300,
+					  NESEMU_DEBUGGER_WRITE));
+	TEST_ASSERT(mem.watch_pages[0x03] == NESEMU_DEBUGGER_READ);
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_READ);
+	TEST_ASSERT(cpu.pc == 0xC009);
+
+	// Both gone, the page gets its fast path back
+	TEST_OK(nes_debugger_watch_remove(&debugger, 0x0300, 0x03FF,
+					  NESEMU_DEBUGGER_READ));
+	TEST_ASSERT(mem.watch_pages[0x03] == 0);
+	TEST_ASSERT(mem.read[0x03] != NULL && mem.write[0x03] != NULL);
+	uint8_t x = cpu.x;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 200, &cycles));
+	TEST_ASSERT(cpu.x > x);
+
+	TEST_OK(nes_debugger_detach(&debugger));
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Writes through a mirror of $0300
+ */
+static const uint8_t code_mirror[] = {
+	0xA2, 0x05, // $C000 LDX #$05
+	0x8E, 0x00, 0x0B, // $C002 STX $0B00
+	0xDB, // $C005 STP
+};
+
+static int test_watchpoints_mirror(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code_mirror,
+			    sizeof(code_mirror));
+	TEST_ASSERT(debugger_setup(false) == EXIT_SUCCESS);
+	int cycles = 0;
+
+	// Every mirror of the page loses its fast path
+	TEST_OK(nes_debugger_watch_add(&debugger, 0x0300, 0x0300,
+				       NESEMU_DEBUGGER_WRITE));
+	for (uint16_t page = 0x03; page < 0x20; page += 0x08) {
+		TEST_ASSERT(mem.watch_pages[page] == NESEMU_DEBUGGER_WRITE);
+		TEST_ASSERT(mem.write[page] == NULL);
+	}
+	TEST_ASSERT(mem.write[0x0C] != NULL);
+
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC005);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_WRITE);
+	TEST_ASSERT(debugger.hit.address == 0x0B00);
+	TEST_ASSERT(debugger.hit.value == 0x05);
+	TEST_ASSERT(mem.ram[0x0300] == 0x05);
+	TEST_OK(nes_debugger_detach(&debugger));
+
+	// Set on a mirror, hit through the work RAM address
+	TEST_ASSERT(debugger_loop_setup(false) == EXIT_SUCCESS);
+	TEST_OK(nes_debugger_watch_add(&debugger, 0x1B00, 0x1B00,
+				       NESEMU_DEBUGGER_WRITE));
+	TEST_ASSERT(mem.write[0x03] == NULL);
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(cpu.pc == 0xC006);
+	TEST_ASSERT(debugger.hit.address == 0x0300);
+
+	TEST_OK(nes_debugger_detach(&debugger));
+	return EXIT_SUCCESS;
+}
+
+static int test_watchpoints_full(void)
+{
+	TEST_ASSERT(debugger_loop_setup(false) == EXIT_SUCCESS);
+
+	for (int i = 0; i < NESEMU_DEBUGGER_WATCHPOINTS; i++) {
+		TEST_OK(nes_debugger_watch_add(&debugger, (uint16_t)i,
+					       (uint16_t)i,
+					       NESEMU_DEBUGGER_READ));
+	}
+	TEST_ASSERT(nes_debugger_watch_add(&debugger, 0x0300, 0x0300,
+					   NESEMU_DEBUGGER_READ) ==
+		    NESEMU_RETURN_CPU_DEBUGGER_FULL);
+
+	TEST_OK(nes_debugger_detach(&debugger));
+	TEST_ASSERT(mem.watch_pages[0x00] == 0);
+	return EXIT_SUCCESS;
+}
+
+static int test_bank_switch(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	for (uint8_t bank = 0; bank < 2; bank++) {
+		test_mapper_program(&cartridge, bank, 0xC000, code_switch,
+				    sizeof(code_switch));
+	}
+	test_mapper_program(&cartridge, 0, 0xC005, code_switch_b0,
+			    sizeof(code_switch_b0));
+	test_mapper_program(&cartridge, 1, 0xC005, code_switch_b1,
+			    sizeof(code_switch_b1));
+	TEST_ASSERT(debugger_setup(false) == EXIT_SUCCESS);
+
+	// Decoded with bank 0 mapped, the switch invalidates the cache
+	TEST_OK(nes_debugger_break_add(&debugger, 0xC005));
+	int cycles = 0;
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 200, &cycles) ==
+		    NESEMU_INFO_CPU_BREAK);
+	TEST_ASSERT(test_mapper_bank == 1);
+	TEST_ASSERT(cpu.pc == 0xC005);
+	TEST_ASSERT(debugger.hit.kind == NESEMU_DEBUGGER_EXECUTE);
+	TEST_ASSERT(!cpu.stop);
+
+	// The instruction of bank 1 runs
+	TEST_OK(nes_debugger_step(&debugger, &cycles));
+	TEST_ASSERT(cpu.x == 1);
+	TEST_OK(nes_debugger_step(&debugger, &cycles));
+	TEST_ASSERT(cpu.stop);
+
+	TEST_OK(nes_debugger_detach(&debugger));
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_breakpoints);
+	TEST_RUN(result, test_breakpoints_blocks);
+	TEST_RUN(result, test_watchpoints);
+	TEST_RUN(result, test_watchpoints_mirror);
+	TEST_RUN(result, test_watchpoints_full);
+	TEST_RUN(result, test_bank_switch);
+
+	return result;
+}
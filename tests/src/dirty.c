@@ -0,0 +1,295 @@
+/**
+ * Dirty memory tracking: blocks flagged by every write path of both buses
+ * (mirrors, stack, block transfers), merged into ranges, and cleared
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/dirty.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/video.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIRTY_RANGES 8
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_mem_video vim;
+static struct nes_cpu cpu;
+
+static struct nes_mem_dirty_range ranges[DIRTY_RANGES];
+static size_t count;
+
+/**
+ * Clean buses over the test mapper
+ */
+static int dirty_setup(bool paged)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, paged) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_vram_init(&vim, &cartridge));
+	TEST_OK(nes_mem_dirty_clear(&mem));
+	TEST_OK(nes_vram_dirty_clear(&vim));
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Compare the ranges of the last query with `expected` (offset, size pairs)
+ */
+static int dirty_check(const uint16_t (*expected)[2], size_t amount)
+{
+	TEST_ASSERT(count == amount);
+	for (size_t i = 0; i < amount; i++) {
+		if (ranges[i].offset != expected[i][0] ||
+		    ranges[i].size != expected[i][1]) {
+			fprintf(stderr,
+				"range %zu: $%04X+%u, expected $%04X+%u\n", i,
+				ranges[i].offset, ranges[i].size,
+				expected[i][0], expected[i][1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int test_ranges(void)
+{
+	static const uint8_t none[4] = { 0 };
+	static const uint8_t merged[] = { 1, 1, 0, 1, 1, 1, 0, 0 };
+	static const uint8_t partial[] = { 0, 0, 0, 1 };
+	static const uint8_t scattered[] = { 1, 0, 1, 0, 1 };
+	static const uint16_t expected_merged[][2] = { { 0x00, 0x80 },
+						       { 0xC0, 0xC0 } };
+	static const uint16_t expected_partial[][2] = { { 0xC0, 0x08 } };
+	static const uint16_t expected_scattered[][2] = { { 0x00, 0x40 },
+							  { 0x80, 0x40 } };
+
+	count = nes_mem_dirty_ranges(none, sizeof(none) * 0x40, ranges,
+				     DIRTY_RANGES);
+	TEST_ASSERT(count == 0);
+
+	// Adjacent blocks make a single range
+	count = nes_mem_dirty_ranges(merged, sizeof(merged) * 0x40, ranges,
+				     DIRTY_RANGES);
+	TEST_ASSERT(dirty_check(expected_merged, 2) == EXIT_SUCCESS);
+
+	// The last block stops at the end of the region
+	count = nes_mem_dirty_ranges(partial, 0xC8, ranges, DIRTY_RANGES);
+	TEST_ASSERT(dirty_check(expected_partial, 1) == EXIT_SUCCESS);
+
+	// Counted past `max`, nothing stored past it
+	memset(ranges, 0xFF, sizeof(ranges));
+	count = nes_mem_dirty_ranges(scattered, sizeof(scattered) * 0x40,
+				     ranges, 2);
+	TEST_ASSERT(count == 3);
+	TEST_ASSERT(ranges[2].offset == 0xFFFF && ranges[2].size == 0xFFFF);
+	count = 2;
+	TEST_ASSERT(dirty_check(expected_scattered, 2) == EXIT_SUCCESS);
+	TEST_ASSERT(nes_mem_dirty_ranges(scattered, sizeof(scattered) * 0x40,
+					 NULL, 0) == 3);
+
+	return EXIT_SUCCESS;
+}
+
+static int dirty_ram_check(bool paged)
+{
+	static const uint16_t expected_ram[][2] = { { 0x000, 0x80 },
+						    { 0x7C0, 0x40 } };
+	static const uint16_t expected_cartridge[][2] = { { 0x0040, 0x40 },
+							  { 0x1FC0, 0x40 } };
+
+	TEST_ASSERT(dirty_setup(paged) == EXIT_SUCCESS);
+
+	// Mirrors flag the block of the RAM byte they alias
+	TEST_OK(nes_mem_w8(&mem, 0x0805, 0x01));
+	TEST_OK(nes_mem_w8(&mem, 0x1040, 0x02));
+	TEST_OK(nes_mem_w8(&mem, 0x1FFF, 0x03));
+	TEST_OK(nes_mem_w8(&mem, 0x0000, 0x00)); // Same value, still a write
+
+	// Registers and PRG ROM are not memory
+	TEST_OK(nes_mem_w8(&mem, 0x2000, 0x04));
+	TEST_OK(nes_mem_w8(&mem, 0x4015, 0x00));
+	TEST_OK(nes_mem_w8(&mem, 0x8000, 0x00));
+
+	TEST_OK(nes_mem_w8(&mem, 0x6040, 0x05));
+	TEST_OK(nes_mem_w8(&mem, 0x7FFF, 0x06));
+
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(dirty_check(expected_ram, 2) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(dirty_check(expected_cartridge, 2) == EXIT_SUCCESS);
+
+	// Truncated to `max`, the count says how many there are
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges, 1,
+			      &count));
+	TEST_ASSERT(count == 2);
+	TEST_ASSERT(ranges[0].offset == 0x000 && ranges[0].size == 0x80);
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, NULL, 0, &count));
+	TEST_ASSERT(count == 2);
+
+	// Video regions belong to the other bus
+	TEST_ASSERT(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_CIRAM, ranges,
+				  DIRTY_RANGES,
+				  &count) == NESEMU_RETURN_BAD_ARGUMENTS);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_ram(void)
+{
+	// Page table and cartridge callbacks
+	TEST_ASSERT(dirty_ram_check(true) == EXIT_SUCCESS);
+	return dirty_ram_check(false);
+}
+
+static int test_stack(void)
+{
+	// JSR $C010 with $sp at $40, the return address straddles two blocks
+	static const uint8_t code[] = { 0x20, 0x10, 0xC0 };
+	static const uint16_t expected[][2] = { { 0x100, 0x80 } };
+
+	TEST_ASSERT(dirty_setup(true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code, sizeof(code));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_mem_dirty_clear(&mem));
+	cpu.pc = 0xC000;
+	cpu.sp = 0x40;
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_next(&cpu, &mem, &cycles));
+	TEST_ASSERT(cpu.pc == 0xC010);
+	TEST_ASSERT(cpu.sp == 0x3E);
+	TEST_ASSERT(mem.ram[0x0140] == 0xC0 && mem.ram[0x013F] == 0x02);
+
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	return dirty_check(expected, 1);
+}
+
+static int test_block(void)
+{
+	static const uint16_t expected_ram[][2] = { { 0x000, 0x40 },
+						    { 0x7C0, 0x40 } };
+	static const uint16_t expected_cartridge[][2] = { { 0x1F00, 0x100 } };
+	uint8_t buffer[0x100] = { 0 };
+
+	TEST_ASSERT(dirty_setup(true) == EXIT_SUCCESS);
+
+	// Reads do not count
+	TEST_OK(nes_mem_read_block(&mem, 0x0000, buffer, sizeof(buffer)));
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 0);
+
+	// Over the end of RAM into its mirror, then into the registers
+	TEST_OK(nes_mem_write_block(&mem, 0x07E0, buffer, 0x40));
+	TEST_OK(nes_mem_write_block(&mem, 0x1FE0, buffer, 0x40));
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(dirty_check(expected_ram, 2) == EXIT_SUCCESS);
+
+	// Cartridge RAM, up to PRG ROM
+	TEST_OK(nes_mem_write_block(&mem, 0x7F00, buffer, sizeof(buffer)));
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	return dirty_check(expected_cartridge, 1);
+}
+
+static int test_video(void)
+{
+	static const uint16_t expected_ciram[][2] = { { 0x000, 0x80 },
+						      { 0x3C0, 0x40 } };
+	static const uint16_t expected_palette[][2] = { { 0x00, 0x20 } };
+	uint8_t buffer[0x10] = { 0 };
+
+	TEST_ASSERT(dirty_setup(true) == EXIT_SUCCESS);
+
+	// Nametable and its mirror at $3000, merged
+	TEST_OK(nes_vram_w8(&vim, 0x2000, 0x01));
+	TEST_OK(nes_vram_w8(&vim, 0x3041, 0x02));
+	TEST_OK(nes_vram_write_block(&vim, 0x23F0, buffer, sizeof(buffer)));
+
+	// $3F10 mirrors $3F00, $3F25 is past the 32 bytes of palette RAM
+	TEST_OK(nes_vram_w8(&vim, 0x3F10, 0x03));
+	TEST_OK(nes_vram_w8(&vim, 0x3F25, 0x04));
+
+	// CHR ROM is not written
+	TEST_ASSERT(nes_vram_w8(&vim, 0x0000, 0x05) ==
+		    NESEMU_RETURN_CARTRIDGE_CHRROM_READ_ONLY);
+
+	TEST_OK(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_CIRAM, ranges,
+			       DIRTY_RANGES, &count));
+	TEST_ASSERT(dirty_check(expected_ciram, 2) == EXIT_SUCCESS);
+	TEST_OK(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_PALETTE, ranges,
+			       DIRTY_RANGES, &count));
+	TEST_ASSERT(dirty_check(expected_palette, 1) == EXIT_SUCCESS);
+	TEST_OK(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_PATTERN, ranges,
+			       DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 0);
+
+	// Main memory regions belong to the other bus
+	TEST_ASSERT(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_RAM, ranges,
+				   DIRTY_RANGES,
+				   &count) == NESEMU_RETURN_BAD_ARGUMENTS);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_clear(void)
+{
+	TEST_ASSERT(dirty_setup(true) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_w8(&mem, 0x0100, 0x01));
+	TEST_OK(nes_mem_w8(&mem, 0x6000, 0x01));
+	TEST_OK(nes_vram_w8(&vim, 0x2000, 0x01));
+
+	// Each bus clears its own regions only
+	TEST_OK(nes_mem_dirty_clear(&mem));
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 0);
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_CARTRIDGE_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 0);
+	TEST_OK(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_CIRAM, ranges,
+			       DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 1);
+
+	TEST_OK(nes_vram_dirty_clear(&vim));
+	TEST_OK(nes_vram_dirty(&vim, NESEMU_MEMORY_DIRTY_CIRAM, ranges,
+			       DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 0);
+
+	// Tracked again from the checkpoint
+	TEST_OK(nes_mem_w8(&mem, 0x0100, 0x02));
+	TEST_OK(nes_mem_dirty(&mem, NESEMU_MEMORY_DIRTY_RAM, ranges,
+			      DIRTY_RANGES, &count));
+	TEST_ASSERT(count == 1);
+	TEST_ASSERT(ranges[0].offset == 0x100 && ranges[0].size == 0x40);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_ranges);
+	TEST_RUN(result, test_ram);
+	TEST_RUN(result, test_stack);
+	TEST_RUN(result, test_block);
+	TEST_RUN(result, test_video);
+	TEST_RUN(result, test_clear);
+
+	return result;
+}
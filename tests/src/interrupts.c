@@ -0,0 +1,320 @@
+/**
+ * Scheduled NMI and IRQ delivery: timing, masking of the level triggered
+ * IRQ lines, release and cancellation
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/status.h"
+#include "nesemu/memory/main.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Handlers of the test program
+ */
+#define INTERRUPTS_NMI 0xD000
+#define INTERRUPTS_IRQ 0xD100
+
+/**
+ * Clock after the reset sequence
+ */
+#define INTERRUPTS_CLOCK NESEMU_CPU_INTERRUPT_CYCLES
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_block_cache blocks;
+
+// NMI, RESET and IRQ/BRK
+static const uint8_t vectors[] = { 0x00, 0xD0, 0x00, 0xC0, 0x00, 0xD1 };
+
+// $D000 STX $0300; STP
+static const uint8_t nmi_stop[] = { 0x8E, 0x00, 0x03, 0xDB };
+
+// $D100 STX $0301; STP
+static const uint8_t irq_stop[] = { 0x8E, 0x01, 0x03, 0xDB };
+
+// RTI
+static const uint8_t rti[] = { 0x40 };
+
+/**
+ * Test mapper with the vectors in place and `count` INX at $C000 followed
+ * by `tail`, NOPs everywhere else
+ */
+static int interrupts_setup(int count, const uint8_t *tail, size_t len)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xFFFA, vectors, sizeof(vectors));
+
+	static const uint8_t inx[] = { 0xE8 };
+	for (int i = 0; i < count; i++) {
+		test_mapper_program(&cartridge, 0, (uint16_t)(0xC000 + i), inx,
+				    sizeof(inx));
+	}
+	if (tail != NULL) {
+		test_mapper_program(&cartridge, 0, (uint16_t)(0xC000 + count),
+				    tail, len);
+	}
+
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_ASSERT(cpu.pc == 0xC000);
+	TEST_ASSERT(cpu.clock == INTERRUPTS_CLOCK);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_nmi_timing(void)
+{
+	TEST_ASSERT(interrupts_setup(64, NULL, 0) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, INTERRUPTS_NMI, rti, sizeof(rti));
+
+	// Between two instructions: the one in progress completes first
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI,
+				       INTERRUPTS_CLOCK + 5));
+	TEST_ASSERT(cpu.next_event == INTERRUPTS_CLOCK + 5);
+
+	int c = 0;
+	for (int i = 0; i < 3; i++) {
+		TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+		TEST_ASSERT(c == 2);
+	}
+	TEST_ASSERT(cpu.pc == 0xC003 && cpu.x == 3);
+
+	// Delivered even though IRQs are masked, instead of an instruction
+	TEST_ASSERT(cpu.status & NESEMU_CPU_FLAGS_I);
+	uint8_t sp = cpu.sp;
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(c == NESEMU_CPU_INTERRUPT_CYCLES);
+	TEST_ASSERT(cpu.pc == INTERRUPTS_NMI);
+	TEST_ASSERT(cpu.sp == (uint8_t)(sp - 3));
+	TEST_ASSERT(cpu.clock ==
+		    INTERRUPTS_CLOCK + 6 + NESEMU_CPU_INTERRUPT_CYCLES);
+	TEST_ASSERT(cpu.events[NESEMU_CPU_EVENT_NMI] == NESEMU_CPU_EVENT_NEVER);
+	TEST_ASSERT(cpu.next_event == NESEMU_CPU_EVENT_NEVER);
+
+	// Back where it was interrupted, edge triggered: not delivered again
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC003 && cpu.sp == sp);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC004 && cpu.x == 4);
+
+	// Exactly at an instruction boundary
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI, cpu.clock));
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == INTERRUPTS_NMI && cpu.x == 4);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run the INX sled until the NMI handler stops the CPU
+ */
+static int nmi_run(bool attach, int budget)
+{
+	TEST_ASSERT(interrupts_setup(64, NULL, 0) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, INTERRUPTS_NMI, nmi_stop,
+			    sizeof(nmi_stop));
+	if (attach) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		nes_cpu_block_cache_attach(&blocks, &cpu);
+	}
+
+	// First boundary at or after the timestamp: 7 + 2 * 7
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI,
+				       INTERRUPTS_CLOCK + 13));
+	while (!cpu.stop) {
+		int c = 0;
+		TEST_OK(nes_cpu_run(&cpu, &mem, budget, &c));
+	}
+
+	TEST_ASSERT(mem.ram[0x0300] == 7);
+	TEST_ASSERT(cpu.status & NESEMU_CPU_FLAGS_I);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_nmi_run(void)
+{
+	TEST_ASSERT(nmi_run(false, INT_MAX) == EXIT_SUCCESS);
+	TEST_ASSERT(nmi_run(false, 1) == EXIT_SUCCESS);
+
+	// Blocks never run past the timestamp
+	TEST_ASSERT(nmi_run(true, INT_MAX) == EXIT_SUCCESS);
+	return nmi_run(true, 5);
+}
+
+static int test_nmi_first(void)
+{
+	TEST_ASSERT(interrupts_setup(64, NULL, 0) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, INTERRUPTS_NMI, rti, sizeof(rti));
+	test_mapper_program(&cartridge, 0, INTERRUPTS_IRQ, rti, sizeof(rti));
+	nes_cpu_status_mask_unset(&cpu, NESEMU_CPU_FLAGS_I);
+
+	// Both due, the NMI goes first and its handler masks the IRQ
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_APU,
+				       cpu.clock));
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI, cpu.clock));
+
+	int c = 0;
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == INTERRUPTS_NMI);
+	TEST_ASSERT(cpu.irq == (1u << NESEMU_CPU_EVENT_IRQ_APU));
+
+	// RTI unmasks it
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC000);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == INTERRUPTS_IRQ);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_irq_masked_level(void)
+{
+	// 10 INX, CLI, NOPs
+	static const uint8_t cli[] = { 0x58 };
+	TEST_ASSERT(interrupts_setup(10, cli, sizeof(cli)) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, INTERRUPTS_IRQ, rti, sizeof(rti));
+
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER,
+				       INTERRUPTS_CLOCK + 2));
+
+	// Asserted but masked, the instructions keep running
+	int c = 0;
+	for (int i = 0; i < 10; i++) {
+		TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+		TEST_ASSERT(c == 2);
+	}
+	TEST_ASSERT(cpu.pc == 0xC00A && cpu.x == 10);
+	TEST_ASSERT(cpu.irq == (1u << NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.next_event <= cpu.clock);
+
+	// CLI, then delivered at the next boundary
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC00B);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(c == NESEMU_CPU_INTERRUPT_CYCLES);
+	TEST_ASSERT(cpu.pc == INTERRUPTS_IRQ);
+	TEST_ASSERT(cpu.status & NESEMU_CPU_FLAGS_I);
+
+	// Level triggered: delivered again after RTI until released
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC00B);
+	TEST_ASSERT((cpu.status & NESEMU_CPU_FLAGS_I) == 0);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == INTERRUPTS_IRQ);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC00B);
+
+	// Acknowledged by the handler
+	TEST_OK(nes_cpu_irq_release(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.irq == 0);
+	TEST_ASSERT(cpu.next_event == NESEMU_CPU_EVENT_NEVER);
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.pc == 0xC00C && c == 2);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_irq_release(void)
+{
+	TEST_ASSERT(interrupts_setup(64, NULL, 0) == EXIT_SUCCESS);
+
+	// Both lines asserted while masked
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER,
+				       cpu.clock));
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_APU,
+				       cpu.clock));
+	int c = 0;
+	TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	TEST_ASSERT(cpu.irq == ((1u << NESEMU_CPU_EVENT_IRQ_MAPPER) |
+				(1u << NESEMU_CPU_EVENT_IRQ_APU)));
+
+	// Releasing one source keeps the other one asserted
+	TEST_OK(nes_cpu_irq_release(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.irq == (1u << NESEMU_CPU_EVENT_IRQ_APU));
+	TEST_ASSERT(cpu.next_event == cpu.clock);
+	TEST_OK(nes_cpu_irq_release(&cpu, NESEMU_CPU_EVENT_IRQ_APU));
+	TEST_ASSERT(cpu.irq == 0);
+	TEST_ASSERT(cpu.next_event == NESEMU_CPU_EVENT_NEVER);
+
+	// Releasing a line that is not asserted does nothing
+	TEST_OK(nes_cpu_irq_release(&cpu, NESEMU_CPU_EVENT_IRQ_APU));
+	TEST_ASSERT(cpu.irq == 0);
+
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	TEST_ASSERT(nes_cpu_irq_release(&cpu, NESEMU_CPU_EVENT_COUNT) ==
+		    NESEMU_RETURN_BAD_ARGUMENTS);
+#endif
+
+	return EXIT_SUCCESS;
+}
+
+static int test_event_cancel(void)
+{
+	TEST_ASSERT(interrupts_setup(64, NULL, 0) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, INTERRUPTS_NMI, nmi_stop,
+			    sizeof(nmi_stop));
+	test_mapper_program(&cartridge, 0, INTERRUPTS_IRQ, irq_stop,
+			    sizeof(irq_stop));
+	nes_cpu_status_mask_unset(&cpu, NESEMU_CPU_FLAGS_I);
+
+	// Cancelled before they are due: never delivered
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_NMI,
+				       INTERRUPTS_CLOCK + 10));
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER,
+				       INTERRUPTS_CLOCK + 20));
+	TEST_ASSERT(cpu.next_event == INTERRUPTS_CLOCK + 10);
+	TEST_OK(nes_cpu_event_cancel(&cpu, NESEMU_CPU_EVENT_NMI));
+	TEST_ASSERT(cpu.next_event == INTERRUPTS_CLOCK + 20);
+	TEST_OK(nes_cpu_event_cancel(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.next_event == NESEMU_CPU_EVENT_NEVER);
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 100, &cycles));
+	TEST_ASSERT(!cpu.stop);
+	TEST_ASSERT(cpu.irq == 0);
+	TEST_ASSERT(cpu.pc >= 0xC000 && cpu.pc < 0xC040);
+
+	// An asserted line is kept, only the timestamp is removed
+	nes_cpu_status_mask_set(&cpu, NESEMU_CPU_FLAGS_I);
+	TEST_OK(nes_cpu_event_schedule(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER,
+				       cpu.clock));
+	TEST_OK(nes_cpu_run(&cpu, &mem, 2, &cycles));
+	TEST_OK(nes_cpu_event_cancel(&cpu, NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.irq == (1u << NESEMU_CPU_EVENT_IRQ_MAPPER));
+	TEST_ASSERT(cpu.events[NESEMU_CPU_EVENT_IRQ_MAPPER] ==
+		    NESEMU_CPU_EVENT_NEVER);
+
+	// Delivered as soon as it is unmasked
+	uint8_t x = cpu.x;
+	nes_cpu_status_mask_unset(&cpu, NESEMU_CPU_FLAGS_I);
+	TEST_OK(nes_cpu_run(&cpu, &mem, 100, &cycles));
+	TEST_ASSERT(cpu.stop);
+	TEST_ASSERT(mem.ram[0x0301] == x);
+	TEST_ASSERT(mem.ram[0x0300] == 0);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_nmi_timing);
+	TEST_RUN(result, test_nmi_run);
+	TEST_RUN(result, test_nmi_first);
+	TEST_RUN(result, test_irq_masked_level);
+	TEST_RUN(result, test_irq_release);
+	TEST_RUN(result, test_event_cancel);
+
+	return result;
+}
@@ -0,0 +1,320 @@
+/**
+ * Block transfers of both buses against byte-by-byte accesses, across
+ * pages, mirrors and nametables, and the page table of the main bus
+ */
+
+#include "test.h"
+
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/video.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_mem_main ref;
+static struct nes_mem_video vim;
+static struct nes_mem_video vim_ref;
+
+static uint8_t buffer[0x10000];
+static uint8_t expected[0x10000];
+
+/**
+ * Range of a block transfer
+ */
+struct memory_range {
+	uint16_t addr;
+	size_t size;
+};
+
+/**
+ * Main bus ranges readable without errors (the test mapper has nothing
+ * at $4020-$5FFF)
+ */
+static const struct memory_range main_ranges[] = {
+	{ 0x0000, 0x2000 }, // Work RAM and its mirrors
+	{ 0x07F0, 0x0020 }, // First mirror boundary
+	{ 0x1FF0, 0x0020 }, // RAM to PPU registers
+	{ 0x3FF0, 0x0020 }, // PPU to I/O registers
+	{ 0x6000, 0xA000 }, // Cartridge RAM and PRG ROM, to the end
+	{ 0x7FF0, 0x0020 }, // Cartridge RAM to PRG ROM
+	{ 0xBFF0, 0x0020 }, // PRG ROM bank mirror
+	{ 0xFFF0, 0x0010 }, // Last bytes
+};
+
+/**
+ * Video bus ranges, everything is readable
+ */
+static const struct memory_range video_ranges[] = {
+	{ 0x0000, 0x4000 }, // Whole address space
+	{ 0x0FF0, 0x0020 }, // Pattern tables
+	{ 0x1FF0, 0x0020 }, // Pattern table to nametable
+	{ 0x23F0, 0x0020 }, // Nametable boundary
+	{ 0x27F0, 0x0020 }, // Mirrored nametable boundary
+	{ 0x2FF0, 0x0020 }, // Nametables to their mirror
+	{ 0x3EF0, 0x0040 }, // Nametable mirror to palette
+	{ 0x3F1C, 0x0008 }, // Palette mirror boundary
+	{ 0x3FF0, 0x0010 }, // Last bytes
+};
+
+/**
+ * Fill the memory of the buses with a pattern
+ */
+static int memory_setup(bool paged)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, paged) == EXIT_SUCCESS);
+	for (size_t i = 0; i < 2 * TEST_BANK_SIZE; i++) {
+		cartridge.mapper.nrom.prgrom[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+	for (size_t i = 0; i < sizeof(test_mapper_ram); i++) {
+		test_mapper_ram[i] = (uint8_t)(i * 3 + (i >> 8));
+	}
+
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	for (size_t i = 0; i < sizeof(mem.ram); i++) {
+		mem.ram[i] = (uint8_t)(i * 5 + (i >> 8));
+	}
+	for (size_t i = 0; i < sizeof(mem.ppu_registers); i++) {
+		mem.ppu_registers[i] = (uint8_t)(0xA0 + i);
+	}
+
+	TEST_OK(nes_vram_init(&vim, &cartridge));
+	for (size_t i = 0; i < sizeof(vim.ciram); i++) {
+		vim.ciram[i] = (uint8_t)(i * 11 + (i >> 8));
+	}
+	for (size_t i = 0; i < sizeof(vim.palette_ram); i++) {
+		vim.palette_ram[i] = (uint8_t)(0x40 + i);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int memory_read_main(void)
+{
+	for (size_t r = 0; r < sizeof(main_ranges) / sizeof(main_ranges[0]);
+	     r++) {
+		const struct memory_range *range = &main_ranges[r];
+		TEST_OK(nes_mem_read_block(&mem, range->addr, buffer,
+					   range->size));
+		for (size_t i = 0; i < range->size; i++) {
+			TEST_OK(nes_mem_r8(&mem, (uint16_t)(range->addr + i),
+					   &expected[i]));
+		}
+		if (memcmp(buffer, expected, range->size) != 0) {
+			fprintf(stderr, "read_block $%04X+%zu differs\n",
+				range->addr, range->size);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int memory_read_video(void)
+{
+	for (size_t r = 0; r < sizeof(video_ranges) / sizeof(video_ranges[0]);
+	     r++) {
+		const struct memory_range *range = &video_ranges[r];
+		TEST_OK(nes_vram_read_block(&vim, range->addr, buffer,
+					    range->size));
+		for (size_t i = 0; i < range->size; i++) {
+			TEST_OK(nes_vram_r8(&vim, (uint16_t)(range->addr + i),
+					    &expected[i]));
+		}
+		if (memcmp(buffer, expected, range->size) != 0) {
+			fprintf(stderr, "vram read_block $%04X+%zu differs\n",
+				range->addr, range->size);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int test_read_block(void)
+{
+	// Fast path
+	TEST_ASSERT(memory_setup(true) == EXIT_SUCCESS);
+	TEST_ASSERT(memory_read_main() == EXIT_SUCCESS);
+	TEST_ASSERT(memory_read_video() == EXIT_SUCCESS);
+
+	// Mirrors hold the same bytes
+	TEST_OK(nes_mem_read_block(&mem, 0x1800, buffer, 0x0800));
+	TEST_ASSERT(memcmp(buffer, mem.ram, sizeof(mem.ram)) == 0);
+	TEST_OK(nes_mem_read_block(&mem, 0x3FF8, buffer, 8));
+	TEST_ASSERT(memcmp(buffer, mem.ppu_registers, 8) == 0);
+
+	// Cartridge callbacks, byte by byte
+	TEST_ASSERT(memory_setup(false) == EXIT_SUCCESS);
+	cartridge.chr_page_fn = NULL;
+	TEST_ASSERT(memory_read_main() == EXIT_SUCCESS);
+	return memory_read_video();
+}
+
+static int test_write_block(void)
+{
+	TEST_ASSERT(memory_setup(true) == EXIT_SUCCESS);
+	// Same state, its own page table
+	TEST_OK(nes_mem_init(&ref, &cartridge));
+	memcpy(ref.ram, mem.ram, sizeof(ref.ram));
+	memcpy(ref.ppu_registers, mem.ppu_registers,
+	       sizeof(ref.ppu_registers));
+	for (size_t i = 0; i < sizeof(buffer); i++) {
+		buffer[i] = (uint8_t)(i * 13 + (i >> 8));
+	}
+
+	// Over RAM mirrors and into the PPU registers
+	static const struct memory_range ranges[] = {
+		{ 0x07F8, 0x0010 },
+		{ 0x0F00, 0x1180 },
+		{ 0x3FFC, 0x0004 },
+	};
+	for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+		const struct memory_range *range = &ranges[r];
+		TEST_OK(nes_mem_write_block(&mem, range->addr, buffer,
+					    range->size));
+		for (size_t i = 0; i < range->size; i++) {
+			TEST_OK(nes_mem_w8(&ref, (uint16_t)(range->addr + i),
+					   buffer[i]));
+		}
+	}
+	TEST_ASSERT(memcmp(mem.ram, ref.ram, sizeof(mem.ram)) == 0);
+	TEST_ASSERT(memcmp(mem.ppu_registers, ref.ppu_registers,
+			   sizeof(mem.ppu_registers)) == 0);
+
+	// Cartridge RAM up to its last byte
+	TEST_OK(nes_mem_write_block(&mem, 0x7F00, buffer, 0x0100));
+	TEST_ASSERT(memcmp(&test_mapper_ram[0x1F00], buffer, 0x0100) == 0);
+
+	// Nametables (and their mirrors) and palette
+	TEST_OK(nes_vram_init(&vim, &cartridge));
+	TEST_OK(nes_vram_init(&vim_ref, &cartridge));
+	static const struct memory_range video[] = {
+		{ 0x23F0, 0x0420 },
+		{ 0x2BF8, 0x0410 },
+		{ 0x3EF8, 0x0010 },
+		{ 0x3F00, 0x0100 },
+	};
+	for (size_t r = 0; r < sizeof(video) / sizeof(video[0]); r++) {
+		const struct memory_range *range = &video[r];
+		TEST_OK(nes_vram_write_block(&vim, range->addr, buffer,
+					     range->size));
+		for (size_t i = 0; i < range->size; i++) {
+			TEST_OK(nes_vram_w8(&vim_ref,
+					    (uint16_t)(range->addr + i),
+					    buffer[i]));
+		}
+	}
+	TEST_ASSERT(memcmp(vim.ciram, vim_ref.ciram, sizeof(vim.ciram)) == 0);
+	TEST_ASSERT(memcmp(vim.palette_ram, vim_ref.palette_ram,
+			   sizeof(vim.palette_ram)) == 0);
+
+	// CHR ROM cannot be written
+	TEST_ASSERT(nes_vram_write_block(&vim, 0x1FF0, buffer, 0x20) ==
+		    NESEMU_RETURN_CARTRIDGE_CHRROM_READ_ONLY);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * PRG ROM in 1 KiB banks, swapped in pairs (never contiguous over 8 KiB)
+ */
+static nesemu_return_t memory_page_1k(nesemu_mapper_generic_ref_t self,
+				      uint16_t addr,
+				      const uint8_t **read,
+				      uint8_t **write)
+{
+	struct nes_ines_nrom_cartridge *nrom = self;
+	if (addr < NESEMU_CARTRIDGE_ROM_BEGIN) {
+		return test_mapper_page(self, addr, read, write);
+	}
+
+	*read = &nrom->prgrom[(addr ^ 0x0400) % TEST_BANK_SIZE];
+	*write = NULL;
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static int test_page_table(void)
+{
+	TEST_ASSERT(memory_setup(true) == EXIT_SUCCESS);
+	const uint8_t *prgrom = cartridge.mapper.nrom.prgrom;
+
+	// RAM mirrors point into the work RAM, registers have no fast path
+	TEST_ASSERT(mem.read[0x0B] == &mem.ram[0x0300]);
+	TEST_ASSERT(mem.write[0x1F] == &mem.ram[0x0700]);
+	TEST_ASSERT(mem.read[0x20] == NULL && mem.write[0x3F] == NULL);
+	TEST_ASSERT(mem.read[0x40] == NULL && mem.write[0x40] == NULL);
+	TEST_ASSERT(mem.write[0x60] == &test_mapper_ram[0]);
+
+	// Every page of a small bank is a plain load
+	cartridge.prg_page_fn = memory_page_1k;
+	nes_mem_map(&mem);
+	for (uint16_t page = 0x80; page <= 0xFF; page++) {
+		uint16_t addr = (uint16_t)(page << 8);
+		TEST_ASSERT(mem.read[page] ==
+			    &prgrom[(addr ^ 0x0400) % TEST_BANK_SIZE]);
+		TEST_ASSERT(mem.write[page] == NULL);
+	}
+	TEST_ASSERT(nes_mem_read8(&mem, 0x8001) == prgrom[0x0401]);
+	TEST_ASSERT(nes_mem_read8(&mem, 0x87FF) == prgrom[0x03FF]);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_out_of_range(void)
+{
+	TEST_ASSERT(memory_setup(true) == EXIT_SUCCESS);
+
+	// Up to the end is fine, one more byte is not (the checks are compiled
+	// out without the safety checks)
+	TEST_OK(nes_mem_read_block(&mem, 0xFF00, buffer, 0x100));
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	TEST_ASSERT(nes_mem_read_block(&mem, 0xFF00, buffer, 0x101) ==
+		    NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+	TEST_ASSERT(nes_mem_write_block(&mem, 0xFFFF, buffer, 2) ==
+		    NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+	TEST_ASSERT(nes_mem_read_block(&mem, 0x0000, NULL, 1) ==
+		    NESEMU_RETURN_BAD_ARGUMENTS);
+#endif
+
+	TEST_OK(nes_vram_read_block(&vim, 0x3F00, buffer, 0x100));
+#ifndef CONFIG_NESEMU_DISABLE_SAFETY_CHECKS
+	TEST_ASSERT(nes_vram_read_block(&vim, 0x3F00, buffer, 0x101) ==
+		    NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+	TEST_ASSERT(nes_vram_write_block(&vim, 0x4000, buffer, 1) ==
+		    NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+	TEST_ASSERT(nes_vram_write_block(&vim, 0x2000, NULL, 1) ==
+		    NESEMU_RETURN_BAD_ARGUMENTS);
+
+	// Nothing is written when the end is out of range
+	uint8_t palette_ram[sizeof(vim.palette_ram)];
+	memcpy(palette_ram, vim.palette_ram, sizeof(palette_ram));
+	TEST_ASSERT(nes_vram_write_block(&vim, 0x3FFF, buffer, 2) ==
+		    NESEMU_RETURN_MEMORY_INVALILD_ADDR);
+	TEST_ASSERT(memcmp(vim.palette_ram, palette_ram, sizeof(palette_ram)) ==
+		    0);
+#endif
+
+	// Errors of the handlers stop the transfer
+	TEST_ASSERT(nes_mem_read_block(&mem, 0x5FF0, buffer, 0x20) ==
+		    NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_read_block);
+	TEST_RUN(result, test_write_block);
+	TEST_RUN(result, test_page_table);
+	TEST_RUN(result, test_out_of_range);
+
+	return result;
+}
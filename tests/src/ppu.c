@@ -0,0 +1,282 @@
+/**
+ * PPU registers: side effects of CPU reads and writes through the bus, OAM
+ * DMA and the cycles it takes from the CPU
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/video.h"
+#include "nesemu/ppu/palette.h"
+#include "nesemu/ppu/ppu.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static nes_ppu_system_palette_t palette = NESEMU_PALETTE_STANDARD;
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_mem_video vim;
+static struct nes_ppu ppu;
+static struct nes_cpu cpu;
+static struct nes_cpu_block_cache blocks;
+
+/**
+ * Bus, video memory and PPU over the test mapper
+ */
+static int ppu_setup(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_vram_init(&vim, &cartridge));
+	TEST_OK(nes_ppu_init(&ppu, &palette, &mem, &vim));
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Point the VRAM address at 'addr' through PPUADDR
+ */
+static int ppu_address(uint16_t addr)
+{
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUADDR, (uint8_t)(addr >> 8)));
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUADDR, (uint8_t)addr));
+	TEST_ASSERT(ppu.v == addr);
+	TEST_ASSERT(ppu.w == 0);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_ppudata_increment(void)
+{
+	TEST_ASSERT(ppu_setup() == EXIT_SUCCESS);
+	TEST_OK(nes_vram_w8(&vim, 0x2000, 0x11));
+	TEST_OK(nes_vram_w8(&vim, 0x2001, 0x22));
+	uint8_t value = 0;
+
+	// Across the nametable, one byte behind (read buffer)
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUCTRL, 0x00));
+	TEST_ASSERT(ppu.increment == 1);
+	TEST_ASSERT(ppu_address(0x2000) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUDATA, &value));
+	TEST_ASSERT(ppu.v == 0x2001);
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUDATA, &value));
+	TEST_ASSERT(ppu.v == 0x2002);
+	TEST_ASSERT(value == 0x11);
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUDATA, &value));
+	TEST_ASSERT(value == 0x22);
+
+	// Down the nametable, through a register mirror
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUCTRL,
+			   NESEMU_PPU_PPUCTRL_INCREMENT));
+	TEST_ASSERT(ppu.increment == 32);
+	TEST_ASSERT(ppu_address(0x2000) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUDATA, &value));
+	TEST_ASSERT(ppu.v == 0x2020);
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUDATA + 0x1FF8, &value));
+	TEST_ASSERT(ppu.v == 0x2040);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_ppustatus_clear(void)
+{
+	TEST_ASSERT(ppu_setup() == EXIT_SUCCESS);
+	uint8_t value = 0;
+
+	// First half of a PPUSCROLL write pending
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUSCROLL, 0x00));
+	TEST_ASSERT(ppu.w == 1);
+	ppu.status |= NESEMU_PPU_PPUSTATUS_VBLANK;
+
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUSTATUS, &value));
+	TEST_ASSERT(value & NESEMU_PPU_PPUSTATUS_VBLANK);
+	TEST_ASSERT(!(ppu.status & NESEMU_PPU_PPUSTATUS_VBLANK));
+	TEST_ASSERT(ppu.w == 0);
+
+	// Read once only
+	TEST_OK(nes_mem_r8(&mem, NESEMU_PPU_REG_PPUSTATUS, &value));
+	TEST_ASSERT(!(value & NESEMU_PPU_PPUSTATUS_VBLANK));
+
+	// The next PPUADDR write is a first half again
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_PPUADDR, 0x21));
+	TEST_ASSERT(ppu.w == 1);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run `wait: LDA $2007; BEQ wait` over zeroed video memory
+ *
+ * @param with_blocks Attach the block cache (polling loop detection)
+ */
+static int ppu_poll(bool with_blocks, uint16_t *v, uint64_t *clock)
+{
+	static const uint8_t code[] = { 0xAD, 0x07, 0x20, 0xF0, 0xFB };
+
+	TEST_ASSERT(ppu_setup() == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code, sizeof(code));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	if (with_blocks) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		TEST_OK(nes_cpu_block_cache_attach(&blocks, &cpu));
+	}
+	TEST_ASSERT(ppu_address(0x2000) == EXIT_SUCCESS);
+	cpu.pc = 0xC000;
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 700, &cycles));
+	*v = ppu.v;
+	*clock = cpu.clock;
+
+	return EXIT_SUCCESS;
+}
+
+static int test_ppudata_polling(void)
+{
+	uint16_t v = 0;
+	uint16_t v_blocks = 0;
+	uint64_t clock = 0;
+	uint64_t clock_blocks = 0;
+
+	TEST_ASSERT(ppu_poll(false, &v, &clock) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_poll(true, &v_blocks, &clock_blocks) == EXIT_SUCCESS);
+
+	// Every iteration reads PPUDATA, none is skipped
+	TEST_ASSERT(v > 0x2000 + 50);
+	TEST_ASSERT(clock_blocks == clock);
+	TEST_ASSERT(v_blocks == v);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Fill a 256-byte page of the CPU bus with a pattern
+ */
+static int ppu_dma_page(uint16_t src)
+{
+	for (uint16_t i = 0; i < 0x100; i++) {
+		TEST_OK(nes_mem_w8(&mem, (uint16_t)(src + i),
+				   (uint8_t)(i * 7 + (src >> 8))));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Copy the page 'src' to OAM through $4014, starting at OAMADDR 'oam_addr'
+ */
+static int ppu_dma_check(uint16_t src, uint8_t oam_addr)
+{
+	const uint8_t *oam = (const uint8_t *)ppu.oam;
+
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_OAMADDR, oam_addr));
+	TEST_OK(nes_mem_w8(&mem, NESEMU_PPU_REG_OAMDMA, (uint8_t)(src >> 8)));
+	TEST_ASSERT(mem.stall == NESEMU_PPU_OAMDMA_CYCLES);
+	mem.stall = 0;
+
+	// Wraps around OAM from OAMADDR, which is left as it was
+	for (uint16_t i = 0; i < 0x100; i++) {
+		uint8_t value = 0;
+		TEST_OK(nes_mem_r8(&mem, (uint16_t)(src + i), &value));
+		TEST_ASSERT(oam[(uint8_t)(oam_addr + i)] == value);
+	}
+	TEST_ASSERT(ppu.oam_addr == oam_addr);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_oam_dma(void)
+{
+	TEST_ASSERT(ppu_setup() == EXIT_SUCCESS);
+	TEST_ASSERT(sizeof(ppu.oam) == 0x100);
+
+	// Work RAM and its mirror, cartridge RAM and PRG ROM
+	TEST_ASSERT(ppu_dma_page(0x0200) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_dma_page(0x6100) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_dma_check(0x0200, 0x00) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_dma_check(0x0A00, 0x04) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_dma_check(0x6100, 0x81) == EXIT_SUCCESS);
+	TEST_ASSERT(ppu_dma_check(0xC000, 0xFF) == EXIT_SUCCESS);
+
+	// Through the cartridge callbacks
+	TEST_ASSERT(test_mapper_setup(&cartridge, false) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_ppu_init(&ppu, &palette, &mem, &vim));
+	TEST_ASSERT(ppu_dma_page(0x7F00) == EXIT_SUCCESS);
+	return ppu_dma_check(0x7F00, 0x10);
+}
+
+/**
+ * Run `STA $4014` from 'clock', return the cycles the instruction took
+ *
+ * @param with_run Run through 'nes_cpu_run' and the block cache instead of
+ * 'nes_cpu_next'
+ */
+static int ppu_dma_stall(uint64_t clock, bool with_run, int *cycles)
+{
+	static const uint8_t code[] = { 0x8D, 0x14, 0x40, 0xDB };
+
+	TEST_ASSERT(ppu_setup() == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code, sizeof(code));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	if (with_run) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		TEST_OK(nes_cpu_block_cache_attach(&blocks, &cpu));
+	}
+	cpu.pc = 0xC000;
+	cpu.a = 0x02;
+	cpu.clock = clock;
+
+	if (with_run) {
+		TEST_OK(nes_cpu_run(&cpu, &mem, 1, cycles));
+	} else {
+		TEST_OK(nes_cpu_next(&cpu, &mem, cycles));
+	}
+	TEST_ASSERT(cpu.pc == 0xC003);
+	TEST_ASSERT(cpu.clock == clock + (uint64_t)*cycles);
+	TEST_ASSERT(mem.stall == 0);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_oam_dma_stall(void)
+{
+	for (int with_run = 0; with_run < 2; with_run++) {
+		int cycles = 0;
+
+		// STA abs ends on an even cycle, 513 cycles
+		TEST_ASSERT(ppu_dma_stall(0, with_run, &cycles) ==
+			    EXIT_SUCCESS);
+		TEST_ASSERT(cycles == 4 + NESEMU_PPU_OAMDMA_CYCLES);
+
+		// Odd cycle, one more to realign
+		TEST_ASSERT(ppu_dma_stall(1, with_run, &cycles) ==
+			    EXIT_SUCCESS);
+		TEST_ASSERT(cycles == 4 + NESEMU_PPU_OAMDMA_CYCLES + 1);
+		TEST_ASSERT(ppu_dma_stall(1000001, with_run, &cycles) ==
+			    EXIT_SUCCESS);
+		TEST_ASSERT(cycles == 4 + NESEMU_PPU_OAMDMA_CYCLES + 1);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_ppudata_increment);
+	TEST_RUN(result, test_ppustatus_clear);
+	TEST_RUN(result, test_ppudata_polling);
+	TEST_RUN(result, test_oam_dma);
+	TEST_RUN(result, test_oam_dma_stall);
+
+	return result;
+}
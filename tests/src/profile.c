@@ -0,0 +1,247 @@
+/**
+ * Profiler: opcode, opcode pair, $pc and page crossing counters of a known
+ * program, and their CSV and JSON exports
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/profile.h"
+#include "nesemu/memory/main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_block_cache blocks;
+static struct nes_cpu_profile profile;
+
+static char output[0x4000];
+
+/*
+ * One indexed read crossing a page, one that does not, a branch taken
+ * within its page and one taken across
+ */
+static const uint8_t code[] = {
+	0xA2, 0x01, // $C0F0 LDX #$01
+	0xBD, 0xFF, 0x02, // $C0F2 LDA $02FF,X (crosses)
+	0xBD, 0x00, 0x02, // $C0F5 LDA $0200,X
+	0xCA, // $C0F8 DEX
+	0xF0, 0x01, // $C0F9 BEQ $C0FC
+	0xEA, // $C0FB NOP (skipped)
+	0xF0, 0x10, // $C0FC BEQ $C10E (crosses)
+};
+static const uint8_t code_stop[] = {
+	0xDB, // $C10E STP
+};
+
+/**
+ * Addresses executed once by a run of 'code'
+ */
+static const uint16_t profile_pcs[] = { 0xC0F0, 0xC0F2, 0xC0F5, 0xC0F8,
+					0xC0F9, 0xC0FC, 0xC10E };
+
+/**
+ * Run the program once, through the block cache (bypassed while profiling)
+ */
+static int profile_run(void)
+{
+	cpu.pc = 0xC0F0;
+	cpu.stop = false;
+
+	int cycles = 0;
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+	TEST_ASSERT(cpu.stop && cpu.brk == 0x00);
+	TEST_ASSERT(cpu.pc == 0xC10F);
+
+	return EXIT_SUCCESS;
+}
+
+static int profile_setup(void)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC0F0, code, sizeof(code));
+	test_mapper_program(&cartridge, 0, 0xC10E, code_stop,
+			    sizeof(code_stop));
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+	TEST_OK(nes_cpu_block_cache_attach(&blocks, &cpu));
+	TEST_OK(nes_cpu_profile_reset(&profile));
+	TEST_OK(nes_cpu_profile_attach(&profile, &cpu));
+
+	return EXIT_SUCCESS;
+}
+
+static int test_counters(void)
+{
+	TEST_ASSERT(profile_setup() == EXIT_SUCCESS);
+	TEST_ASSERT(profile.last == NESEMU_CPU_PROFILE_NO_OPCODE);
+	TEST_ASSERT(profile_run() == EXIT_SUCCESS);
+
+	TEST_ASSERT(profile.opcodes[0xA2] == 1);
+	TEST_ASSERT(profile.opcodes[0xBD] == 2);
+	TEST_ASSERT(profile.opcodes[0xCA] == 1);
+	TEST_ASSERT(profile.opcodes[0xF0] == 2);
+	TEST_ASSERT(profile.opcodes[0xDB] == 1);
+	TEST_ASSERT(profile.opcodes[0xEA] == 0);
+
+	TEST_ASSERT(profile.pairs[0xA2][0xBD] == 1);
+	TEST_ASSERT(profile.pairs[0xBD][0xBD] == 1);
+	TEST_ASSERT(profile.pairs[0xBD][0xCA] == 1);
+	TEST_ASSERT(profile.pairs[0xCA][0xF0] == 1);
+	TEST_ASSERT(profile.pairs[0xF0][0xF0] == 1);
+	TEST_ASSERT(profile.pairs[0xF0][0xDB] == 1);
+	TEST_ASSERT(profile.last == 0xDB);
+
+	for (size_t i = 0; i < sizeof(profile_pcs) / sizeof(profile_pcs[0]);
+	     i++) {
+		TEST_ASSERT(profile.pcs[profile_pcs[i]] == 1);
+	}
+	TEST_ASSERT(profile.pcs[0xC0FB] == 0);
+
+	// Only the crossing read and the branch across the page
+	TEST_ASSERT(profile.page_crosses[0xBD] == 1);
+	TEST_ASSERT(profile.page_crosses[0xF0] == 1);
+
+	uint64_t total = 0;
+	uint64_t crosses = 0;
+	for (int i = 0; i < 256; i++) {
+		total += profile.opcodes[i];
+		crosses += profile.page_crosses[i];
+	}
+	TEST_ASSERT(total == 7 && crosses == 2);
+
+	// Kept across runs, the pair between them included
+	TEST_ASSERT(profile_run() == EXIT_SUCCESS);
+	TEST_ASSERT(profile.opcodes[0xBD] == 4);
+	TEST_ASSERT(profile.pairs[0xDB][0xA2] == 1);
+	TEST_ASSERT(profile.pcs[0xC0F0] == 2);
+	TEST_ASSERT(profile.page_crosses[0xF0] == 2);
+
+	// Cleared
+	TEST_OK(nes_cpu_profile_reset(&profile));
+	TEST_ASSERT(profile.opcodes[0xBD] == 0 && profile.pcs[0xC0F0] == 0);
+	TEST_ASSERT(profile.last == NESEMU_CPU_PROFILE_NO_OPCODE);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Export the counters of a single run into 'output'
+ */
+static int profile_export(bool json)
+{
+	TEST_ASSERT(profile_setup() == EXIT_SUCCESS);
+	TEST_ASSERT(profile_run() == EXIT_SUCCESS);
+
+	FILE *f = tmpfile();
+	TEST_ASSERT(f != NULL);
+	nesemu_return_t err = json ? nes_cpu_profile_dump_json(&profile, f) :
+				     nes_cpu_profile_dump_csv(&profile, f);
+	long int size = ftell(f);
+	rewind(f);
+	size_t len = fread(output, 1, sizeof(output) - 1, f);
+	(void)fclose(f);
+
+	TEST_OK(err);
+	TEST_ASSERT(size > 0 && len == (size_t)size);
+	output[len] = '\0';
+
+	return EXIT_SUCCESS;
+}
+
+static int test_csv(void)
+{
+	static const char *const rows[] = {
+		"kind,key,mnemonic,count\n",
+		"opcode,A2,LDX,1\n",
+		"opcode,BD,LDA,2\n",
+		"opcode,F0,BEQ,2\n",
+		"pair,BD CA,LDA DEX,1\n",
+		"pair,F0 F0,BEQ BEQ,1\n",
+		"pc,C0F2,,1\n",
+		"pc,C10E,,1\n",
+		"page_cross,BD,LDA,1\n",
+		"page_cross,F0,BEQ,1\n",
+	};
+
+	TEST_ASSERT(profile_export(false) == EXIT_SUCCESS);
+	TEST_ASSERT(strncmp(output, rows[0], strlen(rows[0])) == 0);
+	for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+		if (strstr(output, rows[i]) == NULL) {
+			fprintf(stderr, "missing row: %s", rows[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Header, 5 opcodes, 6 pairs, 7 addresses and 2 page crossings
+	size_t lines = 0;
+	for (const char *c = output; *c != '\0'; c++) {
+		lines += (*c == '\n');
+	}
+	TEST_ASSERT(lines == 1 + 5 + 6 + 7 + 2);
+	TEST_ASSERT(strstr(output, "EA") == NULL);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_json(void)
+{
+	static const char *const members[] = {
+		"\"opcodes\": {",
+		"\"BD\": 2",
+		"\"pairs\": {",
+		"\"A2BD\": 1",
+		"\"F0DB\": 1",
+		"\"pcs\": {",
+		"\"C0F2\": 1",
+		"\"C10E\": 1",
+		"\"page_crosses\": {",
+		"\"F0\": 1\n  }\n}\n",
+	};
+
+	TEST_ASSERT(profile_export(true) == EXIT_SUCCESS);
+	TEST_ASSERT(output[0] == '{');
+	for (size_t i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+		if (strstr(output, members[i]) == NULL) {
+			fprintf(stderr, "missing member: %s\n", members[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Balanced, no trailing comma
+	int depth = 0;
+	for (const char *c = output; *c != '\0'; c++) {
+		depth += (*c == '{') - (*c == '}');
+		TEST_ASSERT(depth >= 0);
+		if (*c == ',') {
+			const char *next = c + 1;
+			while (*next == ' ' || *next == '\n') {
+				next++;
+			}
+			TEST_ASSERT(*next == '"');
+		}
+	}
+	TEST_ASSERT(depth == 0);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_counters);
+	TEST_RUN(result, test_csv);
+	TEST_RUN(result, test_json);
+
+	return result;
+}
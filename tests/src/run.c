@@ -0,0 +1,239 @@
+/**
+ * nestest through 'nes_cpu_run' with every execution engine, checked
+ * against 'nes_cpu_next' (also built with the lazy N & Z flags, see
+ * TestRunLazy)
+ *
+ * Reference:
+ * https://www.qmtpro.com/~nes/misc/nestest.txt
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cache.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/jit.h"
+#include "nesemu/memory/main.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_cache cache;
+static struct nes_cpu_block_cache blocks;
+static struct nes_cpu_jit jit;
+
+/**
+ * Final state of a run
+ */
+struct run_state {
+	struct nes_cpu cpu;
+	uint8_t ram[NESEMU_MEMORY_RAM_SIZE];
+	long int cycles;
+};
+
+static struct run_state reference;
+
+/**
+ * FNV-1a over the registers after every instruction of the reference run
+ * (see 'TEST_NESTEST_TRACE_HASH')
+ */
+static uint64_t run_hash(uint64_t hash, const struct nes_cpu *state)
+{
+	const uint8_t bytes[] = {
+		(uint8_t)state->pc,
+		(uint8_t)(state->pc >> 8),
+		state->a,
+		state->x,
+		state->y,
+		state->sp,
+		state->status,
+		(uint8_t)state->clock,
+	};
+
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+/**
+ * Execution engines attached to 'nes_cpu_run'
+ */
+enum run_engine {
+	RUN_PLAIN,
+	RUN_CACHE,
+	RUN_BLOCKS,
+	RUN_JIT,
+	RUN_JIT_DIFFERENTIAL,
+};
+
+/**
+ * Compare a run with the reference
+ */
+static int run_check(const struct run_state *state)
+{
+	TEST_ASSERT(state->cycles == TEST_NESTEST_CYCLES);
+	TEST_ASSERT(state->cpu.stop);
+	TEST_ASSERT(state->cpu.brk == 0x00);
+	TEST_ASSERT(state->cpu.pc == reference.cpu.pc);
+	TEST_ASSERT(state->cpu.a == reference.cpu.a);
+	TEST_ASSERT(state->cpu.x == reference.cpu.x);
+	TEST_ASSERT(state->cpu.y == reference.cpu.y);
+	TEST_ASSERT(state->cpu.sp == reference.cpu.sp);
+	TEST_ASSERT(state->cpu.status == reference.cpu.status);
+	TEST_ASSERT(state->cpu.clock == reference.cpu.clock);
+	TEST_ASSERT(memcmp(state->ram, reference.ram, sizeof(state->ram)) == 0);
+
+	// nestest error codes
+	TEST_ASSERT(state->ram[0x02] == 0x00 && state->ram[0x03] == 0x00);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run nestest with 'engine' attached, in slices of 'budget' cycles
+ */
+static int run_nestest(enum run_engine engine,
+		       int budget,
+		       struct run_state *state)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+
+	if (engine == RUN_CACHE) {
+		TEST_OK(nes_cpu_cache_init(&cache, &mem));
+		nes_cpu_cache_attach(&cache, &cpu);
+	}
+	if (engine >= RUN_BLOCKS) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		nes_cpu_block_cache_attach(&blocks, &cpu);
+	}
+	if (engine >= RUN_JIT) {
+		jit.differential = (engine == RUN_JIT_DIFFERENTIAL);
+		nes_cpu_jit_attach(&jit, &cpu);
+	}
+
+	state->cycles = 0;
+	while (!cpu.stop) {
+		int cycles = 0;
+		TEST_OK(nes_cpu_run(&cpu, &mem, budget, &cycles));
+		TEST_ASSERT(cycles > 0);
+		state->cycles += cycles;
+	}
+
+	nes_cpu_status_sync(&cpu);
+	state->cpu = cpu;
+	memcpy(state->ram, mem.ram, sizeof(state->ram));
+
+	return EXIT_SUCCESS;
+}
+
+static int test_reference(void)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+
+	long int instructions = 0;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	reference.cycles = 0;
+	while (!cpu.stop) {
+		int cycles = 0;
+		TEST_OK(nes_cpu_next(&cpu, &mem, &cycles));
+		reference.cycles += cycles;
+		instructions++;
+		hash = run_hash(hash, &cpu);
+	}
+
+	nes_cpu_status_sync(&cpu);
+	reference.cpu = cpu;
+	memcpy(reference.ram, mem.ram, sizeof(reference.ram));
+
+	// Same registers after every instruction in every build (lazy flags
+	// included)
+	TEST_ASSERT(instructions == TEST_NESTEST_INSTRUCTIONS);
+	TEST_ASSERT(hash == TEST_NESTEST_TRACE_HASH);
+	return run_check(&reference);
+}
+
+static int test_plain(void)
+{
+	struct run_state state;
+	TEST_ASSERT(run_nestest(RUN_PLAIN, INT_MAX, &state) == EXIT_SUCCESS);
+	TEST_ASSERT(run_check(&state) == EXIT_SUCCESS);
+
+	// Small budgets stop and resume at instruction boundaries
+	TEST_ASSERT(run_nestest(RUN_PLAIN, 1, &state) == EXIT_SUCCESS);
+	return run_check(&state);
+}
+
+static int test_decode_cache(void)
+{
+	struct run_state state;
+	TEST_ASSERT(run_nestest(RUN_CACHE, INT_MAX, &state) == EXIT_SUCCESS);
+	return run_check(&state);
+}
+
+static int test_block_cache(void)
+{
+	struct run_state state;
+	TEST_ASSERT(run_nestest(RUN_BLOCKS, INT_MAX, &state) == EXIT_SUCCESS);
+	TEST_ASSERT(run_check(&state) == EXIT_SUCCESS);
+
+	// Superinstructions were executed
+	bool fused = false;
+	for (uint16_t i = 0; i < blocks.count && !fused; i++) {
+		for (uint8_t j = 0; j < blocks.blocks[i].length; j++) {
+			fused |= blocks.blocks[i].insts[j].fused !=
+				 NESEMU_CPU_FUSED_NONE;
+		}
+	}
+	TEST_ASSERT(fused);
+
+	// Blocks cut short by the budget
+	TEST_ASSERT(run_nestest(RUN_BLOCKS, 7, &state) == EXIT_SUCCESS);
+	return run_check(&state);
+}
+
+static int test_jit(void)
+{
+	nesemu_return_t err = nes_cpu_jit_init(&jit, NESEMU_CPU_JIT_BUFFER_SIZE);
+	if (err == NESEMU_RETURN_CPU_JIT_UNSUPPORTED) {
+		printf("     JIT not supported on this host, skipped\n");
+		return EXIT_SUCCESS;
+	}
+	TEST_OK(err);
+
+	struct run_state state;
+	int result = run_nestest(RUN_JIT_DIFFERENTIAL, INT_MAX, &state);
+	if (result == EXIT_SUCCESS) {
+		result = run_check(&state);
+	}
+	if (result == EXIT_SUCCESS) {
+		result = run_nestest(RUN_JIT, INT_MAX, &state);
+	}
+	if (result == EXIT_SUCCESS) {
+		result = run_check(&state);
+	}
+
+	(void)nes_cpu_jit_destroy(&jit);
+	return result;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_reference);
+	TEST_RUN(result, test_plain);
+	TEST_RUN(result, test_decode_cache);
+	TEST_RUN(result, test_block_cache);
+	TEST_RUN(result, test_jit);
+
+	return result;
+}
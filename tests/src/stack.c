@@ -0,0 +1,103 @@
+/**
+ * Stack: pushes and pulls land in page $01 of the work RAM
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/memory/stack.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+
+static int test_push_pop_u8(void)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+	memset(mem.ram, 0, sizeof(mem.ram));
+
+	uint8_t sp = 0xFD;
+	TEST_OK(nes_stack_push_u8(&mem, &sp, 0x42));
+	TEST_ASSERT(sp == 0xFC);
+	TEST_ASSERT(mem.ram[0x01FD] == 0x42);
+	// Not folded onto the zero page
+	TEST_ASSERT(mem.ram[0x00FD] == 0x00);
+
+	uint8_t value = 0;
+	TEST_OK(nes_stack_pop_u8(&mem, &sp, &value));
+	TEST_ASSERT(sp == 0xFD);
+	TEST_ASSERT(value == 0x42);
+
+	// Through the bus as well
+	TEST_OK(nes_mem_r8(&mem, 0x01FD, &value));
+	TEST_ASSERT(value == 0x42);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_push_pop_u16(void)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+	memset(mem.ram, 0, sizeof(mem.ram));
+
+	// Little-endian, MSB pushed first
+	uint8_t sp = 0xFD;
+	TEST_OK(nes_stack_push_u16(&mem, &sp, 0xC5FF));
+	TEST_ASSERT(sp == 0xFB);
+	TEST_ASSERT(mem.ram[0x01FD] == 0xC5);
+	TEST_ASSERT(mem.ram[0x01FC] == 0xFF);
+	TEST_ASSERT(mem.ram[0x00FD] == 0x00 && mem.ram[0x00FC] == 0x00);
+
+	uint16_t value = 0;
+	TEST_OK(nes_stack_pop_u16(&mem, &sp, &value));
+	TEST_ASSERT(sp == 0xFD);
+	TEST_ASSERT(value == 0xC5FF);
+
+	// The second byte wraps around within page $01
+	sp = 0xFE;
+	mem.ram[0x01FF] = 0x34;
+	mem.ram[0x0100] = 0x12;
+	TEST_OK(nes_stack_pop_u16(&mem, &sp, &value));
+	TEST_ASSERT(value == 0x1234);
+	TEST_ASSERT(sp == 0x00);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_instructions(void)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+	memset(mem.ram, 0, sizeof(mem.ram));
+
+	// nestest: JMP, LDX, STX, STX, STX then `C5FD JSR $C72D` with $sp=$FD
+	int c = 0;
+	for (int i = 0; i < 6; i++) {
+		TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	}
+	TEST_ASSERT(cpu.pc == 0xC72D);
+	TEST_ASSERT(cpu.sp == 0xFB);
+
+	// Return address minus one
+	TEST_ASSERT(mem.ram[0x01FD] == 0xC5);
+	TEST_ASSERT(mem.ram[0x01FC] == 0xFF);
+	TEST_ASSERT(mem.ram[0x00FD] == 0x00 && mem.ram[0x00FC] == 0x00);
+
+	return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_push_pop_u8);
+	TEST_RUN(result, test_push_pop_u16);
+	TEST_RUN(result, test_instructions);
+
+	return result;
+}
@@ -0,0 +1,235 @@
+/**
+ * Helpers shared by the unit tests: assertions, loading nestest and a
+ * bank switching test mapper
+ *
+ * Run the tests from 'tests/resources' so that nestest.nes is found.
+ */
+
+#ifndef __NESEMU_TESTS_TEST_H__
+#define __NESEMU_TESTS_TEST_H__
+
+#include "nesemu/cartridge/cartridge.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+#include "nesemu/util/error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_CARTRIDGE "nestest.nes"
+
+/**
+ * Initial $pc address for the headless nestest run
+ */
+#define TEST_NESTEST_PC 0xC000
+
+/**
+ * Cycles and instructions of the headless nestest run (until STP)
+ */
+#define TEST_NESTEST_CYCLES 8774
+#define TEST_NESTEST_INSTRUCTIONS 2779
+
+/**
+ * FNV-1a of $pc, $a, $x, $y, $sp, $status and the clock (low byte) after
+ * every instruction of the headless nestest run
+ */
+#define TEST_NESTEST_TRACE_HASH 0xB3A82605DDCBC6B5ull
+
+/**
+ * Size of a bank of the test mapper, mirrored over $8000-$FFFF
+ */
+#define TEST_BANK_SIZE NESEMU_CARTRIDGE_PRGROM_BANK_SIZE
+
+/**
+ * Fail the current test (returns EXIT_FAILURE) if 'cond' does not hold
+ */
+#define TEST_ASSERT(cond)                                                \
+	do {                                                             \
+		if (!(cond)) {                                           \
+			fprintf(stderr, "%s:%d: assertion failed: %s\n", \
+				__FILE__, __LINE__, #cond);              \
+			return EXIT_FAILURE;                             \
+		}                                                        \
+	} while (0)
+
+/**
+ * Same as 'TEST_ASSERT' for a call returning NESEMU_RETURN_SUCCESS
+ */
+#define TEST_OK(call) TEST_ASSERT((call) == NESEMU_RETURN_SUCCESS)
+
+/**
+ * Run a test function, keep going but remember failures
+ */
+#define TEST_RUN(result, fn)                                     \
+	do {                                                     \
+		if ((fn)() != EXIT_SUCCESS) {                    \
+			fprintf(stderr, "FAIL %s\n", #fn);        \
+			(result) = EXIT_FAILURE;                 \
+		} else {                                         \
+			printf("ok   %s\n", #fn);                \
+		}                                                \
+	} while (0)
+
+/**
+ * Load nestest.nes into a cartridge
+ */
+static inline int test_load(struct nes_cartridge *cartridge)
+{
+	FILE *f = fopen(TEST_CARTRIDGE, "rb");
+	if (f == NULL) {
+		perror("cannot open " TEST_CARTRIDGE);
+		return EXIT_FAILURE;
+	}
+
+	static uint8_t cdata[0x10000];
+	size_t clen = fread(cdata, 1, sizeof(cdata), f);
+	(void)fclose(f);
+
+	TEST_OK(nes_cartridge_read_ines(cartridge, cdata, clen));
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Load nestest and initialize the bus and the CPU at the headless entry
+ * point
+ */
+static inline int test_setup(struct nes_cartridge *cartridge,
+			     struct nes_mem_main *mem,
+			     struct nes_cpu *cpu)
+{
+	TEST_ASSERT(test_load(cartridge) == EXIT_SUCCESS);
+	TEST_OK(nes_mem_init(mem, cartridge));
+	TEST_OK(nes_cpu_init(cpu, mem));
+	cpu->pc = TEST_NESTEST_PC;
+
+	return EXIT_SUCCESS;
+}
+
+/* -- Test mapper -- */
+
+/*
+ * Two 16 KiB PRG banks in the NROM storage, the selected one is mirrored
+ * over $8000-$FFFF and any write there selects bank (data & 1). 8 KiB of
+ * RAM at $6000-$7FFF.
+ */
+
+static struct nes_cartridge *test_mapper_cartridge;
+static uint8_t test_mapper_bank;
+static uint8_t test_mapper_ram[NESEMU_CARTRIDGE_RAM_SIZE];
+
+static inline uint32_t test_mapper_offset_of(uint16_t addr)
+{
+	return (uint32_t)test_mapper_bank * TEST_BANK_SIZE +
+	       (addr % TEST_BANK_SIZE);
+}
+
+static nesemu_return_t test_mapper_read(nesemu_mapper_generic_ref_t self,
+					uint16_t addr,
+					uint8_t *content)
+{
+	struct nes_ines_nrom_cartridge *nrom = self;
+	if (addr >= NESEMU_CARTRIDGE_ROM_BEGIN) {
+		*content = nrom->prgrom[test_mapper_offset_of(addr)];
+	} else if (addr >= NESEMU_CARTRIDGE_RAM_BEGIN) {
+		*content = test_mapper_ram[addr - NESEMU_CARTRIDGE_RAM_BEGIN];
+	} else {
+		return NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED;
+	}
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static nesemu_return_t test_mapper_write(nesemu_mapper_generic_ref_t self,
+					 uint16_t addr,
+					 uint8_t content)
+{
+	(void)self;
+	if (addr >= NESEMU_CARTRIDGE_ROM_BEGIN) {
+		// Like real mappers, only an actual switch remaps the window
+		if (test_mapper_bank != (content & 1)) {
+			test_mapper_bank = content & 1;
+			test_mapper_cartridge->prg_version++;
+		}
+	} else if (addr >= NESEMU_CARTRIDGE_RAM_BEGIN) {
+		test_mapper_ram[addr - NESEMU_CARTRIDGE_RAM_BEGIN] = content;
+	} else {
+		return NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED;
+	}
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static nesemu_return_t test_mapper_offset(nesemu_mapper_generic_ref_t self,
+					  uint16_t addr,
+					  uint32_t *offset)
+{
+	(void)self;
+	if (addr < NESEMU_CARTRIDGE_ROM_BEGIN) {
+		return NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED;
+	}
+	*offset = test_mapper_offset_of(addr);
+	return NESEMU_RETURN_SUCCESS;
+}
+
+static nesemu_return_t test_mapper_page(nesemu_mapper_generic_ref_t self,
+					uint16_t addr,
+					const uint8_t **read,
+					uint8_t **write)
+{
+	struct nes_ines_nrom_cartridge *nrom = self;
+	*read = NULL;
+	*write = NULL;
+	if (addr >= NESEMU_CARTRIDGE_ROM_BEGIN) {
+		*read = &nrom->prgrom[test_mapper_offset_of(addr)];
+	} else if (addr >= NESEMU_CARTRIDGE_RAM_BEGIN) {
+		*write = &test_mapper_ram[addr - NESEMU_CARTRIDGE_RAM_BEGIN];
+		*read = *write;
+	}
+	return NESEMU_RETURN_SUCCESS;
+}
+
+/**
+ * Load nestest (for its CHR ROM and nametable mirroring) and replace its
+ * PRG callbacks with the test mapper, both banks filled with NOPs
+ *
+ * @param paged Expose the memory to the page table ('prg_page_fn'),
+ * otherwise every access goes through the callbacks
+ */
+static inline int test_mapper_setup(struct nes_cartridge *cartridge,
+				    bool paged)
+{
+	TEST_ASSERT(test_load(cartridge) == EXIT_SUCCESS);
+
+	test_mapper_cartridge = cartridge;
+	test_mapper_bank = 0;
+	memset(test_mapper_ram, 0, sizeof(test_mapper_ram));
+	memset(cartridge->mapper.nrom.prgrom, 0xEA,
+	       sizeof(cartridge->mapper.nrom.prgrom));
+
+	cartridge->prg_read_fn = test_mapper_read;
+	cartridge->prg_write_fn = test_mapper_write;
+	cartridge->prg_offset_fn = test_mapper_offset;
+	cartridge->prg_page_fn = paged ? test_mapper_page : NULL;
+	cartridge->prg_size = 2 * TEST_BANK_SIZE;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Copy a program into a bank of the test mapper at CPU address 'addr'
+ */
+static inline void test_mapper_program(struct nes_cartridge *cartridge,
+				       uint8_t bank,
+				       uint16_t addr,
+				       const uint8_t *code,
+				       size_t len)
+{
+	memcpy(&cartridge->mapper.nrom
+			.prgrom[(uint32_t)bank * TEST_BANK_SIZE +
+				(addr % TEST_BANK_SIZE)],
+	       code, len);
+}
+
+#endif
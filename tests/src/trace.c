@@ -0,0 +1,164 @@
+/**
+ * Instruction trace: nestest run with a trace attached, formatted lines
+ * against an excerpt of the reference log (tests/resources/nestest.log)
+ *
+ * Reference:
+ * https://www.qmtpro.com/~nes/misc/nestest.log
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/cpu/trace.h"
+#include "nesemu/memory/main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_LOG "nestest.log"
+
+/**
+ * Lines of the excerpt
+ */
+#define TRACE_LINES_MAX 256
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_trace trace;
+
+static char expected[TRACE_LINES_MAX][NESEMU_CPU_TRACE_LINE_SIZE];
+static size_t expected_count;
+
+/**
+ * Read a line without its terminator (LF or CRLF)
+ *
+ * @return false at the end of the file
+ */
+static bool trace_getline(FILE *f, char *line)
+{
+	if (fgets(line, NESEMU_CPU_TRACE_LINE_SIZE, f) == NULL) {
+		return false;
+	}
+	line[strcspn(line, "\r\n")] = '\0';
+	return true;
+}
+
+static int trace_load_log(void)
+{
+	FILE *f = fopen(TRACE_LOG, "r");
+	if (f == NULL) {
+		perror("cannot open " TRACE_LOG);
+		return EXIT_FAILURE;
+	}
+
+	expected_count = 0;
+	while (expected_count < TRACE_LINES_MAX &&
+	       trace_getline(f, expected[expected_count])) {
+		expected_count++;
+	}
+	(void)fclose(f);
+
+	TEST_ASSERT(expected_count > 0);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run nestest for as many instructions as the excerpt has lines
+ */
+static int trace_run(void)
+{
+	TEST_ASSERT(test_setup(&cartridge, &mem, &cpu) == EXIT_SUCCESS);
+	TEST_OK(nes_cpu_trace_attach(&trace, &cpu));
+
+	// The log starts after the reset sequence
+	TEST_ASSERT(cpu.clock == NESEMU_CPU_INTERRUPT_CYCLES);
+
+	for (size_t i = 0; i < expected_count; i++) {
+		int c = 0;
+		TEST_OK(nes_cpu_next(&cpu, &mem, &c));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Compare formatted lines with the excerpt, reporting the first mismatch
+ */
+static int trace_compare(FILE *f)
+{
+	char line[NESEMU_CPU_TRACE_LINE_SIZE];
+
+	rewind(f);
+	for (size_t i = 0; i < expected_count; i++) {
+		TEST_ASSERT(trace_getline(f, line));
+		if (strcmp(line, expected[i]) != 0) {
+			fprintf(stderr, "line %zu:\n  expected: %s\n  got:      %s\n",
+				i + 1, expected[i], line);
+			return EXIT_FAILURE;
+		}
+	}
+	TEST_ASSERT(!trace_getline(f, line));
+
+	return EXIT_SUCCESS;
+}
+
+static int test_dump(void)
+{
+	TEST_OK(nes_cpu_trace_init(&trace, NESEMU_CPU_TRACE_SIZE));
+	int result = trace_run();
+
+	FILE *f = tmpfile();
+	TEST_ASSERT(f != NULL);
+	if (result == EXIT_SUCCESS) {
+		TEST_OK(nes_cpu_trace_dump(&trace, f));
+		result = trace_compare(f);
+	}
+
+	(void)fclose(f);
+	TEST_OK(nes_cpu_trace_destroy(&trace));
+	return result;
+}
+
+static int test_spill(void)
+{
+	FILE *spill = tmpfile();
+	FILE *f = tmpfile();
+	TEST_ASSERT(spill != NULL && f != NULL);
+
+	// Records go through the writer thread and the file format
+	TEST_OK(nes_cpu_trace_init(&trace, NESEMU_CPU_TRACE_SIZE));
+	TEST_OK(nes_cpu_trace_spill_start(&trace, spill));
+	int result = trace_run();
+	TEST_OK(nes_cpu_trace_spill_stop(&trace));
+	TEST_ASSERT(trace.dropped == 0);
+
+	if (result == EXIT_SUCCESS) {
+		rewind(spill);
+		TEST_OK(nes_cpu_trace_format_file(spill, f));
+		result = trace_compare(f);
+	}
+
+	(void)fclose(spill);
+	(void)fclose(f);
+	TEST_OK(nes_cpu_trace_destroy(&trace));
+	return result;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (trace_load_log() != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	TEST_RUN(result, test_dump);
+	TEST_RUN(result, test_spill);
+
+	return result;
+}
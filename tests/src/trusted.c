@@ -0,0 +1,143 @@
+/**
+ * Trusted builds (CONFIG_NESEMU_TRUSTED): bus errors land in the sticky
+ * error slot and are reported once per 'nes_cpu_next'/'nes_cpu_run' call
+ *
+ * Only built as TestTrusted, over a library built with the same definition.
+ */
+
+#include "test.h"
+
+#include "nesemu/cpu/block.h"
+#include "nesemu/cpu/cpu.h"
+#include "nesemu/memory/main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef CONFIG_NESEMU_TRUSTED
+#error "Build with CONFIG_NESEMU_TRUSTED"
+#endif
+
+static struct nes_cartridge cartridge;
+static struct nes_mem_main mem;
+static struct nes_cpu cpu;
+static struct nes_cpu_block_cache blocks;
+
+/*
+ * Reads $5000, nothing is mapped there by the test mapper
+ */
+static const uint8_t code_unmapped[] = {
+	0xA2, 0x00, // $C000 LDX #$00
+	0xAD, 0x00, 0x50, // $C002 LDA $5000
+	0xE8, // $C005 INX
+	0xDB, // $C006 STP
+};
+
+/**
+ * Bus and CPU over the test mapper running 'code_unmapped'
+ */
+static int trusted_setup(bool with_blocks)
+{
+	TEST_ASSERT(test_mapper_setup(&cartridge, true) == EXIT_SUCCESS);
+	test_mapper_program(&cartridge, 0, 0xC000, code_unmapped,
+			    sizeof(code_unmapped));
+	TEST_OK(nes_mem_init(&mem, &cartridge));
+	TEST_OK(nes_cpu_init(&cpu, &mem));
+	if (with_blocks) {
+		TEST_OK(nes_cpu_block_cache_init(&blocks, &mem));
+		TEST_OK(nes_cpu_block_cache_attach(&blocks, &cpu));
+	}
+	cpu.pc = 0xC000;
+
+	return EXIT_SUCCESS;
+}
+
+static int test_sticky_bus(void)
+{
+	TEST_ASSERT(trusted_setup(false) == EXIT_SUCCESS);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_SUCCESS);
+
+	// Recorded, not returned
+	(void)nes_mem_read8(&mem, 0x5000);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+
+	// Kept across successful accesses
+	nes_mem_write8(&mem, 0x0000, 0x01);
+	TEST_ASSERT(nes_mem_read8(&mem, 0x0000) == 0x01);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+
+	// Checked variants leave the slot alone
+	uint8_t value = 0;
+	TEST_ASSERT(nes_mem_r8(&mem, 0x5001, &value) ==
+		    NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+	TEST_OK(nes_mem_r8(&mem, 0x0000, &value));
+	TEST_ASSERT(mem.error == NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+
+	// Taken once
+	TEST_ASSERT(nes_mem_error(&mem) ==
+		    NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_SUCCESS);
+	TEST_OK(nes_mem_error(&mem));
+
+	return EXIT_SUCCESS;
+}
+
+static int test_sticky_next(void)
+{
+	TEST_ASSERT(trusted_setup(false) == EXIT_SUCCESS);
+	int cycles = 0;
+
+	TEST_OK(nes_cpu_next(&cpu, &mem, &cycles));
+
+	// Reported by the instruction that failed, the CPU stops
+	TEST_ASSERT(nes_cpu_next(&cpu, &mem, &cycles) ==
+		    NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+	TEST_ASSERT(cpu.pc == 0xC005);
+	TEST_ASSERT(cpu.stop);
+	TEST_ASSERT(cpu.brk == 0xFF);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_SUCCESS);
+
+	return EXIT_SUCCESS;
+}
+
+static int sticky_run_check(bool with_blocks)
+{
+	TEST_ASSERT(trusted_setup(with_blocks) == EXIT_SUCCESS);
+	int cycles = 0;
+
+	// Reported at the end of the batch, which may run past the failing
+	// instruction
+	TEST_ASSERT(nes_cpu_run(&cpu, &mem, 1000, &cycles) ==
+		    NESEMU_RETURN_CARTRIDGE_ADDR_NOT_MAPPED);
+	TEST_ASSERT(cpu.stop);
+	TEST_ASSERT(cpu.brk == 0xFF);
+	TEST_ASSERT(cpu.pc >= 0xC005 && cpu.pc <= 0xC007);
+	TEST_ASSERT(cycles > 0 && cycles < 1000);
+	TEST_ASSERT(mem.error == NESEMU_RETURN_SUCCESS);
+
+	// Stays stopped
+	TEST_OK(nes_cpu_run(&cpu, &mem, 1000, &cycles));
+	TEST_ASSERT(cycles == 0);
+
+	return EXIT_SUCCESS;
+}
+
+static int test_sticky_run(void)
+{
+	TEST_ASSERT(sticky_run_check(false) == EXIT_SUCCESS);
+	return sticky_run_check(true);
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	TEST_RUN(result, test_sticky_bus);
+	TEST_RUN(result, test_sticky_next);
+	TEST_RUN(result, test_sticky_run);
+
+	return result;
+}